@@ -285,6 +285,7 @@ void actDoor(Entity* my)
 					my->x -= 5;
 				}
 				my->flags[PASSABLE] = false;
+				++mapGeneration;
 			}
 		}
 		else if ( my->yaw != my->doorStartAng && !my->flags[PASSABLE] )
@@ -299,6 +300,7 @@ void actDoor(Entity* my)
 				my->x += 5;
 			}
 			my->flags[PASSABLE] = true;
+			++mapGeneration;
 		}
 
 		// update for clients
@@ -202,11 +202,13 @@ void Entity::actGate()
 		if ( !somebodyinside )
 		{
 			this->flags[PASSABLE] = false;
+			++mapGeneration;
 		}
 	}
 	else if ( this->z < gateStartHeight - 9 && !this->flags[PASSABLE] )
 	{
 		this->flags[PASSABLE] = true;
+		++mapGeneration;
 	}
 
 	//if ( multiplayer != CLIENT )
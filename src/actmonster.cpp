@@ -29,6 +29,7 @@
 #include "mod_tools.hpp"
 #include "ui/MainMenu.hpp"
 #include "menu.hpp"
+#include "jobs.hpp"
 
 float limbs[NUMMONSTERS][20][3];
 
@@ -3689,9 +3690,10 @@ void actMonster(Entity* my)
 	Entity* ringConflictHolder = nullptr;
 	if ( myStats->type != LICH_ICE && myStats->type != LICH_FIRE )
 	{
-		for ( node = map.creatures->first; node != nullptr; node = node->next ) //Only creatures can wear rings, so don't search map.entities.
+		static std::vector<Entity*> nearbyCreatures; // query buffers are reused across calls, nothing here re-enters actMonster
+		CreatureHash.getCreaturesWithinRadius(my->x, my->y, 5 * TOUCHRANGE, nearbyCreatures, true);
+		for ( Entity* tempentity : nearbyCreatures ) //Only creatures can wear rings, so don't search map.entities.
 		{
-			Entity* tempentity = (Entity*)node->element;
 			if ( tempentity != nullptr && tempentity != my )
 			{
 				Stat* tempstats = tempentity->getStats();
@@ -4409,9 +4411,12 @@ void actMonster(Entity* my)
 					}
 				}
 
-				for ( node2 = map.creatures->first; node2 != nullptr; node2 = node2->next ) //So my concern is that this never explicitly checks for actMonster or actPlayer, instead it relies on there being stats. Now, only monsters and players have stats, so that's not a problem, except...actPlayerLimb can still return a stat from getStat()! D: Meh, if you can find the player's hand, you can find the actual player too, so it shouldn't be an issue.
+				static std::vector<Entity*> nearbyCreatures;
+				CreatureHash.getCreaturesWithinRadius(my->x, my->y,
+					std::max(sightranges[myStats->type], 96.0), nearbyCreatures, true); // dummybots are seen from further
+				for ( Entity* nearby : nearbyCreatures ) //So my concern is that this never explicitly checks for actMonster or actPlayer, instead it relies on there being stats. Now, only monsters and players have stats, so that's not a problem, except...actPlayerLimb can still return a stat from getStat()! D: Meh, if you can find the player's hand, you can find the actual player too, so it shouldn't be an issue.
 				{
-					entity = (Entity*)node2->element;
+					entity = nearby;
 					if ( entity == my || entity->flags[PASSABLE] || entity->isInertMimic() )
 					{
 						continue;
@@ -4503,7 +4508,12 @@ void actMonster(Entity* my)
 
 							if ( visiontest )   // vision cone
 							{
-								if ( (myStats->type >= LICH && myStats->type < KOBOLD) || myStats->type == LICH_FIRE || myStats->type == LICH_ICE || myStats->type == SHADOW )
+								const bool seeInvisible = MonsterThinkPhase::monsterSeesInvisible(*myStats);
+								if ( MonsterThink.getVisionConeHit(*my, *entity, seeInvisible, hit) )
+								{
+									// already traced by the think pass this tick
+								}
+								else if ( seeInvisible )
 								{
 									//See invisible
 									lineTrace(my, my->x, my->y, tangent, monsterVisionRange, 0, false);
@@ -4514,6 +4524,7 @@ void actMonster(Entity* my)
 								}
 								if ( !hit.entity )
 								{
+									// touch range check against every entity, never cached
 									lineTrace(my, my->x, my->y, tangent, TOUCHRANGE, 0, false);
 								}
 								if ( hit.entity == entity )
@@ -4562,9 +4573,12 @@ void actMonster(Entity* my)
 									}
 
 									// alert other monsters of this enemy's presence //TODO: Refactor into its own function.
-									for ( node = map.creatures->first; node != nullptr; node = node->next )
+									// (lineTrace can still hit a creature centred a little past its range)
+									static std::vector<Entity*> nearbyFriends;
+									CreatureHash.getCreaturesWithinRadius(my->x, my->y, monsterVisionRange + 32.0, nearbyFriends, true);
+									for ( Entity* nearby : nearbyFriends )
 									{
-										entity = (Entity*)node->element;
+										entity = nearby;
 										if ( entity->behavior == &actMonster && entity != my )
 										{
 											Stat* buddystats = entity->getStats();
@@ -4859,9 +4873,10 @@ void actMonster(Entity* my)
 					else
 					{
 						real_t dist = sightranges[myStats->type];
-						for ( node = map.creatures->first; node != nullptr; node = node->next )
+						static std::vector<Entity*> nearbyTargets;
+						CreatureHash.getCreaturesWithinRadius(my->x, my->y, sightranges[myStats->type], nearbyTargets, true);
+						for ( Entity* target : nearbyTargets )
 						{
-							Entity* target = (Entity*)node->element;
 							if ( target->behavior == &actMonster && my->checkEnemy(target) )
 							{
 								real_t oldDist = dist;
@@ -5931,9 +5946,12 @@ timeToGoAgain:
 
 			if ( myReflex && (myStats->type != LICH || my->monsterSpecialTimer <= 0) )
 			{
-				for ( node2 = map.creatures->first; node2 != nullptr; node2 = node2->next ) //Stats only exist on a creature, so don't iterate all map.entities.
+				static std::vector<Entity*> nearbyCreatures;
+				CreatureHash.getCreaturesWithinRadius(my->x, my->y,
+					std::max(sightranges[myStats->type], 96.0), nearbyCreatures, true); // dummybots are seen from further
+				for ( Entity* nearby : nearbyCreatures ) //Stats only exist on a creature, so don't iterate all map.entities.
 				{
-					entity = (Entity*)node2->element;
+					entity = nearby;
 					if ( entity == my || entity->flags[PASSABLE] || entity->isInertMimic() )
 					{
 						continue;
@@ -6826,9 +6844,10 @@ timeToGoAgain:
 								//messagePlayer(0, "Sent a move to command, defending here!");
 								// scan for enemies after reaching move point.
 								real_t dist = sightranges[myStats->type];
-								for ( node = map.creatures->first; node != nullptr; node = node->next )
+								static std::vector<Entity*> nearbyTargets;
+								CreatureHash.getCreaturesWithinRadius(my->x, my->y, sightranges[myStats->type], nearbyTargets, true);
+								for ( Entity* target : nearbyTargets )
 								{
-									Entity* target = (Entity*)node->element;
 									if ( target && target->behavior == &actMonster && !target->isInertMimic() && my->checkEnemy(target) )
 									{
 										real_t oldDist = dist;
@@ -6867,9 +6886,10 @@ timeToGoAgain:
 						{
 							// scan for enemies after reaching move point.
 							real_t dist = sightranges[myStats->type];
-							for ( node = map.creatures->first; node != nullptr; node = node->next )
+							static std::vector<Entity*> nearbyTargets;
+							CreatureHash.getCreaturesWithinRadius(my->x, my->y, sightranges[myStats->type], nearbyTargets, true);
+							for ( Entity* target : nearbyTargets )
 							{
-								Entity* target = (Entity*)node->element;
 								if ( target && target->behavior == &actMonster && !target->isInertMimic() && my->checkEnemy(target) )
 								{
 									real_t oldDist = dist;
@@ -6979,9 +6999,10 @@ timeToGoAgain:
 							//messagePlayer(0, "Issued move command, defending here.");
 							// scan for enemies after reaching move point.
 							real_t dist = sightranges[myStats->type];
-							for ( node = map.creatures->first; node != nullptr; node = node->next )
+							static std::vector<Entity*> nearbyTargets;
+							CreatureHash.getCreaturesWithinRadius(my->x, my->y, sightranges[myStats->type], nearbyTargets, true);
+							for ( Entity* target : nearbyTargets )
 							{
-								Entity* target = (Entity*)node->element;
 								if ( target && target->behavior == &actMonster && !target->isInertMimic() && my->checkEnemy(target) )
 								{
 									real_t oldDist = dist;
@@ -8364,9 +8385,10 @@ timeToGoAgain:
 
 			if ( myReflex && my->monsterSpecialState == MIMIC_INERT_SECOND )
 			{
-				for ( node_t* node2 = map.creatures->first; node2 != nullptr; node2 = node2->next )
+				static std::vector<Entity*> nearbyCreatures;
+				CreatureHash.getCreaturesWithinRadius(my->x, my->y, 24.0, nearbyCreatures, true);
+				for ( Entity* entity : nearbyCreatures )
 				{
-					Entity* entity = (Entity*)node2->element;
 					if ( entity == my || entity->flags[PASSABLE] )
 					{
 						continue;
@@ -10024,14 +10046,13 @@ bool Entity::handleMonsterSpecialAttack(Stat* myStats, Entity* target, double di
 
 void getTargetsAroundEntity(Entity* my, Entity* originalTarget, double distToFind, real_t angleToSearch, int searchType, list_t** list)
 {
-	Entity* entity = nullptr;
-	node_t* node = nullptr;
 	node_t* node2 = nullptr;
 
 	// aoe
-	for ( node = map.creatures->first; node != nullptr; node = node->next ) //Only looks at monsters and players, don't iterate all entities (map.entities).
+	static std::vector<Entity*> nearbyCreatures;
+	CreatureHash.getCreaturesWithinCone(my->x, my->y, distToFind, my->yaw, angleToSearch, nearbyCreatures, true);
+	for ( Entity* entity : nearbyCreatures ) //Only looks at monsters and players, don't iterate all entities (map.entities).
 	{
-		entity = (Entity*)node->element;
 		if ( (entity->behavior == &actMonster || entity->behavior == &actPlayer) && entity != originalTarget && entity != my )
 		{
 			if ( searchType == MONSTER_TARGET_ENEMY )
@@ -10059,33 +10080,21 @@ void getTargetsAroundEntity(Entity* my, Entity* originalTarget, double distToFin
 			{
 			}
 
-			double aoeTangent = atan2(entity->y - my->y, entity->x - my->x);
-			real_t angle = my->yaw - aoeTangent;
-			while ( angle >= PI )
-			{
-				angle -= PI * 2;
-			}
-			while ( angle < -PI )
+			// the cone already searches in 2x the given angle, +/- from yaw.
+			double dist = sqrt(pow(my->x - entity->x, 2) + pow(my->y - entity->y, 2));
+			if ( dist < distToFind )
 			{
-				angle += PI * 2;
-			}
-			if ( abs(angle) <= angleToSearch ) // searches in 2x the given angle, +/- from yaw.
-			{
-				double dist = sqrt(pow(my->x - entity->x, 2) + pow(my->y - entity->y, 2));
-				if ( dist < distToFind )
+				//If this is the first entity found, the list needs to be created.
+				if ( !(*list) )
 				{
-					//If this is the first entity found, the list needs to be created.
-					if ( !(*list) )
-					{
-						*list = (list_t*)malloc(sizeof(list_t));
-						(*list)->first = nullptr;
-						(*list)->last = nullptr;
-					}
-					node2 = list_AddNodeLast(*list);
-					node2->element = entity;
-					node2->deconstructor = &emptyDeconstructor;
-					node2->size = sizeof(Entity*);
+					*list = (list_t*)malloc(sizeof(list_t));
+					(*list)->first = nullptr;
+					(*list)->last = nullptr;
 				}
+				node2 = list_AddNodeLast(*list);
+				node2->element = entity;
+				node2->deconstructor = &emptyDeconstructor;
+				node2->size = sizeof(Entity*);
 			}
 		}
 	}
@@ -12534,3 +12543,219 @@ void mimicResetIdle(Entity* my)
 		my->monsterLookDir = (PI / 2) * (local_rng.rand() % 4);
 	}
 }
+
+/*-------------------------------------------------------------------------------
+
+	MonsterThinkPhase
+
+	Traces the vision cone sight checks of every waiting monster in parallel
+	before the server entity loop runs. Workers only read the world (entity
+	positions, stats, the tile entity list and map tiles) and write into their
+	own Thought_t, so the result doesn't depend on how the work is split up.
+	The serial pass through actMonster still happens in map.entities order and
+	does all of the rng calls and state changes exactly as before.
+
+-------------------------------------------------------------------------------*/
+
+MonsterThinkPhase MonsterThink;
+static ConsoleVariable<bool> cvar_monster_think_parallel("/monster_think_parallel", true);
+static ConsoleVariable<int> cvar_monster_think_min_batch("/monster_think_min_batch", 8);
+
+bool MonsterThinkPhase::monsterSeesInvisible(const Stat& myStats)
+{
+	return (myStats.type >= LICH && myStats.type < KOBOLD) || myStats.type == LICH_FIRE
+		|| myStats.type == LICH_ICE || myStats.type == SHADOW;
+}
+
+void MonsterThinkPhase::think(Thought_t& thought)
+{
+	Entity* my = thought.monster;
+	Stat* myStats = my->getStats();
+	if ( !myStats )
+	{
+		return;
+	}
+
+	// same candidates as the MONSTER_STATE_WAIT loop in actMonster. sights are
+	// looked up by target, so the order doesn't matter here
+	static thread_local std::vector<Entity*> nearbyCreatures;
+	CreatureHash.getCreaturesWithinRadius(thought.x, thought.y,
+		std::max(sightranges[myStats->type], 96.0), nearbyCreatures, false);
+	for ( Entity* entity : nearbyCreatures )
+	{
+		if ( entity == my || entity->flags[PASSABLE] || entity->isInertMimic() )
+		{
+			continue;
+		}
+		Stat* hitstats = entity->getStats();
+		if ( !hitstats )
+		{
+			continue;
+		}
+		real_t monsterVisionRange = sightranges[myStats->type];
+		if ( hitstats->type == DUMMYBOT )
+		{
+			monsterVisionRange = std::max(monsterVisionRange, 96.0);
+		}
+		real_t targetdist = sqrt(pow(thought.x - entity->x, 2) + pow(thought.y - entity->y, 2));
+		if ( targetdist > monsterVisionRange )
+		{
+			continue;
+		}
+		real_t tangent = atan2(entity->y - thought.y, entity->x - thought.x);
+		real_t dir = my->yaw - tangent;
+		while ( dir >= PI )
+		{
+			dir -= PI * 2;
+		}
+		while ( dir < -PI )
+		{
+			dir += PI * 2;
+		}
+		if ( dir < -13 * PI / 16 || dir > 13 * PI / 16 )
+		{
+			continue; // outside even the widest vision cone
+		}
+
+		Sight_t sight;
+		sight.targetUid = entity->getUID();
+		sight.targetx = entity->x;
+		sight.targety = entity->y;
+		lineTraceHit(sight.hit, my, thought.x, thought.y, tangent, monsterVisionRange, LINETRACE_IGNORE_ENTITIES, false);
+		if ( sight.hit.entity )
+		{
+			sight.hitUid = sight.hit.entity->getUID();
+			sight.hitx = sight.hit.entity->x;
+			sight.hity = sight.hit.entity->y;
+			sight.hit.entity = nullptr;
+		}
+		thought.sights.push_back(sight);
+	}
+}
+
+void MonsterThinkPhase::run()
+{
+	clear();
+	if ( !*cvar_monster_think_parallel || multiplayer == CLIENT || !map.creatures )
+	{
+		return;
+	}
+
+	for ( node_t* node = map.creatures->first; node != nullptr; node = node->next )
+	{
+		Entity* entity = (Entity*)node->element;
+		if ( !entity || entity->behavior != &actMonster || entity->monsterState != MONSTER_STATE_WAIT )
+		{
+			continue;
+		}
+		Stat* myStats = entity->getStats();
+		if ( !myStats || myStats->HP <= 0 )
+		{
+			continue;
+		}
+		if ( monsterSeesInvisible(*myStats) )
+		{
+			continue; // their traces stop on any entity, which could be anywhere by the time they run
+		}
+		Thought_t thought;
+		thought.monster = entity;
+		thought.uid = entity->getUID();
+		thought.x = entity->x;
+		thought.y = entity->y;
+		thought.seeInvisible = monsterSeesInvisible(*myStats);
+		thoughtIndex[thought.uid] = thoughts.size();
+		thoughts.push_back(std::move(thought));
+	}
+	if ( thoughts.empty() )
+	{
+		return;
+	}
+	generation = mapGeneration;
+
+	// split the monsters into contiguous batches across the job workers. this thread takes the first.
+	const size_t minBatch = std::max(1, *cvar_monster_think_min_batch);
+	Jobs.parallel_for("monster think", 0, thoughts.size(), minBatch, [this](size_t begin, size_t end) {
+		for ( size_t c = begin; c < end; ++c )
+		{
+			think(thoughts[c]);
+		}
+	});
+
+	lastThoughts = thoughts.size();
+	for ( auto& thought : thoughts )
+	{
+		lastSights += thought.sights.size();
+	}
+}
+
+void MonsterThinkPhase::clear()
+{
+	thoughts.clear();
+	thoughtIndex.clear();
+	lastThoughts = 0;
+	lastSights = 0;
+}
+
+/* true if both positions fall on the same map tile */
+static bool sameTile(real_t x1, real_t y1, real_t x2, real_t y2)
+{
+	return (static_cast<int>(x1) >> 4) == (static_cast<int>(x2) >> 4)
+		&& (static_cast<int>(y1) >> 4) == (static_cast<int>(y2) >> 4);
+}
+
+/* fetches the vision cone result traced for my looking at target during run().
+   returns false if there isn't one, or if either party has since left the
+   tile it was on. targets are usually players who move every tick, so an
+   exact position match would almost never hit. */
+bool MonsterThinkPhase::getVisionConeHit(Entity& my, Entity& target, bool seeInvisible, hit_t& out)
+{
+	auto find = thoughtIndex.find(my.getUID());
+	if ( find == thoughtIndex.end() )
+	{
+		return false;
+	}
+	const Thought_t& thought = thoughts[find->second];
+	if ( thought.monster != &my || !sameTile(thought.x, thought.y, my.x, my.y) || thought.seeInvisible != seeInvisible
+		|| generation != mapGeneration )
+	{
+		++missed;
+		return false;
+	}
+	for ( auto& sight : thought.sights )
+	{
+		if ( sight.targetUid == target.getUID() )
+		{
+			if ( !sameTile(sight.targetx, sight.targety, target.x, target.y) )
+			{
+				++missed;
+				return false;
+			}
+			Entity* hitEntity = nullptr;
+			if ( sight.hitUid )
+			{
+				// whatever blocked the view may have moved or been removed since
+				hitEntity = uidToEntity(sight.hitUid);
+				if ( !hitEntity || !sameTile(sight.hitx, sight.hity, hitEntity->x, hitEntity->y) )
+				{
+					++missed;
+					return false;
+				}
+			}
+			out = sight.hit;
+			out.entity = hitEntity;
+			++reused;
+			return true;
+		}
+	}
+	return false;
+}
+
+static ConsoleCommand ccmd_monster_think_stats("/monster_think_stats", "print counters for the parallel monster think pass",
+	[](int argc, const char** argv) {
+	const Uint32 lookups = MonsterThink.reused + MonsterThink.missed;
+	messagePlayer(clientnum, MESSAGE_MISC, "monster think: %u monsters, %u sight traces last tick, %u reused / %u stale since last asked (%.0f%% hit)",
+		MonsterThink.lastThoughts, MonsterThink.lastSights, MonsterThink.reused, MonsterThink.missed,
+		lookups ? 100.0 * MonsterThink.reused / lookups : 0.0);
+	MonsterThink.reused = 0;
+	MonsterThink.missed = 0;
+	});
@@ -44,6 +44,8 @@ void actWallBuster(Entity* my)
 		Uint16 y = std::min<Uint16>(std::max<int>(0.0, my->y / 16), map.height - 1);
 		map.tiles[OBSTACLELAYER + y * MAPLAYERS + x * MAPLAYERS * map.height] = 0;
 		map.tiles[(MAPLAYERS - 1) + y * MAPLAYERS + x * MAPLAYERS * map.height] = 0;
+		mapTileChanged(x, y);
+		markChunksDirty(x, y);
 		spawnExplosion(my->x, my->y, my->z - 8);
 		if ( multiplayer == SERVER )
 		{
@@ -62,7 +64,7 @@ void actWallBuster(Entity* my)
 				sendPacketSafe(net_sock, -1, net_packet, c - 1);
 			}
 		}
-		generatePathMaps();
+		updatePathMaps(x, y);
 		list_RemoveNode(my->mynode);
 	}
 }
@@ -133,6 +135,8 @@ void actWallBuilder(Entity* my)
 		Uint16 x = std::min<Uint16>(std::max<int>(0.0, my->x / 16), map.width - 1);
 		Uint16 y = std::min<Uint16>(std::max<int>(0.0, my->y / 16), map.height - 1);
 		map.tiles[OBSTACLELAYER + y * MAPLAYERS + x * MAPLAYERS * map.height] = map.tiles[y * MAPLAYERS + x * MAPLAYERS * map.height];
+		mapTileChanged(x, y);
+		markChunksDirty(x, y);
 
 		const real_t effectOffset = 2.0;
 		spawnPoof(static_cast<Sint16>(x * 16.0 - effectOffset), static_cast<Sint16>(y * 16.0 - effectOffset), 8, 1.0);
@@ -157,7 +161,7 @@ void actWallBuilder(Entity* my)
 				sendPacketSafe(net_sock, -1, net_packet, c - 1);
 			}
 		}
-		generatePathMaps();
+		updatePathMaps(x, y);
 		list_RemoveNode(my->mynode);
 	}
 }
\ No newline at end of file
@@ -587,12 +587,9 @@ void buttonNewConfirm(button_t* my)
 			}
 		}
 	}
-    for (int c = 0; c < MAXPLAYERS + 1; ++c) {
-        lightmaps[c].clear();
-        lightmaps[c].resize(map.width * map.height);
-        lightmapsSmoothed[c].clear();
-        lightmapsSmoothed[c].resize((map.width + 2) * (map.height + 2));
-    }
+    resetLightmaps(map.width, map.height, 0.f);
+	mapTileChanged();
+	markChunksDirty();
 	strcpy(message, "                             Created a new map.");
 	filename[0] = 0;
 	oldfilename[0] = 0;
@@ -1054,6 +1051,8 @@ void buttonDelete(button_t* my)
 			for ( y = selectedarea_y1; y <= selectedarea_y2; y++ )
 			{
 				map.tiles[drawlayer + y * MAPLAYERS + x * MAPLAYERS * map.height] = 0;
+				mapTileChanged(x, y);
+				markChunksDirty(x, y);
 			}
 		}
 		selectedarea = false;
@@ -1491,12 +1490,7 @@ void buttonAttributesConfirm(button_t* my)
     memset(camera.vismap, 0, sizeof(bool) * map.height * map.width);
 	strcpy(map.name, nametext);
 	strcpy(map.author, authortext);
-    for (int c = 0; c < MAXPLAYERS + 1; ++c) {
-        lightmaps[c].clear();
-        lightmaps[c].resize(map.width * map.height);
-        lightmapsSmoothed[c].clear();
-        lightmapsSmoothed[c].resize((map.width + 2) * (map.height + 2));
-    }
+    resetLightmaps(map.width, map.height, 0.f);
 
 	// transfer data from the new map to the old map and fill extra space with empty data
 	for ( z = 0; z < MAPLAYERS; z++ )
@@ -1517,6 +1511,8 @@ void buttonAttributesConfirm(button_t* my)
 		}
 	}
 	free(mapcopy.tiles);
+	mapTileChanged();
+	markChunksDirty();
 	strcpy(message, "                       Modified map attributes.");
 	messagetime = 60;
 	buttonCloseSubwindow(my);
@@ -1579,6 +1575,8 @@ void buttonClearMapConfirm(button_t* my)
 			}
 		}
 	}
+	mapTileChanged();
+	markChunksDirty();
 	list_FreeAll(map.entities);
 	buttonCloseSubwindow(my);
 }
@@ -447,32 +447,21 @@ bool entityInsideSomething(Entity* entity)
 	}
 
 	// test against entities
-	std::vector<list_t*> entLists = TileEntityList.getEntitiesWithinRadiusAroundEntity(entity, 2);
-	for ( std::vector<list_t*>::iterator it = entLists.begin(); it != entLists.end(); ++it )
-	{
-		list_t* currentList = *it;
-		for ( node_t* node = currentList->first; node != nullptr; node = node->next )
+	return TileEntityList.forEntitiesWithinRadius(static_cast<int>(entity->x) >> 4, static_cast<int>(entity->y) >> 4, 2,
+		[entity](Entity* testEntity) {
+		if ( testEntity == entity || testEntity->flags[PASSABLE] )
 		{
-			Entity* testEntity = (Entity*)node->element;
-			if ( testEntity == entity || testEntity->flags[PASSABLE] )
-			{
-				continue;
-			}
-			if ( entity->behavior == &actDeathGhost )
-			{
-				if ( testEntity->behavior == &actMonster || testEntity->behavior == &actPlayer )
-				{
-					continue;
-				}
-			}
-			if ( entityInsideEntity(entity, testEntity) )
+			return false;
+		}
+		if ( entity->behavior == &actDeathGhost )
+		{
+			if ( testEntity->behavior == &actMonster || testEntity->behavior == &actPlayer )
 			{
-				return true;
+				return false;
 			}
 		}
-	}
-
-	return false;
+		return entityInsideEntity(entity, testEntity);
+	});
 }
 
 static ConsoleVariable<float> cvar_linetrace_smallcollision("/linetrace_smallcollision", 4.0);
@@ -512,7 +501,6 @@ int barony_clear(real_t tx, real_t ty, Entity* my)
 	long x, y;
 	real_t tx2, ty2;
 	node_t* node;
-	Entity* entity;
 	bool levitating = false;
 // Reworked that function to break the loop in two part. 
 // A first fast one using integer only x/y
@@ -620,237 +608,239 @@ int barony_clear(real_t tx, real_t ty, Entity* my)
 			}
 		}
 	}
-	std::vector<list_t*> entLists;
-	if ( multiplayer == CLIENT )
-	{
-		entLists.push_back(map.entities); // clients use old map.entities method
-	}
-	else
-	{
-		entLists = TileEntityList.getEntitiesWithinRadius(static_cast<int>(tx) >> 4, static_cast<int>(ty) >> 4, 2);
-	}
-	for ( std::vector<list_t*>::iterator it = entLists.begin(); it != entLists.end(); ++it )
-	{
-		list_t* currentList = *it;
-		for ( node = currentList->first; node != nullptr; node = node->next )
+	auto collidesWith = [&](Entity* entity) -> bool {
+		if ( entity == my || my->parent == entity->getUID() )
 		{
-			entity = (Entity*)node->element;
-			if ( entity == my || my->parent == entity->getUID() )
-			{
-				continue;
-			}
-			if ( entity->flags[PASSABLE] )
-			{
-				if ( my->behavior == &actBoulder && entity->sprite == 886 )
-				{
-					// 886 is gyrobot, as they are passable, force collision here.
-				}
-				else
-				{
-					continue;
-				}
-			}
-			if ( entity->behavior == &actParticleTimer && static_cast<Uint32>(entity->particleTimerTarget) == my->getUID() )
+			return false;
+		}
+		if ( entity->flags[PASSABLE] )
+		{
+			if ( my->behavior == &actBoulder && entity->sprite == 886 )
 			{
-				continue;
+				// 886 is gyrobot, as they are passable, force collision here.
 			}
-			if ( entity->isDamageableCollider() && entity->colliderHasCollision == 2
-				&& my->behavior == &actMonster && my->getMonsterTypeFromSprite() == MINOTAUR )
+			else
 			{
-				continue;
+				return false;
 			}
-			if ( (my->behavior == &actMonster || my->behavior == &actBoulder) && entity->behavior == &actDoorFrame )
+		}
+		if ( entity->behavior == &actParticleTimer && static_cast<Uint32>(entity->particleTimerTarget) == my->getUID() )
+		{
+			return false;
+		}
+		if ( entity->isDamageableCollider() && entity->colliderHasCollision == 2
+			&& my->behavior == &actMonster && my->getMonsterTypeFromSprite() == MINOTAUR )
+		{
+			return false;
+		}
+		if ( (my->behavior == &actMonster || my->behavior == &actBoulder) && entity->behavior == &actDoorFrame )
+		{
+			return false;    // monsters don't have hard collision with door frames
+		}
+		if ( my->behavior == &actDeathGhost && (entity->behavior == &actMonster 
+			|| entity->behavior == &actPlayer 
+			|| (entity->behavior == &actBoulder && entityInsideEntity(my, entity))) )
+		{
+			return false;
+		}
+		Stat* myStats = stats; //my->getStats();	//SEB <<<
+		Stat* yourStats = entity->getStats();
+		if ( my->behavior == &actPlayer && entity->behavior == &actPlayer )
+		{
+			return false;
+		}
+		if ( myStats && yourStats )
+		{
+			if ( yourStats->leader_uid == my->getUID() )
 			{
-				continue;    // monsters don't have hard collision with door frames
+				return false;
 			}
-			if ( my->behavior == &actDeathGhost && (entity->behavior == &actMonster 
-				|| entity->behavior == &actPlayer 
-				|| (entity->behavior == &actBoulder && entityInsideEntity(my, entity))) )
+			if ( myStats->leader_uid == entity->getUID() )
 			{
-				continue;
+				return false;
 			}
-			Stat* myStats = stats; //my->getStats();	//SEB <<<
-			Stat* yourStats = entity->getStats();
-			if ( my->behavior == &actPlayer && entity->behavior == &actPlayer )
+			if ( entity->behavior == &actMonster && yourStats->type == NOTHING && multiplayer == CLIENT )
 			{
-				continue;
+				// client doesn't know about the type of the monster.
+				yourStats->type = static_cast<Monster>(entity->getMonsterTypeFromSprite());
 			}
-			if ( myStats && yourStats )
+			if ( monsterally[myStats->type][yourStats->type] )
 			{
-				if ( yourStats->leader_uid == my->getUID() )
-				{
-					continue;
-				}
-				if ( myStats->leader_uid == entity->getUID() )
+				if ( my->behavior == &actPlayer && myStats->type != HUMAN )
 				{
-					continue;
-				}
-				if ( entity->behavior == &actMonster && yourStats->type == NOTHING && multiplayer == CLIENT )
-				{
-					// client doesn't know about the type of the monster.
-					yourStats->type = static_cast<Monster>(entity->getMonsterTypeFromSprite());
+					if ( my->checkFriend(entity) )
+					{
+						return false;
+					}
 				}
-				if ( monsterally[myStats->type][yourStats->type] )
+				else if ( my->behavior == &actMonster && entity->behavior == &actPlayer )
 				{
-					if ( my->behavior == &actPlayer && myStats->type != HUMAN )
+					if ( my->checkFriend(entity) )
 					{
-						if ( my->checkFriend(entity) )
-						{
-							continue;
-						}
+						return false;
 					}
-					else if ( my->behavior == &actMonster && entity->behavior == &actPlayer )
+				}
+				else
+				{
+					if ( my->behavior == &actPlayer && yourStats->monsterForceAllegiance == Stat::MONSTER_FORCE_PLAYER_ENEMY
+						|| entity->behavior == &actPlayer && myStats->monsterForceAllegiance == Stat::MONSTER_FORCE_PLAYER_ENEMY )
 					{
-						if ( my->checkFriend(entity) )
-						{
-							continue;
-						}
+						// forced enemies.
 					}
 					else
 					{
-						if ( my->behavior == &actPlayer && yourStats->monsterForceAllegiance == Stat::MONSTER_FORCE_PLAYER_ENEMY
-							|| entity->behavior == &actPlayer && myStats->monsterForceAllegiance == Stat::MONSTER_FORCE_PLAYER_ENEMY )
-						{
-							// forced enemies.
-						}
-						else
-						{
-							continue;
-						}
+						return false;
 					}
 				}
-				else if ( my->behavior == &actPlayer )
-				{
-					if ( my->checkFriend(entity) )
-					{
-						continue;
-					}
-				}
-				if ( (myStats->type == HUMAN || my->flags[USERFLAG2]) && (yourStats->type == HUMAN || entity->flags[USERFLAG2]) )
+			}
+			else if ( my->behavior == &actPlayer )
+			{
+				if ( my->checkFriend(entity) )
 				{
-					continue;
+					return false;
 				}
 			}
-			else if ( multiplayer != CLIENT && tryReduceCollisionSize )
+			if ( (myStats->type == HUMAN || my->flags[USERFLAG2]) && (yourStats->type == HUMAN || entity->flags[USERFLAG2]) )
 			{
-				if ( parent && parentStats && yourStats )
+				return false;
+			}
+		}
+		else if ( multiplayer != CLIENT && tryReduceCollisionSize )
+		{
+			if ( parent && parentStats && yourStats )
+			{
+				reduceCollisionSize = useSmallCollision(*parent, *parentStats, *entity, *yourStats);
+				if ( reduceCollisionSize )
 				{
-					reduceCollisionSize = useSmallCollision(*parent, *parentStats, *entity, *yourStats);
-					if ( reduceCollisionSize )
+					if ( parent->monsterIsTinkeringCreation()
+						&& yourStats->mask && yourStats->mask->type == MASK_TECH_GOGGLES
+						&& (parentStats->leader_uid == entity->getUID()
+							|| parent->monsterAllyGetPlayerLeader() == entity) )
 					{
-						if ( parent->monsterIsTinkeringCreation()
-							&& yourStats->mask && yourStats->mask->type == MASK_TECH_GOGGLES
-							&& (parentStats->leader_uid == entity->getUID()
-								|| parent->monsterAllyGetPlayerLeader() == entity) )
-						{
-							continue;
-						}
+						return false;
 					}
 				}
-				else if ( parent && parent->behavior == &actDeathGhost
-					&& (entity->behavior == &actPlayer
-						|| (entity->behavior == &actMonster && entity->monsterAllyGetPlayerLeader())) )
-				{
-					reduceCollisionSize = true;
-				}
 			}
+			else if ( parent && parent->behavior == &actDeathGhost
+				&& (entity->behavior == &actPlayer
+					|| (entity->behavior == &actMonster && entity->monsterAllyGetPlayerLeader())) )
+			{
+				reduceCollisionSize = true;
+			}
+		}
 
-			if ( multiplayer == CLIENT )
+		if ( multiplayer == CLIENT )
+		{
+			// fixes bug where clients can't move through humans
+			if ( entity->isPlayerHeadSprite() ||
+				entity->sprite == 217 )   // human heads (217 is shopkeep)
 			{
-				// fixes bug where clients can't move through humans
-				if ( entity->isPlayerHeadSprite() ||
-					entity->sprite == 217 )   // human heads (217 is shopkeep)
-				{
-					continue;
-				}
-				else if ( my->behavior == &actPlayer && entity->flags[USERFLAG2] )
-				{
-					continue; // fix clients not being able to walk through friendly monsters
-				}
+				return false;
 			}
-			real_t sizex = entity->sizex;
-			real_t sizey = entity->sizey;
-			if ( reduceCollisionSize )
+			else if ( my->behavior == &actPlayer && entity->flags[USERFLAG2] )
 			{
-				sizex /= *cvar_linetrace_smallcollision;
-				sizey /= *cvar_linetrace_smallcollision;
+				return false; // fix clients not being able to walk through friendly monsters
 			}
-			const real_t eymin = entity->y - sizey, eymax = entity->y + sizey;
-			const real_t exmin = entity->x - sizex, exmax = entity->x + sizex;
-			if ( (entity->sizex > 0) && ((txmin >= exmin && txmin < exmax) || (txmax >= exmin && txmax < exmax) || (txmin <= exmin && txmax > exmax)) )
+		}
+		real_t sizex = entity->sizex;
+		real_t sizey = entity->sizey;
+		if ( reduceCollisionSize )
+		{
+			sizex /= *cvar_linetrace_smallcollision;
+			sizey /= *cvar_linetrace_smallcollision;
+		}
+		const real_t eymin = entity->y - sizey, eymax = entity->y + sizey;
+		const real_t exmin = entity->x - sizex, exmax = entity->x + sizex;
+		if ( (entity->sizex > 0) && ((txmin >= exmin && txmin < exmax) || (txmax >= exmin && txmax < exmax) || (txmin <= exmin && txmax > exmax)) )
+		{
+			if ( (entity->sizey > 0) && ((tymin >= eymin && tymin < eymax) || (tymax >= eymin && tymax < eymax) || (tymin <= eymin && tymax > eymax)) )
 			{
-				if ( (entity->sizey > 0) && ((tymin >= eymin && tymin < eymax) || (tymax >= eymin && tymax < eymax) || (tymin <= eymin && tymax > eymax)) )
+				tx2 = std::max(txmin, exmin);
+				ty2 = std::max(tymin, eymin);
+				hit.x = tx2;
+				hit.y = ty2;
+				hit.mapx = entity->x / 16;
+				hit.mapy = entity->y / 16;
+				hit.entity = entity;
+				if ( multiplayer != CLIENT )
 				{
-					tx2 = std::max(txmin, exmin);
-					ty2 = std::max(tymin, eymin);
-					hit.x = tx2;
-					hit.y = ty2;
-					hit.mapx = entity->x / 16;
-					hit.mapy = entity->y / 16;
-					hit.entity = entity;
-					if ( multiplayer != CLIENT )
+					if ( my->flags[BURNING] && !hit.entity->flags[BURNING] && hit.entity->flags[BURNABLE] )
 					{
-						if ( my->flags[BURNING] && !hit.entity->flags[BURNING] && hit.entity->flags[BURNABLE] )
+						bool dyrnwyn = false;
+						Stat* stats = hit.entity->getStats();
+						if ( stats )
 						{
-							bool dyrnwyn = false;
-							Stat* stats = hit.entity->getStats();
-							if ( stats )
+							if ( stats->weapon )
 							{
-								if ( stats->weapon )
+								if ( stats->weapon->type == ARTIFACT_SWORD )
 								{
-									if ( stats->weapon->type == ARTIFACT_SWORD )
-									{
-										dyrnwyn = true;
-									}
+									dyrnwyn = true;
 								}
 							}
-							if ( !dyrnwyn )
-							{
-								bool previouslyOnFire = hit.entity->flags[BURNING];
+						}
+						if ( !dyrnwyn )
+						{
+							bool previouslyOnFire = hit.entity->flags[BURNING];
 
-								// Attempt to set the Entity on fire
-								hit.entity->SetEntityOnFire();
+							// Attempt to set the Entity on fire
+							hit.entity->SetEntityOnFire();
 
-								// If the Entity is now on fire, tell them
-								if ( hit.entity->flags[BURNING] && !previouslyOnFire )
-								{
-									messagePlayer(hit.entity->skill[2], MESSAGE_STATUS, Language::get(590)); // "You suddenly catch fire!"
-								}
+							// If the Entity is now on fire, tell them
+							if ( hit.entity->flags[BURNING] && !previouslyOnFire )
+							{
+								messagePlayer(hit.entity->skill[2], MESSAGE_STATUS, Language::get(590)); // "You suddenly catch fire!"
 							}
 						}
-						else if ( hit.entity->flags[BURNING] && !my->flags[BURNING] && my->flags[BURNABLE] )
+					}
+					else if ( hit.entity->flags[BURNING] && !my->flags[BURNING] && my->flags[BURNABLE] )
+					{
+						bool dyrnwyn = false;
+						Stat* stats = my->getStats();
+						if ( stats )
 						{
-							bool dyrnwyn = false;
-							Stat* stats = my->getStats();
-							if ( stats )
+							if ( stats->weapon )
 							{
-								if ( stats->weapon )
+								if ( stats->weapon->type == ARTIFACT_SWORD )
 								{
-									if ( stats->weapon->type == ARTIFACT_SWORD )
-									{
-										dyrnwyn = true;
-									}
+									dyrnwyn = true;
 								}
 							}
-							if ( !dyrnwyn )
-							{
-								bool previouslyOnFire = hit.entity->flags[BURNING];
+						}
+						if ( !dyrnwyn )
+						{
+							bool previouslyOnFire = hit.entity->flags[BURNING];
 
-								// Attempt to set the Entity on fire
-								hit.entity->SetEntityOnFire();
+							// Attempt to set the Entity on fire
+							hit.entity->SetEntityOnFire();
 
-								// If the Entity is now on fire, tell them
-								if ( hit.entity->flags[BURNING] && !previouslyOnFire )
-								{
-									messagePlayer(hit.entity->skill[2], MESSAGE_STATUS, Language::get(590)); // "You suddenly catch fire!"
-								}
+							// If the Entity is now on fire, tell them
+							if ( hit.entity->flags[BURNING] && !previouslyOnFire )
+							{
+								messagePlayer(hit.entity->skill[2], MESSAGE_STATUS, Language::get(590)); // "You suddenly catch fire!"
 							}
 						}
 					}
-					return 0;
 				}
+				return true;
 			}
 		}
+		return false;
+	};
+
+	if ( multiplayer == CLIENT )
+	{
+		// clients use old map.entities method
+		for ( node = map.entities->first; node != nullptr; node = node->next )
+		{
+			if ( collidesWith((Entity*)node->element) )
+			{
+				return 0;
+			}
+		}
+	}
+	else if ( TileEntityList.forEntitiesWithinRadius(static_cast<int>(tx) >> 4, static_cast<int>(ty) >> 4, 2, collidesWith) )
+	{
+		return 0;
 	}
 
 	return 1;
@@ -861,7 +851,7 @@ int barony_clear(real_t tx, real_t ty, Entity* my)
 	clipMove
 
 	clips velocity by checking which direction is clear. returns distance
-	covered.
+	covered. a moved creature is re-bucketed in CreatureHash.
 
 -------------------------------------------------------------------------------*/
 
@@ -877,6 +867,10 @@ real_t clipMove(real_t* x, real_t* y, real_t vx, real_t vy, Entity* my)
 	{
 		*x = tx;
 		*y = ty;
+		if ( my )
+		{
+			CreatureHash.updateEntity(*my);
+		}
 		hit.side = 0;
 		return sqrt(vx * vx + vy * vy);
 	}
@@ -888,6 +882,10 @@ real_t clipMove(real_t* x, real_t* y, real_t vx, real_t vy, Entity* my)
 	{
 		*x = tx;
 		*y = ty;
+		if ( my )
+		{
+			CreatureHash.updateEntity(*my);
+		}
 		hit.side = VERTICAL;
 		return fabs(vx);
 	}
@@ -899,6 +897,10 @@ real_t clipMove(real_t* x, real_t* y, real_t vx, real_t vy, Entity* my)
 	{
 		*x = tx;
 		*y = ty;
+		if ( my )
+		{
+			CreatureHash.updateEntity(*my);
+		}
 		hit.side = HORIZONTAL;
 		return fabs(vy);
 	}
@@ -961,7 +963,10 @@ Entity* findEntityInLine( Entity* my, real_t x1, real_t y1, real_t angle, int en
 			{
 				for ( int iy = std::max(0, originy - 1); iy < map.height; ++iy )
 				{
-					entLists.push_back(&TileEntityList.gridEntities[ix][iy]);
+					if ( list_t* tileList = TileEntityList.getTileList(ix, iy) )
+					{
+						entLists.push_back(tileList);
+					}
 				}
 			}
 		}
@@ -979,7 +984,10 @@ Entity* findEntityInLine( Entity* my, real_t x1, real_t y1, real_t angle, int en
 			{
 				for ( int iy = std::max(0, originy - 1); iy < map.height; ++iy )
 				{
-					entLists.push_back(&TileEntityList.gridEntities[ix][iy]);
+					if ( list_t* tileList = TileEntityList.getTileList(ix, iy) )
+					{
+						entLists.push_back(tileList);
+					}
 				}
 			}
 		}
@@ -997,7 +1005,10 @@ Entity* findEntityInLine( Entity* my, real_t x1, real_t y1, real_t angle, int en
 			{
 				for ( int iy = std::min(static_cast<int>(map.height) - 1, originy + 1); iy >= 0; --iy )
 				{
-					entLists.push_back(&TileEntityList.gridEntities[ix][iy]);
+					if ( list_t* tileList = TileEntityList.getTileList(ix, iy) )
+					{
+						entLists.push_back(tileList);
+					}
 				}
 			}
 		}
@@ -1015,7 +1026,10 @@ Entity* findEntityInLine( Entity* my, real_t x1, real_t y1, real_t angle, int en
 			{
 				for ( int iy = std::min(static_cast<int>(map.height) - 1, originy + 1); iy >= 0; --iy )
 				{
-					entLists.push_back(&TileEntityList.gridEntities[ix][iy]);
+					if ( list_t* tileList = TileEntityList.getTileList(ix, iy) )
+					{
+						entLists.push_back(tileList);
+					}
 				}
 			}
 		}
@@ -1278,9 +1292,17 @@ Entity* findEntityInLine( Entity* my, real_t x1, real_t y1, real_t angle, int en
 	the first hit obstacle into the "hit" struct, and report distance to
 	next obstacle. Uses entity coordinates
 
+	lineTraceHit does the same but writes into the given hit_t instead of the
+	global, so it may be run from the monster think workers
+
 -------------------------------------------------------------------------------*/
 
 real_t lineTrace( Entity* my, real_t x1, real_t y1, real_t angle, real_t range, int entities, bool ground )
+{
+	return lineTraceHit(hit, my, x1, y1, angle, range, entities, ground);
+}
+
+real_t lineTraceHit( hit_t& result, Entity* my, real_t x1, real_t y1, real_t angle, real_t range, int entities, bool ground )
 {
 	int posx, posy;
 	real_t fracx, fracy;
@@ -1390,14 +1412,14 @@ real_t lineTrace( Entity* my, real_t x1, real_t y1, real_t angle, real_t range,
 			inx += dincx;
 			d = dval0;
 			dval0 += arx;
-			hit.side = HORIZONTAL;
+			result.side = HORIZONTAL;
 		}
 		else
 		{
 			iny += dincy;
 			d = dval1;
 			dval1 += ary;
-			hit.side = VERTICAL;
+			result.side = VERTICAL;
 		}
 		if ( inx < 0 || iny < 0 || (inx >> 4) >= map.width || (iny >> 4) >= map.height )
 		{
@@ -1411,11 +1433,11 @@ real_t lineTrace( Entity* my, real_t x1, real_t y1, real_t angle, real_t range,
 		int index = (iny >> 4) * MAPLAYERS + (inx >> 4) * MAPLAYERS * map.height;
 		if ( map.tiles[OBSTACLELAYER + index] )
 		{
-			hit.x = ix;
-			hit.y = iy;
-			hit.mapx = inx >> 4;
-			hit.mapy = iny >> 4;
-			hit.entity = NULL;
+			result.x = ix;
+			result.y = iy;
+			result.mapx = inx >> 4;
+			result.mapy = iny >> 4;
+			result.entity = NULL;
 			return d;
 		}
 		if ( ground )
@@ -1429,11 +1451,11 @@ real_t lineTrace( Entity* my, real_t x1, real_t y1, real_t angle, real_t range,
 			if ( !map.tiles[index] 
 				|| ((swimmingtiles[map.tiles[index]] || lavatiles[map.tiles[index]]) && isMonster) )
 			{
-				hit.x = ix;
-				hit.y = iy;
-				hit.mapx = inx >> 4;
-				hit.mapy = iny >> 4;
-				hit.entity = NULL;
+				result.x = ix;
+				result.y = iy;
+				result.mapx = inx >> 4;
+				result.mapy = iny >> 4;
+				result.entity = NULL;
 				return d;
 			}
 		}
@@ -1483,22 +1505,22 @@ real_t lineTrace( Entity* my, real_t x1, real_t y1, real_t angle, real_t range,
 			{
 				if ( iy >= entity->y - sizey && iy <= entity->y + sizey )
 				{
-					hit.x = ix;
-					hit.y = iy;
-					hit.mapx = entity->x / 16;
-					hit.mapy = entity->y / 16;
-					hit.entity = entity;
+					result.x = ix;
+					result.y = iy;
+					result.mapx = entity->x / 16;
+					result.mapy = entity->y / 16;
+					result.entity = entity;
 					return d;
 				}
 			}
 		}
 	}
-	hit.x = ix;
-	hit.y = iy;
-	hit.mapx = inx >> 4;
-	hit.mapy = iny >> 4;
-	hit.entity = NULL;
-	hit.side = 0;
+	result.x = ix;
+	result.y = iy;
+	result.mapx = inx >> 4;
+	result.mapy = iny >> 4;
+	result.entity = NULL;
+	result.side = 0;
 	return range;
 }
 
@@ -1773,40 +1795,38 @@ int checkObstacle(long x, long y, Entity* my, Entity* target, bool useTileEntity
 			}
 			else
 			{
-				std::vector<list_t*> entLists = TileEntityList.getEntitiesWithinRadius(static_cast<int>(x) >> 4, static_cast<int>(y) >> 4, 2);
-				for ( std::vector<list_t*>::iterator it = entLists.begin(); it != entLists.end(); ++it )
-				{
-					list_t* currentList = *it;
-					for ( node = currentList->first; node != nullptr; node = node->next )
+				if ( TileEntityList.forEntitiesWithinRadius(static_cast<int>(x) >> 4, static_cast<int>(y) >> 4, 2,
+					[&](Entity* entity) {
+					//++entCheck;
+					if ( !entity ) { return false; }
+					if ( entity->flags[PASSABLE] || entity == my || entity == target || entity->behavior == &actDoor )
 					{
-						entity = (Entity*)node->element;
-						//++entCheck;
-						if ( !entity ) { continue; }
-						if ( entity->flags[PASSABLE] || entity == my || entity == target || entity->behavior == &actDoor )
-						{
-							continue;
-						}
-						if ( my && entity->behavior == &actParticleTimer && static_cast<Uint32>(entity->particleTimerTarget) == my->getUID() )
-						{
-							continue;
-						}
-						if ( isMonster && my->getMonsterTypeFromSprite() == MINOTAUR && entity->isDamageableCollider()
-							&& entity->colliderHasCollision == 2 )
-						{
-							continue;
-						}
-						if ( my && my->behavior == &actDeathGhost && (entity->behavior == &actPlayer || entity->behavior == &actMonster) )
-						{
-							continue;
-						}
-						if ( x >= (int)(entity->x - entity->sizex) && x <= (int)(entity->x + entity->sizex) )
+						return false;
+					}
+					if ( my && entity->behavior == &actParticleTimer && static_cast<Uint32>(entity->particleTimerTarget) == my->getUID() )
+					{
+						return false;
+					}
+					if ( isMonster && my->getMonsterTypeFromSprite() == MINOTAUR && entity->isDamageableCollider()
+						&& entity->colliderHasCollision == 2 )
+					{
+						return false;
+					}
+					if ( my && my->behavior == &actDeathGhost && (entity->behavior == &actPlayer || entity->behavior == &actMonster) )
+					{
+						return false;
+					}
+					if ( x >= (int)(entity->x - entity->sizex) && x <= (int)(entity->x + entity->sizex) )
+					{
+						if ( y >= (int)(entity->y - entity->sizey) && y <= (int)(entity->y + entity->sizey) )
 						{
-							if ( y >= (int)(entity->y - entity->sizey) && y <= (int)(entity->y + entity->sizey) )
-							{
-								return 1;
-							}
+							return true;
 						}
 					}
+					return false;
+				}) )
+				{
+					return 1;
 				}
 			}
 		}
@@ -1825,3 +1845,69 @@ int checkObstacle(long x, long y, Entity* my, Entity* target, bool useTileEntity
 
 	return 0;
 }
+
+static ConsoleCommand ccmd_collision_bench("/collision_bench", "time checkObstacle and barony_clear over every map tile (args: passes)",
+	[](int argc, const char** argv) {
+	if ( multiplayer == CLIENT || !players[clientnum] || !players[clientnum]->entity )
+	{
+		messagePlayer(clientnum, MESSAGE_MISC, "collision_bench: needs a local player entity on the server");
+		return;
+	}
+	Entity* my = players[clientnum]->entity;
+	if ( my->flags[BURNING] )
+	{
+		messagePlayer(clientnum, MESSAGE_MISC, "collision_bench: can't run while burning (barony_clear spreads fire)");
+		return;
+	}
+	const int passes = argc > 1 ? std::max(1, atoi(argv[1])) : 10;
+	const hit_t oldHit = hit;
+
+	int numEntities = 0;
+	for ( int x = 0; x < map.width; ++x )
+	{
+		for ( int y = 0; y < map.height; ++y )
+		{
+			if ( list_t* list = TileEntityList.getTileList(x, y) )
+			{
+				numEntities += list_Size(list);
+			}
+		}
+	}
+
+	int obstacles = 0;
+	auto t = std::chrono::high_resolution_clock::now();
+	for ( int pass = 0; pass < passes; ++pass )
+	{
+		for ( int x = 0; x < map.width; ++x )
+		{
+			for ( int y = 0; y < map.height; ++y )
+			{
+				obstacles += checkObstacle(x * 16 + 8, y * 16 + 8, my, nullptr);
+			}
+		}
+	}
+	auto t2 = std::chrono::high_resolution_clock::now();
+	int clear = 0;
+	for ( int pass = 0; pass < passes; ++pass )
+	{
+		for ( int x = 0; x < map.width; ++x )
+		{
+			for ( int y = 0; y < map.height; ++y )
+			{
+				clear += barony_clear(x * 16 + 8, y * 16 + 8, my);
+			}
+		}
+	}
+	auto t3 = std::chrono::high_resolution_clock::now();
+	hit = oldHit;
+
+	const double calls = (double)passes * map.width * map.height;
+	const double obstacleUs = std::chrono::duration_cast<std::chrono::duration<double, std::micro>>(t2 - t).count();
+	const double clearUs = std::chrono::duration_cast<std::chrono::duration<double, std::micro>>(t3 - t2).count();
+	messagePlayer(clientnum, MESSAGE_MISC, "collision_bench: %dx%d map, %d entities in tile lists, %d passes",
+		(int)map.width, (int)map.height, numEntities, passes);
+	messagePlayer(clientnum, MESSAGE_MISC, "checkObstacle: %.0f us total, %.3f us/call (%d blocked)",
+		obstacleUs, obstacleUs / calls, obstacles);
+	messagePlayer(clientnum, MESSAGE_MISC, "barony_clear: %.0f us total, %.3f us/call (%d clear)",
+		clearUs, clearUs / calls, clear);
+	});
@@ -32,5 +32,6 @@ int barony_clear(real_t tx, real_t ty, Entity* my);
 real_t clipMove(real_t* x, real_t* y, real_t vx, real_t vy, Entity* my);
 Entity* findEntityInLine(Entity* my, real_t x1, real_t y1, real_t angle, int entities, Entity* target);
 real_t lineTrace(Entity* my, real_t x1, real_t y1, real_t angle, real_t range, int entities, bool ground);
+real_t lineTraceHit(hit_t& result, Entity* my, real_t x1, real_t y1, real_t angle, real_t range, int entities, bool ground); // as lineTrace, but writes result instead of the global hit
 real_t lineTraceTarget(Entity* my, real_t x1, real_t y1, real_t angle, real_t range, int entities, bool ground, Entity* target); //If the linetrace function encounters the linetrace entity, it returns even if it's invisible or passable.
 int checkObstacle(long x, long y, Entity* my, Entity* target, bool useTileEntityList = true);
@@ -0,0 +1,538 @@
+/*-------------------------------------------------------------------------------
+
+	BARONY
+	File: dedicated.cpp
+	Desc: headless host for the barony-server target. Runs a direct connect
+	lobby without the main menu, then drives serverHandleMessages() and
+	gameLogic() at a fixed tick rate, logging how long each tick takes.
+
+	Copyright 2013-2016 (c) Turning Wheel LLC, all rights reserved.
+	See LICENSE for details.
+
+-------------------------------------------------------------------------------*/
+
+#include "main.hpp"
+#include "game.hpp"
+#include "stat.hpp"
+#include "net.hpp"
+#include "menu.hpp"
+#include "player.hpp"
+#include "mod_tools.hpp"
+#include "dedicated.hpp"
+#include "netbots.hpp"
+
+namespace DedicatedServer
+{
+	static Uint16 hostPort = 0;
+	static int playersWanted = 1;
+	static std::string seedString;
+	static bool svFlagsGiven = false;
+	static Uint32 svFlagsArg = 0;
+	static Uint32 tickrate = TICKS_PER_SECOND;
+	static Uint32 maxTicks = 0;
+
+	static bool playerReady[MAXPLAYERS] = { false };
+	static bool lockedSlots[MAXPLAYERS] = { false };
+
+	// wall time spent per tick, reported every few seconds while a game is running
+	struct TickStats_t
+	{
+		Uint32 count = 0;
+		double totalMs = 0.0;
+		double worstMs = 0.0;
+		Uint32 overruns = 0; // ticks that took longer than a tick
+
+		void add(double ms, double budgetMs)
+		{
+			++count;
+			totalMs += ms;
+			worstMs = std::max(worstMs, ms);
+			if ( ms > budgetMs )
+			{
+				++overruns;
+			}
+		}
+		void report(const char* label)
+		{
+			if ( count == 0 )
+			{
+				return;
+			}
+			int entities = map.entities ? (int)list_Size(map.entities) : 0;
+			printlog("[SERVER]: %s: %u ticks, avg %.3f ms, worst %.3f ms, %u over budget, %d entities",
+				label, count, totalMs / count, worstMs, overruns, entities);
+		}
+	};
+	static TickStats_t intervalStats;
+	static TickStats_t sessionStats;
+
+	bool parseArg(const char* arg)
+	{
+		if ( !strncmp(arg, "-port=", 6) )
+		{
+			hostPort = (Uint16)std::max(1, atoi(arg + 6));
+		}
+		else if ( !strncmp(arg, "-players=", 9) )
+		{
+			playersWanted = std::min(std::max(1, atoi(arg + 9)), MAXPLAYERS - 1);
+		}
+		else if ( !strncmp(arg, "-seed=", 6) )
+		{
+			seedString = arg + 6;
+		}
+		else if ( !strncmp(arg, "-svflags=", 9) )
+		{
+			svFlagsArg = (Uint32)strtoul(arg + 9, nullptr, 0);
+			svFlagsGiven = true;
+		}
+		else if ( !strncmp(arg, "-tickrate=", 10) )
+		{
+			tickrate = (Uint32)std::max(1, atoi(arg + 10));
+		}
+		else if ( !strncmp(arg, "-maxticks=", 10) )
+		{
+			maxTicks = (Uint32)std::max(0, atoi(arg + 10));
+		}
+		else if ( !strncmp(arg, "-netsim=", 8) )
+		{
+			// latency,jitter,loss,bandwidth. see NetLinkSimulator
+			int latency = 0, jitter = 0, bandwidth = 0;
+			float loss = 0.f;
+			sscanf(arg + 8, "%d,%d,%f,%d", &latency, &jitter, &loss, &bandwidth);
+			char command[64];
+			consoleCommand("/net_sim 1");
+			snprintf(command, sizeof(command), "/net_sim_latency %d", latency);
+			consoleCommand(command);
+			snprintf(command, sizeof(command), "/net_sim_jitter %d", jitter);
+			consoleCommand(command);
+			snprintf(command, sizeof(command), "/net_sim_loss %f", loss);
+			consoleCommand(command);
+			snprintf(command, sizeof(command), "/net_sim_bandwidth %d", bandwidth);
+			consoleCommand(command);
+		}
+		else if ( NetBots::parseArg(arg) )
+		{
+			return true;
+		}
+		else
+		{
+			return false;
+		}
+		return true;
+	}
+
+	static int connectedPlayers()
+	{
+		int result = 0;
+		for ( int c = 1; c < MAXPLAYERS; ++c )
+		{
+			if ( !client_disconnected[c] )
+			{
+				++result;
+			}
+		}
+		return result;
+	}
+
+	// sends the packet currently in net_packet to every connected client
+	static void sendToClients()
+	{
+		for ( int c = 1; c < MAXPLAYERS; ++c )
+		{
+			if ( client_disconnected[c] )
+			{
+				continue;
+			}
+			net_packet->address.host = net_clients[c - 1].host;
+			net_packet->address.port = net_clients[c - 1].port;
+			sendPacketSafe(net_sock, -1, net_packet, c - 1);
+		}
+	}
+
+	static void sendLobbySettings(int player)
+	{
+		memcpy(net_packet->data, "SVFL", 4);
+		SDLNet_Write32(svFlags, &net_packet->data[4]);
+		net_packet->len = 8;
+		sendToClients();
+
+		if ( !gameModeManager.currentSession.seededRun.seedString.empty() )
+		{
+			memcpy(net_packet->data, "CSEE", 4);
+			stringCopy((char*)net_packet->data + 4, gameModeManager.currentSession.seededRun.seedString.c_str(),
+				32, gameModeManager.currentSession.seededRun.seedString.size());
+			net_packet->len = 36;
+			sendToClients();
+		}
+	}
+
+	static void dropPlayer(int player)
+	{
+		client_disconnected[player] = true;
+		playerReady[player] = false;
+		memcpy(net_packet->data, "DISC", 4);
+		net_packet->data[4] = player;
+		net_packet->len = 5;
+		sendToClients();
+		printlog("[SERVER]: player %d left the lobby", player);
+	}
+
+	/*-------------------------------------------------------------------------------
+
+		handleLobbyPackets
+
+		the subset of the main menu's lobby protocol a host needs: joins,
+		character and ready updates, keepalives and leaving. everything a
+		client sends that concerns the host's own UI is ignored.
+
+	-------------------------------------------------------------------------------*/
+
+	static void handleLobbyPackets()
+	{
+		for ( int numpacket = 0; numpacket < PACKET_LIMIT; ++numpacket )
+		{
+			if ( !SDLNet_UDP_Recv(net_sock, net_packet) )
+			{
+				break;
+			}
+			NetStats.count(NetTelemetry::RECEIVED, net_packet->data, net_packet->len);
+			if ( handleSafePacket() )
+			{
+				continue;
+			}
+
+			const Uint32 packetId = SDLNet_Read32(&net_packet->data[0]);
+			switch ( packetId )
+			{
+				case 'JOIN':
+				{
+					int playerNum = MAXPLAYERS;
+					if ( lobbyPlayerJoinRequest(playerNum, lockedSlots) == NET_LOBBY_JOIN_DIRECTIP_SUCCESS )
+					{
+						playerReady[playerNum] = false;
+						sendLobbySettings(playerNum);
+						printlog("[SERVER]: player %d joined (%d/%d)", playerNum, connectedPlayers(), playersWanted);
+					}
+					break;
+				}
+				case 'PLYR':
+				{
+					// clients may only describe themselves
+					const int player = net_packet->data[4];
+					if ( player == 0 || player != directConnectSender() )
+					{
+						break;
+					}
+					sendToClients();
+					stats[player]->clearStats();
+					stringCopy(stats[player]->name, (char*)(&net_packet->data[5]), sizeof(Stat::name), 32);
+					client_classes[player] = (int)SDLNet_Read32(&net_packet->data[37]);
+					stats[player]->sex = static_cast<sex_t>((int)SDLNet_Read32(&net_packet->data[41]));
+					Uint32 raceAndAppearance = SDLNet_Read32(&net_packet->data[45]);
+					stats[player]->appearance = (raceAndAppearance & 0xFF00) >> 8;
+					stats[player]->playerRace = (raceAndAppearance & 0xFF);
+					initClass(player);
+					break;
+				}
+				case 'REDY':
+				{
+					const int player = net_packet->data[4];
+					if ( player == 0 || player != directConnectSender() )
+					{
+						break;
+					}
+					sendToClients();
+					playerReady[player] = net_packet->data[5] != 0;
+					break;
+				}
+				case 'CMSG':
+					sendToClients();
+					break;
+				case 'KPAL':
+				{
+					const int player = std::min(net_packet->data[4], (Uint8)(MAXPLAYERS - 1));
+					client_keepalive[player] = ticks;
+					break;
+				}
+				case 'PNGU':
+				{
+					PacketReader packet(net_packet->data, net_packet->len);
+					packet.skip(4);
+					PingNetworkStatus_t::respond(packet);
+					break;
+				}
+				case 'PNGR':
+				{
+					PacketReader packet(net_packet->data, net_packet->len);
+					packet.skip(4);
+					PingNetworkStatus_t::receive(packet);
+					break;
+				}
+				case 'DISC':
+				{
+					const int player = std::min(net_packet->data[4], (Uint8)(MAXPLAYERS - 1));
+					if ( player > 0 && !client_disconnected[player] )
+					{
+						dropPlayer(player);
+					}
+					break;
+				}
+				case 'SVFL':
+					sendLobbySettings(0);
+					break;
+				default:
+					break;
+			}
+		}
+	}
+
+	static void lobbyKeepAlive()
+	{
+		if ( ticks % TICKS_PER_SECOND != 0 )
+		{
+			return;
+		}
+		for ( int c = 1; c < MAXPLAYERS; ++c )
+		{
+			if ( !client_disconnected[c] && ticks - client_keepalive[c] > TICKS_PER_SECOND * TIMEOUT_TIME )
+			{
+				dropPlayer(c);
+			}
+		}
+		strcpy((char*)net_packet->data, "KPAL");
+		net_packet->data[4] = clientnum;
+		net_packet->len = 5;
+		sendToClients();
+	}
+
+	static bool lobbyReady()
+	{
+		if ( connectedPlayers() < playersWanted )
+		{
+			return false;
+		}
+		for ( int c = 1; c < MAXPLAYERS; ++c )
+		{
+			if ( !client_disconnected[c] && !playerReady[c] )
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// the host half of MainMenu's startGame() and its GameStart fade
+	static void startGame()
+	{
+		local_rng.seedTime();
+		if ( gameModeManager.currentSession.seededRun.seed > 0 )
+		{
+			uniqueGameKey = gameModeManager.currentSession.seededRun.seed;
+		}
+		else
+		{
+			local_rng.getSeed(&uniqueGameKey, sizeof(uniqueGameKey));
+		}
+		uniqueLobbyKey = local_rng.getU32();
+		net_rng.seedBytes(&uniqueGameKey, sizeof(uniqueGameKey));
+
+		for ( int c = 1; c < MAXPLAYERS; ++c )
+		{
+			if ( client_disconnected[c] )
+			{
+				continue;
+			}
+			memcpy((char*)net_packet->data, "STRT", 4);
+			SDLNet_Write32(svFlags, &net_packet->data[4]);
+			SDLNet_Write32(uniqueGameKey, &net_packet->data[8]);
+			net_packet->data[12] = 0;
+			SDLNet_Write32(uniqueLobbyKey, &net_packet->data[13]);
+			net_packet->address.host = net_clients[c - 1].host;
+			net_packet->address.port = net_clients[c - 1].port;
+			net_packet->len = 17;
+			sendPacketSafe(net_sock, -1, net_packet, c - 1);
+		}
+
+		printlog("[SERVER]: starting game for %d player(s), game key %u", connectedPlayers(), uniqueGameKey);
+		splitscreen = false;
+		doNewGame(false);
+	}
+
+	static bool openSocket()
+	{
+		directConnect = true;
+		const Uint16 port = hostPort = hostPort ? hostPort : (::portnumber ? ::portnumber : DEFAULT_PORT);
+		if ( SDLNet_ResolveHost(&net_server, NULL, port) == -1 )
+		{
+			printlog("[SERVER]: failed to resolve host: %s", SDLNet_GetError());
+			return false;
+		}
+		if ( !(net_sock = SDLNet_UDP_Open(port)) )
+		{
+			printlog("[SERVER]: failed to open udp port %d: %s", port, SDLNet_GetError());
+			return false;
+		}
+
+		// same setup as MainMenu's setupNetGameAsServer()
+		net_clients = (IPaddress*) malloc(sizeof(IPaddress) * MAXPLAYERS);
+		net_tcpclients = (TCPsocket*) malloc(sizeof(TCPsocket) * MAXPLAYERS);
+		for ( int c = 0; c < MAXPLAYERS; ++c )
+		{
+			net_tcpclients[c] = NULL;
+		}
+		net_packet = SDLNet_AllocPacket(NET_PACKET_SIZE);
+		if ( !net_packet )
+		{
+			printlog("[SERVER]: failed to allocate packet: %s", SDLNet_GetError());
+			return false;
+		}
+
+		printlog("[SERVER]: hosting on port %d, waiting for %d player(s)", port, playersWanted);
+		return true;
+	}
+
+	static void closeSocket()
+	{
+		if ( net_sock && net_packet )
+		{
+			// let everyone know the host is gone
+			memcpy(net_packet->data, "DISC", 4);
+			net_packet->data[4] = 0;
+			net_packet->len = 5;
+			for ( int c = 1; c < MAXPLAYERS; ++c )
+			{
+				if ( client_disconnected[c] )
+				{
+					continue;
+				}
+				net_packet->address.host = net_clients[c - 1].host;
+				net_packet->address.port = net_clients[c - 1].port;
+				sendPacket(net_sock, -1, net_packet, c - 1);
+			}
+		}
+		if ( net_sock )
+		{
+			SDLNet_UDP_Close(net_sock);
+			net_sock = nullptr;
+		}
+		if ( net_packet )
+		{
+			SDLNet_FreePacket(net_packet);
+			net_packet = nullptr;
+		}
+		free(net_clients);
+		net_clients = nullptr;
+		free(net_tcpclients);
+		net_tcpclients = nullptr;
+	}
+
+	int run()
+	{
+		if ( svFlagsGiven )
+		{
+			svFlags = svFlagsArg;
+		}
+		if ( !seedString.empty() )
+		{
+			gameModeManager.currentSession.seededRun.setup(seedString);
+		}
+		playersWanted = std::max(playersWanted, NetBots::count());
+		if ( !openSocket() )
+		{
+			closeSocket();
+			return 1;
+		}
+
+		// the host runs the world but nobody plays on it
+		clientnum = 0;
+		multiplayer = SERVER;
+		for ( int c = 0; c < MAXPLAYERS; ++c )
+		{
+			client_disconnected[c] = true;
+			playerReady[c] = false;
+		}
+
+		if ( NetBots::count() && !NetBots::start(hostPort) )
+		{
+			closeSocket();
+			return 1;
+		}
+
+		const Uint64 frequency = SDL_GetPerformanceFrequency();
+		const Uint64 tickLength = frequency / tickrate;
+		const double budgetMs = 1000.0 / tickrate;
+		Uint64 nextTick = SDL_GetPerformanceCounter();
+		bool started = false;
+		Uint32 playedTicks = 0;
+
+		while ( mainloop )
+		{
+			const Uint64 tickStart = SDL_GetPerformanceCounter();
+			NetBots::update();
+			if ( !started )
+			{
+				NetLinkSim.update();
+				handleLobbyPackets();
+				lobbyKeepAlive();
+				resendSafePackets();
+				++ticks;
+				if ( lobbyReady() )
+				{
+					startGame();
+					started = true;
+					nextTick = SDL_GetPerformanceCounter();
+					continue;
+				}
+			}
+			else
+			{
+				serverHandleMessages(tickrate);
+				if ( !loading )
+				{
+					gameLogic();
+					++ticks;
+				}
+
+				const double ms = 1000.0 * (SDL_GetPerformanceCounter() - tickStart) / frequency;
+				intervalStats.add(ms, budgetMs);
+				sessionStats.add(ms, budgetMs);
+				if ( intervalStats.count >= tickrate * 10 )
+				{
+					intervalStats.report("last 10s");
+					intervalStats = TickStats_t();
+					NetBots::report("last 10s");
+				}
+
+				++playedTicks;
+				if ( maxTicks && playedTicks >= maxTicks )
+				{
+					printlog("[SERVER]: reached %u ticks, shutting down", maxTicks);
+					mainloop = 0;
+				}
+				else if ( connectedPlayers() == 0 )
+				{
+					printlog("[SERVER]: everyone left, shutting down");
+					mainloop = 0;
+				}
+			}
+
+			// sleep off the rest of the tick. if we fall more than a second
+			// behind, drop the backlog instead of trying to catch up
+			nextTick += tickLength;
+			const Uint64 now = SDL_GetPerformanceCounter();
+			if ( now < nextTick )
+			{
+				SDL_Delay((Uint32)((nextTick - now) * 1000 / frequency));
+			}
+			else if ( now - nextTick > frequency )
+			{
+				nextTick = now;
+			}
+		}
+
+		sessionStats.report("session");
+		NetBots::stop();
+		closeSocket();
+		return 0;
+	}
+}
@@ -0,0 +1,29 @@
+/*-------------------------------------------------------------------------------
+
+	BARONY
+	File: dedicated.hpp
+	Desc: prototypes for dedicated.cpp, the headless barony-server host
+
+	Copyright 2013-2016 (c) Turning Wheel LLC, all rights reserved.
+	See LICENSE for details.
+
+-------------------------------------------------------------------------------*/
+
+#pragma once
+
+namespace DedicatedServer
+{
+	// server command line options:
+	//   -port=N       udp port to host on (default DEFAULT_PORT)
+	//   -players=N    remote players to wait for before starting (1-3, default 1)
+	//   -seed=STR     custom run seed, as typed into the lobby
+	//   -svflags=N    server flags (SV_FLAG_*), defaults to the game's defaults
+	//   -tickrate=N   logic ticks per second (default TICKS_PER_SECOND)
+	//   -maxticks=N   quit after N ticks of play, for measuring tick cost
+	//   -map=NAME     start on this map instead of the first floor (shared with the client)
+	//   -netsim=LATENCY,JITTER,LOSS,BANDWIDTH
+	//                 run direct connections through a simulated link (ms, ms, percent, bytes/s)
+	// plus the bot options in netbots.hpp, which count towards -players
+	bool parseArg(const char* arg); // true if arg was a server option
+	int run(); // host the lobby and the game until everyone leaves, returns an exit code
+}
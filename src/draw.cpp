@@ -1676,7 +1676,7 @@ void drawClearBuffers()
 
 -------------------------------------------------------------------------------*/
 
-#include <future>
+#include "jobs.hpp"
 
 #ifndef EDITOR
 #include "net.hpp"
@@ -1727,6 +1727,7 @@ void raycast(const view_t& camera, Sint8 (*minimap)[MINIMAP_MAX_DIMENSION], bool
         const view_t camera;
         const Sint32* tiles;
         const vec4_t* lights;
+        const LightmapOverlay* overlay; // the player's own lights, if any
         Sint8 (*minimap)[MINIMAP_MAX_DIMENSION];
 		bool fillWithColor;
     };
@@ -1738,6 +1739,7 @@ void raycast(const view_t& camera, Sint8 (*minimap)[MINIMAP_MAX_DIMENSION], bool
         const view_t& camera = ins.camera;
         const auto& tiles = ins.tiles;
         const auto& lights = ins.lights;
+        const auto& overlay = ins.overlay;
         const auto& minimap = ins.minimap;
         
         const int posx = (int)camera.x;
@@ -1820,7 +1822,7 @@ void raycast(const view_t& camera, Sint8 (*minimap)[MINIMAP_MAX_DIMENSION], bool
                         if (tiles[z + iny2 * MAPLAYERS + inx2 * MAPLAYERS * mh]) {
                             continue;
                         }
-                        auto& l = lights[iny2 + inx2 * mh];
+                        const auto l = overlay ? overlay->composite(lights[iny2 + inx2 * mh], inx2, iny2) : lights[iny2 + inx2 * mh];
                         const auto light = std::max({0.f, l.x, l.y, l.z});
 						bool visible = light > 1.f;
 						if ( !visible && !ins.fillWithColor )
@@ -1860,7 +1862,7 @@ void raycast(const view_t& camera, Sint8 (*minimap)[MINIMAP_MAX_DIMENSION], bool
                         }
                     } else if (z == OBSTACLELAYER) {
                         // update minimap to show empty region
-                        auto& l = lights[iny2 + inx2 * mh];
+                        const auto l = overlay ? overlay->composite(lights[iny2 + inx2 * mh], inx2, iny2) : lights[iny2 + inx2 * mh];
                         const auto light = std::max({0.f, l.x, l.y, l.z});
 						bool visible = light > 1.f;
 						if ( !visible && !ins.fillWithColor )
@@ -1926,29 +1928,31 @@ void raycast(const view_t& camera, Sint8 (*minimap)[MINIMAP_MAX_DIMENSION], bool
     auto t = std::chrono::high_resolution_clock::now();
 
     // shoot the rays
-    const vec4_t* lightmap = lightmaps[0].data();
+    const vec4_t* lightmap = lightmapBase.data();
+    const LightmapOverlay* overlay = nullptr;
     for (int c = 0; c < MAXPLAYERS; ++c) {
         if (&camera == &cameras[c]) {
-            lightmap = lightmaps[c + 1].data();
+            overlay = &lightmapOverlays[c + 1];
             break;
         }
     }
     if (DoRaysInParallel) {
-        std::vector<std::future<std::vector<outs_t>>> tasks;
-        for (int x = 0; x < NumRays; x += NumRaysPerJob) {
-            tasks.emplace_back(std::async(std::launch::async, shoot_ray,
-                ins_t{x, (int)map.width, (int)map.height, camera, map.tiles, lightmap, minimap, fillWithColor}));
-        }
-        for (int x = (int)tasks.size() - 1; x >= 0; --x) {
-            auto out_list = tasks[x].get();
-            for (auto& it : out_list) {
+        const int batches = (NumRays + NumRaysPerJob - 1) / NumRaysPerJob;
+        std::vector<std::vector<outs_t>> results(batches);
+        Jobs.parallel_for("raycast", 0, batches, 1, [&](size_t first, size_t last) {
+            for (size_t batch = first; batch < last; ++batch) {
+                results[batch] = shoot_ray(ins_t{(int)batch * NumRaysPerJob, (int)map.width, (int)map.height,
+                    camera, map.tiles, lightmap, overlay, minimap, fillWithColor});
+            }
+        });
+        for (int x = batches - 1; x >= 0; --x) {
+            for (auto& it : results[x]) {
                 minimap[it.y][it.x] = it.value;
             }
-            tasks.pop_back();
         }
     } else {
         for (int x = 0; x < NumRays; x += NumRaysPerJob) {
-            auto out_list = shoot_ray(ins_t{x, (int)map.width, (int)map.height, camera, map.tiles, lightmap, minimap, fillWithColor});
+            auto out_list = shoot_ray(ins_t{x, (int)map.width, (int)map.height, camera, map.tiles, lightmap, overlay, minimap, fillWithColor});
             for (auto& it : out_list) {
                 minimap[it.y][it.x] = it.value;
             }
@@ -2185,6 +2189,8 @@ void drawEntities3D(view_t* camera, int mode)
 	}
 
 #ifndef EDITOR
+	MagicParticles.draw(camera, mode);
+
 	for ( int i = 0; i < MAXPLAYERS; ++i )
 	{
 		for ( auto& enemybar : enemyHPDamageBarHandler[i].HPBars )
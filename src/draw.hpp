@@ -146,6 +146,12 @@ public:
         _h = height;
     }
 
+    // replaces a rectangle of a texture already sized by loadFloat()
+    void updateFloat(float* data, int x, int y, int width, int height) {
+        GL_CHECK_ERR(glBindTexture(GL_TEXTURE_2D, _texid));
+        GL_CHECK_ERR(glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, (GLsizei)width, (GLsizei)height, GL_RGBA, GL_FLOAT, data));
+    }
+
     void bind() {
         GL_CHECK_ERR(glBindTexture(GL_TEXTURE_2D, _texid));
     }
@@ -326,6 +332,28 @@ extern TempTexture* lightmapTexture[MAXPLAYERS + 1];
 extern Uint32 ditherDisabledTime;
 void temporarilyDisableDithering();
 
+// the tiles a chunk's mesh is built from. with snapshot set this holds its
+// own copy, so workers can keep building while the game changes the map.
+struct ChunkSource {
+    ChunkSource(const map_t& map, bool ceiling, bool snapshot);
+    
+    const Sint32* tiles = nullptr;
+    int width = 0, height = 0;
+    int ceilingTile = 50;
+    bool ceiling = true;
+    std::vector<Sint32> copy;
+};
+
+// CPU side of a chunk: its vertices and the tiles they were made from.
+// building one touches no GL state (see /chunk_bench)
+struct ChunkMesh {
+    int x = 0, y = 0, w = 0, h = 0;
+    std::vector<Sint32> tiles;
+    std::vector<float> positions;
+    std::vector<float> texcoords;
+    std::vector<float> colors;
+};
+
 struct Chunk {
     GLuint vao = 0;
     GLuint vbo_positions = 0;
@@ -393,6 +421,8 @@ struct Chunk {
     }
     
     void build(const map_t& map, bool ceiling, int startX, int startY, int w, int h);
+    static void buildMesh(const ChunkSource& src, int startX, int startY, int w, int h, ChunkMesh& mesh);
+    void upload(ChunkMesh& mesh); // takes the mesh's tiles and uploads its vertices
     void buildBuffers(const std::vector<float>& positions, const std::vector<float>& texcoords, const std::vector<float>& colors);
     void destroyBuffers();
     void draw();
@@ -1037,6 +1037,8 @@ void editFill(int x, int y, int layer, int type)
 			}
 		}
 	}
+	mapTileChanged();
+	markChunksDirty();
 }
 
 /*-------------------------------------------------------------------------------
@@ -1151,6 +1153,8 @@ void undo()
 	camera.vismap = (bool*) malloc(sizeof(bool) * map.height * map.width);
     memset(camera.vismap, 0, sizeof(bool) * map.height * map.width);
 	memcpy(map.tiles, undomap->tiles, sizeof(Sint32)*undomap->width * undomap->height * MAPLAYERS);
+	mapTileChanged();
+	markChunksDirty();
 	list_FreeAll(map.entities);
 	for ( node = undomap->entities->first; node != NULL; node = node->next )
 	{
@@ -1187,6 +1191,8 @@ void redo()
 	camera.vismap = (bool*) malloc(sizeof(bool) * map.height * map.width);
     memset(camera.vismap, 0, sizeof(bool) * map.height * map.width);
 	memcpy(map.tiles, undomap->tiles, sizeof(Sint32)*undomap->width * undomap->height * MAPLAYERS);
+	mapTileChanged();
+	markChunksDirty();
 	list_FreeAll(map.entities);
 	for ( node = undomap->entities->first; node != NULL; node = node->next )
 	{
@@ -1650,12 +1656,9 @@ int main(int argc, char** argv)
 			}
 		}
 	}
-    for (int c = 0; c < MAXPLAYERS + 1; ++c) {
-        lightmaps[c].clear();
-        lightmaps[c].resize(map.width * map.height);
-        lightmapsSmoothed[c].clear();
-        lightmapsSmoothed[c].resize((map.width + 2) * (map.height + 2));
-    }
+    resetLightmaps(map.width, map.height, 0.f);
+	mapTileChanged();
+	markChunksDirty();
 
 	// initialize camera position
 	camera.x = 4;
@@ -2279,6 +2282,8 @@ int main(int argc, char** argv)
 								if ( drawx >= 0 && drawx < map.width && drawy >= 0 && drawy < map.height )
 								{
 									map.tiles[drawlayer + drawy * MAPLAYERS + drawx * MAPLAYERS * map.height] = selectedTile;
+									mapTileChanged(drawx, drawy);
+									markChunksDirty(drawx, drawy);
 								}
 							}
 							else if ( selectedTool == 1 )	// Process Point Tool functionality
@@ -2296,6 +2301,8 @@ int main(int argc, char** argv)
 											if ( x >= 0 && x < map.width && y >= 0 && y < map.height )
 											{
 												map.tiles[drawlayer + y * MAPLAYERS + x * MAPLAYERS * map.height] = selectedTile;
+												mapTileChanged(x, y);
+												markChunksDirty(x, y);
 											}
 										}
 									}
@@ -2371,6 +2378,8 @@ int main(int argc, char** argv)
 										if ( copymap.tiles[z] )
 										{
 											map.tiles[drawlayer + (drawy + y)*MAPLAYERS + (drawx + x)*MAPLAYERS * map.height] = copymap.tiles[z];
+											mapTileChanged(drawx + x, drawy + y);
+											markChunksDirty(drawx + x, drawy + y);
 										}
 									}
 								}
@@ -400,6 +400,8 @@ Entity::Entity(Sint32 in_sprite, Uint32 pos, list_t* entlist, list_t* creatureli
 	mynode->size = sizeof(Entity);
 
 	myCreatureListNode = nullptr;
+	creatureHashCell = -1;
+	creatureHashSlot = -1;
 	if ( creaturelist )
 	{
 		addToCreatureList(creaturelist);
@@ -540,16 +542,13 @@ Entity::~Entity()
 		list_RemoveNode(myCreatureListNode);
 		myCreatureListNode = nullptr;
 	}
+	CreatureHash.removeEntity(*this);
 	if ( myWorldUIListNode )
 	{
 		list_RemoveNode(myWorldUIListNode);
 		myWorldUIListNode = nullptr;
 	}
-	if ( myTileListNode )
-	{
-		list_RemoveNode(myTileListNode);
-		myTileListNode = nullptr;
-	}
+	TileEntityList.removeEntity(*this);
 
 	// alert clients of the entity's deletion
 	if ( multiplayer == SERVER && !loading )
@@ -857,7 +856,7 @@ int Entity::entityLight()
 	}
 	int light_x = (int)this->x / 16;
 	int light_y = (int)this->y / 16;
-    const auto& light = lightmaps[0][light_y + light_x * map.height];
+    const auto& light = lightmapBase[light_y + light_x * map.height];
     //return (light.x + light.y + light.z) / 3.f;
     return std::min(std::max(0, (int)((light.x + light.y + light.z) / 3.f)), 255);
 	//return std::min(std::max(0, (int)((light.x + light.y + light.z) / 3.f * 255.f)), 255);
@@ -6430,7 +6429,7 @@ list_t* checkTileForEntity(int x, int y)
 	{
 		return nullptr; // invalid grid reference!
 	}
-	return &TileEntityList.gridEntities[x][y];
+	return TileEntityList.getTileList(x, y);
 
 //	list_t* return_val = NULL;
 //
@@ -11039,6 +11038,8 @@ void Entity::attack(int pose, int charge, Entity* target)
 								}
 
 								map.tiles[OBSTACLELAYER + hit.mapy * MAPLAYERS + hit.mapx * MAPLAYERS * map.height] = 0;
+								mapTileChanged(hit.mapx, hit.mapy);
+								markChunksDirty(hit.mapx, hit.mapy);
 								// send wall destroy info to clients
 								if ( multiplayer == SERVER )
 								{
@@ -11058,7 +11059,7 @@ void Entity::attack(int pose, int charge, Entity* target)
 									}
 								}
 								// Update the paths so that monsters know they can walk through it
-								generatePathMaps();
+								updatePathMaps(hit.mapx, hit.mapy);
 							}
 							int chance = 2 + (myStats->type == GOBLIN ? 2 : 0);
 							if ( local_rng.rand() % chance && degradePickaxe )
@@ -11320,6 +11321,7 @@ bool Entity::teleport(int tele_x, int tele_y)
 	{
 		TileEntityList.updateEntity(*this);
 	}
+	CreatureHash.updateEntity(*this);
 	if ( multiplayer == SERVER && player > 0 && !players[player]->isLocalPlayer() )
 	{
 		strcpy((char*)net_packet->data, "TELE");
@@ -11832,6 +11834,7 @@ bool Entity::teleporterMove(int tele_x, int tele_y, int type)
 	{
 		TileEntityList.updateEntity(*this);
 	}
+	CreatureHash.updateEntity(*this);
 	if ( player > 0 && multiplayer == SERVER && !players[player]->isLocalPlayer() )
 	{
 		strcpy((char*)net_packet->data, "TELM");
@@ -16015,11 +16018,11 @@ void Entity::serverUpdateEffectsForEntity(bool guarantee)
 		net_packet->len = 13;
 		if ( guarantee )
 		{
-			sendPacketSafe(net_sock, -1, net_packet, player - 1);
+			queuePacketSafe(net_sock, -1, net_packet, player - 1);
 		}
 		else
 		{
-			sendPacket(net_sock, -1, net_packet, player - 1);
+			queuePacket(net_sock, -1, net_packet, player - 1);
 		}
 		clientsHaveItsStats = true;
 	}
@@ -19609,6 +19612,14 @@ void Entity::addToCreatureList(list_t *list)
 		myCreatureListNode->element = this;
 		myCreatureListNode->deconstructor = &emptyDeconstructor;
 		myCreatureListNode->size = sizeof(Entity);
+		if ( list == map.creatures )
+		{
+			CreatureHash.addEntity(*this);
+		}
+		else
+		{
+			CreatureHash.removeEntity(*this);
+		}
 		//printlog("Added dennis to creature list.");
 	}
 }
@@ -19766,6 +19777,80 @@ bool monsterNameIsGeneric(Stat& monsterStats)
 	return false;
 }
 
+void TileEntityListHandler::resizeGrid(int width, int height)
+{
+	// relink whatever is still tracked, the old lists are about to move
+	std::vector<Entity*> tracked;
+	for ( auto& list : gridEntities )
+	{
+		for ( node_t* node = list.first; node != nullptr; node = node->next )
+		{
+			tracked.push_back((Entity*)node->element);
+		}
+	}
+	gridWidth = std::min(std::max(width, 0), kMaxMapDimension);
+	gridHeight = std::min(std::max(height, 0), kMaxMapDimension);
+	gridEntities.assign(gridWidth * gridHeight, list_t{ nullptr, nullptr });
+	for ( Entity* entity : tracked )
+	{
+		entity->myTileListNode = nullptr;
+		int x = (static_cast<int>(entity->x) >> 4);
+		int y = (static_cast<int>(entity->y) >> 4);
+		if ( x >= 0 && x < gridWidth && y >= 0 && y < gridHeight )
+		{
+			linkEntity(*entity, x, y);
+		}
+	}
+}
+
+void TileEntityListHandler::linkEntity(Entity& entity, int x, int y)
+{
+	list_t* list = &gridEntities[y + x * gridHeight];
+	node_t* node = &entity.myTileListNodeData;
+	node->element = &entity;
+	node->deconstructor = &emptyDeconstructor;
+	node->size = sizeof(Entity);
+	node->list = list;
+	node->next = nullptr;
+	node->prev = list->last;
+	if ( list->last )
+	{
+		list->last->next = node;
+	}
+	else
+	{
+		list->first = node;
+	}
+	list->last = node;
+	entity.myTileListNode = node;
+}
+
+void TileEntityListHandler::unlinkEntity(Entity& entity)
+{
+	node_t* node = entity.myTileListNode;
+	list_t* list = node->list;
+	if ( node->prev )
+	{
+		node->prev->next = node->next;
+	}
+	else
+	{
+		list->first = node->next;
+	}
+	if ( node->next )
+	{
+		node->next->prev = node->prev;
+	}
+	else
+	{
+		list->last = node->prev;
+	}
+	node->next = nullptr;
+	node->prev = nullptr;
+	node->list = nullptr;
+	entity.myTileListNode = nullptr;
+}
+
 node_t* TileEntityListHandler::addEntity(Entity& entity)
 {
 	if ( entity.myTileListNode )
@@ -19778,15 +19863,17 @@ node_t* TileEntityListHandler::addEntity(Entity& entity)
 		return nullptr;
 	}
 
+	if ( gridWidth != std::min<int>(map.width, kMaxMapDimension) || gridHeight != std::min<int>(map.height, kMaxMapDimension) )
+	{
+		resizeGrid(map.width, map.height);
+	}
+
 	int x = (static_cast<int>(entity.x) >> 4);
 	int y = (static_cast<int>(entity.y) >> 4);
-	if ( x >= 0 && x < kMaxMapDimension && y >= 0 && y < kMaxMapDimension )
+	if ( x >= 0 && x < gridWidth && y >= 0 && y < gridHeight )
 	{
 		//messagePlayer(0, "added at %d, %d", x, y);
-		entity.myTileListNode = list_AddNodeLast(&TileEntityList.gridEntities[x][y]);
-		entity.myTileListNode->element = &entity;
-		entity.myTileListNode->deconstructor = &emptyDeconstructor;
-		entity.myTileListNode->size = sizeof(Entity);
+		linkEntity(entity, x, y);
 		return entity.myTileListNode;
 	}
 
@@ -19802,29 +19889,45 @@ node_t* TileEntityListHandler::updateEntity(Entity& entity)
 
 	int x = (static_cast<int>(entity.x) >> 4);
 	int y = (static_cast<int>(entity.y) >> 4);
-	if ( x >= 0 && x < kMaxMapDimension && y >= 0 && y < kMaxMapDimension )
+	if ( x >= 0 && x < gridWidth && y >= 0 && y < gridHeight )
 	{
-		list_RemoveNode(entity.myTileListNode);
-		entity.myTileListNode = list_AddNodeLast(&TileEntityList.gridEntities[x][y]);
-		entity.myTileListNode->element = &entity;
-		entity.myTileListNode->deconstructor = &emptyDeconstructor;
-		entity.myTileListNode->size = sizeof(Entity);
+		if ( entity.myTileListNode->list != &gridEntities[y + x * gridHeight] )
+		{
+			unlinkEntity(entity);
+			linkEntity(entity, x, y);
+		}
 		return entity.myTileListNode;
 	}
 
 	return nullptr;
 }
 
+void TileEntityListHandler::removeEntity(Entity& entity)
+{
+	if ( entity.myTileListNode )
+	{
+		unlinkEntity(entity);
+	}
+}
+
 void TileEntityListHandler::clearTile(int x, int y)
 {
-	list_FreeAll(&gridEntities[x][y]);
+	list_t* list = getTileList(x, y);
+	if ( !list )
+	{
+		return;
+	}
+	while ( list->first )
+	{
+		unlinkEntity(*(Entity*)list->first->element);
+	}
 }
 
 void TileEntityListHandler::emptyGridEntities()
 {
-	for ( int i = 0; i < kMaxMapDimension; ++i )
+	for ( int i = 0; i < gridWidth; ++i )
 	{
-		for ( int j = 0; j < kMaxMapDimension; ++j )
+		for ( int j = 0; j < gridHeight; ++j )
 		{
 			clearTile(i, j);
 		}
@@ -19833,9 +19936,9 @@ void TileEntityListHandler::emptyGridEntities()
 
 list_t* TileEntityListHandler::getTileList(int x, int y)
 {
-	if ( x >= 0 && x < kMaxMapDimension && y >= 0 && y < kMaxMapDimension )
+	if ( x >= 0 && x < gridWidth && y >= 0 && y < gridHeight )
 	{
-		return &gridEntities[x][y];
+		return &gridEntities[y + x * gridHeight];
 	}
 	return nullptr;
 }
@@ -19844,6 +19947,7 @@ list_t* TileEntityListHandler::getTileList(int x, int y)
 std::vector<list_t*> TileEntityListHandler::getEntitiesWithinRadius(int u, int v, int radius)
 {
 	std::vector<list_t*> return_val;
+	return_val.reserve((radius * 2 + 1) * (radius * 2 + 1));
 
 	for ( int i = u - radius; i <= u + radius; ++i )
 	{
@@ -19868,6 +19972,129 @@ std::vector<list_t*> TileEntityListHandler::getEntitiesWithinRadiusAroundEntity(
 	return getEntitiesWithinRadius(u, v, radius);
 }
 
+int CreatureSpatialHash::getCell(real_t x, real_t y)
+{
+	int cx = std::min(std::max(0, static_cast<int>(x) / kCellSize), kCellsPerSide - 1);
+	int cy = std::min(std::max(0, static_cast<int>(y) / kCellSize), kCellsPerSide - 1);
+	return cx + cy * kCellsPerSide;
+}
+
+void CreatureSpatialHash::addEntity(Entity& entity)
+{
+	removeEntity(entity);
+	const int cell = getCell(entity.x, entity.y);
+	entity.creatureHashCell = cell;
+	entity.creatureHashSlot = cells[cell].size();
+	cells[cell].push_back(Entry_t{ &entity, nextOrder++ });
+}
+
+void CreatureSpatialHash::removeEntity(Entity& entity)
+{
+	if ( entity.creatureHashCell < 0 )
+	{
+		return;
+	}
+	auto& bucket = cells[entity.creatureHashCell];
+	const int slot = entity.creatureHashSlot;
+	if ( slot != (int)bucket.size() - 1 )
+	{
+		bucket[slot] = bucket.back();
+		bucket[slot].entity->creatureHashSlot = slot;
+	}
+	bucket.pop_back();
+	entity.creatureHashCell = -1;
+	entity.creatureHashSlot = -1;
+}
+
+void CreatureSpatialHash::updateEntity(Entity& entity)
+{
+	if ( entity.creatureHashCell < 0 )
+	{
+		return;
+	}
+	const int cell = getCell(entity.x, entity.y);
+	if ( cell == entity.creatureHashCell )
+	{
+		return;
+	}
+	const Uint32 order = cells[entity.creatureHashCell][entity.creatureHashSlot].order;
+	removeEntity(entity);
+	entity.creatureHashCell = cell;
+	entity.creatureHashSlot = cells[cell].size();
+	cells[cell].push_back(Entry_t{ &entity, order });
+}
+
+void CreatureSpatialHash::clear()
+{
+	for ( auto& bucket : cells )
+	{
+		for ( auto& entry : bucket )
+		{
+			entry.entity->creatureHashCell = -1;
+			entry.entity->creatureHashSlot = -1;
+		}
+		bucket.clear();
+	}
+	nextOrder = 0;
+}
+
+/* fills out with the creatures within radius (inclusive) of x, y. cells are
+   searched a tile past the radius for creatures pushed around by something
+   else since their last re-bucket, anything moving further (teleports)
+   re-buckets itself. listOrder sorts the results into map.creatures order. */
+void CreatureSpatialHash::getCreaturesWithinRadius(real_t x, real_t y, real_t radius, std::vector<Entity*>& out, bool listOrder) const
+{
+	out.clear();
+	static thread_local std::vector<Entry_t> entries; // monster think queries from worker threads
+	entries.clear();
+
+	const real_t reach = radius + 16.0;
+	const int minCell = getCell(x - reach, y - reach);
+	const int maxCell = getCell(x + reach, y + reach);
+	for ( int cy = minCell / kCellsPerSide; cy <= maxCell / kCellsPerSide; ++cy )
+	{
+		for ( int cx = minCell % kCellsPerSide; cx <= maxCell % kCellsPerSide; ++cx )
+		{
+			for ( auto& entry : cells[cx + cy * kCellsPerSide] )
+			{
+				if ( sqrt(pow(entry.entity->x - x, 2) + pow(entry.entity->y - y, 2)) <= radius )
+				{
+					entries.push_back(entry);
+				}
+			}
+		}
+	}
+	if ( listOrder )
+	{
+		std::sort(entries.begin(), entries.end(), [](const Entry_t& lhs, const Entry_t& rhs) {
+			return lhs.order < rhs.order;
+		});
+	}
+	for ( auto& entry : entries )
+	{
+		out.push_back(entry.entity);
+	}
+}
+
+/* fills out with the creatures within radius (inclusive) of x, y that are no
+   more than halfAngle either side of yaw. */
+void CreatureSpatialHash::getCreaturesWithinCone(real_t x, real_t y, real_t radius, real_t yaw, real_t halfAngle, std::vector<Entity*>& out, bool listOrder) const
+{
+	getCreaturesWithinRadius(x, y, radius, out, listOrder);
+	out.erase(std::remove_if(out.begin(), out.end(), [&](Entity* entity) {
+		real_t angle = yaw - atan2(entity->y - y, entity->x - x);
+		while ( angle >= PI )
+		{
+			angle -= PI * 2;
+		}
+		while ( angle < -PI )
+		{
+			angle += PI * 2;
+		}
+		return fabs(angle) > halfAngle;
+	}), out.end());
+}
+
 void Entity::setHumanoidLimbOffset(Entity* limb, Monster race, int limbType)
 {
 	if ( !limb )
@@ -89,6 +89,8 @@ class Entity
 public:
 	Entity(Sint32 in_sprite, Uint32 pos, list_t* entlist, list_t* creaturelist);
 	~Entity();
+	static void* operator new(size_t size); // carved from entityPool, see objects.cpp
+	static void operator delete(void* data, size_t size);
     
     bool ditheringDisabled = false;
     struct Dither {
@@ -578,8 +580,11 @@ public:
 	// a pointer to the entity's location in a list (ie the map list of entities)
 	node_t* mynode;
 	node_t* myCreatureListNode;
-	node_t* myTileListNode;
+	node_t* myTileListNode; // points at myTileListNodeData while in TileEntityList
+	node_t myTileListNodeData;
 	node_t* myWorldUIListNode;
+	int creatureHashCell; // bucket in CreatureHash, -1 if not in it
+	int creatureHashSlot;
 
 	list_t* path; // pathfinding stuff. Most of the code currently stuffs that into children, but the magic code makes use of this variable instead.
 
@@ -367,6 +367,8 @@ Entity::Entity(Sint32 in_sprite, Uint32 pos, list_t* entlist, list_t* creatureli
 	mynode->size = sizeof(Entity);
 
 	myCreatureListNode = nullptr;
+	creatureHashCell = -1;
+	creatureHashSlot = -1;
 
 	// now reset all of my data elements
 	lastupdate = 0;
@@ -17,9 +17,9 @@
 #include <list>
 #include <string>
 #include <thread>
-#include <future>
 
 #include "main.hpp"
+#include "jobs.hpp"
 #include "files.hpp"
 #include "engine/audio/sound.hpp"
 #include "entity.hpp"
@@ -1524,7 +1524,9 @@ SDL_Surface* loadImage(char const * const filename)
 	// load the new surface as a GL texture
 	allsurfaces[imgref] = newSurface;
 	allsurfaces[imgref]->userdata = (void *)((long int)imgref);
+#ifndef BARONY_HEADLESS
 	GL_CHECK_ERR(glLoadTexture(allsurfaces[imgref], imgref));
+#endif
 
 	// free the translated surface
 	SDL_FreeSurface(originalSurface);
@@ -1774,6 +1776,18 @@ int loadMap(const char* filename2, map_t* destmap, list_t* entlist, list_t* crea
 		{
 			list_FreeAll(map.worldUI);
 		}
+
+#ifndef EDITOR
+		MagicParticles.clear();
+		MonsterThink.clear();
+		CreatureHash.clear();
+		EntitySnapshots.reset();
+		EntityInterp.reset();
+#endif
+
+		// the old level's entities are gone, hand their slabs back
+		entityPool.trim();
+		nodePool.trim();
 	}
 	if ( destmap->tiles != nullptr )
 	{
@@ -2290,48 +2304,18 @@ int loadMap(const char* filename2, map_t* destmap, list_t* entlist, list_t* crea
 #endif
 
 		// create new lightmap
-        for (int c = 0; c < MAXPLAYERS + 1; ++c) {
-            auto& lightmap = lightmaps[c];
-            auto& lightmapSmoothed = lightmapsSmoothed[c];
-            lightmap.resize(destmap->width * destmap->height);
-            lightmapSmoothed.resize((destmap->width + 2) * (destmap->height + 2));
-            if ( strncmp(map.name, "Hell", 4) )
+        float ambience = 0.f;
+        if ( !strncmp(map.name, "Hell", 4) )
+        {
+            ambience = hellAmbience;
+#ifndef EDITOR
+            if ( svFlags & SV_FLAG_CHEATS )
             {
-                memset(lightmap.data(), 0, sizeof(vec4_t) * map.width * map.height);
-                memset(lightmapSmoothed.data(), 0, sizeof(vec4_t) * (map.width + 2) * (map.height + 2));
+                ambience = *cvar_hell_ambience;
             }
-            else
-            {
-                for (int c = 0; c < destmap->width * destmap->height; c++ )
-                {
-                    lightmap[c].x = hellAmbience;
-                    lightmap[c].y = hellAmbience;
-                    lightmap[c].z = hellAmbience;
-#ifndef EDITOR
-                    if ( svFlags & SV_FLAG_CHEATS )
-                    {
-                        lightmap[c].x = *cvar_hell_ambience;
-                        lightmap[c].y = *cvar_hell_ambience;
-                        lightmap[c].z = *cvar_hell_ambience;
-                    }
 #endif
-                }
-                for (int c = 0; c < (destmap->width + 2) * (destmap->height + 2); c++ )
-                {
-                    lightmapSmoothed[c].x = hellAmbience;
-                    lightmapSmoothed[c].y = hellAmbience;
-                    lightmapSmoothed[c].z = hellAmbience;
-#ifndef EDITOR
-                    if ( svFlags & SV_FLAG_CHEATS )
-                    {
-                        lightmapSmoothed[c].x = *cvar_hell_ambience;
-                        lightmapSmoothed[c].y = *cvar_hell_ambience;
-                        lightmapSmoothed[c].z = *cvar_hell_ambience;
-                    }
-#endif
-                }
-            }
         }
+        resetLightmaps(destmap->width, destmap->height, ambience);
 
 		// reset minimap
 		for ( x = 0; x < MINIMAP_MAX_DIMENSION; x++ )
@@ -4293,7 +4277,7 @@ void reloadModels(int start, int end) {
 	}
 
 	std::atomic_bool loading_done{ false };
-	auto loading_task = std::async(std::launch::async, [&loading_done, start, end]() {
+	auto loading_task = Jobs.async("reload models", [&loading_done, start, end]() {
 		std::string modelsDirectory = PHYSFS_getRealDir("models/models.txt");
 		modelsDirectory.append(PHYSFS_getDirSeparator()).append("models/models.txt");
 		File* fp = openDataFile(modelsDirectory.c_str(), "rb");
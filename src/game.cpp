@@ -40,6 +40,7 @@
 #include "collision.hpp"
 #include "paths.hpp"
 #include "player.hpp"
+#include "jobs.hpp"
 #include "mod_tools.hpp"
 #include "lobbies.hpp"
 #include "interface/ui.hpp"
@@ -52,11 +53,13 @@
 #include "ui/Image.hpp"
 #include "ui/MainMenu.hpp"
 #include "ui/LoadingScreen.hpp"
+#ifdef BARONY_HEADLESS
+#include "dedicated.hpp"
+#endif
 
 #include "UnicodeDecoder.h"
 
 #include <atomic>
-#include <future>
 #include <thread>
 
 #ifdef LINUX
@@ -224,6 +227,7 @@ LONG CALLBACK unhandled_handler(EXCEPTION_POINTERS* e)
 
 ConsoleVariable<bool> cvar_enableKeepAlives("/keepalive_enabled", true);
 ConsoleVariable<bool> cvar_animate_tiles("/animate_tiles", true);
+static ConsoleVariable<int> cvar_net_entity_interval("/net_entity_interval", TICKS_PER_SECOND / 8); // ticks between entity updates to clients
 
 std::vector<std::string> randomPlayerNamesMale;
 std::vector<std::string> randomPlayerNamesFemale;
@@ -231,6 +235,7 @@ std::vector<std::string> randomNPCNamesMale;
 std::vector<std::string> randomNPCNamesFemale;
 std::vector<std::string> physFSFilesInDirectory;
 TileEntityListHandler TileEntityList;
+CreatureSpatialHash CreatureHash;
 // recommended for valgrind debugging:
 // res of 480x270
 // /nohud
@@ -938,6 +943,8 @@ void gameLogic(void)
 	(void)nxUpdateCrashMessage();
 #endif
 
+	updatePathDebugStats();
+
     if (!gamePaused && !loading) {
         if (demo_file) {
             // demo recording
@@ -1163,28 +1170,7 @@ void gameLogic(void)
 	}
 
 	// handle safe packets
-	if ( !(ticks % 4) )
-	{
-		j = 0;
-		for ( node = safePacketsSent.first; node != nullptr; node = nextnode )
-		{
-			nextnode = node->next;
-
-			packetsend_t* packet = (packetsend_t*)node->element;
-			//printlog("Packet resend: %d", packet->hostnum);
-			sendPacket(packet->sock, packet->channel, packet->packet, packet->hostnum, true);
-			packet->tries++;
-			if ( packet->tries >= MAXTRIES )
-			{
-				list_RemoveNode(node);
-			}
-			j++;
-			if ( j >= MAXDELETES )
-			{
-				break;
-			}
-		}
-	}
+	resendSafePackets();
 
 	// spawn flame particles on burning objects
 	if ( !gamePaused || (multiplayer && !client_disconnected[0]) )
@@ -1648,6 +1634,22 @@ void gameLogic(void)
 			real_t accum = 0.0;
 			DebugStats.eventsT3 = std::chrono::high_resolution_clock::now();
 
+			// step visual-only particles
+			if ( !gamePaused || (multiplayer && !client_disconnected[0]) )
+			{
+				MagicParticles.update();
+			}
+
+			// trace monster sight checks in parallel, actMonster consumes them below
+			if ( !gamePaused || (multiplayer && !client_disconnected[0]) )
+			{
+				MonsterThink.run();
+			}
+			else
+			{
+				MonsterThink.clear();
+			}
+
 			// run world UI entities
 			for ( node = map.worldUI->first; node != nullptr; node = nextnode )
 			{
@@ -1732,6 +1734,7 @@ void gameLogic(void)
 							{
 								TileEntityList.addEntity(*entity);
 							}
+							CreatureHash.updateEntity(*entity);
 
 							/*if ( entity->getUID() >= 0 && entity->behavior != &actFlame && !entity->flags[INVISIBLE]
 								&& entity->behavior != &actDoor && entity->behavior != &actDoorFrame
@@ -1766,6 +1769,7 @@ void gameLogic(void)
 										TileEntityList.updateEntity(*entity);
 									}
 								}
+								CreatureHash.updateEntity(*entity);
 								TimerExperiments::updateEntityInterpolationPosition(entity);
 
 								entity->ranbehavior = true;
@@ -1784,6 +1788,7 @@ void gameLogic(void)
 									TileEntityList.updateEntity(*entity);
 								}
 							}
+							CreatureHash.updateEntity(*entity);
 							TimerExperiments::updateEntityInterpolationPosition(entity);
 
 							entity->ranbehavior = true;
@@ -2082,9 +2087,17 @@ void gameLogic(void)
 
 							if ( loadCustomNextMap.compare("") != 0 )
 							{
-								strcpy((char*)(&net_packet->data[14]), loadCustomNextMap.c_str());
-								net_packet->data[14 + loadCustomNextMap.length()] = 0;
-								net_packet->len = 14 + loadCustomNextMap.length() + 1;
+								// LVLC is one packet, see BulkTransferChannel in net.hpp
+								const int maxNameLen = NET_PACKET_SIZE - 14 - 1;
+								if ( (int)loadCustomNextMap.length() > maxNameLen )
+								{
+									printlog("[NET]: Error - custom map name '%s' is too long to send in LVLC, truncating to %d characters",
+										loadCustomNextMap.c_str(), maxNameLen);
+								}
+								const int nameLen = std::min((int)loadCustomNextMap.length(), maxNameLen);
+								memcpy(&net_packet->data[14], loadCustomNextMap.c_str(), nameLen);
+								net_packet->data[14 + nameLen] = 0;
+								net_packet->len = 14 + nameLen + 1;
 							}
 							else
 							{
@@ -2103,7 +2116,7 @@ void gameLogic(void)
 					loading = true;
 	                createLevelLoadScreen(5);
 	                std::atomic_bool loading_done {false};
-	                auto loading_task = std::async(std::launch::async, [&loading_done](){
+	                auto loading_task = Jobs.async("load level", [&loading_done](){
 					    gameplayCustomManager.readFromFile();
 					    textSourceScript.scriptVariables.clear();
 	                    updateLoadingScreen(10);
@@ -2290,6 +2303,8 @@ void gameLogic(void)
 					fadeout = false;
 					fadealpha = 255;
 
+					// followers and their stats go to each client as one compressed transfer
+					NetMessages.beginBulk();
 					for (c = 0; c < MAXPLAYERS; c++)
 					{
 						if (players[c] && players[c]->entity && !client_disconnected[c])
@@ -2410,7 +2425,7 @@ void gameLogic(void)
 										net_packet->address.host = net_clients[c - 1].host;
 										net_packet->address.port = net_clients[c - 1].port;
 										net_packet->len = 12 + strlen(name.c_str()) + 1;
-										sendPacketSafe(net_sock, -1, net_packet, c - 1);
+										queuePacketSafe(net_sock, -1, net_packet, c - 1);
 
 										serverUpdateAllyStat(c, monster->getUID(), monsterStats->LVL, monsterStats->HP, monsterStats->MAXHP, monsterStats->type);
 									}
@@ -2483,6 +2498,7 @@ void gameLogic(void)
 						}
 						list_FreeAll(&tempFollowers[c]);
 					}
+					NetMessages.endBulk();
 
                     // save at end of level change
 					if ( gameModeManager.allowsSaves() )
@@ -2565,30 +2581,9 @@ void gameLogic(void)
 				}
 
 				// send entity info to clients
-				if ( ticks % (TICKS_PER_SECOND / 8) == 0 )
+				if ( ticks % std::max(1, *cvar_net_entity_interval) == 0 )
 				{
-					for ( node = map.entities->first; node != nullptr; node = node->next )
-					{
-						entity = (Entity*)node->element;
-						for ( c = 1; c < MAXPLAYERS; ++c )
-						{
-							if ( !client_disconnected[c] )
-							{
-								if ( entity->flags[UPDATENEEDED] == true && entity->flags[NOUPDATE] == false )
-								{
-									// update entity for all clients
-									if ( entity->getUID() % (TICKS_PER_SECOND * 4) == ticks % (TICKS_PER_SECOND * 4) )
-									{
-										sendEntityUDP(entity, c, true);
-									}
-									else
-									{
-										sendEntityUDP(entity, c, false);
-									}
-								}
-							}
-						}
-					}
+					EntitySnapshots.serverSend();
 				}
 
 				// handle keep alives
@@ -2900,6 +2895,7 @@ void gameLogic(void)
 				}
 				PingNetworkStatus_t::update();
 			}
+			EntitySnapshots.clientSendAck();
 
 			// animate tiles
 			if ( !gamePaused )
@@ -3036,6 +3032,12 @@ void gameLogic(void)
 				}
 			}
 
+			// step visual-only particles
+			if ( !gamePaused || (multiplayer && !client_disconnected[0]) )
+			{
+				MagicParticles.update();
+			}
+
 			// run world UI entities
 			for ( node = map.worldUI->first; node != nullptr; node = nextnode )
 			{
@@ -3082,6 +3084,7 @@ void gameLogic(void)
 			}
 
 			// run entity actions
+			EntityInterp.update();
 			for ( node = map.entities->first; node != nullptr; node = nextnode )
 			{
 				nextnode = node->next;
@@ -3111,6 +3114,7 @@ void gameLogic(void)
 						}
 						if ( !gamePaused || (multiplayer && !client_disconnected[0]) )
 						{
+							CreatureHash.updateEntity(*entity);
 							(*entity->behavior)(entity);
 							if ( entitiesdeleted.first != NULL )
 							{
@@ -3137,8 +3141,11 @@ void gameLogic(void)
 								nextnode = node->next;
 								if ( entity->flags[UPDATENEEDED] && !entity->flags[NOUPDATE] )
 								{
+									// remote monsters and players are placed from the buffered updates instead
+									const bool interpolated = EntityInterp.apply(*entity);
+
 									// adjust entity position
-									if ( ticks - entity->lastupdate <= TICKS_PER_SECOND / 16 )
+									if ( !interpolated && ticks - entity->lastupdate <= TICKS_PER_SECOND / 16 )
 									{
 										// interpolate to new position
 										if ( (entity->behavior != &actPlayerLimb && entity->behavior != &actDeathGhostLimb)
@@ -3178,7 +3185,7 @@ void gameLogic(void)
 										}
 									}
 									// dead reckoning
-									if ( fabs(entity->vel_x) > 0.0001 || fabs(entity->vel_y) > 0.0001 )
+									if ( !interpolated && (fabs(entity->vel_x) > 0.0001 || fabs(entity->vel_y) > 0.0001) )
 									{
 										double ox = 0, oy = 0, onewx = 0, onewy = 0;
 										if ( entity->behavior == &actPlayer 
@@ -3204,7 +3211,7 @@ void gameLogic(void)
 											}
 										}
 									}
-									if ( entity->behavior != &actArrow )
+									if ( !interpolated && entity->behavior != &actArrow )
 									{
 										// client handles z in actArrow.
 										entity->z += entity->vel_z;
@@ -3475,6 +3482,13 @@ void gameLogic(void)
 	{
 		++completionTime;
 	}
+
+	if ( multiplayer != SINGLE )
+	{
+		NetMessages.flush(); // everything queued this tick goes out together
+		BulkTransfers.update();
+		NetStats.update();
+	}
 }
 
 /*-------------------------------------------------------------------------------
@@ -6648,6 +6662,11 @@ int main(int argc, char** argv)
 					{
 						no_sound = true;
 					}
+#ifdef BARONY_HEADLESS
+					else if ( DedicatedServer::parseArg(argv[c]) )
+					{
+					}
+#endif
 					else
 					{
 #ifdef USE_EOS
@@ -6661,8 +6680,13 @@ int main(int argc, char** argv)
 		printlog("Output path is %s", outputdir);
         
         // init sdl
+#ifdef BARONY_HEADLESS
+        Uint32 init_flags = SDL_INIT_EVENTS | SDL_INIT_TIMER;
+        no_sound = true;
+#else
         Uint32 init_flags = SDL_INIT_VIDEO | SDL_INIT_EVENTS;
         init_flags |= SDL_INIT_JOYSTICK | SDL_INIT_GAMECONTROLLER | SDL_INIT_HAPTIC;
+#endif
         if (SDL_Init(init_flags) == -1)
         {
             printlog("failed to initialize SDL: %s\n", SDL_GetError());
@@ -6753,6 +6777,14 @@ int main(int argc, char** argv)
 		// initialize player conducts
 		setDefaultPlayerConducts();
 
+#ifdef BARONY_HEADLESS
+		// no window, no menu: host until the game ends
+		c = DedicatedServer::run();
+		deinitGame();
+		deinitApp();
+		return c;
+#endif
+
 #ifdef NINTENDO
 		if (!nxIsHandheldMode()) {
 			nxAssignControllers(1, 1, true, false, true, false, nullptr);
@@ -7399,6 +7431,11 @@ int main(int argc, char** argv)
 			{
 			    printTextFormatted(font16x16_bmp, 8, 8, "fps = %3.1f", fps);
 			}
+			static ConsoleVariable<bool> cvar_jobs_overlay("/jobs_overlay", false);
+			if ( *cvar_jobs_overlay )
+			{
+				printTextFormatted(font8x8_bmp, 8, 64, "%s", Jobs.overlayText().c_str());
+			}
 			if ( enableDebugKeys )
 			{
 				printTextFormatted(font8x8_bmp, 8, 20, "gui module: %d\ngui mode: %d", players[0]->GUI.activeModule, players[0]->gui_mode);
@@ -7440,12 +7477,14 @@ int main(int argc, char** argv)
 					DebugStats.displayStats = true;
 					DebugStats.storeStats();
 					DebugStats.storeEventStats();
+					DebugStats.storePoolStats();
 					messagePlayer(clientnum, MESSAGE_MISC, "Timers: %f total.", timer);
 				}
 				if ( DebugStats.displayStats )
 				{
 					printTextFormatted(font8x8_bmp, 8, 200 + 20, DebugStats.debugOutput);
 					printTextFormatted(font8x8_bmp, 8, 200 + 100, DebugStats.debugEventOutput);
+					printTextFormatted(font8x8_bmp, 8, 200 + 180, DebugStats.debugPoolOutput);
 				}
 			}
 
@@ -7620,3 +7659,26 @@ void DebugStatsClass::storeEventStats()
 		"Events1: %4.5fms\nEvents2: %4.5fms\nEvents3: %4.5fms\nEvents4: %4.5fms\nEvents5: %4.5fms\nMessagesT1: %4.5fms\nMessagesT2: %4.5fms\n",
 		out1, out2, out3, out4, out5, messages1, messages2);
 }
+
+void DebugStatsClass::storePoolStats()
+{
+	entityPoolStats = entityPool.getStats();
+	nodePoolStats = nodePool.getStats();
+	snprintf(debugPoolOutput, 255,
+		"Entities: %u live, %u peak, %llu freed, %u slabs\nNodes: %u live, %u peak, %llu freed, %u slabs\n",
+		entityPoolStats.live, entityPoolStats.peak, (unsigned long long)entityPoolStats.freed, entityPoolStats.slabs,
+		nodePoolStats.live, nodePoolStats.peak, (unsigned long long)nodePoolStats.freed, nodePoolStats.slabs);
+}
+
+static ConsoleCommand ccmd_pool_stats("/pool_stats", "print entity and list node pool counters",
+	[](int argc, const char** argv) {
+	DebugStats.storePoolStats();
+	const auto& entities = DebugStats.entityPoolStats;
+	const auto& nodes = DebugStats.nodePoolStats;
+	messagePlayer(clientnum, MESSAGE_MISC, "entity pool: %u live, %u peak, %llu allocated, %llu freed, %u slabs",
+		entities.live, entities.peak, (unsigned long long)entities.allocated, (unsigned long long)entities.freed, entities.slabs);
+	messagePlayer(clientnum, MESSAGE_MISC, "node pool: %u live, %u peak, %llu allocated, %llu freed, %u slabs",
+		nodes.live, nodes.peak, (unsigned long long)nodes.allocated, (unsigned long long)nodes.freed, nodes.slabs);
+	messagePlayer(clientnum, MESSAGE_MISC, "visual particles: %u live, %u peak",
+		(unsigned)MagicParticles.size(), (unsigned)MagicParticles.peak);
+	});
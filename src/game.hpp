@@ -44,18 +44,6 @@ extern Uint32 joyimpulses[NUM_JOY_IMPULSES]; //Joystick/gamepad only impulses.
 bool handleEvents(void);
 void startMessages();
 
-// net packet send
-typedef struct packetsend_t
-{
-	UDPsocket sock;
-	int channel;
-	UDPpacket* packet;
-	int num;
-	int tries;
-	int hostnum;
-} packetsend_t;
-extern list_t safePacketsSent;
-extern std::unordered_map<int, Uint32> safePacketsReceivedMap[MAXPLAYERS];
 extern bool receivedclientnum;
 
 extern Sint32 numplayers;
@@ -373,41 +361,86 @@ class TileEntityListHandler
 {
 private:
 	static const int kMaxMapDimension = 256;
-public:
-	list_t gridEntities[kMaxMapDimension][kMaxMapDimension];
 
+	// one list per map tile, indexed y + x * gridHeight. the nodes are stored
+	// inside each Entity (myTileListNodeData) so moving between tiles never allocates
+	std::vector<list_t> gridEntities;
+	int gridWidth = 0;
+	int gridHeight = 0;
+
+	void resizeGrid(int width, int height);
+	void linkEntity(Entity& entity, int x, int y);
+	void unlinkEntity(Entity& entity);
+public:
 	void clearTile(int x, int y);
 	void emptyGridEntities();
 	list_t* getTileList(int x, int y);
 	node_t* addEntity(Entity& entity);
 	node_t* updateEntity(Entity& entity);
+	void removeEntity(Entity& entity);
 	std::vector<list_t*> getEntitiesWithinRadius(int u, int v, int radius);
 	std::vector<list_t*> getEntitiesWithinRadiusAroundEntity(Entity* entity, int radius);
 
-	TileEntityListHandler()
+	/* calls visit(Entity*) for every entity within radius tiles of u, v (1 radius is a 3x3 area)
+	   without allocating. stops and returns true as soon as visit returns true. */
+	template <typename Visitor>
+	bool forEntitiesWithinRadius(int u, int v, int radius, Visitor&& visit)
 	{
-		for ( int i = 0; i < kMaxMapDimension; ++i )
+		const int xmin = std::max(u - radius, 0);
+		const int xmax = std::min(u + radius, gridWidth - 1);
+		const int ymin = std::max(v - radius, 0);
+		const int ymax = std::min(v + radius, gridHeight - 1);
+		for ( int i = xmin; i <= xmax; ++i )
 		{
-			for ( int j = 0; j < kMaxMapDimension; ++j )
+			for ( int j = ymin; j <= ymax; ++j )
 			{
-				gridEntities[i][j].first = nullptr;
-				gridEntities[i][j].last = nullptr;
+				node_t* nextnode = nullptr;
+				for ( node_t* node = gridEntities[j + i * gridHeight].first; node != nullptr; node = nextnode )
+				{
+					nextnode = node->next;
+					if ( visit((Entity*)node->element) )
+					{
+						return true;
+					}
+				}
 			}
 		}
-	};
+		return false;
+	}
 
-	~TileEntityListHandler()
+	TileEntityListHandler() = default;
+	~TileEntityListHandler() = default; // nodes belong to the entities, nothing to free here
+};
+extern TileEntityListHandler TileEntityList;
+
+/* creature-only spatial index for AI queries over map.creatures. creatures are
+   bucketed into cells of a few tiles, kept in step with addToCreatureList,
+   clipMove, teleports and each entity's turn in gameLogic. queries fill a
+   buffer the caller owns; callers that stop at the first match ask for
+   map.creatures order so they behave the same as when walking the list. */
+class CreatureSpatialHash
+{
+public:
+	static const int kCellSize = 64; // in world units, 4 tiles
+	static const int kCellsPerSide = 64; // covers the largest map dimension
+	struct Entry_t
 	{
-		for ( int i = 0; i < kMaxMapDimension; ++i )
-		{
-			for ( int j = 0; j < kMaxMapDimension; ++j )
-			{
-				clearTile(i, j);
-			}
-		}
+		Entity* entity;
+		Uint32 order; // position in map.creatures, earlier is lower
 	};
+	std::vector<Entry_t> cells[kCellsPerSide * kCellsPerSide];
+
+	void addEntity(Entity& entity);
+	void removeEntity(Entity& entity);
+	void updateEntity(Entity& entity);
+	void clear();
+	void getCreaturesWithinRadius(real_t x, real_t y, real_t radius, std::vector<Entity*>& out, bool listOrder) const;
+	void getCreaturesWithinCone(real_t x, real_t y, real_t radius, real_t yaw, real_t halfAngle, std::vector<Entity*>& out, bool listOrder) const;
+private:
+	Uint32 nextOrder = 0;
+	static int getCell(real_t x, real_t y);
 };
-extern TileEntityListHandler TileEntityList;
+extern CreatureSpatialHash CreatureHash;
 
 class DebugStatsClass
 {
@@ -479,12 +512,16 @@ public:
 	std::chrono::high_resolution_clock::time_point messagesT2WhileLoop;
 	bool handlePacketStartLoop = false;
 
-	std::unordered_map<unsigned long, std::pair<std::string, int>> networkPackets;
 	std::unordered_map<int, int> entityUpdatePackets;
 
 	bool displayStats = false;
 	char debugOutput[1024];
 	char debugEventOutput[1024];
+	char debugPoolOutput[256];
+
+	// live/peak/freed counts from the entity and list node pools
+	ObjectPool::Stats entityPoolStats;
+	ObjectPool::Stats nodePoolStats;
 
 	DebugStatsClass()
 	{};
@@ -516,6 +553,8 @@ public:
 	void storeStats();
 
 	void storeEventStats();
+
+	void storePoolStats();
 };
 
 extern ConsoleVariable<bool> cvar_enableKeepAlives;
@@ -38,6 +38,7 @@
 #include "player.hpp"
 #endif
 #include "items.hpp"
+#include "jobs.hpp"
 #include "cppfuncs.hpp"
 #include "ui/Text.hpp"
 #include "ui/Font.hpp"
@@ -53,7 +54,6 @@ static ConsoleVariable<bool> cvar_sdl_disablejoystickrawinput("/sdl_joystick_raw
 #endif
 
 #include <thread>
-#include <future>
 #include <chrono>
 
 bool mountBaseDataFolders() {
@@ -405,7 +405,7 @@ int initApp(char const * const title, int fullscreen)
 		return 2;
 	}*/
 
-#ifndef EDITOR
+#if !defined(EDITOR) && !defined(BARONY_HEADLESS)
 	initSoundEngine(); //Yes, this silently ignores the return value...(which is not good, but not important either)
 #endif
 
@@ -422,6 +422,7 @@ int initApp(char const * const title, int fullscreen)
 		return 2;
 	}
 
+#ifndef BARONY_HEADLESS
 	// hide cursor for game
 	if ( game )
 	{
@@ -469,6 +470,7 @@ int initApp(char const * const title, int fullscreen)
     }
     GL_CHECK_ERR(glClearColor(0.f, 0.f, 0.f, 1.f));
     GL_CHECK_ERR(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
+#endif // BARONY_HEADLESS
 
 	//SDL_EnableUNICODE(1);
 	//SDL_WM_SetCaption(title, 0);
@@ -483,7 +485,9 @@ int initApp(char const * const title, int fullscreen)
 	{
 		allsurfaces[c] = NULL;
 	}
+#ifndef BARONY_HEADLESS
     GL_CHECK_ERR(glGenTextures(MAXTEXTURES, texid));
+#endif
 
 	// load windows icon
 #ifndef _MSC_VER
@@ -675,7 +679,7 @@ int initApp(char const * const title, int fullscreen)
 
 	// asynchronous loading tasks
 	std::atomic_bool loading_done {false};
-	auto loading_task = std::async(std::launch::async, [&loading_done](){
+	auto loading_task = Jobs.async("load models", [&loading_done](){
 		File* fp;
 
 		updateLoadingScreen(20);
@@ -737,7 +741,7 @@ int initApp(char const * const title, int fullscreen)
 		FileIO::close(fp);
 		updateLoadingScreen(60);
 
-#ifndef EDITOR
+#if !defined(EDITOR) && !defined(BARONY_HEADLESS)
 		int soundStatus = loadSoundResources(60, 20); // start at 60% loading, progress to 80%
 		if ( 0 != soundStatus )
 		{
@@ -760,8 +764,10 @@ int initApp(char const * const title, int fullscreen)
 	int result = loading_task.get();
 	if (result == 0)
 	{
+#ifndef BARONY_HEADLESS
 		generateVBOs(0, nummodels);
         generateTileTextures();
+#endif
 		loadLights();
 	}
 
@@ -1176,6 +1182,7 @@ int deinitApp()
 #endif
 	// close engine
 	printlog("closing engine...\n");
+	Jobs.stop();
 
 	finishStackTraceUnique();
 
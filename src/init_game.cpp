@@ -34,6 +34,7 @@
 #include "menu.hpp"
 #include "paths.hpp"
 #include "player.hpp"
+#include "jobs.hpp"
 #include "cppfuncs.hpp"
 #include "Directory.hpp"
 #include "mod_tools.hpp"
@@ -43,7 +44,6 @@
 #include "ui/MainMenu.hpp"
 
 #include <thread>
-#include <future>
 #include <chrono>
 
 /*-------------------------------------------------------------------------------
@@ -179,7 +179,7 @@ int initGame()
 	setupSpells();
 
 	std::atomic_bool loading_done {false};
-	auto loading_task = std::async(std::launch::async, [&loading_done](){
+	auto loading_task = Jobs.async("load game data", [&loading_done](){
 		updateLoadingScreen(92);
 		initGameDatafilesAsync(false);
 #ifdef NINTENDO
@@ -260,12 +260,7 @@ int initGame()
 
 		removedEntities.first = NULL;
 		removedEntities.last = NULL;
-		safePacketsSent.first = NULL;
-		safePacketsSent.last = NULL;
-		for ( int c = 0; c < MAXPLAYERS; c++ )
-		{
-			safePacketsReceivedMap[c].clear();
-		}
+		SafePackets.reset();
 		topscores.first = NULL;
 		topscores.last = NULL;
 		topscoresMultiplayer.first = NULL;
@@ -325,10 +320,12 @@ int initGame()
 		}
 		updateLoadingScreen(96);
 		
+#ifndef BARONY_HEADLESS
 		if ( !loadMusic() )
 		{
 			printlog("WARN: loadMusic() from initGame() failed!");
 		}
+#endif
 
 		loadAllScores(SCORESFILE);
 		loadAllScores(SCORESFILE_MULTIPLAYER);
@@ -546,11 +543,7 @@ void deinitGame()
 	}
 	list_FreeAll(&command_history);
 
-	list_FreeAll(&safePacketsSent);
-	for ( int c = 0; c < MAXPLAYERS; c++ )
-	{
-		safePacketsReceivedMap[c].clear();
-	}
+	SafePackets.reset();
 #ifdef SOUND
 #ifdef USE_OPENAL //TODO: OpenAL is now all of the broken...
 #define FMOD_Channel_Stop OPENAL_Channel_Stop
@@ -3238,10 +3238,7 @@ namespace ConsoleCommands {
 		});
 
 	static ConsoleCommand ccmd_dumpnetworkdata("/dumpnetworkdata", "", []CCMD{
-		for (auto element : DebugStats.networkPackets)
-		{
-			printlog("Packet: %s | %d", element.second.first.c_str(), element.second.second);
-		}
+		NetStats.print(INT_MAX, true);
 		});
 
 	static ConsoleCommand ccmd_dumpentudata("/dumpentudata", "", []CCMD{
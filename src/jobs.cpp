@@ -0,0 +1,334 @@
+/*-------------------------------------------------------------------------------
+
+	BARONY
+	File: jobs.cpp
+	Desc: a pool of persistent worker threads with work stealing, job
+	dependencies and parallel_for, shared by the renderer, the monster
+	think phase and the loading screens
+
+	Copyright 2013-2016 (c) Turning Wheel LLC, all rights reserved.
+	See LICENSE for details.
+
+-------------------------------------------------------------------------------*/
+
+#include "main.hpp"
+#include "jobs.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+JobSystem Jobs;
+
+struct JobSystem::Job
+{
+	std::function<void()> fn;
+	const char* name = "";
+	bool background = false;
+
+	// unfinished jobs this one runs after, plus one until it's been submitted
+	std::atomic<int> blockers{1};
+	std::atomic<bool> finished{false};
+
+	std::mutex mutex; // guards dependents against the job finishing
+	std::vector<Handle> dependents;
+};
+
+static thread_local int workerIndex = -1; // -1 on threads that aren't ours
+
+JobSystem::~JobSystem()
+{
+	stop();
+}
+
+void JobSystem::start()
+{
+	std::call_once(started, [this]() {
+		const int count = std::max(1, (int)std::thread::hardware_concurrency() - 1);
+		for ( int c = 0; c < count; ++c )
+		{
+			queues.emplace_back(new Queue_t);
+		}
+		for ( int c = 0; c < count; ++c )
+		{
+			threads.emplace_back(&JobSystem::workerLoop, this, c);
+		}
+		printlog("[JOBS]: started %d worker threads", count);
+	});
+}
+
+void JobSystem::stop()
+{
+	if ( threads.empty() )
+	{
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for ( auto& thread : threads )
+	{
+		thread.join();
+	}
+	threads.clear();
+}
+
+int JobSystem::workers()
+{
+	start();
+	return (int)threads.size();
+}
+
+JobSystem::Handle JobSystem::submit(const char* name, std::function<void()> fn, const std::vector<Handle>& after)
+{
+	return queue(name, std::move(fn), after, false);
+}
+
+JobSystem::Handle JobSystem::queue(const char* name, std::function<void()>&& fn, const std::vector<Handle>& after, bool background)
+{
+	start();
+	auto job = std::make_shared<Job>();
+	job->fn = std::move(fn);
+	job->name = name ? name : "";
+	job->background = background;
+	for ( auto& dependency : after )
+	{
+		if ( !dependency )
+		{
+			continue;
+		}
+		std::lock_guard<std::mutex> lock(dependency->mutex);
+		if ( !dependency->finished )
+		{
+			++job->blockers;
+			dependency->dependents.push_back(job);
+		}
+	}
+	release(job);
+	return job;
+}
+
+void JobSystem::release(const Handle& job)
+{
+	if ( --job->blockers == 0 )
+	{
+		enqueue(job);
+	}
+}
+
+void JobSystem::enqueue(const Handle& job)
+{
+	if ( stopping )
+	{
+		run(job); // nobody left to hand it to
+		return;
+	}
+	Queue_t* q;
+	if ( job->background )
+	{
+		q = &backgroundQueue;
+	}
+	else if ( workerIndex >= 0 )
+	{
+		q = queues[workerIndex].get();
+	}
+	else
+	{
+		q = queues[nextQueue++ % queues.size()].get();
+	}
+	{
+		std::lock_guard<std::mutex> lock(q->mutex);
+		q->jobs.push_back(job);
+	}
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		++queued;
+	}
+	wake.notify_one();
+}
+
+JobSystem::Handle JobSystem::take(bool background)
+{
+	// our own queue, newest first while it's still warm in cache
+	if ( workerIndex >= 0 )
+	{
+		auto& q = *queues[workerIndex];
+		std::lock_guard<std::mutex> lock(q.mutex);
+		if ( !q.jobs.empty() )
+		{
+			Handle job = std::move(q.jobs.back());
+			q.jobs.pop_back();
+			--queued;
+			return job;
+		}
+	}
+
+	// then the oldest job from anyone else
+	const int count = (int)queues.size();
+	const int first = workerIndex >= 0 ? workerIndex + 1 : (int)(nextQueue % count);
+	for ( int c = 0; c < count; ++c )
+	{
+		const int index = (first + c) % count;
+		if ( index == workerIndex )
+		{
+			continue;
+		}
+		auto& q = *queues[index];
+		std::lock_guard<std::mutex> lock(q.mutex);
+		if ( !q.jobs.empty() )
+		{
+			Handle job = std::move(q.jobs.front());
+			q.jobs.pop_front();
+			--queued;
+			++stolen;
+			return job;
+		}
+	}
+
+	if ( background )
+	{
+		std::lock_guard<std::mutex> lock(backgroundQueue.mutex);
+		if ( !backgroundQueue.jobs.empty() )
+		{
+			Handle job = std::move(backgroundQueue.jobs.front());
+			backgroundQueue.jobs.pop_front();
+			--queued;
+			return job;
+		}
+	}
+	return nullptr;
+}
+
+void JobSystem::run(const Handle& job)
+{
+	const auto begin = std::chrono::high_resolution_clock::now();
+	job->fn();
+	job->fn = nullptr; // let go of whatever it captured
+	const std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - begin;
+	{
+		std::lock_guard<std::mutex> lock(timingMutex);
+		auto& timing = timings[job->name];
+		++timing.jobs;
+		timing.totalMs += elapsed.count();
+		timing.maxMs = std::max(timing.maxMs, elapsed.count());
+	}
+
+	std::vector<Handle> dependents;
+	{
+		std::lock_guard<std::mutex> lock(job->mutex);
+		job->finished = true;
+		dependents.swap(job->dependents);
+	}
+	for ( auto& dependent : dependents )
+	{
+		release(dependent);
+	}
+	{
+		std::lock_guard<std::mutex> lock(doneMutex);
+	}
+	jobDone.notify_all();
+}
+
+void JobSystem::workerLoop(int index)
+{
+	workerIndex = index;
+	while ( true )
+	{
+		if ( Handle job = take(true) )
+		{
+			run(job);
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		if ( stopping && queued <= 0 )
+		{
+			break;
+		}
+		wake.wait(lock, [this]() { return queued > 0 || stopping; });
+	}
+}
+
+bool JobSystem::done(const Handle& job) const
+{
+	return !job || job->finished;
+}
+
+void JobSystem::wait(const Handle& job)
+{
+	while ( !done(job) )
+	{
+		if ( Handle other = take(false) )
+		{
+			run(other);
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(doneMutex);
+		jobDone.wait_for(lock, std::chrono::milliseconds(1), [&job]() { return (bool)job->finished; });
+	}
+}
+
+void JobSystem::parallel_for(const char* name, size_t begin, size_t end, size_t minBatch,
+	const std::function<void(size_t, size_t)>& fn)
+{
+	if ( end <= begin )
+	{
+		return;
+	}
+	const size_t count = end - begin;
+	const size_t threads = (size_t)workers() + 1;
+	const size_t batches = std::max((size_t)1, std::min(threads, count / std::max((size_t)1, minBatch)));
+	const size_t batchSize = (count + batches - 1) / batches;
+
+	// queue all but the first batch, which this thread takes
+	std::vector<Handle> jobs;
+	jobs.reserve(batches);
+	for ( size_t first = begin + batchSize; first < end; first += batchSize )
+	{
+		const size_t last = std::min(first + batchSize, end);
+		jobs.push_back(submit(name, [&fn, first, last]() { fn(first, last); }));
+	}
+	auto self = std::make_shared<Job>();
+	self->name = name ? name : "";
+	self->fn = [&fn, begin, batchSize, end]() { fn(begin, std::min(begin + batchSize, end)); };
+	run(self);
+	for ( auto& job : jobs )
+	{
+		wait(job);
+	}
+}
+
+const std::string& JobSystem::overlayText()
+{
+	const Uint32 now = SDL_GetTicks();
+	if ( now - lastReport < 1000 && !report.empty() )
+	{
+		return report;
+	}
+	const double seconds = lastReport ? (now - lastReport) / 1000.0 : 1.0;
+	lastReport = now;
+
+	std::vector<std::pair<std::string, Timing_t>> sorted;
+	{
+		std::lock_guard<std::mutex> lock(timingMutex);
+		sorted.assign(timings.begin(), timings.end());
+		timings.clear();
+	}
+	std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) {
+		return a.second.totalMs > b.second.totalMs;
+	});
+
+	char buf[256];
+	snprintf(buf, sizeof(buf), "jobs: %d workers, %d queued, %u stolen/s\n",
+		(int)threads.size(), (int)queued, (unsigned)(stolen.exchange(0) / seconds));
+	report = buf;
+	for ( auto& it : sorted )
+	{
+		const auto& timing = it.second;
+		snprintf(buf, sizeof(buf), "%-20.20s %6.0f/s %8.2f ms/s  avg %6.3f ms  max %6.3f ms\n",
+			it.first.c_str(), timing.jobs / seconds, timing.totalMs / seconds,
+			timing.totalMs / timing.jobs, timing.maxMs);
+		report += buf;
+	}
+	return report;
+}
@@ -0,0 +1,124 @@
+/*-------------------------------------------------------------------------------
+
+	BARONY
+	File: jobs.hpp
+	Desc: prototypes for jobs.cpp, the engine's pool of worker threads
+
+	Copyright 2013-2016 (c) Turning Wheel LLC, all rights reserved.
+	See LICENSE for details.
+
+-------------------------------------------------------------------------------*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/*-------------------------------------------------------------------------------
+
+	JobSystem
+
+	A fixed set of worker threads, started the first time work is submitted,
+	that everything in the engine shares instead of creating threads of its
+	own. Each worker has its own queue; jobs submitted from a worker go on
+	that worker's queue and idle workers steal from the others. A thread that
+	waits on a job runs other queued jobs while it waits.
+
+	Long running work that isn't waited on every frame (level and model
+	loading) goes through async(). Those jobs are only picked up by workers
+	with nothing else to do, so a thread waiting on a quick job never ends
+	up running one.
+
+-------------------------------------------------------------------------------*/
+
+class JobSystem
+{
+public:
+	struct Job;
+	using Handle = std::shared_ptr<Job>;
+
+	~JobSystem();
+
+	// queues fn to run once every job in after has finished. name groups the
+	// job's timings in /jobs_overlay and should be a string literal
+	Handle submit(const char* name, std::function<void()> fn, const std::vector<Handle>& after = {});
+
+	// like std::async(std::launch::async, fn), but on a worker
+	template <typename Fn>
+	auto async(const char* name, Fn&& fn) -> std::future<decltype(fn())>
+	{
+		using Result_t = decltype(fn());
+		auto task = std::make_shared<std::packaged_task<Result_t()>>(std::forward<Fn>(fn));
+		auto future = task->get_future();
+		queue(name, [task]() { (*task)(); }, {}, true);
+		return future;
+	}
+
+	bool done(const Handle& job) const;
+	void wait(const Handle& job); // runs other jobs on this thread until job is done
+
+	// calls fn(first, last) over [begin, end) in batches of at least minBatch,
+	// spread across the workers and this thread. returns once all are done
+	void parallel_for(const char* name, size_t begin, size_t end, size_t minBatch,
+		const std::function<void(size_t, size_t)>& fn);
+
+	int workers(); // worker threads, not counting threads that wait
+	void stop(); // finishes what's queued and joins the workers
+
+	// per job name timings, rebuilt about once a second
+	const std::string& overlayText();
+
+private:
+	struct Queue_t
+	{
+		std::mutex mutex;
+		std::deque<Handle> jobs;
+	};
+
+	struct Timing_t
+	{
+		Uint32 jobs = 0;
+		double totalMs = 0.0;
+		double maxMs = 0.0;
+	};
+
+	Handle queue(const char* name, std::function<void()>&& fn, const std::vector<Handle>& after, bool background);
+	void start();
+	void release(const Handle& job); // one fewer thing the job is waiting on
+	void enqueue(const Handle& job);
+	Handle take(bool background); // from this thread's queue, then anyone's
+	void run(const Handle& job);
+	void workerLoop(int index);
+
+	std::once_flag started;
+	std::vector<std::thread> threads;
+	std::vector<std::unique_ptr<Queue_t>> queues;
+	Queue_t backgroundQueue;
+	std::atomic<unsigned> nextQueue{0};
+	std::atomic<bool> stopping{false};
+
+	// workers sleep here while there's nothing queued
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+	std::atomic<int> queued{0};
+
+	// threads in wait() sleep here between jobs
+	std::mutex doneMutex;
+	std::condition_variable jobDone;
+
+	std::mutex timingMutex;
+	std::unordered_map<std::string, Timing_t> timings;
+	std::atomic<Uint32> stolen{0};
+	Uint32 lastReport = 0;
+	std::string report;
+};
+extern JobSystem Jobs;
@@ -13,6 +13,433 @@
 #include "light.hpp"
 #include "draw.hpp"
 
+LightmapRegion lightmapsDirty[MAXPLAYERS + 1];
+
+void markLightmapDirty(int index, int x0, int y0, int x1, int y1)
+{
+	if ( index )
+	{
+		lightmapsDirty[index].add(x0, y0, x1, y1);
+	}
+	else
+	{
+		for ( int c = 0; c < MAXPLAYERS + 1; ++c )
+		{
+			lightmapsDirty[c].add(x0, y0, x1, y1);
+		}
+	}
+}
+
+void markLightmapsDirty()
+{
+	markLightmapDirty(0, 0, 0, map.width - 1, map.height - 1);
+}
+
+/*-------------------------------------------------------------------------------
+
+	lightmap layers
+
+	Lights with index 0 go into lightmapBase once instead of into a copy of
+	the lightmap for every view. A light made for one player goes into that
+	player's overlay, which only spans that player's lights; the renderer
+	adds the two together as it smooths each view.
+
+-------------------------------------------------------------------------------*/
+
+LightmapOverlay lightmapOverlays[MAXPLAYERS + 1];
+vec4_t lightmapSmoothedFill(0.f);
+
+// adds sign * light->tiles into dest, which holds the tiles of area column by column
+static void accumulateLight(const light_t* light, float sign, vec4_t* dest, const LightmapRegion& area)
+{
+	if ( !light->tiles || area.empty() )
+	{
+		return;
+	}
+	const int size = light->radius * 2 + 1;
+	const int height = area.y1 - area.y0 + 1;
+	const int x0 = std::max(light->x - light->radius, area.x0);
+	const int y0 = std::max(light->y - light->radius, area.y0);
+	const int x1 = std::min(light->x + light->radius, area.x1);
+	const int y1 = std::min(light->y + light->radius, area.y1);
+	for ( int u = x0; u <= x1; ++u )
+	{
+		const vec4_t* src = &light->tiles[(u - light->x + light->radius) * size + (y0 - light->y + light->radius)];
+		vec4_t* d = &dest[(u - area.x0) * height + (y0 - area.y0)];
+		for ( int v = 0; v <= y1 - y0; ++v )
+		{
+			const auto& t = src[v];
+			if ( t.w <= 0.f )
+			{
+				continue; // unlit or past the falloff
+			}
+			d[v].x += sign * t.x;
+			d[v].y += sign * t.y;
+			d[v].z += sign * t.z;
+			d[v].w += sign * t.w;
+		}
+	}
+}
+
+// the part of a light's square that is on the map
+static LightmapRegion lightArea(const light_t* light)
+{
+	LightmapRegion area;
+	area.add(std::max(light->x - light->radius, 0), std::max(light->y - light->radius, 0),
+		std::min(light->x + light->radius, (Sint32)map.width - 1), std::min(light->y + light->radius, (Sint32)map.height - 1));
+	return area;
+}
+
+static bool sameRegion(const LightmapRegion& a, const LightmapRegion& b)
+{
+	if ( a.empty() || b.empty() )
+	{
+		return a.empty() == b.empty();
+	}
+	return a.x0 == b.x0 && a.y0 == b.y0 && a.x1 == b.x1 && a.y1 == b.y1;
+}
+
+void LightmapOverlay::clear()
+{
+	region.clear();
+	tiles.clear();
+	lights.clear();
+}
+
+void LightmapOverlay::add(light_t* light)
+{
+	lights.push_back(light);
+	LightmapRegion grown = region;
+	grown.add(lightArea(light));
+	if ( sameRegion(grown, region) )
+	{
+		accumulateLight(light, 1.f, tiles.data(), region);
+		return;
+	}
+
+	// grow to fit, then put every light back
+	region = grown;
+	tiles.assign((region.x1 - region.x0 + 1) * (region.y1 - region.y0 + 1), vec4_t(0.f));
+	for ( auto l : lights )
+	{
+		accumulateLight(l, 1.f, tiles.data(), region);
+	}
+}
+
+void LightmapOverlay::remove(light_t* light)
+{
+	auto find = std::find(lights.begin(), lights.end(), light);
+	if ( find == lights.end() )
+	{
+		return; // added before the overlay was last cleared
+	}
+	lights.erase(find);
+	if ( lights.empty() )
+	{
+		region.clear();
+		tiles.clear();
+		return;
+	}
+	LightmapRegion shrunk;
+	for ( auto l : lights )
+	{
+		shrunk.add(lightArea(l));
+	}
+	if ( sameRegion(shrunk, region) )
+	{
+		accumulateLight(light, -1.f, tiles.data(), region);
+		return;
+	}
+
+	// shrink to fit what's left
+	region = shrunk;
+	tiles.assign(region.empty() ? 0 : (region.x1 - region.x0 + 1) * (region.y1 - region.y0 + 1), vec4_t(0.f));
+	for ( auto l : lights )
+	{
+		accumulateLight(l, 1.f, tiles.data(), region);
+	}
+}
+
+static void applyLight(light_t* light, bool add)
+{
+	if ( !light || !light->tiles )
+	{
+		return;
+	}
+	if ( light->index > 0 && light->index < MAXPLAYERS + 1 )
+	{
+		if ( add )
+		{
+			lightmapOverlays[light->index].add(light);
+		}
+		else
+		{
+			lightmapOverlays[light->index].remove(light);
+		}
+	}
+	else if ( lightmapBase.size() >= map.width * map.height )
+	{
+		LightmapRegion map_area;
+		map_area.add(0, 0, map.width - 1, map.height - 1);
+		accumulateLight(light, add ? 1.f : -1.f, lightmapBase.data(), map_area);
+	}
+	markLightmapDirty(light->index, light->x - light->radius, light->y - light->radius,
+		light->x + light->radius, light->y + light->radius);
+}
+
+void addLightToLightmap(light_t* light)
+{
+	applyLight(light, true);
+}
+
+void removeLightFromLightmap(light_t* light)
+{
+	applyLight(light, false);
+}
+
+static void clearLightCache();
+
+void resetLightmaps(int width, int height, float ambience)
+{
+	clearLightCache(); // a new level, none of the old lights will come back
+	const vec4_t fill(ambience, ambience, ambience, 0.f);
+	lightmapBase.assign(width * height, fill);
+	lightmapSmoothedFill = fill;
+	for ( int c = 0; c < MAXPLAYERS + 1; ++c )
+	{
+		lightmapOverlays[c].clear();
+		lightmapsSmoothed[c].clear(); // filled in when a view first draws
+	}
+	markLightmapDirty(0, 0, 0, width - 1, height - 1);
+}
+
+#ifndef EDITOR
+#include "game.hpp"
+#include "net.hpp"
+#include "interface/consolecommand.hpp"
+static ConsoleVariable<bool> cvar_lightCache("/light_cache", true);
+#endif
+
+/*-------------------------------------------------------------------------------
+
+	light cache
+
+	Torches, spells and glowing entities throw their light away and add it
+	again whenever they move or flicker, mostly onto the same tile with the
+	same parameters. A shadowed light depends only on those parameters and on
+	the tiles inside its square, so the finished tiles are kept with the
+	mapGeneration they were cast at, and reused while no mapTileChanged()
+	has landed in a region of tiles the square overlaps since. Checking is a
+	handful of reads however large the light is.
+
+	Level loading adds lights from its worker thread, so the cache is shared
+	under a lock. It is only held to look up or store an entry, never while
+	casting.
+
+-------------------------------------------------------------------------------*/
+
+static constexpr Uint8 LIGHT_TILE_OBSTACLE = 1 << 0; // blocks light, but is lit itself
+static constexpr Uint8 LIGHT_TILE_SOLID = 1 << 1; // filled on every layer, never lit
+static constexpr Uint8 LIGHT_TILE_OUTSIDE = 1 << 2; // off the edge of the map
+
+struct LightCacheKey
+{
+	Sint32 x, y, radius;
+	float r, g, b, exp;
+	bool operator==(const LightCacheKey& other) const
+	{
+		return x == other.x && y == other.y && radius == other.radius
+			&& r == other.r && g == other.g && b == other.b && exp == other.exp;
+	}
+};
+
+struct LightCacheKeyHash
+{
+	size_t operator()(const LightCacheKey& key) const
+	{
+		size_t h = std::hash<Sint32>()(key.x);
+		h = h * 31 + std::hash<Sint32>()(key.y);
+		h = h * 31 + std::hash<Sint32>()(key.radius);
+		h = h * 31 + std::hash<float>()(key.r);
+		h = h * 31 + std::hash<float>()(key.g);
+		h = h * 31 + std::hash<float>()(key.b);
+		h = h * 31 + std::hash<float>()(key.exp);
+		return h;
+	}
+};
+
+struct LightCacheEntry
+{
+	Uint32 generation = 0; // mapGeneration when the tiles were cast
+	std::vector<vec4_t> tiles;
+};
+
+static constexpr size_t LIGHT_CACHE_MAX = 4096; // entries; the whole cache is dropped past this
+static std::mutex lightCacheLock; // guards lightCache and its counters
+static std::unordered_map<LightCacheKey, LightCacheEntry, LightCacheKeyHash> lightCache;
+static Uint32 lightCacheHits = 0;
+static Uint32 lightCacheStale = 0;
+static Uint32 lightCacheMisses = 0;
+
+static void clearLightCache()
+{
+	// swap rather than clear() so the buckets are handed back too
+	std::lock_guard<std::mutex> guard(lightCacheLock);
+	std::unordered_map<LightCacheKey, LightCacheEntry, LightCacheKeyHash>().swap(lightCache);
+}
+
+// classifies every tile in the light's square, laid out like light->tiles
+static void lightOccluders(Sint32 x, Sint32 y, Sint32 radius, std::vector<Uint8>& occluders)
+{
+	const int size = radius * 2 + 1;
+	occluders.resize(size * size);
+	for ( int u = x - radius; u <= x + radius; ++u )
+	{
+		for ( int v = y - radius; v <= y + radius; ++v )
+		{
+			Uint8& tile = occluders[(v - y + radius) + (u - x + radius) * size];
+			if ( u < 0 || v < 0 || u >= map.width || v >= map.height )
+			{
+				tile = LIGHT_TILE_OUTSIDE;
+				continue;
+			}
+			const int mapindex = v * MAPLAYERS + u * MAPLAYERS * map.height;
+			tile = map.tiles[OBSTACLELAYER + mapindex] ? LIGHT_TILE_OBSTACLE : 0;
+			bool solid = true;
+			for ( int z = 0; z < MAPLAYERS; ++z )
+			{
+				if ( !map.tiles[mapindex + z] )
+				{
+					solid = false;
+					break;
+				}
+			}
+			if ( solid )
+			{
+				tile |= LIGHT_TILE_SOLID;
+			}
+		}
+	}
+}
+
+/*-------------------------------------------------------------------------------
+
+	lightShadowcast
+
+	Symmetric recursive shadowcasting: each quadrant around the light is
+	scanned one row of tiles at a time, narrowing the visible slopes at
+	every wall edge, so each tile is considered once rather than walking a
+	line back to the origin from every tile. A floor tile is lit only if
+	its centre is inside the visible slopes, which makes the result
+	symmetric (a tile the light reaches could see the light back); walls
+	in view are lit so their faces catch the light.
+
+-------------------------------------------------------------------------------*/
+
+struct LightScan_t
+{
+	const Uint8* occluders;
+	Uint8* visible;
+	int radius;
+	int size;
+	int quadrant;
+};
+
+static int lightScanIndex(const LightScan_t& scan, int depth, int col)
+{
+	int dx, dy;
+	switch ( scan.quadrant )
+	{
+		case 0: dx = col; dy = -depth; break;
+		case 1: dx = col; dy = depth; break;
+		case 2: dx = depth; dy = col; break;
+		default: dx = -depth; dy = col; break;
+	}
+	return (dy + scan.radius) + (dx + scan.radius) * scan.size;
+}
+
+static void lightScanRow(const LightScan_t& scan, int depth, double startSlope, double endSlope)
+{
+	if ( depth > scan.radius )
+	{
+		return;
+	}
+	const int minCol = (int)floor(depth * startSlope + 0.5);
+	const int maxCol = (int)ceil(depth * endSlope - 0.5);
+	int prev = -1; // -1 before the first tile, 0 after a floor, 1 after a wall
+	for ( int col = minCol; col <= maxCol; ++col )
+	{
+		const int index = lightScanIndex(scan, depth, col);
+		const bool wall = scan.occluders[index] & (LIGHT_TILE_OBSTACLE | LIGHT_TILE_OUTSIDE);
+		if ( wall || (col >= depth * startSlope && col <= depth * endSlope) )
+		{
+			scan.visible[index] = 1;
+		}
+		const double edge = (2.0 * col - 1.0) / (2.0 * depth);
+		if ( prev == 1 && !wall )
+		{
+			startSlope = edge;
+		}
+		else if ( prev == 0 && wall )
+		{
+			lightScanRow(scan, depth + 1, startSlope, edge);
+		}
+		prev = wall ? 1 : 0;
+	}
+	if ( prev == 0 )
+	{
+		lightScanRow(scan, depth + 1, startSlope, endSlope);
+	}
+}
+
+// fills tiles (zeroed, (2r+1)^2 long) with the light cast against occluders
+static void lightShadowcast(const Uint8* occluders, vec4_t* tiles, Sint32 radius, float r, float g, float b, float exp)
+{
+	const int size = radius * 2 + 1;
+	static thread_local std::vector<Uint8> visible;
+	visible.assign(size * size, 0);
+	visible[radius + radius * size] = 1;
+	for ( int quadrant = 0; quadrant < 4; ++quadrant )
+	{
+		const LightScan_t scan{ occluders, visible.data(), radius, size, quadrant };
+		lightScanRow(scan, 1, -1.0, 1.0);
+	}
+
+	for ( int dx = -radius; dx <= radius; ++dx )
+	{
+		for ( int dy = -radius; dy <= radius; ++dy )
+		{
+			const auto soff = (dy + radius) + (dx + radius) * size;
+			if ( !visible[soff] || (occluders[soff] & (LIGHT_TILE_SOLID | LIGHT_TILE_OUTSIDE)) )
+			{
+				continue;
+			}
+			const float dist = exp != 1.f ? powf(dx * dx + dy * dy, exp) : dx * dx + dy * dy;
+			const auto falloff = std::min<float>(dist / radius, 1.0f);
+			constexpr float a = 255.f;
+			auto& s = tiles[soff];
+			s.x += r - r * falloff;
+			s.y += g - g * falloff;
+			s.z += b - b * falloff;
+			s.w += a - a * falloff;
+		}
+	}
+}
+
+#ifndef EDITOR
+static ConsoleCommand ccmd_lightCacheStats("/light_cache_stats", "print shadowed light cache counters since last asked",
+	[](int argc, const char** argv) {
+	std::lock_guard<std::mutex> guard(lightCacheLock);
+	const Uint32 total = lightCacheHits + lightCacheStale + lightCacheMisses;
+	messagePlayer(clientnum, MESSAGE_MISC, "light cache: %u shadowed lights, %u reused, %u recast after the map changed, %u new (%.1f%% reused), %u entries",
+		total, lightCacheHits, lightCacheStale, lightCacheMisses,
+		total ? 100.0 * lightCacheHits / total : 0.0, (unsigned)lightCache.size());
+	lightCacheHits = 0;
+	lightCacheStale = 0;
+	lightCacheMisses = 0;
+	});
+#endif
+
 /*-------------------------------------------------------------------------------
 
 	lightSphereShadow
@@ -25,100 +452,62 @@
 light_t* lightSphereShadow(int index, Sint32 x, Sint32 y, Sint32 radius, float r, float g, float b, float exp)
 {
 	light_t* light = newLight(index, x, y, radius);
-    r = r * 255.f;
-    g = g * 255.f;
-    b = b * 255.f;
+	if ( radius <= 0 )
+	{
+		return light;
+	}
+	const int size = radius * 2 + 1;
 
-	for (int v = y - radius; v <= y + radius; ++v) {
-		for (int u = x - radius; u <= x + radius; ++u) {
-			if (u >= 0 && v >= 0 && u < map.width && v < map.height) {
-				const int dx = u - x;
-				const int dy = v - y;
-				const int dxabs = abs(dx);
-				const int dyabs = abs(dy);
-				real_t a0 = dyabs * .5;
-				real_t b0 = dxabs * .5;
-				int u2 = u;
-				int v2 = v;
-                
-                // check origin is okay
-				bool wallhit = true;
-				const int mapindex = v * MAPLAYERS + u * MAPLAYERS * map.height;
-				for (int z = 0; z < MAPLAYERS; z++) {
-					if (!map.tiles[mapindex + z]) {
-						wallhit = false;
-						break;
-					}
-				}
-				if (wallhit == true) {
-					continue;
-				}
-                
-                // line test
-                if (dxabs >= dyabs) { // the line is more horizontal than vertical
-					for (int i = 0; i < dxabs; ++i) {
-						u2 -= sgn(dx);
-						b0 += dyabs;
-						if (b0 >= dxabs) {
-							b0 -= dxabs;
-							v2 -= sgn(dy);
-						}
-						if (u2 >= 0 && u2 < map.width && v2 >= 0 && v2 < map.height) {
-							if (map.tiles[OBSTACLELAYER + v2 * MAPLAYERS + u2 * MAPLAYERS * map.height]) {
-								wallhit = true;
-								break;
-							}
-						}
-					}
-				}
-                else { // the line is more vertical than horizontal
-					for (int i = 0; i < dyabs; ++i) {
-						v2 -= sgn(dy);
-						a0 += dxabs;
-						if (a0 >= dyabs) {
-							a0 -= dyabs;
-							u2 -= sgn(dx);
-						}
-						if (u2 >= 0 && u2 < map.width && v2 >= 0 && v2 < map.height) {
-							if (map.tiles[OBSTACLELAYER + v2 * MAPLAYERS + u2 * MAPLAYERS * map.height]) {
-								wallhit = true;
-								break;
-							}
-						}
-					}
-				}
-                
-                // light tile if it passed line test
-				if (wallhit == false || (wallhit == true && u2 == u && v2 == v)) {
-                    const float dist = exp != 1.f ? powf(dx * dx + dy * dy, exp) : dx * dx + dy * dy;
-                    const auto falloff = std::min<float>(dist / radius, 1.0f);
-                    constexpr float a = 255.f;
-                    const auto soff = (dy + radius) + (dx + radius) * (radius * 2 + 1);
-                    auto& s = light->tiles[soff];
-					s.x += r - r * falloff;
-                    s.y += g - g * falloff;
-                    s.z += b - b * falloff;
-                    s.w += a - a * falloff;
-                    const auto doff = v + u * map.height;
-                    if (index) {
-                        auto& d = lightmaps[index][doff];
-                        d.x += s.x;
-                        d.y += s.y;
-                        d.z += s.z;
-                        d.w += s.w;
-                    } else {
-                        for (int c = 0; c < MAXPLAYERS + 1; ++c) {
-                            auto& d = lightmaps[c][doff];
-                            d.x += s.x;
-                            d.y += s.y;
-                            d.z += s.z;
-                            d.w += s.w;
-                        }
-                    }
-                }
-			}
+#ifndef EDITOR
+	const bool useCache = *cvar_lightCache;
+#else
+	const bool useCache = true;
+#endif
+	const LightCacheKey key{ x, y, radius, r, g, b, exp };
+	bool cached = false;
+	if ( useCache )
+	{
+		const Uint32 tilesChanged = tileRegionGeneration(x - radius, y - radius, x + radius, y + radius);
+		std::lock_guard<std::mutex> guard(lightCacheLock);
+		auto find = lightCache.find(key);
+		if ( find == lightCache.end() )
+		{
+			++lightCacheMisses;
+		}
+		else if ( find->second.generation < tilesChanged )
+		{
+			++lightCacheStale;
 		}
+		else
+		{
+			++lightCacheHits;
+			std::copy(find->second.tiles.begin(), find->second.tiles.end(), light->tiles);
+			cached = true;
+		}
+	}
+	if ( cached )
+	{
+		addLightToLightmap(light);
+		return light;
 	}
+
+	const Uint32 generation = mapGeneration; // before reading the tiles, so a write during the cast counts as newer
+	static thread_local std::vector<Uint8> occluders;
+	lightOccluders(x, y, radius, occluders);
+	lightShadowcast(occluders.data(), light->tiles, radius, r * 255.f, g * 255.f, b * 255.f, exp);
+	if ( useCache )
+	{
+		std::lock_guard<std::mutex> guard(lightCacheLock);
+		if ( lightCache.size() >= LIGHT_CACHE_MAX && lightCache.find(key) == lightCache.end() )
+		{
+			lightCache.clear();
+		}
+		auto& entry = lightCache[key];
+		entry.generation = generation;
+		entry.tiles.assign(light->tiles, light->tiles + size * size);
+	}
+
+	addLightToLightmap(light);
 	return light;
 }
 
@@ -152,25 +541,10 @@ light_t* lightSphere(int index, Sint32 x, Sint32 y, Sint32 radius, float r, floa
                 s.y += g - g * falloff;
                 s.z += b - b * falloff;
                 s.w += a - a * falloff;
-                const auto doff = v + u * map.height;
-                if (index) {
-                    auto& d = lightmaps[index][doff];
-                    d.x += s.x;
-                    d.y += s.y;
-                    d.z += s.z;
-                    d.w += s.w;
-                } else {
-                    for (int c = 0; c < MAXPLAYERS + 1; ++c) {
-                        auto& d = lightmaps[c][doff];
-                        d.x += s.x;
-                        d.y += s.y;
-                        d.z += s.z;
-                        d.w += s.w;
-                    }
-                }
 			}
 		}
 	}
+    addLightToLightmap(light);
 	return light;
 }
 
@@ -27,6 +27,68 @@ light_t* newLight(int index, Sint32 x, Sint32 y, Sint32 radius);
 light_t* addLight(Sint32 x, Sint32 y, const char* name, int range_bonus = 0, int index = 0);
 bool loadLights(bool forceLoadBaseDirectory = false);
 
+// inclusive rectangle of lightmap tiles, empty when x0 > x1
+struct LightmapRegion {
+    int x0 = 0, y0 = 0, x1 = -1, y1 = -1;
+    bool empty() const { return x0 > x1 || y0 > y1; }
+    void clear() { x0 = 0; y0 = 0; x1 = -1; y1 = -1; }
+    void add(int ax0, int ay0, int ax1, int ay1) {
+        if (ax0 > ax1 || ay0 > ay1) {
+            return;
+        }
+        if (empty()) {
+            x0 = ax0; y0 = ay0; x1 = ax1; y1 = ay1;
+        } else {
+            x0 = std::min(x0, ax0); y0 = std::min(y0, ay0);
+            x1 = std::max(x1, ax1); y1 = std::max(y1, ay1);
+        }
+    }
+    void add(const LightmapRegion& r) { add(r.x0, r.y0, r.x1, r.y1); }
+};
+
+// light seen only by one player's view, kept over the smallest rectangle
+// that holds that player's lights rather than over the whole map
+struct LightmapOverlay {
+    LightmapRegion region; // tiles covered, empty when there are no lights
+    std::vector<vec4_t> tiles; // region.x1 - region.x0 + 1 columns of region.y1 - region.y0 + 1
+    std::vector<light_t*> lights;
+    
+    void add(light_t* light);
+    void remove(light_t* light);
+    void clear();
+    
+    // the overlay's column at x, indexed by y - region.y0, or nullptr
+    const vec4_t* column(int x) const {
+        if (region.empty() || x < region.x0 || x > region.x1) {
+            return nullptr;
+        }
+        return &tiles[(x - region.x0) * (region.y1 - region.y0 + 1)];
+    }
+    
+    vec4_t composite(const vec4_t& base, int x, int y) const {
+        const vec4_t* col = column(x);
+        if (!col || y < region.y0 || y > region.y1) {
+            return base;
+        }
+        const auto& o = col[y - region.y0];
+        return vec4_t(base.x + o.x, base.y + o.y, base.z + o.z, base.w + o.w);
+    }
+};
+
+// a player's view sees lightmapBase (lights with index 0) plus
+// lightmapOverlays[player + 1]; any other view sees lightmapBase alone
+extern LightmapOverlay lightmapOverlays[MAXPLAYERS + 1]; // lights with an index; [0] stays empty
+extern vec4_t lightmapSmoothedFill; // what lightmapsSmoothed[] start as when a view first needs one
+
+void addLightToLightmap(light_t* light); // to the base, or to the overlay for light->index
+void removeLightFromLightmap(light_t* light);
+void resetLightmaps(int width, int height, float ambience);
+
+// tiles of each view's lightmap written since the renderer last smoothed them
+extern LightmapRegion lightmapsDirty[MAXPLAYERS + 1];
+void markLightmapDirty(int index, int x0, int y0, int x1, int y1); // index 0 marks every lightmap
+void markLightmapsDirty(); // the whole map, in every lightmap
+
 struct LightDef {
     int radius = 0;
     float r = 0.f;
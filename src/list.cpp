@@ -14,6 +14,263 @@
 #include "items.hpp"
 #include "interface/interface.hpp"
 #include "player.hpp"
+
+ObjectPool nodePool(sizeof(node_t), 4096, 0);
+ObjectPool entityPool(sizeof(Entity), 128, 1);
+
+/*-------------------------------------------------------------------------------
+
+	ObjectPool::cache
+
+	returns the calling thread's free list for this pool. levels load on a
+	worker thread while the main thread keeps running, so every thread keeps
+	its own list and only takes the lock to trade a batch with the shared one.
+
+-------------------------------------------------------------------------------*/
+
+ObjectPool::ThreadCache& ObjectPool::cache()
+{
+	static thread_local ThreadCache caches[kMaxPools];
+	ThreadCache& local = caches[slot];
+	local.pool = this;
+	return local;
+}
+
+ObjectPool::ThreadCache::~ThreadCache()
+{
+	if ( pool && freeList )
+	{
+		pool->spill(*this, count);
+	}
+}
+
+/*-------------------------------------------------------------------------------
+
+	ObjectPool::foldStats
+
+	adds a thread's allocate/release counts to the pool's stats. the lock
+	must be held.
+
+-------------------------------------------------------------------------------*/
+
+void ObjectPool::foldStats(ThreadCache& local)
+{
+	stats.allocated += local.allocated;
+	stats.freed += local.freed;
+	local.allocated = 0;
+	local.freed = 0;
+
+	// objects freed on one thread may have been allocated on another that
+	// hasn't folded its counts in yet
+	stats.live = stats.allocated > stats.freed ? (Uint32)(stats.allocated - stats.freed) : 0;
+	stats.peak = std::max(stats.peak, stats.live);
+}
+
+/*-------------------------------------------------------------------------------
+
+	ObjectPool::refill
+
+	moves a batch of objects from the shared free list to an empty thread
+	list, carving a new slab off the heap if the shared list is empty too
+
+-------------------------------------------------------------------------------*/
+
+void ObjectPool::refill(ThreadCache& local)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	foldStats(local);
+	if ( freeList )
+	{
+		FreeObject* last = freeList;
+		Uint32 count = 1;
+		for ( ; count < objectsPerSlab && last->next; ++count )
+		{
+			last = last->next;
+		}
+		local.freeList = freeList;
+		local.count = count;
+		freeList = last->next;
+		last->next = nullptr;
+		return;
+	}
+
+	Slab* slab = (Slab*) malloc(kSlabHeader + objectSize * objectsPerSlab);
+	if ( !slab )
+	{
+		return;
+	}
+	slab->next = slabs;
+	slabs = slab;
+	++stats.slabs;
+	char* objects = (char*)slab + kSlabHeader;
+	for ( Uint32 c = objectsPerSlab; c > 0; --c )
+	{
+		FreeObject* object = (FreeObject*)(objects + (c - 1) * objectSize);
+		object->next = local.freeList;
+		local.freeList = object;
+	}
+	local.count = objectsPerSlab;
+}
+
+/*-------------------------------------------------------------------------------
+
+	ObjectPool::spill
+
+	moves objects from a thread list back to the shared free list, so a
+	thread that frees more than it allocates doesn't hoard them
+
+-------------------------------------------------------------------------------*/
+
+void ObjectPool::spill(ThreadCache& local, Uint32 amount)
+{
+	if ( !local.freeList || amount == 0 )
+	{
+		return;
+	}
+	FreeObject* first = local.freeList;
+	FreeObject* last = first;
+	Uint32 count = 1;
+	for ( ; count < amount && last->next; ++count )
+	{
+		last = last->next;
+	}
+	local.freeList = last->next;
+	local.count -= count;
+
+	std::lock_guard<std::mutex> guard(lock);
+	foldStats(local);
+	last->next = freeList;
+	freeList = first;
+}
+
+/*-------------------------------------------------------------------------------
+
+	ObjectPool::allocate
+
+	hands out a free object from the calling thread's list, refilling it
+	from the shared list when it runs dry
+
+-------------------------------------------------------------------------------*/
+
+void* ObjectPool::allocate()
+{
+	ThreadCache& local = cache();
+	if ( !local.freeList )
+	{
+		refill(local);
+		if ( !local.freeList )
+		{
+			return nullptr;
+		}
+	}
+	FreeObject* object = local.freeList;
+	local.freeList = object->next;
+	--local.count;
+	++local.allocated;
+	return object;
+}
+
+/*-------------------------------------------------------------------------------
+
+	ObjectPool::release
+
+	returns an object to the calling thread's list
+
+-------------------------------------------------------------------------------*/
+
+void ObjectPool::release(void* object)
+{
+	if ( !object )
+	{
+		return;
+	}
+	ThreadCache& local = cache();
+	FreeObject* freeObject = (FreeObject*)object;
+	freeObject->next = local.freeList;
+	local.freeList = freeObject;
+	++local.count;
+	++local.freed;
+	if ( local.count >= objectsPerSlab * 2 )
+	{
+		spill(local, objectsPerSlab);
+	}
+}
+
+/*-------------------------------------------------------------------------------
+
+	ObjectPool::trim
+
+	frees every slab that has no live objects left in it. called on map
+	change, when most entities and their nodes have just been released.
+	objects sitting in other threads' lists keep their slabs alive.
+
+-------------------------------------------------------------------------------*/
+
+void ObjectPool::trim()
+{
+	ThreadCache& local = cache();
+	spill(local, local.count);
+
+	std::lock_guard<std::mutex> guard(lock);
+	if ( !slabs )
+	{
+		return;
+	}
+
+	// count free objects per slab
+	std::vector<std::pair<char*, Uint32>> slabFree;
+	for ( Slab* slab = slabs; slab != nullptr; slab = slab->next )
+	{
+		slabFree.emplace_back((char*)slab + kSlabHeader, 0);
+	}
+	std::sort(slabFree.begin(), slabFree.end());
+	auto findSlab = [&](void* object) {
+		auto it = std::upper_bound(slabFree.begin(), slabFree.end(), std::make_pair((char*)object, UINT32_MAX));
+		return it - 1;
+	};
+	for ( FreeObject* object = freeList; object != nullptr; object = object->next )
+	{
+		++findSlab(object)->second;
+	}
+
+	// drop the empty slabs' objects from the free list, then the slabs themselves
+	FreeObject** link = &freeList;
+	while ( *link )
+	{
+		if ( findSlab(*link)->second == objectsPerSlab )
+		{
+			*link = (*link)->next;
+		}
+		else
+		{
+			link = &(*link)->next;
+		}
+	}
+	Slab** slabLink = &slabs;
+	while ( *slabLink )
+	{
+		Slab* slab = *slabLink;
+		if ( findSlab((char*)slab + kSlabHeader)->second == objectsPerSlab )
+		{
+			*slabLink = slab->next;
+			free(slab);
+			--stats.slabs;
+		}
+		else
+		{
+			slabLink = &slab->next;
+		}
+	}
+}
+
+ObjectPool::Stats ObjectPool::getStats()
+{
+	ThreadCache& local = cache();
+	std::lock_guard<std::mutex> guard(lock);
+	foldStats(local);
+	return stats;
+}
+
 /*-------------------------------------------------------------------------------
 
 	list_FreeAll
@@ -181,7 +438,7 @@ void list_RemoveNode(node_t* node)
 	{
 		free(node->element);
 	}
-	free(node);
+	nodePool.release(node);
 }
 
 /*-------------------------------------------------------------------------------
@@ -199,7 +456,7 @@ node_t* list_AddNodeFirst(list_t* list)
 	node_t* node;
 
 	// allocate memory for node
-	if ( (node = (node_t*) malloc(sizeof(node_t))) == NULL )
+	if ( (node = (node_t*) nodePool.allocate()) == NULL )
 	{
 		printlog( "failed to allocate memory for new node!\n" );
 		exit(1);
@@ -245,7 +502,7 @@ node_t* list_AddNodeLast(list_t* list)
 	node_t* node;
 
 	// allocate memory for node
-	if ( (node = (node_t*) malloc(sizeof(node_t))) == NULL )
+	if ( (node = (node_t*) nodePool.allocate()) == NULL )
 	{
 		printlog( "failed to allocate memory for new node!\n" );
 		exit(1);
@@ -296,7 +553,7 @@ node_t* list_AddNode(list_t* list, int index)
 	}
 
 	// allocate memory for node
-	if ( (node = (node_t*) malloc(sizeof(node_t))) == NULL )
+	if ( (node = (node_t*) nodePool.allocate()) == NULL )
 	{
 		printlog( "failed to allocate memory for new node!\n" );
 		exit(1);
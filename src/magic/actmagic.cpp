@@ -3584,7 +3584,7 @@ void actMagicMissile(Entity* my)   //TODO: Verify this function.
 				{
 					if ( !client_disconnected[i] && players[i]->isLocalPlayer() && cameras[i].vismap[y + x * map.height] )
 					{
-						spawnMagicParticle(my);
+						emitMagicParticle(my);
 						break;
 					}
 				}
@@ -3592,7 +3592,7 @@ void actMagicMissile(Entity* my)   //TODO: Verify this function.
 		}
 		else
 		{
-			spawnMagicParticle(my);
+			emitMagicParticle(my);
 		}
 	}
 	else
@@ -3651,7 +3651,7 @@ void actMagicClient(Entity* my)
 			{
 				if ( !client_disconnected[i] && players[i]->isLocalPlayer() && cameras[i].vismap[y + x * map.height] )
 				{
-					spawnMagicParticle(my);
+					emitMagicParticle(my);
 					break;
 				}
 			}
@@ -3659,7 +3659,7 @@ void actMagicClient(Entity* my)
 	}
 	else
 	{
-		spawnMagicParticle(my);
+		emitMagicParticle(my);
 	}
 }
 
@@ -3676,7 +3676,7 @@ void actMagicClientNoLight(Entity* my)
 			{
 				if ( !client_disconnected[i] && players[i]->isLocalPlayer() && cameras[i].vismap[y + x * map.height] )
 				{
-					spawnMagicParticle(my);
+					emitMagicParticle(my);
 					break;
 				}
 			}
@@ -3684,7 +3684,7 @@ void actMagicClientNoLight(Entity* my)
 	}
 	else
 	{
-		spawnMagicParticle(my);
+		emitMagicParticle(my);
 	}
 }
 
@@ -3865,6 +3865,182 @@ Entity* spawnMagicParticleCustom(Entity* parentent, int sprite, real_t scale, re
 	return entity;
 }
 
+ParticleSystem MagicParticles;
+
+void ParticleSystem::spawn(const Particle& particle)
+{
+	x.push_back(particle.x);
+	y.push_back(particle.y);
+	z.push_back(particle.z);
+	velx.push_back(particle.vel_x);
+	vely.push_back(particle.vel_y);
+	velz.push_back(particle.vel_z);
+	yaw.push_back(particle.yaw);
+	pitch.push_back(particle.pitch);
+	roll.push_back(particle.roll);
+	scale.push_back(particle.scale);
+	shrink.push_back(particle.shrink);
+	light.push_back(particle.lightBonus);
+	life.push_back(particle.lifetime >= 0 ? particle.lifetime : INT_MAX);
+	sprite.push_back(particle.sprite);
+	peak = std::max(peak, sprite.size());
+}
+
+void ParticleSystem::remove(size_t index)
+{
+	// swap with the last particle, draw order doesn't matter for opaque voxels
+	const size_t last = sprite.size() - 1;
+	x[index] = x[last]; x.pop_back();
+	y[index] = y[last]; y.pop_back();
+	z[index] = z[last]; z.pop_back();
+	velx[index] = velx[last]; velx.pop_back();
+	vely[index] = vely[last]; vely.pop_back();
+	velz[index] = velz[last]; velz.pop_back();
+	yaw[index] = yaw[last]; yaw.pop_back();
+	pitch[index] = pitch[last]; pitch.pop_back();
+	roll[index] = roll[last]; roll.pop_back();
+	scale[index] = scale[last]; scale.pop_back();
+	shrink[index] = shrink[last]; shrink.pop_back();
+	light[index] = light[last]; light.pop_back();
+	life[index] = life[last]; life.pop_back();
+	sprite[index] = sprite[last]; sprite.pop_back();
+}
+
+void ParticleSystem::update()
+{
+	const size_t num = sprite.size();
+	for ( size_t c = 0; c < num; ++c )
+	{
+		x[c] += velx[c];
+		y[c] += vely[c];
+		z[c] += velz[c];
+		scale[c] -= shrink[c];
+		--life[c];
+	}
+	for ( size_t c = 0; c < sprite.size(); )
+	{
+		if ( life[c] < 0 || scale[c] <= 0.f )
+		{
+			remove(c);
+		}
+		else
+		{
+			++c;
+		}
+	}
+}
+
+void ParticleSystem::draw(view_t* camera, int mode)
+{
+	if ( sprite.empty() || mode == ENTITYUIDS || !camera )
+	{
+		return;
+	}
+	if ( !proxy )
+	{
+		proxy = newEntity(-1, 1, &proxyList, nullptr);
+		proxy->flags[PASSABLE] = true;
+		proxy->flags[NOUPDATE] = true;
+		proxy->flags[UNCLICKABLE] = true;
+		if ( multiplayer != CLIENT )
+		{
+			entity_uids--;
+		}
+		proxy->setUID(-3);
+	}
+	auto& dither = proxy->dithering[camera];
+	dither.value = Entity::Dither::MAX;
+	dither.lastUpdateTick = ticks;
+
+	for ( size_t c = 0; c < sprite.size(); ++c )
+	{
+		const int tx = static_cast<int>(x[c]) >> 4;
+		const int ty = static_cast<int>(y[c]) >> 4;
+		if ( tx >= 0 && ty >= 0 && tx < map.width && ty < map.height )
+		{
+			if ( !camera->vismap[ty + tx * map.height] )
+			{
+				continue;
+			}
+		}
+		if ( behindCamera(*camera, x[c] / 16.0, y[c] / 16.0) )
+		{
+			continue;
+		}
+		proxy->sprite = sprite[c];
+		proxy->x = x[c];
+		proxy->y = y[c];
+		proxy->z = z[c];
+		proxy->yaw = yaw[c];
+		proxy->pitch = pitch[c];
+		proxy->roll = roll[c];
+		proxy->scalex = scale[c];
+		proxy->scaley = scale[c];
+		proxy->scalez = scale[c];
+		proxy->lightBonus = vec4(light[c], light[c], light[c], 0.f);
+		glDrawVoxel(camera, proxy, mode);
+	}
+}
+
+void ParticleSystem::clear()
+{
+	x.clear();
+	y.clear();
+	z.clear();
+	velx.clear();
+	vely.clear();
+	velz.clear();
+	yaw.clear();
+	pitch.clear();
+	roll.clear();
+	scale.clear();
+	shrink.clear();
+	light.clear();
+	life.clear();
+	sprite.clear();
+}
+
+void emitMagicParticle(Entity* parentent)
+{
+	if ( !parentent )
+	{
+		return;
+	}
+	ParticleSystem::Particle particle;
+	particle.sprite = parentent->sprite;
+	particle.x = parentent->x + (local_rng.rand() % 50 - 25) / 20.f;
+	particle.y = parentent->y + (local_rng.rand() % 50 - 25) / 20.f;
+	particle.z = parentent->z + (local_rng.rand() % 50 - 25) / 20.f;
+	particle.scale = 0.7;
+	particle.shrink = (particle.sprite == 943 || particle.sprite == 979) ? 0.1 : 0.05;
+	particle.yaw = parentent->yaw;
+	particle.pitch = parentent->pitch;
+	particle.roll = parentent->roll;
+	particle.lightBonus = *cvar_magic_fx_light_bonus;
+	MagicParticles.spawn(particle);
+}
+
+void emitMagicParticleCustom(Entity* parentent, int sprite, real_t scale, real_t spreadReduce)
+{
+	if ( !parentent )
+	{
+		return;
+	}
+	ParticleSystem::Particle particle;
+	int size = 50 / spreadReduce;
+	particle.sprite = sprite;
+	particle.x = parentent->x + (local_rng.rand() % size - size / 2) / 20.f;
+	particle.y = parentent->y + (local_rng.rand() % size - size / 2) / 20.f;
+	particle.z = parentent->z + (local_rng.rand() % size - size / 2) / 20.f;
+	particle.scale = scale;
+	particle.shrink = (sprite == 943 || sprite == 979) ? 0.1 : 0.05;
+	particle.yaw = parentent->yaw;
+	particle.pitch = parentent->pitch;
+	particle.roll = parentent->roll;
+	particle.lightBonus = *cvar_magic_fx_light_bonus;
+	MagicParticles.spawn(particle);
+}
+
 void spawnMagicEffectParticles(Sint16 x, Sint16 y, Sint16 z, Uint32 sprite)
 {
 	int c;
@@ -3891,28 +4067,17 @@ void spawnMagicEffectParticles(Sint16 x, Sint16 y, Sint16 z, Uint32 sprite)
 	// boosty boost
 	for ( c = 0; c < 10; c++ )
 	{
-		Entity* entity = newEntity(sprite, 1, map.entities, nullptr); //Particle entity.
-		entity->x = x - 5 + local_rng.rand() % 11;
-		entity->y = y - 5 + local_rng.rand() % 11;
-		entity->z = z - 10 + local_rng.rand() % 21;
-		entity->scalex = 0.7;
-		entity->scaley = 0.7;
-		entity->scalez = 0.7;
-		entity->sizex = 1;
-		entity->sizey = 1;
-		entity->yaw = (local_rng.rand() % 360) * PI / 180.f;
-		entity->flags[PASSABLE] = true;
-		entity->flags[NOUPDATE] = true;
-		entity->flags[UNCLICKABLE] = true;
-		entity->lightBonus = vec4(*cvar_magic_fx_light_bonus, *cvar_magic_fx_light_bonus, 
-			*cvar_magic_fx_light_bonus, 0.f);
-		entity->behavior = &actMagicParticle;
-		entity->vel_z = -1;
-		if ( multiplayer != CLIENT )
-		{
-			entity_uids--;
-		}
-		entity->setUID(-3);
+		ParticleSystem::Particle particle;
+		particle.sprite = sprite;
+		particle.x = x - 5 + local_rng.rand() % 11;
+		particle.y = y - 5 + local_rng.rand() % 11;
+		particle.z = z - 10 + local_rng.rand() % 21;
+		particle.scale = 0.7;
+		particle.shrink = (particle.sprite == 943 || particle.sprite == 979) ? 0.1 : 0.05;
+		particle.yaw = (local_rng.rand() % 360) * PI / 180.f;
+		particle.lightBonus = *cvar_magic_fx_light_bonus;
+		particle.vel_z = -1;
+		MagicParticles.spawn(particle);
 	}
 }
 
@@ -4090,26 +4255,15 @@ void createParticleDot(Entity* parent)
 	}
 	for ( int c = 0; c < 50; c++ )
 	{
-		Entity* entity = newEntity(576, 1, map.entities, nullptr); //Particle entity.
-		entity->sizex = 1;
-		entity->sizey = 1;
-		entity->x = parent->x + (-4 + local_rng.rand() % 9);
-		entity->y = parent->y + (-4 + local_rng.rand() % 9);
-		entity->z = 7.5 + local_rng.rand()%50;
-		entity->vel_z = -1;
-		//entity->yaw = (local_rng.rand() % 360) * PI / 180.0;
-		entity->skill[0] = 10 + local_rng.rand()% 50;
-		entity->behavior = &actParticleDot;
-		entity->flags[PASSABLE] = true;
-		entity->flags[NOUPDATE] = true;
-		entity->flags[UNCLICKABLE] = true;
-		entity->lightBonus = vec4(*cvar_magic_fx_light_bonus, *cvar_magic_fx_light_bonus,
-			*cvar_magic_fx_light_bonus, 0.f);
-		if ( multiplayer != CLIENT )
-		{
-			entity_uids--;
-		}
-		entity->setUID(-3);
+		ParticleSystem::Particle particle;
+		particle.sprite = 576;
+		particle.x = parent->x + (-4 + local_rng.rand() % 9);
+		particle.y = parent->y + (-4 + local_rng.rand() % 9);
+		particle.z = 7.5 + local_rng.rand()%50;
+		particle.vel_z = -1;
+		particle.lifetime = 10 + local_rng.rand()% 50;
+		particle.lightBonus = *cvar_magic_fx_light_bonus;
+		MagicParticles.spawn(particle);
 	}
 }
 
@@ -4323,7 +4477,7 @@ void actParticleAestheticOrbit(Entity* my)
 				return;
 			}
 			my->yaw += 0.2;
-			spawnMagicParticle(my);
+			emitMagicParticle(my);
 			my->x = parent->x + my->actmagicOrbitDist * cos(my->yaw);
 			my->y = parent->y + my->actmagicOrbitDist * sin(my->yaw);
 		}
@@ -4605,29 +4759,16 @@ void createParticleDropRising(Entity* parent, int sprite, double scale)
 	for ( int c = 0; c < 50; c++ )
 	{
 		// shoot drops to the sky
-		Entity* entity = newEntity(sprite, 1, map.entities, nullptr); //Particle entity.
-		entity->sizex = 1;
-		entity->sizey = 1;
-		entity->x = parent->x - 4 + local_rng.rand() % 9;
-		entity->y = parent->y - 4 + local_rng.rand() % 9;
-		entity->z = 7.5 + local_rng.rand() % 50;
-		entity->vel_z = -1;
-		//entity->yaw = (local_rng.rand() % 360) * PI / 180.0;
-		entity->particleDuration = 10 + local_rng.rand() % 50;
-		entity->scalex *= scale;
-		entity->scaley *= scale;
-		entity->scalez *= scale;
-		entity->behavior = &actParticleDot;
-		entity->flags[PASSABLE] = true;
-		entity->flags[NOUPDATE] = true;
-		entity->flags[UNCLICKABLE] = true;
-		entity->lightBonus = vec4(*cvar_magic_fx_light_bonus, *cvar_magic_fx_light_bonus,
-			*cvar_magic_fx_light_bonus, 0.f);
-		if ( multiplayer != CLIENT )
-		{
-			entity_uids--;
-		}
-		entity->setUID(-3);
+		ParticleSystem::Particle particle;
+		particle.sprite = sprite;
+		particle.x = parent->x - 4 + local_rng.rand() % 9;
+		particle.y = parent->y - 4 + local_rng.rand() % 9;
+		particle.z = 7.5 + local_rng.rand() % 50;
+		particle.vel_z = -1;
+		particle.lifetime = 10 + local_rng.rand() % 50;
+		particle.scale = scale;
+		particle.lightBonus = *cvar_magic_fx_light_bonus;
+		MagicParticles.spawn(particle);
 	}
 }
 
@@ -4682,7 +4823,7 @@ void actParticleErupt(Entity* my)
 				{
 					if ( !client_disconnected[i] && players[i]->isLocalPlayer() && cameras[i].vismap[y + x * map.height] )
 					{
-						spawnMagicParticle(my);
+						emitMagicParticle(my);
 						break;
 					}
 				}
@@ -4690,7 +4831,7 @@ void actParticleErupt(Entity* my)
 		}
 		else
 		{
-			spawnMagicParticle(my);
+			emitMagicParticle(my);
 		}
 		if ( my->skill[1] == 0 ) // rising
 		{
@@ -5293,7 +5434,7 @@ void actParticleSap(Entity* my)
 					{
 						if ( !client_disconnected[i] && players[i]->isLocalPlayer() && cameras[i].vismap[y + x * map.height] )
 						{
-							spawnMagicParticle(my);
+							emitMagicParticle(my);
 							break;
 						}
 					}
@@ -5301,7 +5442,7 @@ void actParticleSap(Entity* my)
 			}
 			else
 			{
-				spawnMagicParticle(my);
+				emitMagicParticle(my);
 			}
 		}
 		Entity* parent = uidToEntity(my->parent);
@@ -6772,6 +6913,8 @@ bool magicDig(Entity* parent, Entity* projectile, int numRocks, int randRocks)
 				}
 
 				map.tiles[(int)(OBSTACLELAYER + hit.mapy * MAPLAYERS + hit.mapx * MAPLAYERS * map.height)] = 0;
+				mapTileChanged(hit.mapx, hit.mapy);
+				markChunksDirty(hit.mapx, hit.mapy);
 
 				// send wall destroy info to clients
 				if ( multiplayer == SERVER )
@@ -6792,7 +6935,7 @@ bool magicDig(Entity* parent, Entity* projectile, int numRocks, int randRocks)
 					}
 				}
 
-				generatePathMaps();
+				updatePathMaps(hit.mapx, hit.mapy);
 				return true;
 			}
 		}
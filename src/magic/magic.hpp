@@ -14,6 +14,47 @@
 #pragma once
 
 class Stat;
+struct view_t;
+
+// visual-only particles (trails, sparkles, rising drops) that nothing ever looks up,
+// collides with or sends over the network. they are kept out of map.entities in
+// parallel arrays and stepped in one pass per tick, and drawn through a single
+// stand-in entity.
+class ParticleSystem
+{
+public:
+	struct Particle
+	{
+		Sint32 sprite = 0;
+		real_t x = 0.0, y = 0.0, z = 0.0;
+		real_t vel_x = 0.0, vel_y = 0.0, vel_z = 0.0;
+		real_t yaw = 0.0, pitch = 0.0, roll = 0.0;
+		real_t scale = 1.0;
+		real_t shrink = 0.0; // scale lost per tick, removed once it reaches 0
+		int lifetime = -1; // ticks to live, -1 to live until shrunk away
+		float lightBonus = 0.f;
+	};
+
+	void spawn(const Particle& particle);
+	void update(); // once per logic tick
+	void draw(view_t* camera, int mode);
+	void clear();
+	size_t size() const { return sprite.size(); }
+	size_t peak = 0;
+private:
+	std::vector<float> x, y, z;
+	std::vector<float> velx, vely, velz;
+	std::vector<float> yaw, pitch, roll;
+	std::vector<float> scale, shrink, light;
+	std::vector<int> life;
+	std::vector<Sint32> sprite;
+
+	list_t proxyList{ nullptr, nullptr };
+	Entity* proxy = nullptr;
+
+	void remove(size_t index);
+};
+extern ParticleSystem MagicParticles;
 
 static const int SPELLCASTING_BEGINNER = 40; //If the player's spellcasting skill is below this, they're a newbie and will suffer various penalties to their spellcasting.
 
@@ -523,6 +564,8 @@ void actHUDMagicParticle(Entity* my);
 void actHUDMagicParticleCircling(Entity* my);
 Entity* spawnMagicParticle(Entity* parentent);
 Entity* spawnMagicParticleCustom(Entity* parentent, int sprite, real_t scale, real_t spreadReduce);
+void emitMagicParticle(Entity* parentent); // as spawnMagicParticle, but into MagicParticles
+void emitMagicParticleCustom(Entity* parentent, int sprite, real_t scale, real_t spreadReduce);
 void spawnMagicEffectParticles(Sint16 x, Sint16 y, Sint16 z, Uint32 sprite);
 void createParticleCircling(Entity* parent, int duration, int sprite);
 void actParticleCircle(Entity* my);
@@ -384,8 +384,6 @@ TCPsocket net_tcpsock = nullptr;
 UDPpacket* net_packet = nullptr;
 TCPsocket* net_tcpclients = nullptr;
 SDLNet_SocketSet tcpset = nullptr;
-list_t safePacketsSent;
-std::unordered_map<int, Uint32> safePacketsReceivedMap[MAXPLAYERS];
 bool receivedclientnum = false;
 char const * window_title = nullptr;
 SDL_Window* screen = nullptr;
@@ -535,7 +533,8 @@ bool *lavatiles = nullptr;
 bool *swimmingtiles = nullptr;
 int rscale = 1;
 real_t vidgamma = 1.0f;
-std::vector<vec4_t> lightmaps[MAXPLAYERS + 1];
+std::vector<vec4_t> lightmapBase;
+Uint32 mapGeneration = 0;
 std::vector<vec4_t> lightmapsSmoothed[MAXPLAYERS + 1];
 bool mode3d = false;
 bool verticalSync = false;
@@ -586,6 +585,52 @@ bool no_sound = false;
 
 hit_t hit;
 
+/*-------------------------------------------------------------------------------
+
+	mapTileChanged
+
+	bumps mapGeneration after a tile write, and stamps the region of tiles
+	it landed in with the new generation so caches covering part of the
+	map only need to look at the regions they cover
+
+-------------------------------------------------------------------------------*/
+
+static const int kTileRegionsPerSide = 256 / kTileRegionSize; // largest map dimension
+static Uint32 tileRegionGenerations[kTileRegionsPerSide * kTileRegionsPerSide] = { 0 };
+
+static int tileRegion(int tile)
+{
+	return std::min(std::max(tile, 0) / kTileRegionSize, kTileRegionsPerSide - 1);
+}
+
+void mapTileChanged(int x, int y)
+{
+	++mapGeneration;
+	tileRegionGenerations[tileRegion(y) + tileRegion(x) * kTileRegionsPerSide] = mapGeneration;
+}
+
+void mapTileChanged()
+{
+	++mapGeneration;
+	for ( auto& generation : tileRegionGenerations )
+	{
+		generation = mapGeneration;
+	}
+}
+
+Uint32 tileRegionGeneration(int x1, int y1, int x2, int y2)
+{
+	Uint32 result = 0;
+	for ( int u = tileRegion(x1); u <= tileRegion(x2); ++u )
+	{
+		for ( int v = tileRegion(y1); v <= tileRegion(y2); ++v )
+		{
+			result = std::max(result, tileRegionGenerations[v + u * kTileRegionsPerSide]);
+		}
+	}
+	return result;
+}
+
 /*-------------------------------------------------------------------------------
 
 	longestline
@@ -54,6 +54,7 @@ using std::string; //Instead of including an entire namespace, please explicitly
 #include <unordered_set>
 #include <set>
 #include <functional>
+#include <mutex>
 #include "physfs.h"
 #include "Config.hpp"
 
@@ -720,7 +721,7 @@ extern int minimapTransparencyForeground;
 extern int minimapTransparencyBackground;
 extern int minimapScale;
 extern int minimapObjectZoom;
-extern std::vector<vec4_t> lightmaps[MAXPLAYERS + 1];
+extern std::vector<vec4_t> lightmapBase; // shared by every view, see light.hpp
 extern std::vector<vec4_t> lightmapsSmoothed[MAXPLAYERS + 1];
 extern list_t entitiesdeleted;
 extern Sint32 multiplayer;
@@ -776,6 +777,27 @@ extern SDLNet_SocketSet tcpset;
 
 // various definitions
 extern map_t map;
+
+// tells the renderer the tiles at x, y changed so the chunks around them get
+// rebuilt. main thread only. without arguments, the whole map changed
+void markChunksDirty(int x, int y);
+void markChunksDirty();
+
+// game logic calls this right after writing map.tiles at x, y, separately
+// from markChunksDirty(), which is for the renderer. without arguments, the
+// whole map changed. main thread only
+void mapTileChanged(int x, int y);
+void mapTileChanged();
+
+// the mapGeneration of the latest mapTileChanged() in any kTileRegionSize
+// square of tiles overlapping x1, y1 to x2, y2 (inclusive). a result no newer
+// than a cache entry's generation means none of those tiles changed since
+static const int kTileRegionSize = 8;
+Uint32 tileRegionGeneration(int x1, int y1, int x2, int y2);
+
+// bumped by mapTileChanged() and whenever a door or gate opens or closes,
+// so anything caching line of sight knows to throw its results away
+extern Uint32 mapGeneration;
 extern list_t ttfTextHash[HASH_SIZE];
 extern TTF_Font* ttf8;
 #define TTF8_WIDTH 7
@@ -841,6 +863,73 @@ int numdigits_sint16(Sint16 x);
 int longestline(char const * const str);
 int concatedStringLength(char* str, ...);
 
+// fixed-size slab allocator for node_t and Entity (see list.cpp).
+// each thread allocates from and releases to its own free list without
+// locking; the lock is only taken to trade a whole batch with the shared list.
+class ObjectPool
+{
+public:
+	struct Stats
+	{
+		Uint32 live = 0;
+		Uint32 peak = 0;
+		Uint64 allocated = 0;
+		Uint64 freed = 0;
+		Uint32 slabs = 0;
+	};
+
+	static const Uint32 kMaxPools = 2;
+
+	// slot picks this pool's thread-local free list, and must be unique per pool
+	constexpr ObjectPool(size_t size, Uint32 perSlab, Uint32 slot) :
+		objectSize((std::max(size, sizeof(void*)) + kAlignment - 1) & ~(kAlignment - 1)),
+		objectsPerSlab(perSlab),
+		slot(slot)
+	{}
+
+	void* allocate(); // nullptr if the heap is exhausted
+	void release(void* object);
+	void trim(); // returns slabs with no live objects to the heap, call between levels
+	Stats getStats(); // other threads' counts lag by up to one batch
+
+	// no destructor on purpose: objects can still be released during static teardown
+private:
+	static const size_t kAlignment = 16;
+	struct FreeObject
+	{
+		FreeObject* next;
+	};
+	struct Slab
+	{
+		Slab* next;
+	};
+	static const size_t kSlabHeader = (sizeof(Slab) + kAlignment - 1) & ~(kAlignment - 1);
+	struct ThreadCache
+	{
+		ObjectPool* pool = nullptr;
+		FreeObject* freeList = nullptr;
+		Uint32 count = 0;
+		Uint64 allocated = 0; // not yet folded into stats
+		Uint64 freed = 0;
+		~ThreadCache(); // hands the list back to the shared pool when the thread exits
+	};
+
+	ThreadCache& cache();
+	void refill(ThreadCache& local);
+	void spill(ThreadCache& local, Uint32 amount);
+	void foldStats(ThreadCache& local);
+
+	std::mutex lock; // guards everything below
+	const size_t objectSize;
+	const Uint32 objectsPerSlab;
+	const Uint32 slot;
+	Slab* slabs = nullptr;
+	FreeObject* freeList = nullptr;
+	Stats stats;
+};
+extern ObjectPool nodePool;
+extern ObjectPool entityPool;
+
 // function prototypes for list.c:
 void list_FreeAll(list_t* list);
 void list_RemoveNode(node_t* node);
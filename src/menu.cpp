@@ -8940,6 +8940,7 @@ void doNewGame(bool makeHighscore) {
 			if ( followers )
 			{
 				int c;
+				NetMessages.beginBulk(); // followers go to each client as one compressed transfer
 				for ( c = 0; c < MAXPLAYERS; c++ )
 				{
 					node_t* tempNode = list_Node(followers, c);
@@ -9038,7 +9039,7 @@ void doNewGame(bool makeHighscore) {
 										net_packet->address.host = net_clients[c - 1].host;
 										net_packet->address.port = net_clients[c - 1].port;
 										net_packet->len = 12 + strlen(name.c_str()) + 1;
-										sendPacketSafe(net_sock, -1, net_packet, c - 1);
+										queuePacketSafe(net_sock, -1, net_packet, c - 1);
 
 										serverUpdateAllyStat(c, monster->getUID(), monsterStats->LVL, monsterStats->HP, monsterStats->MAXHP, monsterStats->type);
 									}
@@ -9109,6 +9110,7 @@ void doNewGame(bool makeHighscore) {
 						}
 					}
 				}
+				NetMessages.endBulk();
 				list_FreeAll(followers);
 				free(followers);
 			}
@@ -9336,10 +9338,9 @@ void doNewGame(bool makeHighscore) {
 	// delete game data clutter
 	list_FreeAll(&messages);
 	list_FreeAll(&command_history);
-	list_FreeAll(&safePacketsSent);
+	SafePackets.clear();
 	for ( int c = 0; c < MAXPLAYERS; c++ )
 	{
-		safePacketsReceivedMap[c].clear();
 		players[c]->messageZone.deleteAllNotificationMessages();
 	}
 	if ( !loadingsavegame ) // don't delete the followers we just created!
@@ -9887,10 +9888,9 @@ void doEndgame(bool saveHighscore) {
 	// delete game data clutter
 	list_FreeAll(&messages);
 	list_FreeAll(&command_history);
-	list_FreeAll(&safePacketsSent);
+	SafePackets.clear();
 	for ( c = 0; c < MAXPLAYERS; c++ )
 	{
-		safePacketsReceivedMap[c].clear();
 		players[c]->messageZone.deleteAllNotificationMessages();
 	}
 	for (c = 0; c < MAXPLAYERS; c++)
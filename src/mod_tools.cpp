@@ -14,6 +14,7 @@ See LICENSE for details.
 #include "classdescriptions.hpp"
 #include "draw.hpp"
 #include "player.hpp"
+#include "jobs.hpp"
 #include "scores.hpp"
 #include "ui/Field.hpp"
 #include "ui/Image.hpp"
@@ -25,7 +26,6 @@ See LICENSE for details.
 #include "init.hpp"
 #include "ui/LoadingScreen.hpp"
 #include <thread>
-#include <future>
 #include <fstream>
 
 MonsterStatCustomManager monsterStatCustomManager;
@@ -8343,20 +8343,20 @@ void GameplayPreferences_t::sendToClients(const int targetPlayer)
 	sendPacketSafe(net_sock, -1, net_packet, targetPlayer - 1);
 }
 
-void GameplayPreferences_t::receivePacket()
+void GameplayPreferences_t::receivePacket(PacketReader& packet)
 {
-	if ( !net_packet )
-	{
-		return;
-	}
-	int player = (Uint8)net_packet->data[4];
-	if ( player >= 0 && player < MAXPLAYERS )
+	int player = packet.read8();
+	const int numPrefs = packet.read8();
+	if ( packet.ok() && player >= 0 && player < MAXPLAYERS )
 	{
 		auto& playerPrefs = gameplayPreferences[player];
-		const int numPrefs = (Uint8)net_packet->data[5];
 		for ( int i = 0; i < numPrefs && i < GPREF_ENUM_END; ++i )
 		{
-			int data = (net_packet->data[6 + i] & 0xFF);
+			int data = packet.read8();
+			if ( !packet.ok() )
+			{
+				break;
+			}
 			playerPrefs.preferences[i].value = data;
 			playerPrefs.preferences[i].needsUpdate = false;
 			//messagePlayer(clientnum, MESSAGE_DEBUG, "%d rcv: %d : %d", player, i, playerPrefs.preferences[i].value);
@@ -9232,7 +9232,7 @@ void Mods::loadModels(int start, int end) {
 	}
 
 	std::atomic_bool loading_done{ false };
-	auto loading_task = std::async(std::launch::async, [&loading_done, start, end]() {
+	auto loading_task = Jobs.async("reload models", [&loading_done, start, end]() {
 		std::string modelsDirectory = PHYSFS_getRealDir("models/models.txt");
 	modelsDirectory.append(PHYSFS_getDirSeparator()).append("models/models.txt");
 	File* fp = openDataFile(modelsDirectory.c_str(), "rb");
@@ -9338,7 +9338,7 @@ void Mods::unloadMods(bool force)
 
 	// begin async load process
 	std::atomic_bool loading_done{ false };
-	auto loading_task = std::async(std::launch::async, [&loading_done]() {
+	auto loading_task = Jobs.async("reload mod data", [&loading_done]() {
 		initGameDatafilesAsync(true);
 
 		// update sounds
@@ -9624,7 +9624,7 @@ void Mods::loadMods()
 	doLoadingScreen();
 
 	std::atomic_bool loading_done{ false };
-	auto loading_task = std::async(std::launch::async, [&loading_done]() {
+	auto loading_task = Jobs.async("reload game data", [&loading_done]() {
 		initGameDatafilesAsync(true);
 		loading_done = true;
 		return 0;
@@ -3231,6 +3231,7 @@ struct LocalAchievements_t
 };
 extern LocalAchievements_t LocalAchievements;
 
+class PacketReader;
 class GameplayPreferences_t
 {
 	//Player& player;
@@ -3264,7 +3265,7 @@ public:
 	void sendToClients(const int targetPlayer);
 	void process();
 	void sendToServer();
-	static void receivePacket();
+	static void receivePacket(PacketReader& packet);
 
 	enum GameConfigIndexes : int
 	{
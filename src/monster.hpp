@@ -1233,4 +1233,50 @@ struct MimicGenerator
 	void init();
 	bool bForceSpawnForCurrentFloor();
 };
-extern MimicGenerator mimic_generator;
\ No newline at end of file
+extern MimicGenerator mimic_generator;
+/* read-only "think" pass run ahead of the server entity loop. sight checks for
+   monsters idling in MONSTER_STATE_WAIT are traced in parallel against the
+   start-of-tick world, then actMonster picks them up during the normal serial
+   pass instead of tracing again. results are only reused while the monster,
+   its candidate target and whatever the trace hit are still on the tiles they
+   were traced from, and no tile, door or gate has changed (mapGeneration)
+   since the snapshot. */
+class MonsterThinkPhase
+{
+public:
+	struct Sight_t
+	{
+		Uint32 targetUid = 0;
+		real_t targetx = 0.0;
+		real_t targety = 0.0;
+		hit_t hit; // hit.entity is always null, see hitUid
+		Uint32 hitUid = 0; // what the trace stopped on, if it was an entity
+		real_t hitx = 0.0;
+		real_t hity = 0.0;
+	};
+	struct Thought_t
+	{
+		Entity* monster = nullptr;
+		Uint32 uid = 0;
+		real_t x = 0.0;
+		real_t y = 0.0;
+		bool seeInvisible = false;
+		std::vector<Sight_t> sights;
+	};
+
+	void run();
+	void clear();
+	bool getVisionConeHit(Entity& my, Entity& target, bool seeInvisible, hit_t& out);
+	static bool monsterSeesInvisible(const Stat& myStats);
+
+	Uint32 lastThoughts = 0; // monsters considered by the last run()
+	Uint32 lastSights = 0; // traces done by the last run()
+	Uint32 reused = 0; // traces skipped in actMonster, since last reported
+	Uint32 missed = 0; // traced but stale by the time actMonster looked, since last reported
+private:
+	std::vector<Thought_t> thoughts;
+	std::unordered_map<Uint32, size_t> thoughtIndex; // by monster uid
+	Uint32 generation = 0; // mapGeneration the thoughts were traced against
+	static void think(Thought_t& thought);
+};
+extern MonsterThinkPhase MonsterThink;
@@ -644,6 +644,8 @@ void actDemonCeilingBuster(Entity* my)
 						return;
 					}
 					map.tiles[index] = 0;
+					mapTileChanged((int)floor(x / 16), (int)floor(y / 16));
+					markChunksDirty((int)floor(x / 16), (int)floor(y / 16));
 					if ( multiplayer != CLIENT )
 					{
 						playSoundEntity(my, 67, 128);
@@ -206,6 +206,8 @@ void devilDie(Entity* my)
 			if ( !map.tiles[y * MAPLAYERS + x * MAPLAYERS * map.height] )
 			{
 				map.tiles[y * MAPLAYERS + x * MAPLAYERS * map.height] = 72;
+				mapTileChanged(x, y);
+				markChunksDirty(x, y);
 			}
 		}
 	}
@@ -32,6 +32,7 @@
 #include "steam.hpp"
 #endif
 #include "player.hpp"
+#include "jobs.hpp"
 #include "scores.hpp"
 #include "colors.hpp"
 #include "mod_tools.hpp"
@@ -45,8 +46,8 @@
 #endif
 
 #include <atomic>
-#include <future>
 #include <thread>
+#include <zlib.h>
 
 NetHandler* net_handler = nullptr;
 
@@ -60,36 +61,14 @@ bool disableFPSLimitOnNetworkMessages = true; // always process the messages, ot
 // uncomment this to have the game log packet info
 //#define PACKETINFO
 
-void packetDeconstructor(void* data)
-{
-	packetsend_t* packetsend = (packetsend_t*)data;
-	SDLNet_FreePacket(packetsend->packet);
-	free(data);
-}
-
 void pollNetworkForShutdown() {
 	// handle network messages
-	if ( !(SDL_GetTicks() % 25) && multiplayer )
+	if ( multiplayer )
 	{
-		int j = 0;
-		node_t* node, *nextnode;
-		for ( node = safePacketsSent.first; node != NULL; node = nextnode )
-		{
-			nextnode = node->next;
-
-			packetsend_t* packet = (packetsend_t*)node->element;
-			sendPacket(packet->sock, packet->channel, packet->packet, packet->hostnum);
-			packet->tries++;
-			if ( packet->tries >= MAXTRIES )
-			{
-				list_RemoveNode(node);
-			}
-			j++;
-			if ( j >= MAXDELETES )
-			{
-				break;
-			}
-		}
+		NetMessages.flush();
+		BulkTransfers.update();
+		SafePackets.update();
+		NetLinkSim.update();
 	}
 #ifdef STEAMWORKS
 	SteamAPI_RunCallbacks();
@@ -118,9 +97,10 @@ void pollNetworkForShutdown() {
 
 int sendPacket(UDPsocket sock, int channel, UDPpacket* packet, int hostnum, bool tryReliable)
 {
+	NetStats.count(NetTelemetry::SENT, packet->data, packet->len);
 	if ( directConnect )
 	{
-		return SDLNet_UDP_Send(sock, channel, packet);
+		return NetLinkSim.send(sock, channel, packet);
 	}
 	else
 	{
@@ -163,7 +143,6 @@ int sendPacket(UDPsocket sock, int channel, UDPpacket* packet, int hostnum, bool
 
 -------------------------------------------------------------------------------*/
 
-Uint32 packetnum = 0;
 int sendPacketSafe(UDPsocket sock, int channel, UDPpacket* packet, int hostnum)
 {
 	if ( hostnum < 0 || hostnum >= MAXPLAYERS )
@@ -194,844 +173,1570 @@ int sendPacketSafe(UDPsocket sock, int channel, UDPpacket* packet, int hostnum)
 		}
 	}
 
-	packetsend_t* packetsend = (packetsend_t*) malloc(sizeof(packetsend_t));
-	if (!(packetsend->packet = SDLNet_AllocPacket(NET_PACKET_SIZE)))
+	return SafePackets.send(sock, channel, packet, hostnum);
+}
+
+/*-------------------------------------------------------------------------------
+
+	resendSafePackets
+
+	retransmits safe packets whose ack is overdue and sends any acks that
+	didn't get a ride on an outgoing packet. gameLogic calls this every tick
+
+-------------------------------------------------------------------------------*/
+
+void resendSafePackets()
+{
+	SafePackets.update();
+}
+
+/*-------------------------------------------------------------------------------
+
+	SafePacketChannel
+
+	see net.hpp for the header layout. Retransmit timers follow TCP: a
+	smoothed RTT and variance from packets acked on their first try, and
+	a timeout that doubles with every retry.
+
+-------------------------------------------------------------------------------*/
+
+SafePacketChannel SafePackets;
+
+static const int SAFE_RESENDS_PER_UPDATE = 32;
+
+int SafePacketChannel::peerForHost(int hostnum, const IPaddress& address) const
+{
+	// hostnum indexes net_clients on the server, clients only ever talk to the server
+	if ( multiplayer == CLIENT )
 	{
-		printlog("warning: packet allocation failed: %s\n", SDLNet_GetError());
-		free(packetsend);
 		return 0;
 	}
-
-	packetsend->hostnum = hostnum;
-	packetsend->sock = sock;
-	packetsend->channel = channel;
-	packetsend->packet->channel = channel;
-	memcpy(packetsend->packet->data + 9, packet->data, NET_PACKET_SIZE - 9);
-	packetsend->packet->len = packet->len + 9;
-	packetsend->packet->address.host = packet->address.host;
-	packetsend->packet->address.port = packet->address.port;
-	strcpy((char*)packetsend->packet->data, "SAFE");
-	if ( receivedclientnum || multiplayer != CLIENT )
+	if ( directConnect && net_clients )
 	{
-		packetsend->packet->data[4] = clientnum;
+		// direct connect goes by address and callers don't always bother with hostnum
+		for ( int c = 1; c < MAXPLAYERS; ++c )
+		{
+			if ( net_clients[c - 1].host == address.host && net_clients[c - 1].port == address.port )
+			{
+				return c;
+			}
+		}
 	}
-	else
+	return std::min(std::max(hostnum + 1, 0), MAXPLAYERS - 1);
+}
+
+void SafePacketChannel::writeAck(Peer_t& peer, Uint8* data)
+{
+	Uint32 bits = 0;
+	for ( Uint32 n = 0; n < 32 && n + 1 < peer.received; ++n )
 	{
-		packetsend->packet->data[4] = MAXPLAYERS;
+		if ( peer.receivedBits.test((peer.received - n - 1) % RECEIVE_WINDOW) )
+		{
+			bits |= 1u << n;
+		}
 	}
-	SDLNet_Write32(packetnum, &packetsend->packet->data[5]);
-	packetsend->num = packetnum;
-	packetsend->tries = 0;
-	packetnum++;
-
-	node_t* node = list_AddNodeFirst(&safePacketsSent);
-	node->element = packetsend;
-	node->deconstructor = &packetDeconstructor;
+	SDLNet_Write32(peer.received, data);
+	SDLNet_Write32(bits, data + 4);
+	peer.ackPending = false;
+}
 
-	if ( directConnect )
+void SafePacketChannel::applyAcks(Peer_t& peer, Uint32 ack, Uint32 bits)
+{
+	if ( ack == 0 )
 	{
-		return SDLNet_UDP_Send(sock, channel, packetsend->packet);
+		return;
 	}
-	else
+	const Uint32 now = SDL_GetTicks();
+	for ( int n = -1; n < 32; ++n )
 	{
-		if ( LobbyHandler.getP2PType() == LobbyHandler_t::LobbyServiceType::LOBBY_STEAM )
+		if ( n >= 0 && !(bits & (1u << n)) )
 		{
-#ifdef STEAMWORKS
-			if ( steamIDRemote[hostnum] )
+			continue;
+		}
+		const Uint32 seq = ack - (n + 1);
+		if ( seq == 0 || seq > ack )
+		{
+			break;
+		}
+		Outgoing_t& out = peer.outgoing[seq % WINDOW];
+		if ( !out.inUse || out.seq != seq )
+		{
+			continue;
+		}
+		if ( out.tries == 1 )
+		{
+			// only time packets that went out once, otherwise we can't tell which send was acked
+			const float sample = (float)(now - out.sentAt);
+			if ( peer.srtt == 0.f )
 			{
-				return SteamNetworking()->SendP2PPacket(*static_cast<CSteamID* >(steamIDRemote[hostnum]), packetsend->packet->data, packetsend->packet->len, k_EP2PSendReliable, 0);
+				peer.srtt = sample;
+				peer.rttvar = sample / 2.f;
 			}
 			else
 			{
-				return 0;
+				peer.rttvar = 0.75f * peer.rttvar + 0.25f * fabs(peer.srtt - sample);
+				peer.srtt = 0.875f * peer.srtt + 0.125f * sample;
 			}
-#endif
+			peer.rto = std::min(std::max((Uint32)(peer.srtt + 4.f * peer.rttvar), MIN_RTO), MAX_RTO);
 		}
-		else if ( LobbyHandler.getP2PType() == LobbyHandler_t::LobbyServiceType::LOBBY_CROSSPLAY )
+		out.inUse = false;
+		--peer.inFlight;
+		++peer.stats.acked;
+	}
+}
+
+bool SafePacketChannel::markReceived(Peer_t& peer, Uint32 seq)
+{
+	if ( peer.received == 0 || seq > peer.received )
+	{
+		if ( peer.received == 0 || seq - peer.received >= RECEIVE_WINDOW )
 		{
-#if defined USE_EOS
-			EOS.SendMessageP2P(EOS.P2PConnectionInfo.getPeerIdFromIndex(hostnum), packetsend->packet->data, packetsend->packet->len);
-			return 0;
-#endif
+			peer.receivedBits.reset();
 		}
-		return 0;
+		else
+		{
+			for ( Uint32 s = peer.received + 1; s < seq; ++s )
+			{
+				peer.receivedBits.reset(s % RECEIVE_WINDOW);
+			}
+		}
+		peer.received = seq;
+		peer.receivedBits.set(seq % RECEIVE_WINDOW);
+		return true;
+	}
+	if ( peer.received - seq >= RECEIVE_WINDOW )
+	{
+		// nobody retries a packet this old, the peer must have started over
+		peer.receivedBits.reset();
+		peer.received = seq;
+		peer.receivedBits.set(seq % RECEIVE_WINDOW);
+		return true;
+	}
+	if ( peer.receivedBits.test(seq % RECEIVE_WINDOW) )
+	{
+		return false;
 	}
+	peer.receivedBits.set(seq % RECEIVE_WINDOW);
+	return true;
 }
 
-/*-------------------------------------------------------------------------------
-
-	power
+int SafePacketChannel::transmit(Peer_t& peer, Outgoing_t& out)
+{
+	writeAck(peer, out.data + 9); // acks are as fresh as the send
+	UDPpacket packet;
+	packet.channel = out.channel;
+	packet.data = out.data;
+	packet.len = out.len;
+	packet.maxlen = NET_PACKET_SIZE;
+	packet.status = 0;
+	packet.address = out.address;
+	out.sentAt = SDL_GetTicks();
+	++out.tries;
+	return sendPacket(out.sock, out.channel, &packet, out.hostnum, true);
+}
 
-	A simple power function designed to work only with integers.
+int SafePacketChannel::send(UDPsocket sock, int channel, UDPpacket* packet, int hostnum)
+{
+	Peer_t& peer = peers[peerForHost(hostnum, packet->address)];
 
--------------------------------------------------------------------------------*/
+	int len = packet->len;
+	if ( len > NET_PACKET_SIZE - HEADER_LEN )
+	{
+		printlog("[NET]: Warning - safe packet %c%c%c%c is %d bytes, truncating to %d",
+			(char)packet->data[0], (char)packet->data[1], (char)packet->data[2], (char)packet->data[3],
+			len, NET_PACKET_SIZE - HEADER_LEN);
+		len = NET_PACKET_SIZE - HEADER_LEN;
+	}
 
-int power(int a, int b)
-{
-	int c, result = 1;
-	for ( c = 0; c < b; c++ )
+	// with the window full, wait for the oldest packets to be acked rather
+	// than push one out. anything already waiting goes first
+	if ( !peer.backlog.empty() || peer.outgoing[peer.nextSeq % WINDOW].inUse )
 	{
-		result *= a;
+		if ( (int)peer.backlog.size() >= MAX_BACKLOG )
+		{
+			printlog("[NET]: Warning - safe packet backlog to host %d is full, dropping %c%c%c%c",
+				hostnum, (char)packet->data[0], (char)packet->data[1], (char)packet->data[2], (char)packet->data[3]);
+			++peer.stats.expired;
+			return 0;
+		}
+		if ( peer.backlog.empty() )
+		{
+			printlog("[NET]: safe packet window to host %d is full, holding packets back", hostnum);
+		}
+		peer.backlog.emplace_back();
+		Held_t& held = peer.backlog.back();
+		held.sock = sock;
+		held.channel = channel;
+		held.hostnum = hostnum;
+		held.address = packet->address;
+		held.data.assign(packet->data, packet->data + len);
+		++peer.stats.held;
+		return 0;
 	}
-	return result;
+	return start(peer, sock, channel, hostnum, packet->address, packet->data, len);
 }
 
-/*-------------------------------------------------------------------------------
-
-messageLocalPlayers
+int SafePacketChannel::start(Peer_t& peer, UDPsocket sock, int channel, int hostnum, const IPaddress& address, const Uint8* data, int len)
+{
+	const Uint32 seq = peer.nextSeq++;
+	Outgoing_t& out = peer.outgoing[seq % WINDOW];
+	out.inUse = true;
+	out.seq = seq;
+	out.sock = sock;
+	out.channel = channel;
+	out.hostnum = hostnum;
+	out.address = address;
+	out.len = len + HEADER_LEN;
+	out.tries = 0;
+	strcpy((char*)out.data, "SAFE");
+	if ( receivedclientnum || multiplayer != CLIENT )
+	{
+		out.data[4] = clientnum;
+	}
+	else
+	{
+		out.data[4] = MAXPLAYERS;
+	}
+	SDLNet_Write32(seq, &out.data[5]);
+	memcpy(out.data + HEADER_LEN, data, len);
+	++peer.inFlight;
+	++peer.stats.sent;
 
-Support function, messages all local players with the message "message"
+	return transmit(peer, out);
+}
 
--------------------------------------------------------------------------------*/
+void SafePacketChannel::drainBacklog(Peer_t& peer)
+{
+	while ( !peer.backlog.empty() && !peer.outgoing[peer.nextSeq % WINDOW].inUse )
+	{
+		Held_t& held = peer.backlog.front();
+		start(peer, held.sock, held.channel, held.hostnum, held.address, held.data.data(), (int)held.data.size());
+		peer.backlog.pop_front();
+	}
+}
 
-bool messageLocalPlayers(Uint32 type, char const * const message, ...)
+bool SafePacketChannel::receive()
 {
-	char str[Player::MessageZone_t::ADD_MESSAGE_BUFFER_LENGTH] = { 0 };
+	const Uint32 packetId = SDLNet_Read32(&net_packet->data[0]);
+	if ( packetId == 'SAFE' )
+	{
+		if ( net_packet->data[4] >= MAXPLAYERS || net_packet->len < HEADER_LEN )
+		{
+			return false;
+		}
+		Peer_t& peer = peers[multiplayer == CLIENT ? 0 : net_packet->data[4]];
+		applyAcks(peer, SDLNet_Read32(&net_packet->data[9]), SDLNet_Read32(&net_packet->data[13]));
 
-	va_list argptr;
-	va_start(argptr, message);
-	vsnprintf(str, Player::MessageZone_t::ADD_MESSAGE_BUFFER_LENGTH - 1, message, argptr);
-	va_end(argptr);
+		// ack it even if we've seen it, our last ack may have been the one that got lost
+		peer.ackPending = true;
+		if ( !markReceived(peer, SDLNet_Read32(&net_packet->data[5])) )
+		{
+			++peer.stats.duplicates;
+			return true;
+		}
 
-    bool result = true;
-	for ( int player = 0; player < MAXPLAYERS; ++player )
+		net_packet->len -= HEADER_LEN;
+		Uint8 bytedata[NET_PACKET_SIZE];
+		memcpy(&bytedata, net_packet->data + HEADER_LEN, net_packet->len);
+		memcpy(net_packet->data, &bytedata, net_packet->len);
+	}
+
+	// they got the safe packet(s)
+	else if ( packetId == 'GOTP' )
 	{
-		if ( players[player]->isLocalPlayer() )
+		if ( net_packet->data[4] < MAXPLAYERS )
 		{
-			result = messagePlayerColor(player, type, 0xFFFFFFFF, str) ? result : false;
+			Peer_t& peer = peers[multiplayer == CLIENT ? 0 : net_packet->data[4]];
+			applyAcks(peer, SDLNet_Read32(&net_packet->data[5]), SDLNet_Read32(&net_packet->data[9]));
 		}
+		return true;
 	}
 
-	return result;
+	return false;
 }
 
-/*-------------------------------------------------------------------------------
-
-	messagePlayer
-
-	Support function, messages the player number given by "player" with the
-	message "message"
-
--------------------------------------------------------------------------------*/
-
-bool messagePlayer(int player, Uint32 type, char const * const message, ...)
+void SafePacketChannel::flushAcks()
 {
-	if ( player < 0 || player >= MAXPLAYERS )
+	if ( !net_packet || !net_packet->data )
 	{
-		return false;
+		return;
+	}
+	for ( int c = 0; c < MAXPLAYERS; ++c )
+	{
+		Peer_t& peer = peers[c];
+		if ( !peer.ackPending )
+		{
+			continue;
+		}
+		int hostnum = 0;
+		if ( multiplayer == CLIENT )
+		{
+			if ( c != 0 )
+			{
+				continue;
+			}
+			net_packet->address.host = net_server.host;
+			net_packet->address.port = net_server.port;
+		}
+		else
+		{
+			if ( c == 0 || !net_clients )
+			{
+				continue;
+			}
+			hostnum = c - 1;
+			net_packet->address.host = net_clients[hostnum].host;
+			net_packet->address.port = net_clients[hostnum].port;
+		}
+		strcpy((char*)net_packet->data, "GOTP");
+		net_packet->data[4] = clientnum;
+		writeAck(peer, &net_packet->data[5]);
+		net_packet->len = 13;
+		sendPacket(net_sock, -1, net_packet, hostnum);
 	}
-	char str[Player::MessageZone_t::ADD_MESSAGE_BUFFER_LENGTH] = { 0 };
-
-	va_list argptr;
-	va_start( argptr, message );
-	vsnprintf( str, Player::MessageZone_t::ADD_MESSAGE_BUFFER_LENGTH - 1, message, argptr );
-	va_end( argptr );
-
-	strncpy(str, messageSanitizePercentSign(str, nullptr).c_str(), Player::MessageZone_t::ADD_MESSAGE_BUFFER_LENGTH - 1);
-
-	return messagePlayerColor(player, type, 0xFFFFFFFF, str);
 }
 
-/*-------------------------------------------------------------------------------
-
-messageLocalPlayersColor
-
-Messages all local players with the message "message"
-and color "color"
+void SafePacketChannel::update()
+{
+	const Uint32 now = SDL_GetTicks();
+	for ( int c = 0; c < MAXPLAYERS; ++c )
+	{
+		Peer_t& peer = peers[c];
+		drainBacklog(peer);
+		if ( peer.inFlight <= 0 )
+		{
+			continue;
+		}
+		int resent = 0;
+		for ( Uint32 seq = peer.nextSeq - std::min(peer.nextSeq - 1, (Uint32)WINDOW); seq < peer.nextSeq; ++seq )
+		{
+			Outgoing_t& out = peer.outgoing[seq % WINDOW];
+			if ( !out.inUse || out.seq != seq )
+			{
+				continue;
+			}
+			const Uint32 timeout = std::min(peer.rto << std::min(out.tries - 1, 5), MAX_RTO);
+			if ( now - out.sentAt < timeout )
+			{
+				continue;
+			}
+			if ( out.tries >= MAXTRIES )
+			{
+				out.inUse = false;
+				--peer.inFlight;
+				++peer.stats.expired;
+				continue;
+			}
+			transmit(peer, out);
+			++peer.stats.resent;
+			if ( ++resent >= SAFE_RESENDS_PER_UPDATE )
+			{
+				break;
+			}
+		}
+	}
+	flushAcks();
+}
 
--------------------------------------------------------------------------------*/
+void SafePacketChannel::clear()
+{
+	for ( int c = 0; c < MAXPLAYERS; ++c )
+	{
+		Peer_t& peer = peers[c];
+		for ( auto& out : peer.outgoing )
+		{
+			out.inUse = false;
+		}
+		peer.backlog.clear();
+		peer.inFlight = 0;
+		peer.ackPending = false;
+	}
+}
 
-bool messageLocalPlayersColor(Uint32 color, Uint32 type, char const * const message, ...)
+void SafePacketChannel::reset()
 {
-	char str[Player::MessageZone_t::ADD_MESSAGE_BUFFER_LENGTH] = { 0 };
+	for ( int c = 0; c < MAXPLAYERS; ++c )
+	{
+		resetPeer(c);
+	}
+}
 
-	va_list argptr;
-	va_start(argptr, message);
-	vsnprintf(str, Player::MessageZone_t::ADD_MESSAGE_BUFFER_LENGTH - 1, message, argptr);
-	va_end(argptr);
+void SafePacketChannel::resetPeer(int player)
+{
+	Peer_t& peer = peers[player];
+	for ( auto& out : peer.outgoing )
+	{
+		out.inUse = false;
+	}
+	peer.backlog.clear();
+	peer.nextSeq = 1;
+	peer.inFlight = 0;
+	peer.received = 0;
+	peer.receivedBits.reset();
+	peer.ackPending = false;
+	peer.srtt = 0.f;
+	peer.rttvar = 0.f;
+	peer.rto = INITIAL_RTO;
+	peer.stats = Stats_t();
+}
 
-    bool result = true;
-	for ( int player = 0; player < MAXPLAYERS; ++player )
+static ConsoleCommand ccmd_net_safe_stats("/net_safe_stats", "print reliable packet stats for each peer",
+	[](int argc, const char** argv) {
+	for ( int c = 0; c < MAXPLAYERS; ++c )
 	{
-		if ( players[player]->isLocalPlayer() )
+		const auto& stats = SafePackets.stats(c);
+		if ( !stats.sent && !stats.acked && !stats.duplicates )
 		{
-			result = messagePlayerColor(player, type, color, str) ? result : false;
+			continue;
 		}
+		messagePlayer(clientnum, MESSAGE_MISC, "peer %d: rtt %.1f ms (+/- %.1f, timeout %u), %d in flight",
+			c, SafePackets.rtt(c), SafePackets.rttVariance(c), SafePackets.rto(c), SafePackets.inFlight(c));
+		messagePlayer(clientnum, MESSAGE_MISC, "  %u sent, %u resent, %u acked, %u given up, %u duplicates, %u held back",
+			stats.sent, stats.resent, stats.acked, stats.expired, stats.duplicates, stats.held);
 	}
-
-	return result;
-}
+	});
 
 /*-------------------------------------------------------------------------------
 
-	messagePlayerColor
+	BulkTransferChannel
 
-	Messages the player number given by "player" with the message "message"
-	and color "color"
+	see net.hpp for the BULK layout. A transfer's fragments go out in order,
+	but as separate safe packets they can arrive in any order, and the
+	fragments of the next transfer can overtake a resend of this one's, so
+	several transfers from one sender may be open at once.
 
 -------------------------------------------------------------------------------*/
 
-bool messagePlayerColor(int player, Uint32 type, Uint32 color, char const * const message, ...)
-{
-	char str[Player::MessageZone_t::ADD_MESSAGE_BUFFER_LENGTH] = { 0 };
-	va_list argptr;
+BulkTransferChannel BulkTransfers;
 
-	if ( message == NULL )
+static ConsoleVariable<bool> cvar_net_bulk_transfers("/net_bulk_transfers", true);
+
+void clientHandlePacket();
+void serverHandlePacket();
+
+int BulkTransferChannel::peerForHost(int hostnum) const
+{
+	if ( multiplayer == CLIENT )
 	{
-		return false;
+		return 0;
 	}
-	if ( player < 0 || player >= MAXPLAYERS )
+	return std::min(std::max(hostnum + 1, 0), MAXPLAYERS - 1);
+}
+
+bool BulkTransferChannel::send(UDPsocket sock, int hostnum, const IPaddress& address, Uint32 type, const Uint8* data, int len)
+{
+	if ( len <= 0 || len > MAX_PAYLOAD )
 	{
+		printlog("[NET]: Warning - bulk transfer of %d bytes refused", len);
 		return false;
 	}
 
-	// format the content
-	va_start( argptr, message );
-	vsnprintf( str, Player::MessageZone_t::ADD_MESSAGE_BUFFER_LENGTH - 1, message, argptr );
-	va_end( argptr );
+	// only keep the deflated copy if it's actually smaller
+	uLongf deflatedLen = compressBound((uLong)len);
+	std::vector<Uint8> deflated(deflatedLen);
+	const Uint8* payload = data;
+	int payloadLen = len;
+	bool isDeflated = false;
+	if ( compress2(deflated.data(), &deflatedLen, data, (uLong)len, Z_DEFAULT_COMPRESSION) == Z_OK
+		&& (int)deflatedLen < len )
+	{
+		payload = deflated.data();
+		payloadLen = (int)deflatedLen;
+		isDeflated = true;
+	}
+
+	const int fragments = (payloadLen + FRAGMENT_LEN - 1) / FRAGMENT_LEN;
+	Peer_t& peer = peers[peerForHost(hostnum)];
+	const Uint16 id = peer.nextId++;
+	for ( int n = 0; n < fragments; ++n )
+	{
+		peer.outgoing.emplace_back();
+		Fragment_t& fragment = peer.outgoing.back();
+		const int offset = n * FRAGMENT_LEN;
+		const int fragmentLen = std::min(FRAGMENT_LEN, payloadLen - offset);
+		fragment.sock = sock;
+		fragment.hostnum = hostnum;
+		fragment.address = address;
+		fragment.len = HEADER_LEN + fragmentLen;
+		memcpy(fragment.data, "BULK", 4);
+		fragment.data[4] = clientnum;
+		SDLNet_Write16(id, &fragment.data[5]);
+		SDLNet_Write16((Uint16)n, &fragment.data[7]);
+		SDLNet_Write16((Uint16)fragments, &fragment.data[9]);
+		SDLNet_Write32(type, &fragment.data[11]);
+		SDLNet_Write32((Uint32)len, &fragment.data[15]);
+		fragment.data[19] = isDeflated ? 1 : 0;
+		memcpy(fragment.data + HEADER_LEN, payload + offset, fragmentLen);
+	}
+	++transfersSent;
+	rawBytesSent += len;
+	compressedBytesSent += payloadLen;
+
+	update(); // get the first fragments moving now rather than next tick
+	return true;
+}
 
-	// fixes crash when reading config at start of game
-	if (!initialized)
+void BulkTransferChannel::receive(PacketReader& packet)
+{
+	const int sender = packet.read8();
+	const Uint16 id = packet.read16();
+	const int index = packet.read16();
+	const int fragments = packet.read16();
+	const Uint32 type = packet.read32();
+	const Uint32 rawLen = packet.read32();
+	const bool deflated = packet.read8() != 0;
+	const int fragmentLen = packet.remaining();
+	if ( !packet.ok() || sender >= MAXPLAYERS || index >= fragments || rawLen == 0 || rawLen > (Uint32)MAX_PAYLOAD
+		|| fragmentLen > FRAGMENT_LEN || (index < fragments - 1 && fragmentLen != FRAGMENT_LEN) )
 	{
-		printlog("%s\n", str);
-		return true;
+		return;
 	}
-    
-    // don't bother printing any message if we're not in game, it just clutters the log
-    if (intro) {
-        return false;
-    }
+	const int player = multiplayer == CLIENT ? 0 : sender;
 
-    // if this is for a local player, but we've disabled this message type, don't print it!
-    const bool localPlayer = players[player]->isLocalPlayer();
+	// the fragment count has to fit the payload, or a peer could have us
+	// allocate up to 65535 fragments for a few bytes
+	const uLong payloadBound = deflated ? compressBound((uLong)rawLen) : (uLong)rawLen;
+	const int maxFragments = (int)((payloadBound + FRAGMENT_LEN - 1) / FRAGMENT_LEN);
+	if ( fragments > maxFragments || (!deflated && fragments != maxFragments) )
+	{
+		return;
+	}
 
-	bool result = false;
-	if ( localPlayer )
+	Peer_t& peer = peers[player];
+	if ( peer.incoming.find(id) == peer.incoming.end() && (int)peer.incoming.size() >= MAX_INCOMING )
 	{
-	    printlog("%s\n", str);
-#ifdef NDEBUG
-		if (type != MESSAGE_DEBUG) { 
-			auto string = newString(&messages, color, completionTime, player, str);
-			addMessageToLogWindow(player, string);
+		printlog("[NET]: Warning - bulk transfer %u from player %d refused, %d already open",
+			id, player, (int)peer.incoming.size());
+		return;
+	}
+	Incoming_t& transfer = peer.incoming[id];
+	if ( transfer.fragments == 0 )
+	{
+		transfer.type = type;
+		transfer.rawLen = rawLen;
+		transfer.deflated = deflated;
+		transfer.fragments = fragments;
+		transfer.have.assign(fragments, false);
+		transfer.data.resize((size_t)fragments * FRAGMENT_LEN);
+		transfer.startedAt = SDL_GetTicks();
+	}
+	else if ( transfer.fragments != fragments || transfer.type != type || transfer.rawLen != rawLen )
+	{
+		return; // doesn't belong to the transfer we know by this id
+	}
+	transfer.lastHeard = SDL_GetTicks();
+	if ( transfer.have[index] )
+	{
+		return;
+	}
+	transfer.have[index] = true;
+	++transfer.received;
+	transfer.len += fragmentLen;
+	packet.readBytes(transfer.data.data() + (size_t)index * FRAGMENT_LEN, fragmentLen);
+
+	if ( transfer.received == transfer.fragments )
+	{
+		complete(player, id, transfer);
+		peer.incoming.erase(id);
+	}
+}
+
+void BulkTransferChannel::complete(int player, Uint16 id, Incoming_t& transfer)
+{
+	std::vector<Uint8> inflated;
+	const Uint8* payload = transfer.data.data();
+	int payloadLen = transfer.len;
+	if ( transfer.deflated )
+	{
+		inflated.resize(transfer.rawLen);
+		uLongf inflatedLen = transfer.rawLen;
+		if ( uncompress(inflated.data(), &inflatedLen, transfer.data.data(), (uLong)transfer.len) != Z_OK
+			|| inflatedLen != transfer.rawLen )
+		{
+			printlog("[NET]: Warning - bulk transfer %u from player %d didn't inflate", id, player);
+			++transfersDropped;
+			return;
 		}
-#else
-		auto string = newString(&messages, color, completionTime, player, str);
-		addMessageToLogWindow(player, string);
-#endif
-	    while ( list_Size(&messages) > MESSAGE_LIST_SIZE_CAP )
-	    {
-		    list_RemoveNode(messages.first);
-	    }
-	    if (!disable_messages && (messagesEnabled & type))
-	    {
-	        players[player]->messageZone.addMessage(color, str);
-	        result = true;
-	    }
+		payload = inflated.data();
+		payloadLen = (int)inflatedLen;
 	}
-	else if ( multiplayer == SERVER )
+	++transfersReceived;
+	printlog("[NET]: bulk transfer %u from player %d: %d bytes (%d on the wire) in %d fragments, %u ms",
+		id, player, payloadLen, transfer.len, transfer.fragments, SDL_GetTicks() - transfer.startedAt);
+
+	switch ( transfer.type )
 	{
-		strcpy((char*)net_packet->data, "MSGS");
-		SDLNet_Write32(color, &net_packet->data[4]);
-		SDLNet_Write32((Uint32)type, &net_packet->data[8]);
-		strcpy((char*)(&net_packet->data[12]), str);
-		net_packet->address.host = net_clients[player - 1].host;
-		net_packet->address.port = net_clients[player - 1].port;
-		net_packet->len = 12 + strlen(str) + 1;
-		sendPacketSafe(net_sock, -1, net_packet, player - 1);
+		case 'BTCH':
+			NetMessageQueue::unpackMessages(payload, payloadLen,
+				multiplayer == CLIENT ? &clientHandlePacket : &serverHandlePacket);
+			break;
+		default:
+			printlog("[NET]: Warning - bulk transfer %u from player %d has unknown type %c%c%c%c", id, player,
+				(char)(transfer.type >> 24), (char)(transfer.type >> 16), (char)(transfer.type >> 8), (char)transfer.type);
+			break;
 	}
+}
 
-    // player death messages trigger this achievement
-	int c;
-	char tempstr[256];
-	for ( c = 0; c < MAXPLAYERS; c++ )
+void BulkTransferChannel::update()
+{
+	const Uint32 now = SDL_GetTicks();
+	for ( int c = 0; c < MAXPLAYERS; ++c )
 	{
-		if ( client_disconnected[c] )
+		Peer_t& peer = peers[c];
+		while ( !peer.outgoing.empty() && SafePackets.inFlight(c) < MAX_IN_FLIGHT )
 		{
-			continue;
+			Fragment_t& fragment = peer.outgoing.front();
+			UDPpacket packet;
+			packet.channel = -1;
+			packet.data = fragment.data;
+			packet.len = fragment.len;
+			packet.maxlen = NET_PACKET_SIZE;
+			packet.status = 0;
+			packet.address = fragment.address;
+			sendPacketSafe(fragment.sock, -1, &packet, fragment.hostnum);
+			++fragmentsSent;
+			peer.outgoing.pop_front();
 		}
-		snprintf(tempstr, 256, Language::get(697), stats[c]->name);
-		if ( !strcmp(str, tempstr) )
+		for ( auto it = peer.incoming.begin(); it != peer.incoming.end(); )
 		{
-			steamAchievementClient(player, "BARONY_ACH_NOT_A_TEAM_PLAYER");
+			if ( now - it->second.lastHeard > TIMEOUT )
+			{
+				printlog("[NET]: Warning - bulk transfer %u from player %d timed out with %d of %d fragments",
+					it->first, c, it->second.received, it->second.fragments);
+				++transfersDropped;
+				it = peer.incoming.erase(it);
+			}
+			else
+			{
+				++it;
+			}
 		}
 	}
+}
 
-	return result;
+void BulkTransferChannel::clear()
+{
+	for ( int c = 0; c < MAXPLAYERS; ++c )
+	{
+		resetPeer(c);
+	}
 }
 
+void BulkTransferChannel::resetPeer(int player)
+{
+	// the id carries on, so fragments from before the reset can't join a new transfer
+	Peer_t& peer = peers[player];
+	peer.outgoing.clear();
+	peer.incoming.clear();
+}
+
+float BulkTransferChannel::progress(int player) const
+{
+	int fragments = 0;
+	int received = 0;
+	for ( auto& it : peers[player].incoming )
+	{
+		fragments += it.second.fragments;
+		received += it.second.received;
+	}
+	return fragments ? received / (float)fragments : 1.f;
+}
+
+static ConsoleCommand ccmd_net_bulk_stats("/net_bulk_stats", "print bulk transfer counters since last asked",
+	[](int argc, const char** argv) {
+	messagePlayer(clientnum, MESSAGE_MISC, "bulk transfers: %u sent in %u fragments, %u bytes deflated to %u (%.0f%%)",
+		BulkTransfers.transfersSent, BulkTransfers.fragmentsSent, BulkTransfers.rawBytesSent, BulkTransfers.compressedBytesSent,
+		BulkTransfers.rawBytesSent ? 100.0 * BulkTransfers.compressedBytesSent / BulkTransfers.rawBytesSent : 100.0);
+	messagePlayer(clientnum, MESSAGE_MISC, "%u received, %u dropped", BulkTransfers.transfersReceived, BulkTransfers.transfersDropped);
+	for ( int c = 0; c < MAXPLAYERS; ++c )
+	{
+		const float progress = BulkTransfers.progress(c);
+		if ( progress < 1.f || BulkTransfers.waiting(c) )
+		{
+			messagePlayer(clientnum, MESSAGE_MISC, "  peer %d: %.0f%% of incoming arrived, %d fragments waiting to go out",
+				c, progress * 100.f, BulkTransfers.waiting(c));
+		}
+	}
+	BulkTransfers.transfersSent = 0;
+	BulkTransfers.transfersReceived = 0;
+	BulkTransfers.transfersDropped = 0;
+	BulkTransfers.rawBytesSent = 0;
+	BulkTransfers.compressedBytesSent = 0;
+	BulkTransfers.fragmentsSent = 0;
+	});
+
 /*-------------------------------------------------------------------------------
 
-	sendEntityUDP / sendEntityTCP
+	queuePacket / queuePacketSafe
 
-	Updates given entity data for given client. Server -> client functions
+	like sendPacket and sendPacketSafe, but the packet waits in NetMessages
+	to share a datagram with whatever else goes to the same peer this tick
 
 -------------------------------------------------------------------------------*/
 
-void sendEntityTCP(Entity* entity, int c)
+NetMessageQueue NetMessages;
+
+static ConsoleVariable<bool> cvar_net_batch_messages("/net_batch_messages", true);
+
+int queuePacket(UDPsocket sock, int channel, UDPpacket* packet, int hostnum)
 {
-	// deprecated
+	return NetMessages.queue(sock, channel, packet, hostnum, false);
 }
 
-void sendEntityUDP(Entity* entity, int c, bool guarantee)
+int queuePacketSafe(UDPsocket sock, int channel, UDPpacket* packet, int hostnum)
 {
-	int j;
+	return NetMessages.queue(sock, channel, packet, hostnum, true);
+}
 
-	if ( entity == NULL )
+int NetMessageQueue::queue(UDPsocket sock, int channel, UDPpacket* packet, int hostnum, bool safe)
+{
+	const int capacity = safe ? NET_PACKET_SIZE - SafePacketChannel::HEADER_LEN : NET_PACKET_SIZE;
+	if ( !*cvar_net_batch_messages || hostnum < 0 || hostnum >= MAXPLAYERS
+		|| HEADER_LEN + FRAME_LEN + packet->len > capacity )
 	{
-		return;
+		return safe ? sendPacketSafe(sock, channel, packet, hostnum) : sendPacket(sock, channel, packet, hostnum);
 	}
-	if ( client_disconnected[c] == true || players[c]->isLocalPlayer() )
+
+	if ( bulkDepth > 0 && (int)bulk[hostnum].data.size() + FRAME_LEN + packet->len <= BulkTransferChannel::MAX_PAYLOAD )
 	{
-		return;
+		// everything in a bulk payload arrives, even the ones that didn't need to
+		Bulk_t& payload = bulk[hostnum];
+		if ( payload.data.empty() )
+		{
+			payload.sock = sock;
+			payload.channel = channel;
+			payload.address = packet->address;
+		}
+		const size_t offset = payload.data.size();
+		payload.data.resize(offset + FRAME_LEN + packet->len);
+		SDLNet_Write16((Uint16)packet->len, &payload.data[offset]);
+		memcpy(&payload.data[offset + FRAME_LEN], packet->data, packet->len);
+		++messagesQueued;
+		return 0;
 	}
-	if ( c <= 0 )
+
+	Lane_t& lane = lanes[hostnum][safe ? 1 : 0];
+	if ( lane.count && (lane.len + FRAME_LEN + packet->len > capacity
+		|| lane.address.host != packet->address.host || lane.address.port != packet->address.port) )
 	{
-		return;
+		flushLane(lane, hostnum, safe);
 	}
-
-	// send entity data to the client
-	strcpy((char*)net_packet->data, "ENTU");
-	SDLNet_Write32((Uint32)entity->getUID(), &net_packet->data[4]);
-	SDLNet_Write16((Uint16)entity->sprite, &net_packet->data[8]);
-	SDLNet_Write16((Sint16)(entity->x * 32), &net_packet->data[10]);
-	SDLNet_Write16((Sint16)(entity->y * 32), &net_packet->data[12]);
-	SDLNet_Write16((Sint16)(entity->z * 32), &net_packet->data[14]);
-	net_packet->data[16] = (Sint8)entity->sizex;
-	net_packet->data[17] = (Sint8)entity->sizey;
-	net_packet->data[18] = (Uint8)(entity->scalex * 128);
-	net_packet->data[19] = (Uint8)(entity->scaley * 128);
-	net_packet->data[20] = (Uint8)(entity->scalez * 128);
-	SDLNet_Write16((Sint16)(entity->yaw * 256), &net_packet->data[21]);
-	SDLNet_Write16((Sint16)(entity->pitch * 256), &net_packet->data[23]);
-	SDLNet_Write16((Sint16)(entity->roll * 256), &net_packet->data[25]);
-	net_packet->data[27] = (Sint8)(entity->focalx * 8);
-	net_packet->data[28] = (Sint8)(entity->focaly * 8);
-	net_packet->data[29] = (Sint8)(entity->focalz * 8);
-	SDLNet_Write32(entity->skill[2], &net_packet->data[30]);
-	net_packet->data[34] = 0;
-	net_packet->data[35] = 0;
-	for (j = 0; j < 16; j++)
+	if ( !lane.count )
 	{
-		if ( entity->flags[j] )
-		{
-			net_packet->data[34 + j / 8] |= power(2, j - (j / 8) * 8);
-		}
+		memcpy(lane.data, "BTCH", 4);
+		lane.len = HEADER_LEN;
+		lane.sock = sock;
+		lane.channel = channel;
+		lane.address = packet->address;
 	}
-	SDLNet_Write32((Uint32)ticks, &net_packet->data[36]);
-	SDLNet_Write16((Sint16)(entity->vel_x * 32), &net_packet->data[40]);
-	SDLNet_Write16((Sint16)(entity->vel_y * 32), &net_packet->data[42]);
-	SDLNet_Write16((Sint16)(entity->vel_z * 32), &net_packet->data[44]);
-	net_packet->address.host = net_clients[c - 1].host;
-	net_packet->address.port = net_clients[c - 1].port;
-	net_packet->len = ENTITY_PACKET_LENGTH;
+	SDLNet_Write16((Uint16)packet->len, &lane.data[lane.len]);
+	memcpy(&lane.data[lane.len + FRAME_LEN], packet->data, packet->len);
+	lane.len += FRAME_LEN + packet->len;
+	++lane.count;
+	++messagesQueued;
+	return 0;
+}
 
-	// sometimes you want more insurance that the entity update arrives
-	if ( guarantee )
+void NetMessageQueue::flushLane(Lane_t& lane, int hostnum, bool safe)
+{
+	if ( !lane.count )
 	{
-		sendPacketSafe(net_sock, -1, net_packet, c - 1);
+		return;
+	}
+	UDPpacket packet;
+	packet.channel = lane.channel;
+	packet.maxlen = NET_PACKET_SIZE;
+	packet.status = 0;
+	packet.address = lane.address;
+	if ( lane.count == 1 )
+	{
+		// nothing to share the datagram with, send it as it was
+		packet.data = lane.data + HEADER_LEN + FRAME_LEN;
+		packet.len = lane.len - HEADER_LEN - FRAME_LEN;
 	}
 	else
 	{
-		sendPacket(net_sock, -1, net_packet, c - 1);
+		packet.data = lane.data;
+		packet.len = lane.len;
 	}
-	if ( entity->clientsHaveItsStats )
+	lane.count = 0;
+	lane.len = 0;
+	++packetsSent;
+	if ( safe )
 	{
-		entity->serverUpdateEffectsForEntity(false);
+		sendPacketSafe(lane.sock, lane.channel, &packet, hostnum);
+	}
+	else
+	{
+		sendPacket(lane.sock, lane.channel, &packet, hostnum);
 	}
 }
 
-/*-------------------------------------------------------------------------------
-
-	sendMapSeedTCP
-
-	Sends the seed necessary to generate the next map
-
--------------------------------------------------------------------------------*/
-
-void sendMapSeedTCP(int c)
+void NetMessageQueue::flush()
 {
-	// deprecated
+	for ( int c = 0; c < MAXPLAYERS; ++c )
+	{
+		flushLane(lanes[c][1], c, true);
+		flushLane(lanes[c][0], c, false);
+	}
 }
 
-/*-------------------------------------------------------------------------------
-
-	sendMapTCP
-
-	Sends all map data to clients
-
--------------------------------------------------------------------------------*/
-
-void sendMapTCP(int c)
+void NetMessageQueue::clear()
 {
-	// deprecated
+	for ( int c = 0; c < MAXPLAYERS; ++c )
+	{
+		lanes[c][0].count = 0;
+		lanes[c][1].count = 0;
+		bulk[c].data.clear();
+	}
+	bulkDepth = 0;
 }
 
-/*-------------------------------------------------------------------------------
-
-	serverUpdateBodypartIDs
-
-	Updates the uid numbers of all the given bodyparts for the given entity
-
--------------------------------------------------------------------------------*/
+void NetMessageQueue::beginBulk()
+{
+	if ( *cvar_net_bulk_transfers || bulkDepth > 0 )
+	{
+		++bulkDepth;
+	}
+}
 
-void serverUpdateBodypartIDs(Entity* entity)
+void NetMessageQueue::endBulk()
 {
-	int c;
-	if ( multiplayer != SERVER )
+	if ( bulkDepth <= 0 || --bulkDepth > 0 )
 	{
 		return;
 	}
-	for ( c = 1; c < MAXPLAYERS; c++ )
+	for ( int c = 0; c < MAXPLAYERS; ++c )
 	{
-		if ( client_disconnected[c] || players[c]->isLocalPlayer() )
+		Bulk_t& payload = bulk[c];
+		if ( payload.data.empty() )
 		{
 			continue;
 		}
-		strcpy((char*)net_packet->data, "BDYI");
-		SDLNet_Write32(entity->getUID(), &net_packet->data[4]);
-		node_t* node;
-		int i;
-		for ( i = 0, node = entity->children.first; node != NULL; node = node->next, i++ )
+		if ( HEADER_LEN + (int)payload.data.size() <= NET_PACKET_SIZE - SafePacketChannel::HEADER_LEN )
 		{
-			if ( i < 1 || (i < 2 && entity->behavior == &actMonster) )
-			{
-				continue;
-			}
-			Entity* tempEntity = (Entity*)node->element;
-			if ( entity->behavior == &actMonster )
-			{
-				SDLNet_Write32(tempEntity->getUID(), &net_packet->data[8 + 4 * (i - 2)]);
-			}
-			else
+			// fits in one batch, that's cheaper than a transfer
+			UDPpacket packet;
+			packet.channel = payload.channel;
+			packet.maxlen = NET_PACKET_SIZE;
+			packet.status = 0;
+			packet.address = payload.address;
+			for ( size_t offset = 0; offset + FRAME_LEN <= payload.data.size(); )
 			{
-				SDLNet_Write32(tempEntity->getUID(), &net_packet->data[8 + 4 * (i - 1)]);
+				packet.len = SDLNet_Read16(&payload.data[offset]);
+				packet.data = &payload.data[offset + FRAME_LEN];
+				--messagesQueued; // queue() counts it again
+				queue(payload.sock, payload.channel, &packet, c, true);
+				offset += FRAME_LEN + packet.len;
 			}
 		}
-		net_packet->address.host = net_clients[c - 1].host;
-		net_packet->address.port = net_clients[c - 1].port;
-		net_packet->len = 8 + (list_Size(&entity->children) - 2) * 4;
-		sendPacketSafe(net_sock, -1, net_packet, c - 1);
+		else
+		{
+			BulkTransfers.send(payload.sock, c, payload.address, 'BTCH', payload.data.data(), (int)payload.data.size());
+		}
+		payload.data.clear();
+	}
+}
+
+static int unpackDepth = 0; // handlers called from unpack() see messages that were already counted
+
+bool NetMessageQueue::unpack(void (*handler)())
+{
+	if ( net_packet->len < HEADER_LEN || SDLNet_Read32(&net_packet->data[0]) != 'BTCH' )
+	{
+		return false;
+	}
+
+	// handlers write replies into net_packet, and the client handlers still
+	// read it at fixed offsets, so walk a copy
+	Uint8 batch[NET_PACKET_SIZE];
+	const int len = std::min(net_packet->len, NET_PACKET_SIZE);
+	memcpy(batch, net_packet->data, len);
+	unpackMessages(batch + HEADER_LEN, len - HEADER_LEN, handler);
+	return true;
+}
+
+void NetMessageQueue::unpackMessages(const Uint8* data, int len, void (*handler)())
+{
+	for ( int offset = 0; offset + FRAME_LEN <= len; )
+	{
+		const int messageLen = SDLNet_Read16(&data[offset]);
+		offset += FRAME_LEN;
+		if ( messageLen < 4 || messageLen > NET_PACKET_SIZE || offset + messageLen > len )
+		{
+			break;
+		}
+		memcpy(net_packet->data, &data[offset], messageLen);
+		net_packet->len = messageLen;
+		++unpackDepth;
+		(*handler)();
+		--unpackDepth;
+		offset += messageLen;
 	}
 }
 
+static ConsoleCommand ccmd_net_batch_stats("/net_batch_stats", "print how many queued messages went out in how many packets",
+	[](int argc, const char** argv) {
+	messagePlayer(clientnum, MESSAGE_MISC, "message queue: %u messages in %u packets since last asked",
+		NetMessages.messagesQueued, NetMessages.packetsSent);
+	NetMessages.messagesQueued = 0;
+	NetMessages.packetsSent = 0;
+	});
+
 /*-------------------------------------------------------------------------------
 
-	serverUpdateEntityBodypart
+	NetLinkSimulator
 
-	Updates the given bodypart of the given entity for all clients
+	see net.hpp. latency and jitter are in milliseconds, loss in percent,
+	bandwidth in bytes per second (0 for no cap)
 
 -------------------------------------------------------------------------------*/
 
-//int numPlayerBodypartUpdates = 0;
-//int numMonsterBodypartUpdates = 0;
-//Uint32 lastbodypartTick = 0;
+NetLinkSimulator NetLinkSim;
 
-void serverUpdateEntityBodypart(Entity* entity, int bodypart)
+static ConsoleVariable<bool> cvar_net_sim("/net_sim", false);
+static ConsoleVariable<int> cvar_net_sim_latency("/net_sim_latency", 50);
+static ConsoleVariable<int> cvar_net_sim_jitter("/net_sim_jitter", 10);
+static ConsoleVariable<float> cvar_net_sim_loss("/net_sim_loss", 0.f);
+static ConsoleVariable<int> cvar_net_sim_bandwidth("/net_sim_bandwidth", 0);
+
+bool NetLinkSimulator::enabled() const
 {
-	int c;
-	if ( multiplayer != SERVER )
+	return *cvar_net_sim;
+}
+
+int NetLinkSimulator::send(UDPsocket sock, int channel, UDPpacket* packet)
+{
+	if ( !*cvar_net_sim )
 	{
-		return;
+		return SDLNet_UDP_Send(sock, channel, packet);
 	}
-	for ( c = 1; c < MAXPLAYERS; c++ )
+	if ( !rng.isSeeded() )
 	{
-		if ( client_disconnected[c] || players[c]->isLocalPlayer() )
+		rng.seedTime();
+	}
+	if ( *cvar_net_sim_loss > 0.f && rng.getF32() * 100.f < *cvar_net_sim_loss )
+	{
+		++packetsLost;
+		return 1; // as far as the sender knows, it went out
+	}
+
+	const Uint32 now = SDL_GetTicks();
+	const int jitter = std::max(*cvar_net_sim_jitter, 0);
+	double due = now + std::max(*cvar_net_sim_latency, 0) + (jitter ? rng.uniform(-jitter, jitter) : 0);
+	if ( *cvar_net_sim_bandwidth > 0 )
+	{
+		// the link sends one packet at a time, so a packet can't leave before the one ahead of it
+		const Uint64 destination = ((Uint64)packet->address.host << 16) | packet->address.port;
+		double& freeAt = linkFreeAt[destination];
+		freeAt = std::max(freeAt, (double)now);
+		if ( freeAt - now > 1000.0 )
 		{
-			continue;
-		}
-		strcpy((char*)net_packet->data, "ENTB");
-		SDLNet_Write32(entity->getUID(), &net_packet->data[4]);
-		net_packet->data[8] = bodypart;
-		node_t* node = list_Node(&entity->children, bodypart);
-		if ( !node )
-		{
-			continue;
+			++packetsOverflowed;
+			return 1;
 		}
-		Entity* tempEntity = (Entity*)node->element;
-		SDLNet_Write32(tempEntity->sprite, &net_packet->data[9]);
-		net_packet->data[13] = tempEntity->flags[INVISIBLE];
-		net_packet->address.host = net_clients[c - 1].host;
-		net_packet->address.port = net_clients[c - 1].port;
-		net_packet->len = 14;
-		sendPacketSafe(net_sock, -1, net_packet, c - 1);
+		freeAt += 1000.0 * packet->len / *cvar_net_sim_bandwidth;
+		due = std::max(due, freeAt);
 	}
-	//if ( entity->behavior == &actPlayer )
-	//{
-	//	++numPlayerBodypartUpdates;
-	//}
-	//else if ( entity->behavior == &actMonster )
-	//{
-	//	++numMonsterBodypartUpdates;
-	//}
-	//if ( lastbodypartTick == 0 )
-	//{
-	//	lastbodypartTick = ticks;
-	//}
-	//if ( ticks - lastbodypartTick >= 250 )
-	//{
-	//	messagePlayer(0, "Bodypart updates (%ds) players: %d, monster: %d", (ticks - lastbodypartTick) / 50, numPlayerBodypartUpdates, numMonsterBodypartUpdates);
-	//	lastbodypartTick = 0;
-	//	numMonsterBodypartUpdates = 0;
-	//	numPlayerBodypartUpdates = 0;
-	//}
-}
-
-/*-------------------------------------------------------------------------------
-
-	serverUpdateEntitySprite
 
-	Updates the given entity's sprite for all clients
-
--------------------------------------------------------------------------------*/
+	inFlight.emplace_back();
+	Delayed_t& delayed = inFlight.back();
+	delayed.due = (Uint32)std::max(due, (double)now);
+	delayed.sock = sock;
+	delayed.channel = channel;
+	delayed.address = packet->address;
+	delayed.len = std::min(packet->len, NET_PACKET_SIZE);
+	memcpy(delayed.data, packet->data, delayed.len);
+	++packetsDelayed;
+	return 1;
+}
 
-void serverUpdateEntitySprite(Entity* entity)
+void NetLinkSimulator::update()
 {
-	int c;
-	if ( multiplayer != SERVER )
+	if ( inFlight.empty() )
 	{
 		return;
 	}
-	for ( c = 1; c < MAXPLAYERS; c++ )
+	const Uint32 now = SDL_GetTicks();
+	UDPpacket packet;
+	packet.maxlen = NET_PACKET_SIZE;
+	packet.status = 0;
+	size_t kept = 0;
+	for ( size_t i = 0; i < inFlight.size(); ++i )
 	{
-		if ( client_disconnected[c] || players[c]->isLocalPlayer() )
+		Delayed_t& delayed = inFlight[i];
+		if ( (Sint32)(now - delayed.due) < 0 )
 		{
+			if ( kept != i )
+			{
+				inFlight[kept] = delayed;
+			}
+			++kept;
 			continue;
 		}
-		strcpy((char*)net_packet->data, "ENTA");
-		SDLNet_Write32(entity->getUID(), &net_packet->data[4]);
-		SDLNet_Write32(entity->sprite, &net_packet->data[8]);
-		net_packet->address.host = net_clients[c - 1].host;
-		net_packet->address.port = net_clients[c - 1].port;
-		net_packet->len = 12;
-		sendPacketSafe(net_sock, -1, net_packet, c - 1);
+		// jitter means these can go out of order, same as the real thing
+		packet.channel = delayed.channel;
+		packet.address = delayed.address;
+		packet.data = delayed.data;
+		packet.len = delayed.len;
+		SDLNet_UDP_Send(delayed.sock, delayed.channel, &packet);
 	}
+	inFlight.resize(kept);
+}
+
+void NetLinkSimulator::clear()
+{
+	inFlight.clear();
+	linkFreeAt.clear();
 }
 
+static ConsoleCommand ccmd_net_sim_stats("/net_sim_stats", "print simulated link counters since last asked",
+	[](int argc, const char** argv) {
+	messagePlayer(clientnum, MESSAGE_MISC, "simulated link %s: %d ms +/- %d ms, %.1f%% loss, %d bytes/s",
+		NetLinkSim.enabled() ? "on" : "off", *cvar_net_sim_latency, *cvar_net_sim_jitter, *cvar_net_sim_loss, *cvar_net_sim_bandwidth);
+	messagePlayer(clientnum, MESSAGE_MISC, "%u packets delayed, %u lost, %u over the bandwidth cap",
+		NetLinkSim.packetsDelayed, NetLinkSim.packetsLost, NetLinkSim.packetsOverflowed);
+	NetLinkSim.packetsDelayed = 0;
+	NetLinkSim.packetsLost = 0;
+	NetLinkSim.packetsOverflowed = 0;
+	});
+
 /*-------------------------------------------------------------------------------
 
-	serverUpdateEntitySkill
+	NetTelemetry
 
-	Updates a specific entity skill for all clients
+	see net.hpp. /net_packet_stats prints the table, /net_telemetry_dump
+	writes it out, /net_telemetry_interval dumps it every so many seconds
 
 -------------------------------------------------------------------------------*/
 
-void serverUpdateEntitySkill(Entity* entity, int skill)
+NetTelemetry NetStats;
+
+static ConsoleVariable<int> cvar_net_telemetry_interval("/net_telemetry_interval", 0); // seconds, 0 for never
+
+// packet ids are four letters, but anything can turn up on the wire
+static void telemetryPacketName(Uint32 packetId, char* name)
 {
-	int c;
-	if ( multiplayer != SERVER )
-	{
-		return;
-	}
-	for ( c = 1; c < MAXPLAYERS; c++ )
+	for ( int c = 0; c < 4; ++c )
 	{
-		if ( client_disconnected[c] || players[c]->isLocalPlayer() )
-		{
-			continue;
-		}
-		strcpy((char*)net_packet->data, "ENTS");
-		SDLNet_Write32(entity->getUID(), &net_packet->data[4]);
-		net_packet->data[8] = skill;
-		SDLNet_Write32(entity->skill[skill], &net_packet->data[9]);
-		net_packet->address.host = net_clients[c - 1].host;
-		net_packet->address.port = net_clients[c - 1].port;
-		net_packet->len = 13;
-		sendPacketSafe(net_sock, -1, net_packet, c - 1);
+		const char letter = (char)((packetId >> (24 - c * 8)) & 0xFF);
+		name[c] = isalnum((unsigned char)letter) ? letter : '_';
 	}
+	name[4] = '\0';
 }
 
-/*-------------------------------------------------------------------------------
-
-serverUpdateEntitySkill
-
-Updates a specific entity skill for all clients
-
--------------------------------------------------------------------------------*/
-
-void serverUpdateEntityStatFlag(Entity* entity, int flag)
+void NetTelemetry::count(Direction_t direction, const Uint8* data, int len)
 {
-	int c;
-	if ( multiplayer != SERVER )
+	if ( len < 4 )
 	{
 		return;
 	}
-	if ( !entity->getStats() )
+	const Uint32 packetId = SDLNet_Read32(data);
+	Counter_t& counter = table[direction][packetId];
+	++counter.count;
+	if ( packetId == 'SAFE' && len >= SafePacketChannel::HEADER_LEN )
 	{
+		counter.bytes += SafePacketChannel::HEADER_LEN;
+		count(direction, data + SafePacketChannel::HEADER_LEN, len - SafePacketChannel::HEADER_LEN);
 		return;
 	}
-	for ( c = 1; c < MAXPLAYERS; c++ )
+	if ( packetId == 'BTCH' )
 	{
-		if ( client_disconnected[c] || players[c]->isLocalPlayer() )
+		int offset = NetMessageQueue::HEADER_LEN;
+		int payload = 0;
+		while ( offset + NetMessageQueue::FRAME_LEN <= len )
 		{
-			continue;
+			const int messageLen = SDLNet_Read16(&data[offset]);
+			if ( offset + NetMessageQueue::FRAME_LEN + messageLen > len )
+			{
+				break;
+			}
+			count(direction, data + offset + NetMessageQueue::FRAME_LEN, messageLen);
+			payload += messageLen;
+			offset += NetMessageQueue::FRAME_LEN + messageLen;
 		}
-		strcpy((char*)net_packet->data, "ENSF");
-		SDLNet_Write32(entity->getUID(), &net_packet->data[4]);
-		net_packet->data[8] = flag;
-		SDLNet_Write32(entity->getStats()->MISC_FLAGS[flag], &net_packet->data[9]);
-		net_packet->address.host = net_clients[c - 1].host;
-		net_packet->address.port = net_clients[c - 1].port;
-		net_packet->len = 13;
-		sendPacketSafe(net_sock, -1, net_packet, c - 1);
+		counter.bytes += len - payload; // header, frame lengths and anything left over
+		return;
 	}
+	counter.bytes += len;
 }
 
-/*-------------------------------------------------------------------------------
-
-serverUpdateEntityFSkill
-
-Updates a specific entity fskill for all clients
-
--------------------------------------------------------------------------------*/
+void NetTelemetry::handled(Uint32 packetId, Uint64 elapsed)
+{
+	Counter_t& counter = table[RECEIVED][packetId];
+	counter.handlerTime += elapsed;
+	counter.worstHandlerTime = std::max(counter.worstHandlerTime, elapsed);
+}
 
-void serverUpdateEntityFSkill(Entity* entity, int fskill)
+void NetTelemetry::update()
 {
-	int c;
-	if ( multiplayer != SERVER )
+	const int interval = *cvar_net_telemetry_interval;
+	if ( interval <= 0 )
 	{
 		return;
 	}
-	for ( c = 1; c < MAXPLAYERS; c++ )
+	if ( ticks - lastDumpTicks >= (Uint32)interval * TICKS_PER_SECOND )
 	{
-		if ( client_disconnected[c] || players[c]->isLocalPlayer() )
-		{
-			continue;
-		}
-		strcpy((char*)net_packet->data, "ENFS");
-		SDLNet_Write32(entity->getUID(), &net_packet->data[4]);
-		net_packet->data[8] = fskill;
-		SDLNet_Write16(static_cast<Sint16>(entity->fskill[fskill] * 256), &net_packet->data[9]);
-		net_packet->address.host = net_clients[c - 1].host;
-		net_packet->address.port = net_clients[c - 1].port;
-		net_packet->len = 11;
-		sendPacketSafe(net_sock, -1, net_packet, c - 1);
+		dump();
 	}
 }
 
-/*-------------------------------------------------------------------------------
-
-serverSpawnMiscParticles
+bool NetTelemetry::dump()
+{
+	const Uint32 now = SDL_GetTicks();
+	const double seconds = lastDumpTime ? std::max(1u, now - lastDumpTime) / 1000.0 : 0.0;
+	const double usPerTick = 1000000.0 / SDL_GetPerformanceFrequency();
+	static const char* directions[NUM_DIRECTIONS] = { "sent", "received" };
+
+	std::string path = outputdir;
+	path.append(PHYSFS_getDirSeparator());
+	path.append("net_telemetry.csv");
+	File* csv = FileIO::open(path.c_str(), "wb");
+	path = outputdir;
+	path.append(PHYSFS_getDirSeparator());
+	path.append("net_telemetry.json");
+	File* json = FileIO::open(path.c_str(), "wb");
+	if ( !csv || !json )
+	{
+		printlog("[NET]: failed to open %s for the telemetry dump", path.c_str());
+		FileIO::close(csv);
+		FileIO::close(json);
+		return false;
+	}
 
-Spawns misc particle effects for all clients
+	// totals since the counters were reset, and rates since the last dump
+	csv->puts("direction,packet,count,bytes,handler_us,worst_handler_us,count_per_sec,bytes_per_sec\n");
+	json->printf("{\n\t\"ticks\": %u,\n\t\"seconds_since_last_dump\": %.3f", ticks, seconds);
+	for ( int d = 0; d < NUM_DIRECTIONS; ++d )
+	{
+		json->printf(",\n\t\"%s\": [", directions[d]);
+		bool first = true;
+		for ( auto& pair : table[d] )
+		{
+			const Counter_t& counter = pair.second;
+			const Counter_t& previous = lastDump[d][pair.first];
+			const double countRate = seconds > 0.0 ? (counter.count - previous.count) / seconds : 0.0;
+			const double byteRate = seconds > 0.0 ? (counter.bytes - previous.bytes) / seconds : 0.0;
+			char name[5];
+			telemetryPacketName(pair.first, name);
+			csv->printf("%s,%s,%llu,%llu,%.1f,%.1f,%.2f,%.1f\n",
+				directions[d], name, (unsigned long long)counter.count, (unsigned long long)counter.bytes,
+				counter.handlerTime * usPerTick, counter.worstHandlerTime * usPerTick, countRate, byteRate);
+			json->printf("%s\n\t\t{ \"packet\": \"%s\", \"count\": %llu, \"bytes\": %llu, \"handler_us\": %.1f, "
+				"\"worst_handler_us\": %.1f, \"count_per_sec\": %.2f, \"bytes_per_sec\": %.1f }",
+				first ? "" : ",", name, (unsigned long long)counter.count, (unsigned long long)counter.bytes,
+				counter.handlerTime * usPerTick, counter.worstHandlerTime * usPerTick, countRate, byteRate);
+			first = false;
+		}
+		json->puts("\n\t]");
+		lastDump[d] = table[d];
+	}
+	json->puts("\n}\n");
+	FileIO::close(csv);
+	FileIO::close(json);
+
+	lastDumpTime = now;
+	lastDumpTicks = ticks;
+	return true;
+}
 
--------------------------------------------------------------------------------*/
+void NetTelemetry::print(int max, bool toLog)
+{
+	const double usPerTick = 1000000.0 / SDL_GetPerformanceFrequency();
+	static const char* directions[NUM_DIRECTIONS] = { "out", "in" };
+	for ( int d = 0; d < NUM_DIRECTIONS; ++d )
+	{
+		std::vector<std::pair<Uint32, const Counter_t*>> sorted;
+		for ( auto& pair : table[d] )
+		{
+			sorted.emplace_back(pair.first, &pair.second);
+		}
+		std::sort(sorted.begin(), sorted.end(), [](const std::pair<Uint32, const Counter_t*>& a, const std::pair<Uint32, const Counter_t*>& b) {
+			return a.second->bytes > b.second->bytes;
+		});
+		if ( (int)sorted.size() > max )
+		{
+			sorted.resize(max);
+		}
+		for ( auto& pair : sorted )
+		{
+			const Counter_t& counter = *pair.second;
+			char name[5];
+			telemetryPacketName(pair.first, name);
+			char line[128];
+			if ( d == RECEIVED && counter.handlerTime )
+			{
+				snprintf(line, sizeof(line), "%s %s: %llu packets, %.1f KB, handler avg %.1f us (worst %.1f us)",
+					name, directions[d], (unsigned long long)counter.count, counter.bytes / 1024.0,
+					counter.handlerTime * usPerTick / std::max((Uint64)1, counter.count), counter.worstHandlerTime * usPerTick);
+			}
+			else
+			{
+				snprintf(line, sizeof(line), "%s %s: %llu packets, %.1f KB",
+					name, directions[d], (unsigned long long)counter.count, counter.bytes / 1024.0);
+			}
+			if ( toLog )
+			{
+				printlog("%s", line);
+			}
+			else
+			{
+				messagePlayer(clientnum, MESSAGE_MISC, "%s", line);
+			}
+		}
+	}
+}
 
-void serverSpawnMiscParticles(Entity* entity, int particleType, int particleSprite, Uint32 optionalUid)
+void NetTelemetry::reset()
 {
-	int c;
-	if ( multiplayer != SERVER )
+	for ( int d = 0; d < NUM_DIRECTIONS; ++d )
+	{
+		table[d].clear();
+		lastDump[d].clear();
+	}
+	lastDumpTime = 0;
+	lastDumpTicks = ticks;
+}
+
+static ConsoleCommand ccmd_net_packet_stats("/net_packet_stats", "print traffic by packet type, biggest first (args: how many, or 'reset')",
+	[](int argc, const char** argv) {
+	if ( argc > 1 && !strcmp(argv[1], "reset") )
 	{
+		NetStats.reset();
 		return;
 	}
-	for ( c = 1; c < MAXPLAYERS; c++ )
+	NetStats.print(argc > 1 ? std::max(1, atoi(argv[1])) : 8, false);
+	});
+
+static ConsoleCommand ccmd_net_telemetry_dump("/net_telemetry_dump", "write traffic by packet type to net_telemetry.csv and net_telemetry.json",
+	[](int argc, const char** argv) {
+	if ( NetStats.dump() )
 	{
-		if ( client_disconnected[c] || players[c]->isLocalPlayer() )
-		{
-			continue;
-		}
-		strcpy((char*)net_packet->data, "SPPE");
-		SDLNet_Write32(entity->getUID(), &net_packet->data[4]);
-		net_packet->data[8] = particleType;
-		SDLNet_Write16(particleSprite, &net_packet->data[9]);
-		SDLNet_Write32(optionalUid, &net_packet->data[11]);
-		net_packet->address.host = net_clients[c - 1].host;
-		net_packet->address.port = net_clients[c - 1].port;
-		net_packet->len = 16;
-		sendPacketSafe(net_sock, -1, net_packet, c - 1);
+		messagePlayer(clientnum, MESSAGE_MISC, "wrote net_telemetry.csv and net_telemetry.json to %s", outputdir);
 	}
-}
+	});
 
 /*-------------------------------------------------------------------------------
 
-serverSpawnMiscParticlesAtLocation
+	power
 
-Spawns misc particle effects for all clients at given coordinates.
+	A simple power function designed to work only with integers.
 
 -------------------------------------------------------------------------------*/
 
-void serverSpawnMiscParticlesAtLocation(Sint16 x, Sint16 y, Sint16 z, int particleType, int particleSprite)
+int power(int a, int b)
 {
-	int c;
-	if ( multiplayer != SERVER )
-	{
-		return;
-	}
-	for ( c = 1; c < MAXPLAYERS; c++ )
+	int c, result = 1;
+	for ( c = 0; c < b; c++ )
 	{
-		if ( client_disconnected[c] || players[c]->isLocalPlayer() )
-		{
-			continue;
-		}
-		strcpy((char*)net_packet->data, "SPPL");
-		SDLNet_Write16(x, &net_packet->data[4]);
-		SDLNet_Write16(y, &net_packet->data[6]);
-		SDLNet_Write16(z, &net_packet->data[8]);
-		net_packet->data[10] = particleType;
-		SDLNet_Write16(particleSprite, &net_packet->data[11]);
-		net_packet->address.host = net_clients[c - 1].host;
-		net_packet->address.port = net_clients[c - 1].port;
-		net_packet->len = 14;
-		sendPacketSafe(net_sock, -1, net_packet, c - 1);
+		result *= a;
 	}
+	return result;
 }
 
 /*-------------------------------------------------------------------------------
 
-	serverUpdateEntityFlag
+messageLocalPlayers
 
-	Updates a specific entity flag for all clients
+Support function, messages all local players with the message "message"
 
 -------------------------------------------------------------------------------*/
 
-void serverUpdateEntityFlag(Entity* entity, int flag)
+bool messageLocalPlayers(Uint32 type, char const * const message, ...)
 {
-	int c;
-	if ( multiplayer != SERVER )
-	{
-		return;
-	}
-	for ( c = 1; c < MAXPLAYERS; c++ )
+	char str[Player::MessageZone_t::ADD_MESSAGE_BUFFER_LENGTH] = { 0 };
+
+	va_list argptr;
+	va_start(argptr, message);
+	vsnprintf(str, Player::MessageZone_t::ADD_MESSAGE_BUFFER_LENGTH - 1, message, argptr);
+	va_end(argptr);
+
+    bool result = true;
+	for ( int player = 0; player < MAXPLAYERS; ++player )
 	{
-		if ( client_disconnected[c] || players[c]->isLocalPlayer() )
+		if ( players[player]->isLocalPlayer() )
 		{
-			continue;
+			result = messagePlayerColor(player, type, 0xFFFFFFFF, str) ? result : false;
 		}
-		strcpy((char*)net_packet->data, "ENTF");
-		SDLNet_Write32(entity->getUID(), &net_packet->data[4]);
-		net_packet->data[8] = flag;
-		net_packet->data[9] = entity->flags[flag];
-		net_packet->address.host = net_clients[c - 1].host;
-		net_packet->address.port = net_clients[c - 1].port;
-		net_packet->len = 10;
-		sendPacketSafe(net_sock, -1, net_packet, c - 1);
 	}
+
+	return result;
 }
 
 /*-------------------------------------------------------------------------------
 
-	serverUpdateEffects
+	messagePlayer
 
-	Updates the status of the EFFECTS variables (blindness, drunkenness, etc.)
-	for the specified client.
+	Support function, messages the player number given by "player" with the
+	message "message"
 
 -------------------------------------------------------------------------------*/
 
-void serverUpdateEffects(int player)
+bool messagePlayer(int player, Uint32 type, char const * const message, ...)
 {
-	int j;
+	if ( player < 0 || player >= MAXPLAYERS )
+	{
+		return false;
+	}
+	char str[Player::MessageZone_t::ADD_MESSAGE_BUFFER_LENGTH] = { 0 };
 
-	if ( multiplayer != SERVER || clientnum == player )
+	va_list argptr;
+	va_start( argptr, message );
+	vsnprintf( str, Player::MessageZone_t::ADD_MESSAGE_BUFFER_LENGTH - 1, message, argptr );
+	va_end( argptr );
+
+	strncpy(str, messageSanitizePercentSign(str, nullptr).c_str(), Player::MessageZone_t::ADD_MESSAGE_BUFFER_LENGTH - 1);
+
+	return messagePlayerColor(player, type, 0xFFFFFFFF, str);
+}
+
+/*-------------------------------------------------------------------------------
+
+messageLocalPlayersColor
+
+Messages all local players with the message "message"
+and color "color"
+
+-------------------------------------------------------------------------------*/
+
+bool messageLocalPlayersColor(Uint32 color, Uint32 type, char const * const message, ...)
+{
+	char str[Player::MessageZone_t::ADD_MESSAGE_BUFFER_LENGTH] = { 0 };
+
+	va_list argptr;
+	va_start(argptr, message);
+	vsnprintf(str, Player::MessageZone_t::ADD_MESSAGE_BUFFER_LENGTH - 1, message, argptr);
+	va_end(argptr);
+
+    bool result = true;
+	for ( int player = 0; player < MAXPLAYERS; ++player )
 	{
-		return;
+		if ( players[player]->isLocalPlayer() )
+		{
+			result = messagePlayerColor(player, type, color, str) ? result : false;
+		}
 	}
-	if ( player <= 0 || player >= MAXPLAYERS )
+
+	return result;
+}
+
+/*-------------------------------------------------------------------------------
+
+	messagePlayerColor
+
+	Messages the player number given by "player" with the message "message"
+	and color "color"
+
+-------------------------------------------------------------------------------*/
+
+bool messagePlayerColor(int player, Uint32 type, Uint32 color, char const * const message, ...)
+{
+	char str[Player::MessageZone_t::ADD_MESSAGE_BUFFER_LENGTH] = { 0 };
+	va_list argptr;
+
+	if ( message == NULL )
 	{
-		return;
+		return false;
 	}
-	if ( client_disconnected[player] == true || players[player]->isLocalPlayer() )
+	if ( player < 0 || player >= MAXPLAYERS )
 	{
-		return;
+		return false;
 	}
 
-	strcpy((char*)net_packet->data, "UPEF");
-	net_packet->data[4] = 0;
-	net_packet->data[5] = 0;
-	net_packet->data[6] = 0;
-	net_packet->data[7] = 0;
-	net_packet->data[8] = 0;
-	net_packet->data[9] = 0;
-	net_packet->data[10] = 0;
-	net_packet->data[11] = 0;
-	net_packet->data[12] = 0;
-	net_packet->data[13] = 0;
-	for (j = 0; j < NUMEFFECTS; j++)
+	// format the content
+	va_start( argptr, message );
+	vsnprintf( str, Player::MessageZone_t::ADD_MESSAGE_BUFFER_LENGTH - 1, message, argptr );
+	va_end( argptr );
+
+	// fixes crash when reading config at start of game
+	if (!initialized)
 	{
-		if ( stats[player]->EFFECTS[j] == true )
+		printlog("%s\n", str);
+		return true;
+	}
+    
+    // don't bother printing any message if we're not in game, it just clutters the log
+    if (intro) {
+        return false;
+    }
+
+    // if this is for a local player, but we've disabled this message type, don't print it!
+    const bool localPlayer = players[player]->isLocalPlayer();
+
+	bool result = false;
+	if ( localPlayer )
+	{
+	    printlog("%s\n", str);
+#ifdef NDEBUG
+		if (type != MESSAGE_DEBUG) { 
+			auto string = newString(&messages, color, completionTime, player, str);
+			addMessageToLogWindow(player, string);
+		}
+#else
+		auto string = newString(&messages, color, completionTime, player, str);
+		addMessageToLogWindow(player, string);
+#endif
+	    while ( list_Size(&messages) > MESSAGE_LIST_SIZE_CAP )
+	    {
+		    list_RemoveNode(messages.first);
+	    }
+	    if (!disable_messages && (messagesEnabled & type))
+	    {
+	        players[player]->messageZone.addMessage(color, str);
+	        result = true;
+	    }
+	}
+	else if ( multiplayer == SERVER )
+	{
+		strcpy((char*)net_packet->data, "MSGS");
+		SDLNet_Write32(color, &net_packet->data[4]);
+		SDLNet_Write32((Uint32)type, &net_packet->data[8]);
+		strcpy((char*)(&net_packet->data[12]), str);
+		net_packet->address.host = net_clients[player - 1].host;
+		net_packet->address.port = net_clients[player - 1].port;
+		net_packet->len = 12 + strlen(str) + 1;
+		sendPacketSafe(net_sock, -1, net_packet, player - 1);
+	}
+
+    // player death messages trigger this achievement
+	int c;
+	char tempstr[256];
+	for ( c = 0; c < MAXPLAYERS; c++ )
+	{
+		if ( client_disconnected[c] )
 		{
-			net_packet->data[4 + j / 8] |= power(2, j - (j / 8) * 8);
+			continue;
 		}
-		if ( stats[player]->EFFECTS_TIMERS[j] < TICKS_PER_SECOND * 5 && stats[player]->EFFECTS_TIMERS[j] > 0 )
+		snprintf(tempstr, 256, Language::get(697), stats[c]->name);
+		if ( !strcmp(str, tempstr) )
 		{
-			// use these bits to denote if duration is low.
-			net_packet->data[9 + j / 8] |= power(2, j - (j / 8) * 8);
+			steamAchievementClient(player, "BARONY_ACH_NOT_A_TEAM_PLAYER");
 		}
 	}
-	net_packet->address.host = net_clients[player - 1].host;
-	net_packet->address.port = net_clients[player - 1].port;
-	net_packet->len = 14;
-	sendPacketSafe(net_sock, -1, net_packet, player - 1);
+
+	return result;
 }
 
 /*-------------------------------------------------------------------------------
 
-	serverUpdateHunger
+	sendEntityUDP / sendEntityTCP
 
-	Updates the HUNGER variable for the specified client
+	Updates given entity data for given client. Server -> client functions
 
 -------------------------------------------------------------------------------*/
 
-void serverUpdateHunger(int player)
+void sendEntityTCP(Entity* entity, int c)
 {
-	if ( multiplayer != SERVER || clientnum == player )
+	// deprecated
+}
+
+// writes an ENTU packet for the given entity into data, which must hold ENTITY_PACKET_LENGTH bytes
+static void packEntityUpdate(Entity* entity, Uint8* data)
+{
+	strcpy((char*)data, "ENTU");
+	SDLNet_Write32((Uint32)entity->getUID(), &data[4]);
+	SDLNet_Write16((Uint16)entity->sprite, &data[8]);
+	SDLNet_Write16((Sint16)(entity->x * 32), &data[10]);
+	SDLNet_Write16((Sint16)(entity->y * 32), &data[12]);
+	SDLNet_Write16((Sint16)(entity->z * 32), &data[14]);
+	data[16] = (Sint8)entity->sizex;
+	data[17] = (Sint8)entity->sizey;
+	data[18] = (Uint8)(entity->scalex * 128);
+	data[19] = (Uint8)(entity->scaley * 128);
+	data[20] = (Uint8)(entity->scalez * 128);
+	SDLNet_Write16((Sint16)(entity->yaw * 256), &data[21]);
+	SDLNet_Write16((Sint16)(entity->pitch * 256), &data[23]);
+	SDLNet_Write16((Sint16)(entity->roll * 256), &data[25]);
+	data[27] = (Sint8)(entity->focalx * 8);
+	data[28] = (Sint8)(entity->focaly * 8);
+	data[29] = (Sint8)(entity->focalz * 8);
+	SDLNet_Write32(entity->skill[2], &data[30]);
+	data[34] = 0;
+	data[35] = 0;
+	for ( int j = 0; j < 16; j++ )
+	{
+		if ( entity->flags[j] )
+		{
+			data[34 + j / 8] |= power(2, j - (j / 8) * 8);
+		}
+	}
+	SDLNet_Write32((Uint32)ticks, &data[36]);
+	SDLNet_Write16((Sint16)(entity->vel_x * 32), &data[40]);
+	SDLNet_Write16((Sint16)(entity->vel_y * 32), &data[42]);
+	SDLNet_Write16((Sint16)(entity->vel_z * 32), &data[44]);
+}
+
+void sendEntityUDP(Entity* entity, int c, bool guarantee)
+{
+	if ( entity == NULL )
 	{
 		return;
 	}
-	if ( player <= 0 || player >= MAXPLAYERS )
+	if ( client_disconnected[c] == true || players[c]->isLocalPlayer() )
 	{
 		return;
 	}
-	if ( client_disconnected[player] == true || players[player]->isLocalPlayer() )
+	if ( c <= 0 )
 	{
 		return;
 	}
 
-	strcpy((char*)net_packet->data, "HNGR");
-	SDLNet_Write32(stats[player]->HUNGER, &net_packet->data[4]);
-	net_packet->address.host = net_clients[player - 1].host;
-	net_packet->address.port = net_clients[player - 1].port;
-	net_packet->len = 8;
-	sendPacketSafe(net_sock, -1, net_packet, player - 1);
+	// send entity data to the client
+	packEntityUpdate(entity, net_packet->data);
+	net_packet->address.host = net_clients[c - 1].host;
+	net_packet->address.port = net_clients[c - 1].port;
+	net_packet->len = ENTITY_PACKET_LENGTH;
+
+	// sometimes you want more insurance that the entity update arrives
+	if ( guarantee )
+	{
+		sendPacketSafe(net_sock, -1, net_packet, c - 1);
+	}
+	else
+	{
+		sendPacket(net_sock, -1, net_packet, c - 1);
+	}
+	if ( entity->clientsHaveItsStats )
+	{
+		entity->serverUpdateEffectsForEntity(false);
+	}
 }
 
 /*-------------------------------------------------------------------------------
 
-serverUpdateSexChange
+	sendMapSeedTCP
 
-Updates all clients on specified player's sex
+	Sends the seed necessary to generate the next map
 
 -------------------------------------------------------------------------------*/
 
-void serverUpdateSexChange(int player)
+void sendMapSeedTCP(int c)
 {
-	if ( multiplayer != SERVER || !stats[player] )
-	{
-		return;
-	}
+	// deprecated
+}
 
-	for ( int c = 1; c < MAXPLAYERS; c++ )
-	{
-		if ( client_disconnected[c] || players[c]->isLocalPlayer() )
-		{
-			continue;
-		}
-		strcpy((char*)net_packet->data, "SEXU");
-		net_packet->data[4] = static_cast<Uint8>(player);
-		net_packet->data[5] = static_cast<Uint8>(stats[player]->sex);
-		net_packet->address.host = net_clients[c - 1].host;
-		net_packet->address.port = net_clients[c - 1].port;
-		net_packet->len = 6;
-		sendPacketSafe(net_sock, -1, net_packet, c - 1);
-	}
+/*-------------------------------------------------------------------------------
+
+	sendMapTCP
+
+	Sends all map data to clients
+
+-------------------------------------------------------------------------------*/
+
+void sendMapTCP(int c)
+{
+	// deprecated
 }
 
 /*-------------------------------------------------------------------------------
 
-serverUpdatePlayerStats
+	serverUpdateBodypartIDs
 
-Updates all player current HP/MP for clients
+	Updates the uid numbers of all the given bodyparts for the given entity
 
 -------------------------------------------------------------------------------*/
 
-void serverUpdatePlayerStats()
+void serverUpdateBodypartIDs(Entity* entity)
 {
 	int c;
 	if ( multiplayer != SERVER )
@@ -1044,152 +1749,135 @@ void serverUpdatePlayerStats()
 		{
 			continue;
 		}
-		strcpy((char*)net_packet->data, "STAT");
-		Sint32 playerHP = 0;
-		Sint32 playerMP = 0;
-		for ( int i = 0; i < MAXPLAYERS; ++i )
+		strcpy((char*)net_packet->data, "BDYI");
+		SDLNet_Write32(entity->getUID(), &net_packet->data[4]);
+		node_t* node;
+		int i;
+		for ( i = 0, node = entity->children.first; node != NULL; node = node->next, i++ )
 		{
-			if ( stats[i] )
+			if ( i < 1 || (i < 2 && entity->behavior == &actMonster) )
 			{
-				playerHP = static_cast<Sint16>(stats[i]->MAXHP);
-				playerHP |= static_cast<Sint16>(stats[i]->HP) << 16;
-				playerMP = static_cast<Sint16>(stats[i]->MAXMP);
-				playerMP |= static_cast<Sint16>(stats[i]->MP) << 16;
+				continue;
+			}
+			Entity* tempEntity = (Entity*)node->element;
+			if ( entity->behavior == &actMonster )
+			{
+				SDLNet_Write32(tempEntity->getUID(), &net_packet->data[8 + 4 * (i - 2)]);
+			}
+			else
+			{
+				SDLNet_Write32(tempEntity->getUID(), &net_packet->data[8 + 4 * (i - 1)]);
 			}
-			SDLNet_Write32(playerHP, &net_packet->data[4 + i * 8]); // 4/12/20/28 data
-			SDLNet_Write32(playerMP, &net_packet->data[8 + i * 8]); // 8/16/24/32 data
-			playerHP = 0;
-			playerMP = 0;
 		}
 		net_packet->address.host = net_clients[c - 1].host;
 		net_packet->address.port = net_clients[c - 1].port;
-		net_packet->len = 4 + 8 * MAXPLAYERS;
-		sendPacketSafe(net_sock, -1, net_packet, c - 1);
+		net_packet->len = 8 + (list_Size(&entity->children) - 2) * 4;
+		queuePacketSafe(net_sock, -1, net_packet, c - 1);
 	}
 }
 
 /*-------------------------------------------------------------------------------
 
-serverUpdatePlayerGameplayStats
+	serverUpdateEntityBodypart
 
-Updates given players gameplayStatistics value by given increment.
+	Updates the given bodypart of the given entity for all clients
 
 -------------------------------------------------------------------------------*/
-void serverUpdatePlayerGameplayStats(int player, int gameplayStat, int changeval)
+
+//int numPlayerBodypartUpdates = 0;
+//int numMonsterBodypartUpdates = 0;
+//Uint32 lastbodypartTick = 0;
+
+void serverUpdateEntityBodypart(Entity* entity, int bodypart)
 {
-	if ( player < 0 || player >= MAXPLAYERS )
-	{
-		return;
-	}
-	if ( client_disconnected[player] )
+	int c;
+	if ( multiplayer != SERVER )
 	{
 		return;
 	}
-	if ( player == 0 )
+	for ( c = 1; c < MAXPLAYERS; c++ )
 	{
-		if ( gameplayStat == STATISTICS_TEMPT_FATE )
-		{
-			if ( gameStatistics[STATISTICS_TEMPT_FATE] == -1 )
-			{
-				// don't change, completed task.
-			}
-			else
-			{
-				if ( changeval == 5 )
-				{
-					gameStatistics[gameplayStat] = changeval;
-				}
-				else if ( changeval == 1 && gameStatistics[gameplayStat] > 0 )
-				{
-					gameStatistics[gameplayStat] = -1;
-				}
-			}
-		}
-		else if ( gameplayStat == STATISTICS_FORUM_TROLL )
-		{
-			if ( changeval == AchievementObserver::FORUM_TROLL_BREAK_WALL )
-			{
-				int walls = gameStatistics[gameplayStat] & 0xFF;
-				walls = std::min(walls + 1, 3);
-				gameStatistics[gameplayStat] = gameStatistics[gameplayStat] & 0xFFFFFF00;
-				gameStatistics[gameplayStat] |= walls;
-			}
-			else if ( changeval == AchievementObserver::FORUM_TROLL_RECRUIT_TROLL )
-			{
-				int trolls = (gameStatistics[gameplayStat] >> 8) & 0xFF;
-				trolls = std::min(trolls + 1, 3);
-				gameStatistics[gameplayStat] = gameStatistics[gameplayStat] & 0xFFFF00FF;
-				gameStatistics[gameplayStat] |= (trolls << 8);
-			}
-			else if ( changeval == AchievementObserver::FORUM_TROLL_FEAR )
-			{
-				int fears = (gameStatistics[gameplayStat] >> 16) & 0xFF;
-				fears = std::min(fears + 1, 3);
-				gameStatistics[gameplayStat] = gameStatistics[gameplayStat] & 0xFF00FFFF;
-				gameStatistics[gameplayStat] |= (fears << 16);
-			}
-		}
-		else if ( gameplayStat == STATISTICS_POP_QUIZ_1 || gameplayStat == STATISTICS_POP_QUIZ_2 )
+		if ( client_disconnected[c] || players[c]->isLocalPlayer() )
 		{
-			int spellID = changeval;
-			if ( spellID >= 30 )
-			{
-				spellID -= 30;
-				int shifted = (1 << spellID);
-				gameStatistics[gameplayStat] |= shifted;
-			}
-			else
-			{
-				int shifted = (1 << spellID);
-				gameStatistics[gameplayStat] |= shifted;
-			}
+			continue;
 		}
-		else
+		strcpy((char*)net_packet->data, "ENTB");
+		SDLNet_Write32(entity->getUID(), &net_packet->data[4]);
+		net_packet->data[8] = bodypart;
+		node_t* node = list_Node(&entity->children, bodypart);
+		if ( !node )
 		{
-			gameStatistics[gameplayStat] += changeval;
+			continue;
 		}
+		Entity* tempEntity = (Entity*)node->element;
+		SDLNet_Write32(tempEntity->sprite, &net_packet->data[9]);
+		net_packet->data[13] = tempEntity->flags[INVISIBLE];
+		net_packet->address.host = net_clients[c - 1].host;
+		net_packet->address.port = net_clients[c - 1].port;
+		net_packet->len = 14;
+		queuePacketSafe(net_sock, -1, net_packet, c - 1);
 	}
-	else if ( !players[player]->isLocalPlayer() )
-	{
-		strcpy((char*)net_packet->data, "GPST");
-		SDLNet_Write32(gameplayStat, &net_packet->data[4]);
-		SDLNet_Write32(changeval, &net_packet->data[8]);
-		net_packet->address.host = net_clients[player - 1].host;
-		net_packet->address.port = net_clients[player - 1].port;
-		net_packet->len = 12;
-		sendPacketSafe(net_sock, -1, net_packet, player - 1);
-	}
-	//messagePlayer(clientnum, "[DEBUG]: sent: %d, %d: val %d", gameplayStat, changeval, gameStatistics[gameplayStat]);
+	//if ( entity->behavior == &actPlayer )
+	//{
+	//	++numPlayerBodypartUpdates;
+	//}
+	//else if ( entity->behavior == &actMonster )
+	//{
+	//	++numMonsterBodypartUpdates;
+	//}
+	//if ( lastbodypartTick == 0 )
+	//{
+	//	lastbodypartTick = ticks;
+	//}
+	//if ( ticks - lastbodypartTick >= 250 )
+	//{
+	//	messagePlayer(0, "Bodypart updates (%ds) players: %d, monster: %d", (ticks - lastbodypartTick) / 50, numPlayerBodypartUpdates, numMonsterBodypartUpdates);
+	//	lastbodypartTick = 0;
+	//	numMonsterBodypartUpdates = 0;
+	//	numPlayerBodypartUpdates = 0;
+	//}
 }
 
-void serverUpdatePlayerConduct(int player, int conduct, int value)
+/*-------------------------------------------------------------------------------
+
+	serverUpdateEntitySprite
+
+	Updates the given entity's sprite for all clients
+
+-------------------------------------------------------------------------------*/
+
+void serverUpdateEntitySprite(Entity* entity)
 {
-	if ( player <= 0 || player >= MAXPLAYERS )
+	int c;
+	if ( multiplayer != SERVER )
 	{
 		return;
 	}
-	if ( client_disconnected[player] || players[player]->isLocalPlayer() )
+	for ( c = 1; c < MAXPLAYERS; c++ )
 	{
-		return;
+		if ( client_disconnected[c] || players[c]->isLocalPlayer() )
+		{
+			continue;
+		}
+		strcpy((char*)net_packet->data, "ENTA");
+		SDLNet_Write32(entity->getUID(), &net_packet->data[4]);
+		SDLNet_Write32(entity->sprite, &net_packet->data[8]);
+		net_packet->address.host = net_clients[c - 1].host;
+		net_packet->address.port = net_clients[c - 1].port;
+		net_packet->len = 12;
+		queuePacketSafe(net_sock, -1, net_packet, c - 1);
 	}
-	strcpy((char*)net_packet->data, "COND");
-	SDLNet_Write16(conduct, &net_packet->data[4]);
-	SDLNet_Write16(value, &net_packet->data[6]);
-	net_packet->address.host = net_clients[player - 1].host;
-	net_packet->address.port = net_clients[player - 1].port;
-	net_packet->len = 8;
-	sendPacketSafe(net_sock, -1, net_packet, player - 1);
 }
 
 /*-------------------------------------------------------------------------------
 
-serverUpdatePlayerLVL
+	serverUpdateEntitySkill
 
-Updates all player current LVL for clients
+	Updates a specific entity skill for all clients
 
 -------------------------------------------------------------------------------*/
 
-void serverUpdatePlayerLVL()
+void serverUpdateEntitySkill(Entity* entity, int skill)
 {
 	int c;
 	if ( multiplayer != SERVER )
@@ -1202,1202 +1890,2594 @@ void serverUpdatePlayerLVL()
 		{
 			continue;
 		}
-		strcpy((char*)net_packet->data, "UPLV");
-		Sint32 playerLevels = 0;
-		for ( int i = 0; i < MAXPLAYERS; ++i )
-		{
-			if ( stats[i] )
-			{
-				playerLevels |= static_cast<Uint8>(stats[i]->LVL) << (8 * i); // store uint8 in data, highest bits for player 4.
-			}
-		}
-		SDLNet_Write32(playerLevels, &net_packet->data[4]);
+		PacketWriter packet(net_packet);
+		packet.writeId("ENTS");
+		packet.write32(entity->getUID());
+		packet.write8(skill);
+		packet.write32(entity->skill[skill]);
+		packet.finish(net_packet);
 		net_packet->address.host = net_clients[c - 1].host;
 		net_packet->address.port = net_clients[c - 1].port;
-		net_packet->len = 8;
-		sendPacketSafe(net_sock, -1, net_packet, c - 1);
+		queuePacketSafe(net_sock, -1, net_packet, c - 1);
 	}
 }
 
-void serverRemoveClientFollower(int player, Uint32 uidToRemove)
+/*-------------------------------------------------------------------------------
+
+serverUpdateEntitySkill
+
+Updates a specific entity skill for all clients
+
+-------------------------------------------------------------------------------*/
+
+void serverUpdateEntityStatFlag(Entity* entity, int flag)
 {
-	if ( multiplayer != SERVER || player <= 0 )
+	int c;
+	if ( multiplayer != SERVER )
 	{
 		return;
 	}
-	if ( client_disconnected[player] || players[player]->isLocalPlayer() )
+	if ( !entity->getStats() )
 	{
 		return;
 	}
-
-	strcpy((char*)net_packet->data, "LDEL");
-	SDLNet_Write32(uidToRemove, &net_packet->data[4]);
-	net_packet->address.host = net_clients[player - 1].host;
-	net_packet->address.port = net_clients[player - 1].port;
-	net_packet->len = 8;
-	sendPacketSafe(net_sock, -1, net_packet, player - 1);
+	for ( c = 1; c < MAXPLAYERS; c++ )
+	{
+		if ( client_disconnected[c] || players[c]->isLocalPlayer() )
+		{
+			continue;
+		}
+		strcpy((char*)net_packet->data, "ENSF");
+		SDLNet_Write32(entity->getUID(), &net_packet->data[4]);
+		net_packet->data[8] = flag;
+		SDLNet_Write32(entity->getStats()->MISC_FLAGS[flag], &net_packet->data[9]);
+		net_packet->address.host = net_clients[c - 1].host;
+		net_packet->address.port = net_clients[c - 1].port;
+		net_packet->len = 13;
+		queuePacketSafe(net_sock, -1, net_packet, c - 1);
+	}
 }
 
-void serverSendItemToPickupAndEquip(int player, Item* item)
+/*-------------------------------------------------------------------------------
+
+serverUpdateEntityFSkill
+
+Updates a specific entity fskill for all clients
+
+-------------------------------------------------------------------------------*/
+
+void serverUpdateEntityFSkill(Entity* entity, int fskill)
 {
-	if ( multiplayer != SERVER || player <= 0 )
+	int c;
+	if ( multiplayer != SERVER )
 	{
 		return;
 	}
-	if ( client_disconnected[player] || players[player]->isLocalPlayer() )
+	for ( c = 1; c < MAXPLAYERS; c++ )
 	{
-		return;
+		if ( client_disconnected[c] || players[c]->isLocalPlayer() )
+		{
+			continue;
+		}
+		PacketWriter packet(net_packet);
+		packet.writeId("ENFS");
+		packet.write32(entity->getUID());
+		packet.write8(fskill);
+		packet.write16(static_cast<Sint16>(entity->fskill[fskill] * 256));
+		packet.finish(net_packet);
+		net_packet->address.host = net_clients[c - 1].host;
+		net_packet->address.port = net_clients[c - 1].port;
+		queuePacketSafe(net_sock, -1, net_packet, c - 1);
 	}
+}
 
-	// send the client info on the item it just picked up
-	strcpy((char*)net_packet->data, "ITEQ");
-	SDLNet_Write32((Uint32)item->type, &net_packet->data[4]);
-	SDLNet_Write32((Uint32)item->status, &net_packet->data[8]);
-	SDLNet_Write32((Uint32)item->beatitude, &net_packet->data[12]);
-	SDLNet_Write32((Uint32)item->count, &net_packet->data[16]);
-	SDLNet_Write32((Uint32)item->appearance, &net_packet->data[20]);
-	SDLNet_Write32((Uint32)item->ownerUid, &net_packet->data[24]);
-	net_packet->data[28] = item->identified;
-	net_packet->address.host = net_clients[player - 1].host;
-	net_packet->address.port = net_clients[player - 1].port;
-	net_packet->len = 29;
-	sendPacketSafe(net_sock, -1, net_packet, player - 1);
-}
+/*-------------------------------------------------------------------------------
 
-void serverUpdateAllyStat(int player, Uint32 uidToUpdate, int LVL, int HP, int MAXHP, int type)
+serverSpawnMiscParticles
+
+Spawns misc particle effects for all clients
+
+-------------------------------------------------------------------------------*/
+
+void serverSpawnMiscParticles(Entity* entity, int particleType, int particleSprite, Uint32 optionalUid)
 {
-	if ( multiplayer != SERVER || player <= 0 )
+	int c;
+	if ( multiplayer != SERVER )
 	{
 		return;
 	}
-	if ( client_disconnected[player] || players[player]->isLocalPlayer() )
+	for ( c = 1; c < MAXPLAYERS; c++ )
 	{
-		return;
+		if ( client_disconnected[c] || players[c]->isLocalPlayer() )
+		{
+			continue;
+		}
+		strcpy((char*)net_packet->data, "SPPE");
+		SDLNet_Write32(entity->getUID(), &net_packet->data[4]);
+		net_packet->data[8] = particleType;
+		SDLNet_Write16(particleSprite, &net_packet->data[9]);
+		SDLNet_Write32(optionalUid, &net_packet->data[11]);
+		net_packet->address.host = net_clients[c - 1].host;
+		net_packet->address.port = net_clients[c - 1].port;
+		net_packet->len = 16;
+		queuePacketSafe(net_sock, -1, net_packet, c - 1);
 	}
+}
 
-	strcpy((char*)net_packet->data, "NPCI");
-	SDLNet_Write32(uidToUpdate, &net_packet->data[4]);
-	net_packet->data[8] = static_cast<Uint8>(LVL);
-	SDLNet_Write16(HP, &net_packet->data[9]);
-	SDLNet_Write16(MAXHP, &net_packet->data[11]);
-	net_packet->data[13] = static_cast<Uint8>(type);
-	net_packet->address.host = net_clients[player - 1].host;
-	net_packet->address.port = net_clients[player - 1].port;
-	net_packet->len = 14;
-	sendPacketSafe(net_sock, -1, net_packet, player - 1);
+/*-------------------------------------------------------------------------------
+
+serverSpawnMiscParticlesAtLocation
+
+Spawns misc particle effects for all clients at given coordinates.
+
+-------------------------------------------------------------------------------*/
+
+void serverSpawnMiscParticlesAtLocation(Sint16 x, Sint16 y, Sint16 z, int particleType, int particleSprite)
+{
+	int c;
+	if ( multiplayer != SERVER )
+	{
+		return;
+	}
+	for ( c = 1; c < MAXPLAYERS; c++ )
+	{
+		if ( client_disconnected[c] || players[c]->isLocalPlayer() )
+		{
+			continue;
+		}
+		strcpy((char*)net_packet->data, "SPPL");
+		SDLNet_Write16(x, &net_packet->data[4]);
+		SDLNet_Write16(y, &net_packet->data[6]);
+		SDLNet_Write16(z, &net_packet->data[8]);
+		net_packet->data[10] = particleType;
+		SDLNet_Write16(particleSprite, &net_packet->data[11]);
+		net_packet->address.host = net_clients[c - 1].host;
+		net_packet->address.port = net_clients[c - 1].port;
+		net_packet->len = 14;
+		queuePacketSafe(net_sock, -1, net_packet, c - 1);
+	}
 }
 
-void serverUpdatePlayerSummonStrength(int player)
+/*-------------------------------------------------------------------------------
+
+	serverUpdateEntityFlag
+
+	Updates a specific entity flag for all clients
+
+-------------------------------------------------------------------------------*/
+
+void serverUpdateEntityFlag(Entity* entity, int flag)
 {
+	int c;
 	if ( multiplayer != SERVER )
 	{
 		return;
 	}
-	if ( player <= 0 || player > MAXPLAYERS )
+	for ( c = 1; c < MAXPLAYERS; c++ )
+	{
+		if ( client_disconnected[c] || players[c]->isLocalPlayer() )
+		{
+			continue;
+		}
+		strcpy((char*)net_packet->data, "ENTF");
+		SDLNet_Write32(entity->getUID(), &net_packet->data[4]);
+		net_packet->data[8] = flag;
+		net_packet->data[9] = entity->flags[flag];
+		net_packet->address.host = net_clients[c - 1].host;
+		net_packet->address.port = net_clients[c - 1].port;
+		net_packet->len = 10;
+		queuePacketSafe(net_sock, -1, net_packet, c - 1);
+	}
+}
+
+/*-------------------------------------------------------------------------------
+
+	serverUpdateEffects
+
+	Updates the status of the EFFECTS variables (blindness, drunkenness, etc.)
+	for the specified client.
+
+-------------------------------------------------------------------------------*/
+
+void serverUpdateEffects(int player)
+{
+	int j;
+
+	if ( multiplayer != SERVER || clientnum == player )
 	{
 		return;
 	}
-	if ( client_disconnected[player] || !stats[player] || players[player]->isLocalPlayer() )
+	if ( player <= 0 || player >= MAXPLAYERS )
+	{
+		return;
+	}
+	if ( client_disconnected[player] == true || players[player]->isLocalPlayer() )
 	{
 		return;
 	}
 
-	strcpy((char*)net_packet->data, "SUMS");
-	SDLNet_Write32(stats[player]->playerSummonLVLHP, &net_packet->data[4]);
-	SDLNet_Write32(stats[player]->playerSummonSTRDEXCONINT, &net_packet->data[8]);
-	SDLNet_Write32(stats[player]->playerSummonPERCHR, &net_packet->data[12]);
-	SDLNet_Write32(stats[player]->playerSummon2LVLHP, &net_packet->data[16]);
-	SDLNet_Write32(stats[player]->playerSummon2STRDEXCONINT, &net_packet->data[20]);
-	SDLNet_Write32(stats[player]->playerSummon2PERCHR, &net_packet->data[24]);
+	strcpy((char*)net_packet->data, "UPEF");
+	net_packet->data[4] = 0;
+	net_packet->data[5] = 0;
+	net_packet->data[6] = 0;
+	net_packet->data[7] = 0;
+	net_packet->data[8] = 0;
+	net_packet->data[9] = 0;
+	net_packet->data[10] = 0;
+	net_packet->data[11] = 0;
+	net_packet->data[12] = 0;
+	net_packet->data[13] = 0;
+	for (j = 0; j < NUMEFFECTS; j++)
+	{
+		if ( stats[player]->EFFECTS[j] == true )
+		{
+			net_packet->data[4 + j / 8] |= power(2, j - (j / 8) * 8);
+		}
+		if ( stats[player]->EFFECTS_TIMERS[j] < TICKS_PER_SECOND * 5 && stats[player]->EFFECTS_TIMERS[j] > 0 )
+		{
+			// use these bits to denote if duration is low.
+			net_packet->data[9 + j / 8] |= power(2, j - (j / 8) * 8);
+		}
+	}
 	net_packet->address.host = net_clients[player - 1].host;
 	net_packet->address.port = net_clients[player - 1].port;
-	net_packet->len = 28;
-	sendPacketSafe(net_sock, -1, net_packet, player - 1);
+	net_packet->len = 14;
+	queuePacketSafe(net_sock, -1, net_packet, player - 1);
 }
 
-void serverUpdateAllyHP(int player, Uint32 uidToUpdate, int HP, int MAXHP, bool guarantee)
+/*-------------------------------------------------------------------------------
+
+	serverUpdateHunger
+
+	Updates the HUNGER variable for the specified client
+
+-------------------------------------------------------------------------------*/
+
+void serverUpdateHunger(int player)
 {
-	if ( multiplayer != SERVER )
+	if ( multiplayer != SERVER || clientnum == player )
 	{
 		return;
 	}
-	if ( player <= 0 )
+	if ( player <= 0 || player >= MAXPLAYERS )
 	{
 		return;
 	}
-	if ( client_disconnected[player] || players[player]->isLocalPlayer() )
+	if ( client_disconnected[player] == true || players[player]->isLocalPlayer() )
 	{
 		return;
 	}
 
-	strcpy((char*)net_packet->data, "NPCU");
-	SDLNet_Write32(uidToUpdate, &net_packet->data[4]);
-	SDLNet_Write16(HP, &net_packet->data[8]);
-	SDLNet_Write16(MAXHP, &net_packet->data[10]);
+	strcpy((char*)net_packet->data, "HNGR");
+	SDLNet_Write32(stats[player]->HUNGER, &net_packet->data[4]);
 	net_packet->address.host = net_clients[player - 1].host;
 	net_packet->address.port = net_clients[player - 1].port;
-	net_packet->len = 12;
-	if ( !guarantee )
+	net_packet->len = 8;
+	queuePacketSafe(net_sock, -1, net_packet, player - 1);
+}
+
+/*-------------------------------------------------------------------------------
+
+serverUpdateSexChange
+
+Updates all clients on specified player's sex
+
+-------------------------------------------------------------------------------*/
+
+void serverUpdateSexChange(int player)
+{
+	if ( multiplayer != SERVER || !stats[player] )
 	{
-		sendPacket(net_sock, -1, net_packet, player - 1);
+		return;
 	}
-	else
+
+	for ( int c = 1; c < MAXPLAYERS; c++ )
 	{
-		sendPacketSafe(net_sock, -1, net_packet, player - 1);
+		if ( client_disconnected[c] || players[c]->isLocalPlayer() )
+		{
+			continue;
+		}
+		strcpy((char*)net_packet->data, "SEXU");
+		net_packet->data[4] = static_cast<Uint8>(player);
+		net_packet->data[5] = static_cast<Uint8>(stats[player]->sex);
+		net_packet->address.host = net_clients[c - 1].host;
+		net_packet->address.port = net_clients[c - 1].port;
+		net_packet->len = 6;
+		queuePacketSafe(net_sock, -1, net_packet, c - 1);
 	}
 }
 
-void sendMinimapPing(Uint8 player, Uint8 x, Uint8 y, Uint8 pingType)
+/*-------------------------------------------------------------------------------
+
+serverUpdatePlayerStats
+
+Updates all player current HP/MP for clients
+
+-------------------------------------------------------------------------------*/
+
+void serverUpdatePlayerStats()
 {
-	if ( multiplayer == CLIENT )
+	int c;
+	if ( multiplayer != SERVER )
 	{
-		// send to host to relay info.
-		strcpy((char*)net_packet->data, "PMAP"); 
-		net_packet->data[4] = player;
-		net_packet->data[5] = x;
-		net_packet->data[6] = y;
-		net_packet->data[7] = pingType;
-
-		net_packet->address.host = net_server.host;
-		net_packet->address.port = net_server.port;
-		net_packet->len = 8;
-		sendPacket(net_sock, -1, net_packet, 0);
+		return;
 	}
-	else
+	for ( c = 1; c < MAXPLAYERS; c++ )
 	{
-		for ( int c = 0; c < MAXPLAYERS; c++ )
+		if ( client_disconnected[c] || players[c]->isLocalPlayer() )
 		{
-			if ( client_disconnected[c] )
+			continue;
+		}
+		strcpy((char*)net_packet->data, "STAT");
+		Sint32 playerHP = 0;
+		Sint32 playerMP = 0;
+		for ( int i = 0; i < MAXPLAYERS; ++i )
+		{
+			if ( stats[i] )
 			{
-				continue;
-			}
-			if ( players[c]->isLocalPlayer() )
-			{
-				minimapPingAdd(player, c, MinimapPing(ticks, player, x, y, false, (MinimapPing::PingType)pingType));
-				continue;
-			}
-
-			if ( multiplayer == SERVER )
-			{
-				// send to all clients.
-				strcpy((char*)net_packet->data, "PMAP");
-				net_packet->data[4] = player;
-				net_packet->data[5] = x;
-				net_packet->data[6] = y;
-				net_packet->data[7] = pingType;
-
-				net_packet->address.host = net_clients[c - 1].host;
-				net_packet->address.port = net_clients[c - 1].port;
-				net_packet->len = 8;
-				sendPacketSafe(net_sock, -1, net_packet, c - 1);
+				playerHP = static_cast<Sint16>(stats[i]->MAXHP);
+				playerHP |= static_cast<Sint16>(stats[i]->HP) << 16;
+				playerMP = static_cast<Sint16>(stats[i]->MAXMP);
+				playerMP |= static_cast<Sint16>(stats[i]->MP) << 16;
 			}
+			SDLNet_Write32(playerHP, &net_packet->data[4 + i * 8]); // 4/12/20/28 data
+			SDLNet_Write32(playerMP, &net_packet->data[8 + i * 8]); // 8/16/24/32 data
+			playerHP = 0;
+			playerMP = 0;
 		}
+		net_packet->address.host = net_clients[c - 1].host;
+		net_packet->address.port = net_clients[c - 1].port;
+		net_packet->len = 4 + 8 * MAXPLAYERS;
+		queuePacketSafe(net_sock, -1, net_packet, c - 1);
 	}
 }
 
-void sendAllyCommandClient(int player, Uint32 uid, int command, Uint8 x, Uint8 y, Uint32 targetUid)
+/*-------------------------------------------------------------------------------
+
+serverUpdatePlayerGameplayStats
+
+Updates given players gameplayStatistics value by given increment.
+
+-------------------------------------------------------------------------------*/
+void serverUpdatePlayerGameplayStats(int player, int gameplayStat, int changeval)
 {
-	if ( multiplayer != CLIENT )
+	if ( player < 0 || player >= MAXPLAYERS )
 	{
 		return;
 	}
-	//messagePlayer(clientnum, "%d", targetUid);
-
-	// send to host.
-	strcpy((char*)net_packet->data, "ALLY");
-	net_packet->data[4] = player;
-	net_packet->data[5] = command;
-	net_packet->data[6] = x;
-	net_packet->data[7] = y;
-	SDLNet_Write32(uid, &net_packet->data[8]);
-	net_packet->len = 12;
-	if ( targetUid != 0 )
-	{
-		SDLNet_Write32(targetUid, &net_packet->data[12]);
-		net_packet->len = 16;
-	}
-	net_packet->address.host = net_server.host;
-	net_packet->address.port = net_server.port;
-	sendPacket(net_sock, -1, net_packet, 0);
-}
-
-NetworkingLobbyJoinRequestResult lobbyPlayerJoinRequest(int& outResult, bool lockedSlots[4])
-{
-    printlog("processing lobby join request\n");
-
-	Uint32 result = MAXPLAYERS;
-	if ( strcmp(VERSION, (char*)net_packet->data + 48) ) // TODO this should be safer.
+	if ( client_disconnected[player] )
 	{
-		result = MAXPLAYERS + 1; // wrong version number
+		return;
 	}
-	else
+	if ( player == 0 )
 	{
-		Uint32 clientms = SDLNet_Read32(&net_packet->data[57]);
-		Uint32 clientlsg = SDLNet_Read32(&net_packet->data[61]);
-		Uint32 clientlobbyKey = (net_packet->len > 65) ? SDLNet_Read32(&net_packet->data[65]) : 0;
-		if ( net_packet->data[56] == 0 )
+		if ( gameplayStat == STATISTICS_TEMPT_FATE )
 		{
-			// client will enter any player spot
-			for ( result = 1; result < MAXPLAYERS; result++ )
+			if ( gameStatistics[STATISTICS_TEMPT_FATE] == -1 )
 			{
-				if ( client_disconnected[result] == true && !lockedSlots[result] )
+				// don't change, completed task.
+			}
+			else
+			{
+				if ( changeval == 5 )
 				{
-					break;    // no more player slots
+					gameStatistics[gameplayStat] = changeval;
+				}
+				else if ( changeval == 1 && gameStatistics[gameplayStat] > 0 )
+				{
+					gameStatistics[gameplayStat] = -1;
 				}
 			}
 		}
-		else
+		else if ( gameplayStat == STATISTICS_FORUM_TROLL )
 		{
-			// client is joining a particular player spot
-			result = net_packet->data[56];
-			if ( result >= MAXPLAYERS || !client_disconnected[result] || lockedSlots[result] )
+			if ( changeval == AchievementObserver::FORUM_TROLL_BREAK_WALL )
 			{
-				result = MAXPLAYERS;  // client wants to fill a space that is already filled
+				int walls = gameStatistics[gameplayStat] & 0xFF;
+				walls = std::min(walls + 1, 3);
+				gameStatistics[gameplayStat] = gameStatistics[gameplayStat] & 0xFFFFFF00;
+				gameStatistics[gameplayStat] |= walls;
+			}
+			else if ( changeval == AchievementObserver::FORUM_TROLL_RECRUIT_TROLL )
+			{
+				int trolls = (gameStatistics[gameplayStat] >> 8) & 0xFF;
+				trolls = std::min(trolls + 1, 3);
+				gameStatistics[gameplayStat] = gameStatistics[gameplayStat] & 0xFFFF00FF;
+				gameStatistics[gameplayStat] |= (trolls << 8);
+			}
+			else if ( changeval == AchievementObserver::FORUM_TROLL_FEAR )
+			{
+				int fears = (gameStatistics[gameplayStat] >> 16) & 0xFF;
+				fears = std::min(fears + 1, 3);
+				gameStatistics[gameplayStat] = gameStatistics[gameplayStat] & 0xFF00FFFF;
+				gameStatistics[gameplayStat] |= (fears << 16);
 			}
 		}
-		SaveGameInfo savegameinfo;
-		if (loadingsavegame) {
-			savegameinfo = getSaveGameInfo(false);
-		}
-		if ( clientlsg != loadingsavegame && loadingsavegame == 0 )
-		{
-			result = MAXPLAYERS + 2;  // client shouldn't load save game
-		}
-		else if ( clientlsg == 0 && loadingsavegame != 0 )
-		{
-			result = MAXPLAYERS + 3;  // client is trying to join a save game without a save of their own
-		}
-		else if ( clientlsg != loadingsavegame )
-		{
-			result = MAXPLAYERS + 4;  // client is trying to join the game with an incompatible save
-		}
-		else if ( loadingsavegame && savegameinfo.mapseed != clientms )
+		else if ( gameplayStat == STATISTICS_POP_QUIZ_1 || gameplayStat == STATISTICS_POP_QUIZ_2 )
 		{
-			result = MAXPLAYERS + 5;  // client is trying to join the game with a slightly incompatible save (wrong level)
+			int spellID = changeval;
+			if ( spellID >= 30 )
+			{
+				spellID -= 30;
+				int shifted = (1 << spellID);
+				gameStatistics[gameplayStat] |= shifted;
+			}
+			else
+			{
+				int shifted = (1 << spellID);
+				gameStatistics[gameplayStat] |= shifted;
+			}
 		}
-		else if ( (loadingsavegame && clientlobbyKey != savegameinfo.lobbykey) )
+		else
 		{
-			result = MAXPLAYERS + 6; // lobby key not matching
+			gameStatistics[gameplayStat] += changeval;
 		}
 	}
-	outResult = result;
-	if ( result >= MAXPLAYERS )
+	else if ( !players[player]->isLocalPlayer() )
 	{
+		strcpy((char*)net_packet->data, "GPST");
+		SDLNet_Write32(gameplayStat, &net_packet->data[4]);
+		SDLNet_Write32(changeval, &net_packet->data[8]);
+		net_packet->address.host = net_clients[player - 1].host;
+		net_packet->address.port = net_clients[player - 1].port;
+		net_packet->len = 12;
+		queuePacketSafe(net_sock, -1, net_packet, player - 1);
+	}
+	//messagePlayer(clientnum, "[DEBUG]: sent: %d, %d: val %d", gameplayStat, changeval, gameStatistics[gameplayStat]);
+}
 
-		// on error, client gets a player number that is invalid (to be interpreted as an error code)
-		net_clients[MAXPLAYERS - 1].host = net_packet->address.host;
-		net_clients[MAXPLAYERS - 1].port = net_packet->address.port;
-		net_packet->address.host = net_clients[MAXPLAYERS - 1].host;
-		net_packet->address.port = net_clients[MAXPLAYERS - 1].port;
-		net_packet->len = 8;
-		memcpy(net_packet->data, "HELO", 4);
-		SDLNet_Write32(result, &net_packet->data[4]); // error code for client to interpret
-		printlog("sending error code %d to client.\n", result);
-		if ( directConnect )
-		{
-			sendPacketSafe(net_sock, -1, net_packet, 0);
-			return NET_LOBBY_JOIN_DIRECTIP_FAILURE;
-		}
-		else
-		{
-			return NET_LOBBY_JOIN_P2P_FAILURE;
-		}
+void serverUpdatePlayerConduct(int player, int conduct, int value)
+{
+	if ( player <= 0 || player >= MAXPLAYERS )
+	{
+		return;
 	}
-	else
+	if ( client_disconnected[player] || players[player]->isLocalPlayer() )
 	{
-	    const int c = result;
+		return;
+	}
+	strcpy((char*)net_packet->data, "COND");
+	SDLNet_Write16(conduct, &net_packet->data[4]);
+	SDLNet_Write16(value, &net_packet->data[6]);
+	net_packet->address.host = net_clients[player - 1].host;
+	net_packet->address.port = net_clients[player - 1].port;
+	net_packet->len = 8;
+	queuePacketSafe(net_sock, -1, net_packet, player - 1);
+}
 
-		// on success, client gets legit player number
-		client_disconnected[c] = false;
-        stringCopy(stats[c]->name, (const char*)net_packet->data + 4, sizeof(Stat::name), 32);
-		client_classes[c] = (int)SDLNet_Read32(&net_packet->data[36]);
-		stats[c]->sex = static_cast<sex_t>((int)SDLNet_Read32(&net_packet->data[40]));
-		Uint32 raceAndAppearance = (Uint32)SDLNet_Read32(&net_packet->data[44]);
-		stats[c]->appearance = (raceAndAppearance & 0xFF00) >> 8;
-		stats[c]->playerRace = (raceAndAppearance & 0xFF);
-		net_clients[c - 1].host = net_packet->address.host;
-		net_clients[c - 1].port = net_packet->address.port;
-		client_keepalive[c] = ticks;
+/*-------------------------------------------------------------------------------
 
-		printlog("client %d connected.\n", c);
+serverUpdatePlayerLVL
 
-		// send existing clients info on new client
-		for ( int x = 1; x < MAXPLAYERS; x++ )
+Updates all player current LVL for clients
+
+-------------------------------------------------------------------------------*/
+
+void serverUpdatePlayerLVL()
+{
+	int c;
+	if ( multiplayer != SERVER )
+	{
+		return;
+	}
+	for ( c = 1; c < MAXPLAYERS; c++ )
+	{
+		if ( client_disconnected[c] || players[c]->isLocalPlayer() )
 		{
-			if ( client_disconnected[x] || c == x )
+			continue;
+		}
+		strcpy((char*)net_packet->data, "UPLV");
+		Sint32 playerLevels = 0;
+		for ( int i = 0; i < MAXPLAYERS; ++i )
+		{
+			if ( stats[i] )
 			{
-				continue;
+				playerLevels |= static_cast<Uint8>(stats[i]->LVL) << (8 * i); // store uint8 in data, highest bits for player 4.
 			}
-			strcpy((char*)(&net_packet->data[0]), "JOIN");
-			net_packet->data[4] = c; // clientnum
-			net_packet->data[5] = client_classes[c]; // class
-			net_packet->data[6] = stats[c]->sex; // sex
-			net_packet->data[7] = (Uint8)stats[c]->appearance; // appearance
-			net_packet->data[8] = (Uint8)stats[c]->playerRace; // player race
-			stringCopy((char*)net_packet->data + 9, stats[c]->name, 32, sizeof(Stat::name)); // name
-			net_packet->address.host = net_clients[x - 1].host;
-			net_packet->address.port = net_clients[x - 1].port;
-			net_packet->len = 9 + 32;
-			sendPacketSafe(net_sock, -1, net_packet, x - 1);
 		}
-		char shortname[32] = { 0 };
-		strncpy(shortname, stats[c]->name, 22);
-
-		//newString(&lobbyChatboxMessages, 0xFFFFFFFF, "\n***   %s has joined the game   ***\n", shortname);
+		SDLNet_Write32(playerLevels, &net_packet->data[4]);
+		net_packet->address.host = net_clients[c - 1].host;
+		net_packet->address.port = net_clients[c - 1].port;
+		net_packet->len = 8;
+		queuePacketSafe(net_sock, -1, net_packet, c - 1);
+	}
+}
 
-		// send new client their id number + info on other clients
-		memcpy(net_packet->data, "HELO", 4);
-		SDLNet_Write32(c, &net_packet->data[4]);
-		if (loadingsavegame) {
-			constexpr int chunk_size = 6 + 32 + 6 * 10; // 6 bytes for player stats, 32 for name, 60 for equipment
-			for ( int x = 0; x < MAXPLAYERS; x++ )
-			{
-				net_packet->data[8 + x * chunk_size + 0] = client_disconnected[x]; // connectedness
-				net_packet->data[8 + x * chunk_size + 1] = lockedSlots[x]; // locked state
-				net_packet->data[8 + x * chunk_size + 2] = client_classes[x]; // class
-				net_packet->data[8 + x * chunk_size + 3] = stats[x]->sex; // sex
-				net_packet->data[8 + x * chunk_size + 4] = (Uint8)stats[x]->appearance; // appearance
-				net_packet->data[8 + x * chunk_size + 5] = (Uint8)stats[x]->playerRace; // player race
+void serverRemoveClientFollower(int player, Uint32 uidToRemove)
+{
+	if ( multiplayer != SERVER || player <= 0 )
+	{
+		return;
+	}
+	if ( client_disconnected[player] || players[player]->isLocalPlayer() )
+	{
+		return;
+	}
 
-				char shortname[32];
-				snprintf(shortname, sizeof(shortname), "%s", stats[x]->name);
-				memcpy(net_packet->data + 8 + x * chunk_size + 6, shortname, sizeof(shortname)); // name
+	strcpy((char*)net_packet->data, "LDEL");
+	SDLNet_Write32(uidToRemove, &net_packet->data[4]);
+	net_packet->address.host = net_clients[player - 1].host;
+	net_packet->address.port = net_clients[player - 1].port;
+	net_packet->len = 8;
+	queuePacketSafe(net_sock, -1, net_packet, player - 1);
+}
 
-				const Item* player_slots[] = {
-					stats[x]->helmet,
-					stats[x]->breastplate,
-					stats[x]->gloves,
-					stats[x]->shoes,
-					stats[x]->shield,
-					stats[x]->weapon,
-					stats[x]->cloak,
-					stats[x]->amulet,
-					stats[x]->ring,
-					stats[x]->mask,
-				};
-				constexpr int num_slots = sizeof(player_slots) / sizeof(player_slots[0]);
+void serverSendItemToPickupAndEquip(int player, Item* item)
+{
+	if ( multiplayer != SERVER || player <= 0 )
+	{
+		return;
+	}
+	if ( client_disconnected[player] || players[player]->isLocalPlayer() )
+	{
+		return;
+	}
 
-				for (int j = 0; j < num_slots; ++j) {
-					auto slot = player_slots[j];
-					if (slot) {
-						SDLNet_Write16((Uint16)slot->type, net_packet->data + 8 + x * chunk_size + 6 + 32 + j * 6);
-						SDLNet_Write32((Uint32)slot->appearance, net_packet->data + 8 + x * chunk_size + 6 + 32 + j * 6 + 2);
-					} else {
-						SDLNet_Write16(0xffff, net_packet->data + 8 + x * chunk_size + 6 + 32 + j * 6);
-						SDLNet_Write32(0xffffffff, net_packet->data + 8 + x * chunk_size + 6 + 32 + j * 6 + 2);
-					}
-				}
-			}
-			net_packet->len = 8 + MAXPLAYERS * chunk_size;
-		} else {
-			constexpr int chunk_size = 6 + 32; // 6 bytes for player stats, 32 for name
-			for ( int x = 0; x < MAXPLAYERS; x++ )
-			{
-				net_packet->data[8 + x * chunk_size + 0] = client_disconnected[x]; // connectedness
-				net_packet->data[8 + x * chunk_size + 1] = lockedSlots[x]; // locked state
-				net_packet->data[8 + x * chunk_size + 2] = client_classes[x]; // class
-				net_packet->data[8 + x * chunk_size + 3] = stats[x]->sex; // sex
-				net_packet->data[8 + x * chunk_size + 4] = (Uint8)stats[x]->appearance; // appearance
-				net_packet->data[8 + x * chunk_size + 5] = (Uint8)stats[x]->playerRace; // player race
+	// send the client info on the item it just picked up
+	strcpy((char*)net_packet->data, "ITEQ");
+	SDLNet_Write32((Uint32)item->type, &net_packet->data[4]);
+	SDLNet_Write32((Uint32)item->status, &net_packet->data[8]);
+	SDLNet_Write32((Uint32)item->beatitude, &net_packet->data[12]);
+	SDLNet_Write32((Uint32)item->count, &net_packet->data[16]);
+	SDLNet_Write32((Uint32)item->appearance, &net_packet->data[20]);
+	SDLNet_Write32((Uint32)item->ownerUid, &net_packet->data[24]);
+	net_packet->data[28] = item->identified;
+	net_packet->address.host = net_clients[player - 1].host;
+	net_packet->address.port = net_clients[player - 1].port;
+	net_packet->len = 29;
+	queuePacketSafe(net_sock, -1, net_packet, player - 1);
+}
 
-				char shortname[32];
-				snprintf(shortname, sizeof(shortname), "%s", stats[x]->name);
-				memcpy(net_packet->data + 8 + x * chunk_size + 6, shortname, sizeof(shortname)); // name
-			}
-			net_packet->len = 8 + MAXPLAYERS * chunk_size;
-		}
-		net_packet->address.host = net_clients[c - 1].host;
-		net_packet->address.port = net_clients[c - 1].port;
-		if ( directConnect )
-		{
-		    sendPacketSafe(net_sock, -1, net_packet, 0);
-			return NET_LOBBY_JOIN_DIRECTIP_SUCCESS;
-		}
-		else
-		{
-			return NET_LOBBY_JOIN_P2P_SUCCESS;
-		}
+void serverUpdateAllyStat(int player, Uint32 uidToUpdate, int LVL, int HP, int MAXHP, int type)
+{
+	if ( multiplayer != SERVER || player <= 0 )
+	{
+		return;
+	}
+	if ( client_disconnected[player] || players[player]->isLocalPlayer() )
+	{
+		return;
 	}
+
+	strcpy((char*)net_packet->data, "NPCI");
+	SDLNet_Write32(uidToUpdate, &net_packet->data[4]);
+	net_packet->data[8] = static_cast<Uint8>(LVL);
+	SDLNet_Write16(HP, &net_packet->data[9]);
+	SDLNet_Write16(MAXHP, &net_packet->data[11]);
+	net_packet->data[13] = static_cast<Uint8>(type);
+	net_packet->address.host = net_clients[player - 1].host;
+	net_packet->address.port = net_clients[player - 1].port;
+	net_packet->len = 14;
+	queuePacketSafe(net_sock, -1, net_packet, player - 1);
 }
 
-/*-------------------------------------------------------------------------------
+void serverUpdatePlayerSummonStrength(int player)
+{
+	if ( multiplayer != SERVER )
+	{
+		return;
+	}
+	if ( player <= 0 || player > MAXPLAYERS )
+	{
+		return;
+	}
+	if ( client_disconnected[player] || !stats[player] || players[player]->isLocalPlayer() )
+	{
+		return;
+	}
 
-	receiveEntity
+	strcpy((char*)net_packet->data, "SUMS");
+	SDLNet_Write32(stats[player]->playerSummonLVLHP, &net_packet->data[4]);
+	SDLNet_Write32(stats[player]->playerSummonSTRDEXCONINT, &net_packet->data[8]);
+	SDLNet_Write32(stats[player]->playerSummonPERCHR, &net_packet->data[12]);
+	SDLNet_Write32(stats[player]->playerSummon2LVLHP, &net_packet->data[16]);
+	SDLNet_Write32(stats[player]->playerSummon2STRDEXCONINT, &net_packet->data[20]);
+	SDLNet_Write32(stats[player]->playerSummon2PERCHR, &net_packet->data[24]);
+	net_packet->address.host = net_clients[player - 1].host;
+	net_packet->address.port = net_clients[player - 1].port;
+	net_packet->len = 28;
+	queuePacketSafe(net_sock, -1, net_packet, player - 1);
+}
 
-	receives entity data from server
+void serverUpdateAllyHP(int player, Uint32 uidToUpdate, int HP, int MAXHP, bool guarantee)
+{
+	if ( multiplayer != SERVER )
+	{
+		return;
+	}
+	if ( player <= 0 )
+	{
+		return;
+	}
+	if ( client_disconnected[player] || players[player]->isLocalPlayer() )
+	{
+		return;
+	}
 
--------------------------------------------------------------------------------*/
+	strcpy((char*)net_packet->data, "NPCU");
+	SDLNet_Write32(uidToUpdate, &net_packet->data[4]);
+	SDLNet_Write16(HP, &net_packet->data[8]);
+	SDLNet_Write16(MAXHP, &net_packet->data[10]);
+	net_packet->address.host = net_clients[player - 1].host;
+	net_packet->address.port = net_clients[player - 1].port;
+	net_packet->len = 12;
+	if ( !guarantee )
+	{
+		queuePacket(net_sock, -1, net_packet, player - 1);
+	}
+	else
+	{
+		queuePacketSafe(net_sock, -1, net_packet, player - 1);
+	}
+}
 
-Entity* receiveEntity(Entity* entity)
+void sendMinimapPing(Uint8 player, Uint8 x, Uint8 y, Uint8 pingType)
 {
-	bool newentity = false;
-	int c;
-
-	//TODO: Find out if this is needed.
-	/*bool oldeffects[NUMEFFECTS];
-	Stat* entityStats = entity->getStats();
+	if ( multiplayer == CLIENT )
+	{
+		// send to host to relay info.
+		strcpy((char*)net_packet->data, "PMAP"); 
+		net_packet->data[4] = player;
+		net_packet->data[5] = x;
+		net_packet->data[6] = y;
+		net_packet->data[7] = pingType;
 
-	for ( int i = 0; i < NUMEFFECTS; ++i )
+		net_packet->address.host = net_server.host;
+		net_packet->address.port = net_server.port;
+		net_packet->len = 8;
+		sendPacket(net_sock, -1, net_packet, 0);
+	}
+	else
 	{
-		if ( !entityStats )
-		{
-			oldeffects[i] = 0;
-		}
-		else
+		for ( int c = 0; c < MAXPLAYERS; c++ )
 		{
-			oldeffects[i] = entityStats->EFFECTS[i];
+			if ( client_disconnected[c] )
+			{
+				continue;
+			}
+			if ( players[c]->isLocalPlayer() )
+			{
+				minimapPingAdd(player, c, MinimapPing(ticks, player, x, y, false, (MinimapPing::PingType)pingType));
+				continue;
+			}
+
+			if ( multiplayer == SERVER )
+			{
+				// send to all clients.
+				strcpy((char*)net_packet->data, "PMAP");
+				net_packet->data[4] = player;
+				net_packet->data[5] = x;
+				net_packet->data[6] = y;
+				net_packet->data[7] = pingType;
+
+				net_packet->address.host = net_clients[c - 1].host;
+				net_packet->address.port = net_clients[c - 1].port;
+				net_packet->len = 8;
+				sendPacketSafe(net_sock, -1, net_packet, c - 1);
+			}
 		}
 	}
-	//Yes, it is necessary. I don't think I like this solution though, will try something else.
-	*/
+}
 
-    Sint32 oldSprite = 0;
-	if ( entity == nullptr )
-	{
-		newentity = true;
-		entity = newEntity((int)SDLNet_Read16(&net_packet->data[8]), 0, map.entities, nullptr);
-	}
-	else
+void sendAllyCommandClient(int player, Uint32 uid, int command, Uint8 x, Uint8 y, Uint32 targetUid)
+{
+	if ( multiplayer != CLIENT )
 	{
-	    oldSprite = entity->sprite;
-		entity->sprite = (int)SDLNet_Read16(&net_packet->data[8]);
+		return;
 	}
+	//messagePlayer(clientnum, "%d", targetUid);
 
-    // for certain monsters, we don't want to use certain bytes,
-    // because voxel-animated creatures (like rats and slimes)
-    // need to move vertically for their animation.
-	const auto monsterType = entity->getMonsterTypeFromSprite();
-	const bool excludeForAnimation =
-	    !newentity &&
-	    entity->behavior == &actMonster &&
-	    (monsterType == RAT || monsterType == SLIME || monsterType == SCARAB) &&
+	// send to host.
+	strcpy((char*)net_packet->data, "ALLY");
+	net_packet->data[4] = player;
+	net_packet->data[5] = command;
+	net_packet->data[6] = x;
+	net_packet->data[7] = y;
+	SDLNet_Write32(uid, &net_packet->data[8]);
+	net_packet->len = 12;
+	if ( targetUid != 0 )
+	{
+		SDLNet_Write32(targetUid, &net_packet->data[12]);
+		net_packet->len = 16;
+	}
+	net_packet->address.host = net_server.host;
+	net_packet->address.port = net_server.port;
+	sendPacket(net_sock, -1, net_packet, 0);
+}
+
+NetworkingLobbyJoinRequestResult lobbyPlayerJoinRequest(int& outResult, bool lockedSlots[4])
+{
+    printlog("processing lobby join request\n");
+
+	Uint32 result = MAXPLAYERS;
+	if ( strcmp(VERSION, (char*)net_packet->data + 48) ) // TODO this should be safer.
+	{
+		result = MAXPLAYERS + 1; // wrong version number
+	}
+	else
+	{
+		Uint32 clientms = SDLNet_Read32(&net_packet->data[57]);
+		Uint32 clientlsg = SDLNet_Read32(&net_packet->data[61]);
+		Uint32 clientlobbyKey = (net_packet->len > 65) ? SDLNet_Read32(&net_packet->data[65]) : 0;
+		if ( net_packet->data[56] == 0 )
+		{
+			// client will enter any player spot
+			for ( result = 1; result < MAXPLAYERS; result++ )
+			{
+				if ( client_disconnected[result] == true && !lockedSlots[result] )
+				{
+					break;    // no more player slots
+				}
+			}
+		}
+		else
+		{
+			// client is joining a particular player spot
+			result = net_packet->data[56];
+			if ( result >= MAXPLAYERS || !client_disconnected[result] || lockedSlots[result] )
+			{
+				result = MAXPLAYERS;  // client wants to fill a space that is already filled
+			}
+		}
+		SaveGameInfo savegameinfo;
+		if (loadingsavegame) {
+			savegameinfo = getSaveGameInfo(false);
+		}
+		if ( clientlsg != loadingsavegame && loadingsavegame == 0 )
+		{
+			result = MAXPLAYERS + 2;  // client shouldn't load save game
+		}
+		else if ( clientlsg == 0 && loadingsavegame != 0 )
+		{
+			result = MAXPLAYERS + 3;  // client is trying to join a save game without a save of their own
+		}
+		else if ( clientlsg != loadingsavegame )
+		{
+			result = MAXPLAYERS + 4;  // client is trying to join the game with an incompatible save
+		}
+		else if ( loadingsavegame && savegameinfo.mapseed != clientms )
+		{
+			result = MAXPLAYERS + 5;  // client is trying to join the game with a slightly incompatible save (wrong level)
+		}
+		else if ( (loadingsavegame && clientlobbyKey != savegameinfo.lobbykey) )
+		{
+			result = MAXPLAYERS + 6; // lobby key not matching
+		}
+	}
+	outResult = result;
+	if ( result >= MAXPLAYERS )
+	{
+
+		// on error, client gets a player number that is invalid (to be interpreted as an error code)
+		net_clients[MAXPLAYERS - 1].host = net_packet->address.host;
+		net_clients[MAXPLAYERS - 1].port = net_packet->address.port;
+		net_packet->address.host = net_clients[MAXPLAYERS - 1].host;
+		net_packet->address.port = net_clients[MAXPLAYERS - 1].port;
+		net_packet->len = 8;
+		memcpy(net_packet->data, "HELO", 4);
+		SDLNet_Write32(result, &net_packet->data[4]); // error code for client to interpret
+		printlog("sending error code %d to client.\n", result);
+		if ( directConnect )
+		{
+			sendPacketSafe(net_sock, -1, net_packet, 0);
+			return NET_LOBBY_JOIN_DIRECTIP_FAILURE;
+		}
+		else
+		{
+			return NET_LOBBY_JOIN_P2P_FAILURE;
+		}
+	}
+	else
+	{
+	    const int c = result;
+
+		// on success, client gets legit player number
+		client_disconnected[c] = false;
+        stringCopy(stats[c]->name, (const char*)net_packet->data + 4, sizeof(Stat::name), 32);
+		client_classes[c] = (int)SDLNet_Read32(&net_packet->data[36]);
+		stats[c]->sex = static_cast<sex_t>((int)SDLNet_Read32(&net_packet->data[40]));
+		Uint32 raceAndAppearance = (Uint32)SDLNet_Read32(&net_packet->data[44]);
+		stats[c]->appearance = (raceAndAppearance & 0xFF00) >> 8;
+		stats[c]->playerRace = (raceAndAppearance & 0xFF);
+		net_clients[c - 1].host = net_packet->address.host;
+		net_clients[c - 1].port = net_packet->address.port;
+		client_keepalive[c] = ticks;
+
+		printlog("client %d connected.\n", c);
+
+		// send existing clients info on new client
+		for ( int x = 1; x < MAXPLAYERS; x++ )
+		{
+			if ( client_disconnected[x] || c == x )
+			{
+				continue;
+			}
+			strcpy((char*)(&net_packet->data[0]), "JOIN");
+			net_packet->data[4] = c; // clientnum
+			net_packet->data[5] = client_classes[c]; // class
+			net_packet->data[6] = stats[c]->sex; // sex
+			net_packet->data[7] = (Uint8)stats[c]->appearance; // appearance
+			net_packet->data[8] = (Uint8)stats[c]->playerRace; // player race
+			stringCopy((char*)net_packet->data + 9, stats[c]->name, 32, sizeof(Stat::name)); // name
+			net_packet->address.host = net_clients[x - 1].host;
+			net_packet->address.port = net_clients[x - 1].port;
+			net_packet->len = 9 + 32;
+			sendPacketSafe(net_sock, -1, net_packet, x - 1);
+		}
+		char shortname[32] = { 0 };
+		strncpy(shortname, stats[c]->name, 22);
+
+		//newString(&lobbyChatboxMessages, 0xFFFFFFFF, "\n***   %s has joined the game   ***\n", shortname);
+
+		// send new client their id number + info on other clients
+		memcpy(net_packet->data, "HELO", 4);
+		SDLNet_Write32(c, &net_packet->data[4]);
+		if (loadingsavegame && HELO_SENDS_EQUIPMENT) {
+			constexpr int chunk_size = HELO_PLAYER_LEN + HELO_EQUIPMENT_LEN; // 6 bytes for player stats, 32 for name, 60 for equipment
+			for ( int x = 0; x < MAXPLAYERS; x++ )
+			{
+				net_packet->data[8 + x * chunk_size + 0] = client_disconnected[x]; // connectedness
+				net_packet->data[8 + x * chunk_size + 1] = lockedSlots[x]; // locked state
+				net_packet->data[8 + x * chunk_size + 2] = client_classes[x]; // class
+				net_packet->data[8 + x * chunk_size + 3] = stats[x]->sex; // sex
+				net_packet->data[8 + x * chunk_size + 4] = (Uint8)stats[x]->appearance; // appearance
+				net_packet->data[8 + x * chunk_size + 5] = (Uint8)stats[x]->playerRace; // player race
+
+				char shortname[32];
+				snprintf(shortname, sizeof(shortname), "%s", stats[x]->name);
+				memcpy(net_packet->data + 8 + x * chunk_size + 6, shortname, sizeof(shortname)); // name
+
+				const Item* player_slots[] = {
+					stats[x]->helmet,
+					stats[x]->breastplate,
+					stats[x]->gloves,
+					stats[x]->shoes,
+					stats[x]->shield,
+					stats[x]->weapon,
+					stats[x]->cloak,
+					stats[x]->amulet,
+					stats[x]->ring,
+					stats[x]->mask,
+				};
+				constexpr int num_slots = sizeof(player_slots) / sizeof(player_slots[0]);
+
+				for (int j = 0; j < num_slots; ++j) {
+					auto slot = player_slots[j];
+					if (slot) {
+						SDLNet_Write16((Uint16)slot->type, net_packet->data + 8 + x * chunk_size + 6 + 32 + j * 6);
+						SDLNet_Write32((Uint32)slot->appearance, net_packet->data + 8 + x * chunk_size + 6 + 32 + j * 6 + 2);
+					} else {
+						SDLNet_Write16(0xffff, net_packet->data + 8 + x * chunk_size + 6 + 32 + j * 6);
+						SDLNet_Write32(0xffffffff, net_packet->data + 8 + x * chunk_size + 6 + 32 + j * 6 + 2);
+					}
+				}
+			}
+			net_packet->len = HELO_HEADER_LEN + MAXPLAYERS * chunk_size;
+		} else {
+			constexpr int chunk_size = HELO_PLAYER_LEN; // 6 bytes for player stats, 32 for name
+			for ( int x = 0; x < MAXPLAYERS; x++ )
+			{
+				net_packet->data[8 + x * chunk_size + 0] = client_disconnected[x]; // connectedness
+				net_packet->data[8 + x * chunk_size + 1] = lockedSlots[x]; // locked state
+				net_packet->data[8 + x * chunk_size + 2] = client_classes[x]; // class
+				net_packet->data[8 + x * chunk_size + 3] = stats[x]->sex; // sex
+				net_packet->data[8 + x * chunk_size + 4] = (Uint8)stats[x]->appearance; // appearance
+				net_packet->data[8 + x * chunk_size + 5] = (Uint8)stats[x]->playerRace; // player race
+
+				char shortname[32];
+				snprintf(shortname, sizeof(shortname), "%s", stats[x]->name);
+				memcpy(net_packet->data + 8 + x * chunk_size + 6, shortname, sizeof(shortname)); // name
+			}
+			net_packet->len = HELO_HEADER_LEN + MAXPLAYERS * chunk_size;
+		}
+		net_packet->address.host = net_clients[c - 1].host;
+		net_packet->address.port = net_clients[c - 1].port;
+		SafePackets.resetPeer(c); // whoever had this slot before, sequence numbers start over
+		BulkTransfers.resetPeer(c);
+		if ( directConnect )
+		{
+		    sendPacketSafe(net_sock, -1, net_packet, 0);
+			return NET_LOBBY_JOIN_DIRECTIP_SUCCESS;
+		}
+		else
+		{
+			return NET_LOBBY_JOIN_P2P_SUCCESS;
+		}
+	}
+}
+
+/*-------------------------------------------------------------------------------
+
+	directConnectSender
+
+	returns the connected client whose address net_packet came from, or -1
+	if it matches none of them. only meaningful for direct connections, p2p
+	lobbies identify the sender by its peer id instead.
+
+-------------------------------------------------------------------------------*/
+
+int directConnectSender()
+{
+	for ( int c = 1; c < MAXPLAYERS; ++c )
+	{
+		if ( !client_disconnected[c]
+			&& net_clients[c - 1].host == net_packet->address.host
+			&& net_clients[c - 1].port == net_packet->address.port )
+		{
+			return c;
+		}
+	}
+	return -1;
+}
+
+/*-------------------------------------------------------------------------------
+
+	receiveEntity
+
+	receives entity data from server
+
+-------------------------------------------------------------------------------*/
+
+Entity* receiveEntity(Entity* entity)
+{
+	bool newentity = false;
+	int c;
+
+	//TODO: Find out if this is needed.
+	/*bool oldeffects[NUMEFFECTS];
+	Stat* entityStats = entity->getStats();
+
+	for ( int i = 0; i < NUMEFFECTS; ++i )
+	{
+		if ( !entityStats )
+		{
+			oldeffects[i] = 0;
+		}
+		else
+		{
+			oldeffects[i] = entityStats->EFFECTS[i];
+		}
+	}
+	//Yes, it is necessary. I don't think I like this solution though, will try something else.
+	*/
+
+    Sint32 oldSprite = 0;
+	if ( entity == nullptr )
+	{
+		newentity = true;
+		entity = newEntity((int)SDLNet_Read16(&net_packet->data[8]), 0, map.entities, nullptr);
+	}
+	else
+	{
+	    oldSprite = entity->sprite;
+		entity->sprite = (int)SDLNet_Read16(&net_packet->data[8]);
+	}
+
+    // for certain monsters, we don't want to use certain bytes,
+    // because voxel-animated creatures (like rats and slimes)
+    // need to move vertically for their animation.
+	const auto monsterType = entity->getMonsterTypeFromSprite();
+	const bool excludeForAnimation =
+	    !newentity &&
+	    entity->behavior == &actMonster &&
+	    (monsterType == RAT || monsterType == SLIME || monsterType == SCARAB) &&
 	    entity->skill[8]; // MONSTER_ATTACK
 
-	//if ( Entity::getMonsterTypeFromSprite(entity->sprite) == SPIDER )
-	//{
-	//	if ( arachnophobia_filter )
-	//	{
-	//		switch ( entity->sprite )
-	//		{
-	//			case 267: // spider
-	//				entity->sprite = 997; // crab
-	//				break;
-	//			case 823: // player spider
-	//				entity->sprite = 1001; // player crab
-	//				break;
-	//			case 1118: // shelob
-	//				entity->sprite = 1189; // bubbles
-	//				break;
-	//			default:
-	//				break;
-	//		}
-	//	}
-	//	else
-	//	{
-	//		switch ( entity->sprite )
-	//		{
-	//			case 997: // crab
-	//				entity->sprite = 997; // spider
-	//				break;
-	//			case 1001: // player crab
-	//				entity->sprite = 823; // player spider
-	//				break;
-	//			case 1189: // bubbles
-	//				entity->sprite = 1118; // bubbles
-	//				break;
-	//			default:
-	//				break;
-	//		}
-	//	}
-	//}
+	//if ( Entity::getMonsterTypeFromSprite(entity->sprite) == SPIDER )
+	//{
+	//	if ( arachnophobia_filter )
+	//	{
+	//		switch ( entity->sprite )
+	//		{
+	//			case 267: // spider
+	//				entity->sprite = 997; // crab
+	//				break;
+	//			case 823: // player spider
+	//				entity->sprite = 1001; // player crab
+	//				break;
+	//			case 1118: // shelob
+	//				entity->sprite = 1189; // bubbles
+	//				break;
+	//			default:
+	//				break;
+	//		}
+	//	}
+	//	else
+	//	{
+	//		switch ( entity->sprite )
+	//		{
+	//			case 997: // crab
+	//				entity->sprite = 997; // spider
+	//				break;
+	//			case 1001: // player crab
+	//				entity->sprite = 823; // player spider
+	//				break;
+	//			case 1189: // bubbles
+	//				entity->sprite = 1118; // bubbles
+	//				break;
+	//			default:
+	//				break;
+	//		}
+	//	}
+	//}
+
+	if (excludeForAnimation) {
+	    entity->sprite = oldSprite;
+	}
+
+	entity->lastupdate = ticks;
+	entity->lastupdateserver = (Uint32)SDLNet_Read32(&net_packet->data[36]);
+	entity->setUID((int)SDLNet_Read32(&net_packet->data[4])); // remember who I am
+	entity->new_x = ((Sint16)SDLNet_Read16(&net_packet->data[10])) / 32.0;
+	entity->new_y = ((Sint16)SDLNet_Read16(&net_packet->data[12])) / 32.0;
+	if (!excludeForAnimation && (newentity || monsterType != SCARAB)) {
+	    entity->new_z = ((Sint16)SDLNet_Read16(&net_packet->data[14])) / 32.0;
+	}
+	entity->sizex = (Sint8)net_packet->data[16];
+	entity->sizey = (Sint8)net_packet->data[17];
+	if (newentity || monsterType != SLIME) {
+	    entity->scalex = ((Uint8)net_packet->data[18]) / 128.f;
+	    entity->scaley = ((Uint8)net_packet->data[19]) / 128.f;
+	    entity->scalez = ((Uint8)net_packet->data[20]) / 128.f;
+	}
+	if ( newentity || entity->behavior != &actMagiclightBall )
+	{
+		entity->new_yaw = ((Sint16)SDLNet_Read16(&net_packet->data[21])) / 256.0;
+	}
+	entity->new_pitch = ((Sint16)SDLNet_Read16(&net_packet->data[23])) / 256.0;
+	entity->new_roll = ((Sint16)SDLNet_Read16(&net_packet->data[25])) / 256.0;
+	if ( newentity )
+	{
+		entity->x = entity->new_x;
+		entity->y = entity->new_y;
+		entity->z = entity->new_z;
+		entity->yaw = entity->new_yaw;
+		entity->pitch = entity->new_pitch;
+		entity->roll = entity->new_roll;
+	}
+	entity->focalx = ((Sint8)net_packet->data[27]) / 8.0;
+	entity->focaly = ((Sint8)net_packet->data[28]) / 8.0;
+	if (!excludeForAnimation) {
+	    entity->focalz = ((Sint8)net_packet->data[29]) / 8.0;
+	}
+	for (c = 0; c < 16; ++c)
+	{
+		if ( net_packet->data[34 + c / 8]&power(2, c - (c / 8) * 8) )
+		{
+			entity->flags[c] = true;
+		}
+	}
+	entity->vel_x = ((Sint16)SDLNet_Read16(&net_packet->data[40])) / 32.0;
+	entity->vel_y = ((Sint16)SDLNet_Read16(&net_packet->data[42])) / 32.0;
+	entity->vel_z = ((Sint16)SDLNet_Read16(&net_packet->data[44])) / 32.0;
+
+	return entity;
+}
+
+/*-------------------------------------------------------------------------------
+
+	clientActions
+
+	Assigns an action to a given entity based mainly on its sprite
+
+-------------------------------------------------------------------------------*/
+
+void clientActions(Entity* entity)
+{
+	int playernum;
+
+	// this code assigns behaviors based on the sprite (model) number
+	switch ( entity->sprite )
+	{
+	    case 1163:
+	    case 1164:
+	    case 1165:
+	    case 1166:
+	    case 1167:
+	    case 1168:
+	    case 1169:
+		case 1:
+			entity->behavior = &actDoorFrame;
+			break;
+		case 2:
+			entity->behavior = &actDoor;
+			break;
+		case 3:
+			entity->behavior = &actTorch;
+			entity->flags[NOUPDATE] = 1;
+			break;
+		case 160:
+		case 203:
+		case 212:
+		case 213:
+		case 214:
+		case 682:
+		case 681:
+			entity->flags[NOUPDATE] = true;
+			break;
+		case 162:
+			entity->behavior = &actCampfire;
+			entity->flags[NOUPDATE] = true;
+			break;
+		case 163:
+			entity->skill[2] = (int)SDLNet_Read32(&net_packet->data[30]);
+			entity->behavior = &actFountain;
+			break;
+		case 174:
+			if (SDLNet_Read32(&net_packet->data[30]) != 0)
+			{
+				entity->behavior = &actMagiclightBall; //TODO: Finish this here. I think this gets reassigned every time the entity is recieved? Make sure.
+			}
+			break;
+		case 185:
+			entity->behavior = &actSwitch;
+			break;
+		case 186:
+			entity->behavior = &actGate;
+			break;
+		case 216:
+			entity->behavior = &actChestLid;
+			break;
+		case 254:
+		case 255:
+		case 256:
+		case 257:
+			entity->behavior = &actPortal;
+			break;
+		case 273:
+			entity->behavior = &actMCaxe;
+			break;
+		case 278:
+		case 279:
+		case 280:
+		case 281:
+			entity->behavior = &actWinningPortal;
+			break;
+		case 282:
+			entity->behavior = &actSpearTrap;
+			break;
+		case 578:
+			entity->behavior = &actPowerCrystal;
+			break;
+		case 586:
+			entity->behavior = &actSwitchWithTimer;
+			break;
+		case 601:
+			entity->behavior = &actPedestalBase;
+			break;
+		case 602:
+		case 603:
+		case 604:
+		case 605:
+			entity->behavior = &actPedestalOrb;
+			break;
+		case 667:
+		case 668:
+			entity->behavior = &actBeartrap;
+			break;
+		case 674:
+		case 675:
+		case 676:
+		case 677:
+			entity->behavior = &actCeilingTile;
+			entity->flags[NOUPDATE] = true;
+			break;
+		case 629:
+			entity->behavior = &actColumn;
+			entity->flags[NOUPDATE] = true;
+			break;
+		case 632:
+		case 633:
+			entity->behavior = &actPistonCam;
+			entity->flags[NOUPDATE] = true;
+			break;
+		case 130:
+			entity->behavior = &actGoldBag;
+			break;
+		case Player::Ghost_t::GHOST_MODEL_P1:
+		case Player::Ghost_t::GHOST_MODEL_P2:
+		case Player::Ghost_t::GHOST_MODEL_P3:
+		case Player::Ghost_t::GHOST_MODEL_P4:
+		case Player::Ghost_t::GHOST_MODEL_PX:
+			// player ghosts
+			playernum = SDLNet_Read32(&net_packet->data[30]);
+			if ( playernum >= 0 && playernum < MAXPLAYERS )
+			{
+				if ( players[playernum] )
+				{
+					players[playernum]->ghost.my = entity;
+				}
+				entity->skill[2] = playernum;
+				entity->behavior = &actDeathGhost;
+				if ( playernum == clientnum && multiplayer == CLIENT )
+				{
+					entity->flags[UPDATENEEDED] = false;
+				}
+				else
+				{
+					entity->flags[UPDATENEEDED] = true;
+				}
+				entity->flags[PASSABLE] = true;
+				entity->flags[INVISIBLE] = true;
+				entity->flags[GENIUS] = true;
+				entity->sizex = 2;
+				entity->sizey = 2;
+			}
+			break;
+		default:
+			if ( entity->isPlayerHeadSprite() )
+			{
+				// these are all player heads
+				playernum = SDLNet_Read32(&net_packet->data[30]);
+				if ( playernum >= 0 && playernum < MAXPLAYERS )
+				{
+					if ( players[playernum] && players[playernum]->entity )
+					{
+						players[playernum]->entity = entity;
+					}
+					entity->skill[2] = playernum;
+					entity->behavior = &actPlayer;
+				}
+			}
+			break;
+	}
+
+	// if the above method failed, we check the value of skill[2] (stored in net_packet->data[30]) and assign an action based on that
+	if ( entity->behavior == NULL )
+	{
+		Sint32 c = (Sint32)SDLNet_Read32(&net_packet->data[30]);
+		if ( c < 0 )
+		{
+			switch ( c )
+			{
+				case -4:
+					entity->behavior = &actMonster;
+					break;
+				case -5:
+					entity->behavior = &actItem;
+					break;
+				case -6:
+					entity->behavior = &actGib;
+					break;
+				case -7:
+					entity->behavior = &actEmpty;
+					if ( entity->sprite == 989 ) // boulder_lava.vox
+					{
+						entity->flags[BURNABLE] = true;
+					}
+					break;
+				case -8:
+					entity->behavior = &actThrown;
+					break;
+				case -9:
+					entity->behavior = &actLiquid;
+					break;
+				case -10:
+					entity->behavior = &actMagiclightBall;
+					break;
+				case -11:
+					entity->behavior = &actMagicClient;
+					break;
+				case -12:
+					entity->behavior = &actMagicClientNoLight;
+					break;
+				case -13:
+					entity->behavior = &actParticleSapCenter;
+					break;
+				case -14:
+					entity->behavior = &actDecoyBox;
+					break;
+				case -15:
+					entity->behavior = &actBomb;
+					break;
+				case -16:
+					entity->behavior = &actBoulder;
+					break;
+				default:
+					if ( static_cast<Uint8>(c & 0xFF) == 17 )
+					{
+						entity->arrowShotByWeapon = (c >> 8) & 0xFFF;
+						int dropOffModifier = (c >> 20) & 0xF;
+						entity->arrowDropOffEquipmentModifier = dropOffModifier - 8;
+						entity->behavior = &actArrow;
+					}
+					break;
+			}
+		}
+	}
+}
+
+/*-------------------------------------------------------------------------------
+
+	clientHandlePacket
+
+	Called by clientHandleMessages. Does the actual handling of a packet.
+
+-------------------------------------------------------------------------------*/
 
-	if (excludeForAnimation) {
-	    entity->sprite = oldSprite;
+static void changeLevel() {
+	if ( net_packet->data[14] != 0 )
+	{
+		// loading a custom map name.
+		char buf[128] = "";
+		strcpy(buf, (char*)&net_packet->data[14]);
+		loadCustomNextMap = buf;
+	}
+
+	if ( MainMenu::isCutsceneActive() )
+	{
+		introstage = 1; // return to normal game functionality
+		pauseGame(1, false); // unpause game
+	}
+
+	// hack to fix these things from breaking everything...
+	for ( int i = 0; i < MAXPLAYERS; ++i )
+	{
+		players[i]->hud.arm = nullptr;
+		players[i]->hud.weapon = nullptr;
+		players[i]->hud.magicLeftHand = nullptr;
+		players[i]->hud.magicRightHand = nullptr;
+		players[i]->ghost.reset();
+		FollowerMenu[i].recentEntity = nullptr;
+		FollowerMenu[i].followerToCommand = nullptr;
+		FollowerMenu[i].entityToInteractWith = nullptr;
+		CalloutMenu[i].closeCalloutMenuGUI();
+		CalloutMenu[i].callouts.clear();
+	}
+
+	// stop all sounds
+#ifdef USE_FMOD
+	if ( sound_group )
+	{
+		sound_group->stop();
+	}
+	if ( soundAmbient_group )
+	{
+		soundAmbient_group->stop();
+	}
+	if ( soundEnvironment_group )
+	{
+		soundEnvironment_group->stop();
+	}
+	if ( soundNotification_group )
+	{
+		soundNotification_group->stop();
+	}
+#elif defined USE_OPENAL
+	if ( sound_group )
+	{
+		OPENAL_ChannelGroup_Stop(sound_group);
+	}
+	if ( soundAmbient_group )
+	{
+		OPENAL_ChannelGroup_Stop(soundAmbient_group);
+	}
+	if ( soundEnvironment_group )
+	{
+		OPENAL_ChannelGroup_Stop(soundEnvironment_group);
+	}
+#endif
+	if ( openedChest[clientnum] )
+	{
+		closeChestClientside(clientnum);
+	}
+
+	// unlock some steam achievements
+	if ( !secretlevel )
+	{
+		switch ( currentlevel )
+		{
+		case 0:
+			steamAchievement("BARONY_ACH_ENTER_THE_DUNGEON");
+			break;
+		default:
+			break;
+		}
+	}
+
+	MainMenu::destroyMainMenu();
+	movie = false;
+
+	// setup level change
+	const int newlevel = static_cast<Sint8>(net_packet->data[13]);
+	printlog("Received order to change level to %d (from %d).\n", newlevel, currentlevel);
+	currentlevel = newlevel;
+
+	if ( !secretlevel )
+	{
+		switch ( currentlevel )
+		{
+			case 5:
+				steamAchievement("BARONY_ACH_TWISTY_PASSAGES");
+				break;
+			case 10:
+				steamAchievement("BARONY_ACH_JUNGLE_FEVER");
+				break;
+			case 15:
+				steamAchievement("BARONY_ACH_SANDMAN");
+				break;
+			case 30:
+				steamAchievement("BARONY_ACH_SPELUNKY");
+				break;
+			case 35:
+				if ( ((completionTime / TICKS_PER_SECOND) / 60) <= 45 )
+				{
+					conductGameChallenges[CONDUCT_BLESSED_BOOTS_SPEED] = 1;
+				}
+				break;
+			default:
+				break;
+		}
+	}
+
+	list_FreeAll(&removedEntities);
+	for ( auto node = map.entities->first; node != nullptr; node = node->next )
+	{
+		auto entity = (Entity*)node->element;
+		auto entity2 = newEntity(entity->sprite, 1, &removedEntities, nullptr);
+		entity2->setUID(entity->getUID());
+	}
+	for ( int i = 0; i < MAXPLAYERS; ++i )
+	{
+		list_FreeAll(&stats[i]->FOLLOWERS);
+	}
+
+	// load next level
+	darkmap = false;
+	secretlevel = net_packet->data[4];
+	mapseed = SDLNet_Read32(&net_packet->data[5]);
+	numplayers = 0;
+	entity_uids = (Uint32)SDLNet_Read32(&net_packet->data[9]);
+	printlog("Received map seed: %d. Entity UID start: %d\n", mapseed, entity_uids);
+
+	for ( int i = 0; i < MAXPLAYERS; ++i )
+	{
+		minimapPings[i].clear(); // clear minimap pings
+        auto& camera = players[i]->camera();
+        camera.globalLightModifierActive = GLOBAL_LIGHT_MODIFIER_STOPPED;
+        camera.luminance = defaultLuminance;
+		players[i]->hud.followerBars.clear();
+	}
+	EnemyHPDamageBarHandler::dumpCache();
+	monsterAllyFormations.reset();
+
+	// clear follower menu entities.
+	FollowerMenu[clientnum].closeFollowerMenuGUI(true);
+	CalloutMenu[clientnum].closeCalloutMenuGUI();
+
+    // load map file
+	loading = true;
+    createLevelLoadScreen(5);
+    std::atomic_bool loading_done {false};
+    auto loading_task = Jobs.async("load level", [&loading_done](){
+	    gameplayCustomManager.readFromFile();
+        updateLoadingScreen(10);
+
+	    int checkMapHash = -1;
+	    int result = physfsLoadMapFile(currentlevel, mapseed, false, &checkMapHash);
+	    if (!verifyMapHash(map.filename, checkMapHash))
+	    {
+		    conductGameChallenges[CONDUCT_MODDED] = 1;
+			Mods::disableSteamAchievements = true;
+	    }
+        updateLoadingScreen(50);
+
+	    numplayers = 0;
+	    assignActions(&map);
+        updateLoadingScreen(55);
+
+	    generatePathMaps();
+        updateLoadingScreen(80);
+
+        node_t *node, *nextnode;
+	    for ( node = map.entities->first; node != nullptr; node = nextnode )
+	    {
+		    nextnode = node->next;
+		    Entity* entity = (Entity*)node->element;
+		    if ( entity->flags[NOUPDATE] )
+		    {
+			    list_RemoveNode(entity->mynode);    // we're anticipating this entity data from server
+		    }
+	    }
+        updateLoadingScreen(99);
+
+	    loading_done = true;
+	    return result;
+	});
+    while (!loading_done)
+    {
+	    doLoadingScreen();
+	    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    destroyLoadingScreen();
+	loading = false;
+    int result = loading_task.get();
+    
+    clearChunks();
+    createChunks();
+
+	// (special) unlock temple achievement
+	if ( secretlevel && currentlevel == 8 )
+	{
+		steamAchievement("BARONY_ACH_TRICKS_AND_TRAPS");
+	}
+
+	Player::Minimap_t::mapDetails.clear();
+
+	if ( !secretlevel )
+	{
+		messagePlayer(clientnum, MESSAGE_PROGRESSION, Language::get(710), currentlevel);
+	}
+	else
+	{
+		messagePlayer(clientnum, MESSAGE_PROGRESSION, Language::get(711), map.name);
 	}
-
-	entity->lastupdate = ticks;
-	entity->lastupdateserver = (Uint32)SDLNet_Read32(&net_packet->data[36]);
-	entity->setUID((int)SDLNet_Read32(&net_packet->data[4])); // remember who I am
-	entity->new_x = ((Sint16)SDLNet_Read16(&net_packet->data[10])) / 32.0;
-	entity->new_y = ((Sint16)SDLNet_Read16(&net_packet->data[12])) / 32.0;
-	if (!excludeForAnimation && (newentity || monsterType != SCARAB)) {
-	    entity->new_z = ((Sint16)SDLNet_Read16(&net_packet->data[14])) / 32.0;
+	if ( !secretlevel && result )
+	{
+		switch ( currentlevel )
+		{
+			case 2:
+				messagePlayer(clientnum, MESSAGE_HINT, Language::get(712));
+				Player::Minimap_t::mapDetails.push_back(std::make_pair("secret_exit_description", Language::get(712)));
+				break;
+			case 3:
+				messagePlayer(clientnum, MESSAGE_HINT, Language::get(713));
+				Player::Minimap_t::mapDetails.push_back(std::make_pair("secret_exit_description", Language::get(713)));
+				break;
+			case 7:
+				messagePlayer(clientnum, MESSAGE_HINT, Language::get(714));
+				Player::Minimap_t::mapDetails.push_back(std::make_pair("secret_exit_description", Language::get(714)));
+				break;
+			case 8:
+				messagePlayer(clientnum, MESSAGE_HINT, Language::get(715));
+				Player::Minimap_t::mapDetails.push_back(std::make_pair("secret_exit_description", Language::get(715)));
+				break;
+			case 11:
+				messagePlayer(clientnum, MESSAGE_HINT, Language::get(716));
+				Player::Minimap_t::mapDetails.push_back(std::make_pair("secret_exit_description", Language::get(716)));
+				break;
+			case 13:
+				messagePlayer(clientnum, MESSAGE_HINT, Language::get(717));
+				Player::Minimap_t::mapDetails.push_back(std::make_pair("secret_exit_description", Language::get(717)));
+				break;
+			case 16:
+				messagePlayer(clientnum, MESSAGE_HINT, Language::get(718));
+				Player::Minimap_t::mapDetails.push_back(std::make_pair("secret_exit_description", Language::get(718)));
+				break;
+			case 18:
+				messagePlayer(clientnum, MESSAGE_HINT, Language::get(719));
+				Player::Minimap_t::mapDetails.push_back(std::make_pair("secret_exit_description", Language::get(719)));
+				break;
+			default:
+				break;
+		}
 	}
-	entity->sizex = (Sint8)net_packet->data[16];
-	entity->sizey = (Sint8)net_packet->data[17];
-	if (newentity || monsterType != SLIME) {
-	    entity->scalex = ((Uint8)net_packet->data[18]) / 128.f;
-	    entity->scaley = ((Uint8)net_packet->data[19]) / 128.f;
-	    entity->scalez = ((Uint8)net_packet->data[20]) / 128.f;
+	if ( MFLAG_DISABLETELEPORT )
+	{
+		Player::Minimap_t::mapDetails.push_back(std::make_pair("map_flag_disable_teleport", Language::get(2382)));
 	}
-	if ( newentity || entity->behavior != &actMagiclightBall )
+	if ( MFLAG_DISABLEOPENING )
 	{
-		entity->new_yaw = ((Sint16)SDLNet_Read16(&net_packet->data[21])) / 256.0;
+		Player::Minimap_t::mapDetails.push_back(std::make_pair("map_flag_disable_opening", Language::get(2382)));
 	}
-	entity->new_pitch = ((Sint16)SDLNet_Read16(&net_packet->data[23])) / 256.0;
-	entity->new_roll = ((Sint16)SDLNet_Read16(&net_packet->data[25])) / 256.0;
-	if ( newentity )
+	if ( MFLAG_DISABLETELEPORT || MFLAG_DISABLEOPENING )
 	{
-		entity->x = entity->new_x;
-		entity->y = entity->new_y;
-		entity->z = entity->new_z;
-		entity->yaw = entity->new_yaw;
-		entity->pitch = entity->new_pitch;
-		entity->roll = entity->new_roll;
+		messagePlayer(clientnum, MESSAGE_HINT, Language::get(2382));
 	}
-	entity->focalx = ((Sint8)net_packet->data[27]) / 8.0;
-	entity->focaly = ((Sint8)net_packet->data[28]) / 8.0;
-	if (!excludeForAnimation) {
-	    entity->focalz = ((Sint8)net_packet->data[29]) / 8.0;
+	if ( MFLAG_DISABLELEVITATION )
+	{
+		messagePlayer(clientnum, MESSAGE_HINT, Language::get(2383));
+		Player::Minimap_t::mapDetails.push_back(std::make_pair("map_flag_disable_levitation", Language::get(2383)));
 	}
-	for (c = 0; c < 16; ++c)
+	if ( MFLAG_DISABLEDIGGING )
 	{
-		if ( net_packet->data[34 + c / 8]&power(2, c - (c / 8) * 8) )
-		{
-			entity->flags[c] = true;
-		}
+		messagePlayer(clientnum, MESSAGE_HINT, Language::get(2450));
+		Player::Minimap_t::mapDetails.push_back(std::make_pair("map_flag_disable_digging", Language::get(2450)));
+	}
+	if ( MFLAG_DISABLEHUNGER )
+	{
+		Player::Minimap_t::mapDetails.push_back(std::make_pair("map_flag_disable_hunger", ""));
 	}
-	entity->vel_x = ((Sint16)SDLNet_Read16(&net_packet->data[40])) / 32.0;
-	entity->vel_y = ((Sint16)SDLNet_Read16(&net_packet->data[42])) / 32.0;
-	entity->vel_z = ((Sint16)SDLNet_Read16(&net_packet->data[44])) / 32.0;
 
-	return entity;
+	if ( gameModeManager.allowsSaves() )
+	{
+		saveGame();
+	}
+#ifdef LOCAL_ACHIEVEMENTS
+	LocalAchievements_t::writeToFile();
+#endif
+	printlog("Done.\n");
+
+	if ( !strncmp(map.name, "Mages Guild", 11) )
+	{
+		messagePlayer(clientnum, MESSAGE_HINT, Language::get(2599));
+	}
+	fadeout = false;
+	fadealpha = 255;
 }
 
 /*-------------------------------------------------------------------------------
 
-	clientActions
+	clientHandleEntityUpdate
 
-	Assigns an action to a given entity based mainly on its sprite
+	applies the ENTU packet in net_packet, creating the entity if it's new
 
 -------------------------------------------------------------------------------*/
 
-void clientActions(Entity* entity)
+static void clientHandleEntityUpdate()
 {
-	int playernum;
+	client_keepalive[0] = ticks; // don't timeout
+	Entity *entity = uidToEntity((int)SDLNet_Read32(&net_packet->data[4]));
+	if ( entity )
+	{
+		if ( (Uint32)SDLNet_Read32(&net_packet->data[36]) < (Uint32)entity->lastupdateserver )
+		{
+			// old packet, not used
+		}
+		else if ( entity->behavior == &actPlayer && entity->skill[2] == clientnum )
+		{
+			// don't update my player
+		}
+		else if ( entity->behavior == &actDeathGhost && entity->skill[2] == clientnum )
+		{
+			// don't update my ghost
+		}
+		else if ( entity->flags[NOUPDATE] )
+		{
+			// inform the server that it tried to update a no-update entity
+			strcpy((char*)net_packet->data, "NOUP");
+			net_packet->data[4] = clientnum;
+			SDLNet_Write32(entity->getUID(), &net_packet->data[5]);
+			net_packet->address.host = net_server.host;
+			net_packet->address.port = net_server.port;
+			net_packet->len = 9;
+			sendPacket(net_sock, -1, net_packet, 0);
+		}
+		else
+		{
+			// receive the entity
+			receiveEntity(entity);
+			entity->behavior = NULL;
+			clientActions(entity);
+			EntityInterp.receive(*entity);
+		}
+		return;
+	}
 
-	// this code assigns behaviors based on the sprite (model) number
-	switch ( entity->sprite )
+	for ( auto node = removedEntities.first; node != NULL; node = node->next )
 	{
-	    case 1163:
-	    case 1164:
-	    case 1165:
-	    case 1166:
-	    case 1167:
-	    case 1168:
-	    case 1169:
-		case 1:
-			entity->behavior = &actDoorFrame;
-			break;
-		case 2:
-			entity->behavior = &actDoor;
-			break;
-		case 3:
-			entity->behavior = &actTorch;
-			entity->flags[NOUPDATE] = 1;
-			break;
-		case 160:
-		case 203:
-		case 212:
-		case 213:
-		case 214:
-		case 682:
-		case 681:
-			entity->flags[NOUPDATE] = true;
-			break;
-		case 162:
-			entity->behavior = &actCampfire;
-			entity->flags[NOUPDATE] = true;
-			break;
-		case 163:
-			entity->skill[2] = (int)SDLNet_Read32(&net_packet->data[30]);
-			entity->behavior = &actFountain;
-			break;
-		case 174:
-			if (SDLNet_Read32(&net_packet->data[30]) != 0)
-			{
-				entity->behavior = &actMagiclightBall; //TODO: Finish this here. I think this gets reassigned every time the entity is recieved? Make sure.
-			}
-			break;
-		case 185:
-			entity->behavior = &actSwitch;
-			break;
-		case 186:
-			entity->behavior = &actGate;
-			break;
-		case 216:
-			entity->behavior = &actChestLid;
-			break;
-		case 254:
-		case 255:
-		case 256:
-		case 257:
-			entity->behavior = &actPortal;
-			break;
-		case 273:
-			entity->behavior = &actMCaxe;
-			break;
-		case 278:
-		case 279:
-		case 280:
-		case 281:
-			entity->behavior = &actWinningPortal;
-			break;
-		case 282:
-			entity->behavior = &actSpearTrap;
-			break;
-		case 578:
-			entity->behavior = &actPowerCrystal;
-			break;
-		case 586:
-			entity->behavior = &actSwitchWithTimer;
-			break;
-		case 601:
-			entity->behavior = &actPedestalBase;
-			break;
-		case 602:
-		case 603:
-		case 604:
-		case 605:
-			entity->behavior = &actPedestalOrb;
-			break;
-		case 667:
-		case 668:
-			entity->behavior = &actBeartrap;
-			break;
-		case 674:
-		case 675:
-		case 676:
-		case 677:
-			entity->behavior = &actCeilingTile;
-			entity->flags[NOUPDATE] = true;
-			break;
-		case 629:
-			entity->behavior = &actColumn;
-			entity->flags[NOUPDATE] = true;
-			break;
-		case 632:
-		case 633:
-			entity->behavior = &actPistonCam;
-			entity->flags[NOUPDATE] = true;
-			break;
-		case 130:
-			entity->behavior = &actGoldBag;
-			break;
-		case Player::Ghost_t::GHOST_MODEL_P1:
-		case Player::Ghost_t::GHOST_MODEL_P2:
-		case Player::Ghost_t::GHOST_MODEL_P3:
-		case Player::Ghost_t::GHOST_MODEL_P4:
-		case Player::Ghost_t::GHOST_MODEL_PX:
-			// player ghosts
-			playernum = SDLNet_Read32(&net_packet->data[30]);
-			if ( playernum >= 0 && playernum < MAXPLAYERS )
+		auto entity2 = (Entity*)node->element;
+		if ( entity2->getUID() == (int)SDLNet_Read32(&net_packet->data[4]) )
+		{
+			return;
+		}
+	}
+
+	entity = receiveEntity(NULL);
+	// IMPORTANT! Assign actions to the objects the client has control over
+	clientActions(entity);
+	EntityInterp.receive(*entity);
+}
+
+/*-------------------------------------------------------------------------------
+
+	EntitySnapshotStream
+
+	SNAP packet layout:
+	[0][1][2][3]: "SNAP"
+	[4][5][6][7]: sequence number, per client
+	[8][9][10][11]: server ticks, stands in for ENTU's [36]
+	[12]: number of entities
+	then per entity: uid (4 bytes), field mask (2 bytes), and for each set
+	bit the matching byte range of the entity's ENTU packet, in order.
+
+	SNPA packet layout (client -> server):
+	[4]: client number
+	[5][6][7][8]: newest SNAP sequence applied
+	[9]..[16]: bit n set = sequence (newest - n - 1) arrived too
+	[17]: number of uids to resend in full, then that many uids (4 bytes).
+	a client asks for this when it gets a partial update for an entity it
+	doesn't have, since acking the packet alone would tell the server those
+	fields arrived.
+
+	Fields are sent as the same quantized bytes ENTU uses, not as arithmetic
+	deltas: a client may hold newer unacked values than the server's
+	baseline, so only absolute values are safe to apply.
+
+-------------------------------------------------------------------------------*/
+
+EntitySnapshotStream EntitySnapshots;
+
+static ConsoleVariable<bool> cvar_net_entity_snapshots("/net_entity_snapshots", true);
+
+static const struct
+{
+	Uint8 offset;
+	Uint8 len;
+} snapshotFields[EntitySnapshotStream::NUM_FIELDS] = {
+	{ 8, 2 }, // sprite
+	{ 10, 2 }, // x
+	{ 12, 2 }, // y
+	{ 14, 2 }, // z
+	{ 16, 2 }, // size
+	{ 18, 3 }, // scale
+	{ 21, 2 }, // yaw
+	{ 23, 2 }, // pitch
+	{ 25, 2 }, // roll
+	{ 27, 3 }, // focal
+	{ 30, 4 }, // skill[2]
+	{ 34, 2 }, // flags
+	{ 40, 6 }, // velocity
+};
+static const int SNAPSHOT_HEADER_LEN = 13;
+static const int SNAPSHOT_RECORD_HEADER_LEN = 6;
+
+static int snapshotFieldsLength(Uint16 fields)
+{
+	int len = 0;
+	for ( int f = 0; f < EntitySnapshotStream::NUM_FIELDS; ++f )
+	{
+		if ( fields & (1 << f) )
+		{
+			len += snapshotFields[f].len;
+		}
+	}
+	return len;
+}
+
+static Uint16 snapshotFieldsChanged(const Uint8* a, const Uint8* b)
+{
+	Uint16 fields = 0;
+	for ( int f = 0; f < EntitySnapshotStream::NUM_FIELDS; ++f )
+	{
+		if ( memcmp(a + snapshotFields[f].offset, b + snapshotFields[f].offset, snapshotFields[f].len) )
+		{
+			fields |= 1 << f;
+		}
+	}
+	return fields;
+}
+
+// copies the given fields between ENTU images
+static void snapshotFieldsCopy(Uint8* dest, const Uint8* src, Uint16 fields)
+{
+	for ( int f = 0; f < EntitySnapshotStream::NUM_FIELDS; ++f )
+	{
+		if ( fields & (1 << f) )
+		{
+			memcpy(dest + snapshotFields[f].offset, src + snapshotFields[f].offset, snapshotFields[f].len);
+		}
+	}
+}
+
+static ConsoleVariable<float> cvar_net_interest_range("/net_interest_range", 24.f); // tiles
+static ConsoleVariable<int> cvar_net_entity_budget("/net_entity_budget", 2400); // bytes per client per round, 0 for no limit
+static const Uint32 SNAPSHOT_IRRELEVANT_REFRESH = 16; // rounds between updates of entities a client doesn't need
+
+// true if no wall stands between the two points, checked every half tile
+static bool snapshotLineOfSight(real_t x1, real_t y1, real_t x2, real_t y2)
+{
+	const real_t dx = x2 - x1;
+	const real_t dy = y2 - y1;
+	const int steps = (int)(sqrt(dx * dx + dy * dy) / 8.0);
+	for ( int i = 1; i < steps; ++i )
+	{
+		const int x = (int)floor((x1 + dx * i / steps) / 16.0);
+		const int y = (int)floor((y1 + dy * i / steps) / 16.0);
+		if ( x < 0 || y < 0 || x >= (int)map.width || y >= (int)map.height )
+		{
+			return false;
+		}
+		if ( map.tiles[OBSTACLELAYER + y * MAPLAYERS + x * MAPLAYERS * map.height] )
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+// how much an entity matters to clients regardless of where they are.
+// limbs and other attachments go along with the creature they belong to
+static void snapshotClassify(Entity* entity, float& weight, int& allyOf, bool& global)
+{
+	weight = 1.f;
+	allyOf = -1;
+	global = false;
+	if ( entity->behavior == &actArrow || entity->behavior == &actMagicMissile
+		|| entity->behavior == &actThrown || entity->behavior == &actBoulder )
+	{
+		weight = 4.f;
+		return;
+	}
+	if ( entity->behavior == &actItem )
+	{
+		weight = 2.f;
+		return;
+	}
+	Entity* creature = entity;
+	if ( creature->behavior != &actMonster && creature->behavior != &actPlayer )
+	{
+		creature = entity->parent ? uidToEntity(entity->parent) : nullptr;
+		if ( !creature || (creature->behavior != &actMonster && creature->behavior != &actPlayer) )
+		{
+			return;
+		}
+	}
+	if ( creature->behavior == &actPlayer )
+	{
+		weight = 8.f;
+		global = true; // everyone's minimap shows everyone
+	}
+	else
+	{
+		weight = 4.f;
+		if ( creature->monsterAllyIndex >= 0 && creature->monsterAllyIndex < MAXPLAYERS )
+		{
+			allyOf = creature->monsterAllyIndex;
+		}
+	}
+}
+
+float EntitySnapshotStream::relevance(const Captured_t& entity, int player) const
+{
+	Entity* viewer = players[player]->entity;
+	if ( !viewer || entity.global || entity.allyOf == player )
+	{
+		// a dead player's camera can follow anyone, so they get the lot
+		return 1.f;
+	}
+	const real_t range = std::max(*cvar_net_interest_range, 1.f) * 16.0;
+	const real_t dx = entity.x - viewer->x;
+	const real_t dy = entity.y - viewer->y;
+	const real_t dist = sqrt(dx * dx + dy * dy);
+	if ( dist > range )
+	{
+		return 0.f;
+	}
+	const float nearness = 1.f - (float)(dist / range);
+	if ( dist < 32.0 || snapshotLineOfSight(viewer->x, viewer->y, entity.x, entity.y) )
+	{
+		return 1.f + nearness;
+	}
+	return 0.25f + 0.25f * nearness; // behind a wall, could step into view any time
+}
+
+void EntitySnapshotStream::reset()
+{
+	for ( int c = 0; c < MAXPLAYERS; ++c )
+	{
+		resetPeer(c);
+	}
+	images.clear();
+	receivedSeq = 0;
+	receivedBits = 0;
+	ackPending = false;
+	refreshRequests.clear();
+}
+
+void EntitySnapshotStream::resetPeer(int player)
+{
+	// the sequence number carries on, so packets from before the reset can't be mistaken for new ones
+	Peer_t& peer = peers[player];
+	peer.baselines.clear();
+	peer.priority.clear();
+	for ( auto& pending : peer.history )
+	{
+		pending.seq = 0;
+		pending.entities.clear();
+	}
+	peer.lastAcked = 0;
+}
+
+void EntitySnapshotStream::flush(int player, Uint8* buf, int len)
+{
+	memcpy(net_packet->data, buf, len);
+	net_packet->address.host = net_clients[player - 1].host;
+	net_packet->address.port = net_clients[player - 1].port;
+	net_packet->len = len;
+	sendPacket(net_sock, -1, net_packet, player - 1);
+	++packetsSent;
+	bytesSent += len;
+}
+
+void EntitySnapshotStream::serverSend()
+{
+	if ( !*cvar_net_entity_snapshots )
+	{
+		// old behaviour: one ENTU per entity per client
+		const Uint32 refresh = ticks % (TICKS_PER_SECOND * 4);
+		for ( node_t* node = map.entities->first; node != nullptr; node = node->next )
+		{
+			Entity* entity = (Entity*)node->element;
+			if ( entity->flags[UPDATENEEDED] == false || entity->flags[NOUPDATE] == true )
 			{
-				if ( players[playernum] )
-				{
-					players[playernum]->ghost.my = entity;
-				}
-				entity->skill[2] = playernum;
-				entity->behavior = &actDeathGhost;
-				if ( playernum == clientnum && multiplayer == CLIENT )
-				{
-					entity->flags[UPDATENEEDED] = false;
-				}
-				else
-				{
-					entity->flags[UPDATENEEDED] = true;
-				}
-				entity->flags[PASSABLE] = true;
-				entity->flags[INVISIBLE] = true;
-				entity->flags[GENIUS] = true;
-				entity->sizex = 2;
-				entity->sizey = 2;
+				continue;
 			}
-			break;
-		default:
-			if ( entity->isPlayerHeadSprite() )
+			for ( int c = 1; c < MAXPLAYERS; ++c )
 			{
-				// these are all player heads
-				playernum = SDLNet_Read32(&net_packet->data[30]);
-				if ( playernum >= 0 && playernum < MAXPLAYERS )
+				if ( !client_disconnected[c] )
 				{
-					if ( players[playernum] && players[playernum]->entity )
-					{
-						players[playernum]->entity = entity;
-					}
-					entity->skill[2] = playernum;
-					entity->behavior = &actPlayer;
+					sendEntityUDP(entity, c, entity->getUID() % (TICKS_PER_SECOND * 4) == refresh);
 				}
 			}
-			break;
+		}
+		return;
 	}
 
-	// if the above method failed, we check the value of skill[2] (stored in net_packet->data[30]) and assign an action based on that
-	if ( entity->behavior == NULL )
+	bool anyClients = false;
+	for ( int c = 1; c < MAXPLAYERS; ++c )
 	{
-		Sint32 c = (Sint32)SDLNet_Read32(&net_packet->data[30]);
-		if ( c < 0 )
+		if ( client_disconnected[c] || players[c]->isLocalPlayer() )
 		{
-			switch ( c )
+			if ( !peers[c].baselines.empty() )
 			{
-				case -4:
-					entity->behavior = &actMonster;
-					break;
-				case -5:
-					entity->behavior = &actItem;
-					break;
-				case -6:
-					entity->behavior = &actGib;
-					break;
-				case -7:
-					entity->behavior = &actEmpty;
-					if ( entity->sprite == 989 ) // boulder_lava.vox
-					{
-						entity->flags[BURNABLE] = true;
-					}
-					break;
-				case -8:
-					entity->behavior = &actThrown;
-					break;
-				case -9:
-					entity->behavior = &actLiquid;
-					break;
-				case -10:
-					entity->behavior = &actMagiclightBall;
-					break;
-				case -11:
-					entity->behavior = &actMagicClient;
-					break;
-				case -12:
-					entity->behavior = &actMagicClientNoLight;
-					break;
-				case -13:
-					entity->behavior = &actParticleSapCenter;
-					break;
-				case -14:
-					entity->behavior = &actDecoyBox;
-					break;
-				case -15:
-					entity->behavior = &actBomb;
-					break;
-				case -16:
-					entity->behavior = &actBoulder;
-					break;
-				default:
-					if ( static_cast<Uint8>(c & 0xFF) == 17 )
-					{
-						entity->arrowShotByWeapon = (c >> 8) & 0xFFF;
-						int dropOffModifier = (c >> 20) & 0xF;
-						entity->arrowDropOffEquipmentModifier = dropOffModifier - 8;
-						entity->behavior = &actArrow;
-					}
-					break;
+				resetPeer(c);
 			}
+			continue;
 		}
+		anyClients = true;
 	}
-}
+	if ( !anyClients )
+	{
+		return;
+	}
+	++rounds;
 
-/*-------------------------------------------------------------------------------
+	// pack every entity once, whoever it goes to
+	captured.clear();
+	for ( node_t* node = map.entities->first; node != nullptr; node = node->next )
+	{
+		Entity* entity = (Entity*)node->element;
+		if ( entity->flags[UPDATENEEDED] == false || entity->flags[NOUPDATE] == true )
+		{
+			continue;
+		}
+		captured.emplace_back();
+		Captured_t& capture = captured.back();
+		capture.uid = entity->getUID();
+		packEntityUpdate(entity, capture.image.data);
+		snapshotClassify(entity, capture.weight, capture.allyOf, capture.global);
+		capture.x = entity->x;
+		capture.y = entity->y;
+		if ( entity->clientsHaveItsStats )
+		{
+			entity->serverUpdateEffectsForEntity(false);
+		}
+	}
 
-	clientHandlePacket
+	const int budget = std::max(*cvar_net_entity_budget, 0);
+	Uint8 buf[NET_PACKET_SIZE];
+	for ( int c = 1; c < MAXPLAYERS; ++c )
+	{
+		if ( client_disconnected[c] || players[c]->isLocalPlayer() )
+		{
+			continue;
+		}
+		Peer_t& peer = peers[c];
 
-	Called by clientHandleMessages. Does the actual handling of a packet.
+		// pick out what this client needs, and how badly
+		candidates.clear();
+		for ( int i = 0; i < (int)captured.size(); ++i )
+		{
+			const Captured_t& capture = captured[i];
+			const Uint32 uid = capture.uid;
 
--------------------------------------------------------------------------------*/
+			// everything the client hasn't acked, plus a full refresh every 32 rounds
+			// in case the client dropped the entity on its own
+			Uint16 fields = FIELDS_ALL;
+			auto find = peer.baselines.find(uid);
+			if ( find != peer.baselines.end() && (uid + rounds) % 32 != 0 )
+			{
+				const Baseline_t& baseline = find->second;
+				fields = (snapshotFieldsChanged(baseline.acked.data, capture.image.data) | ~baseline.known) & FIELDS_ALL;
+			}
+			if ( !fields )
+			{
+				++recordsSkipped;
+				peer.priority.erase(uid);
+				continue;
+			}
 
-static void changeLevel() {
-	if ( net_packet->data[14] != 0 )
-	{
-		// loading a custom map name.
-		char buf[128] = "";
-		strcpy(buf, (char*)&net_packet->data[14]);
-		loadCustomNextMap = buf;
-	}
+			float score = relevance(capture, c);
+			if ( score <= 0.f )
+			{
+				if ( (uid + rounds) % SNAPSHOT_IRRELEVANT_REFRESH != 0 )
+				{
+					++recordsCulled;
+					continue;
+				}
+				score = 0.1f;
+			}
+			float& priority = peer.priority[uid];
+			priority += score * capture.weight;
+			candidates.push_back(Candidate_t{ i, fields, priority });
+		}
+		if ( budget > 0 )
+		{
+			std::sort(candidates.begin(), candidates.end(), [](const Candidate_t& a, const Candidate_t& b) {
+				return a.priority > b.priority;
+			});
+		}
 
-	if ( MainMenu::isCutsceneActive() )
-	{
-		introstage = 1; // return to normal game functionality
-		pauseGame(1, false); // unpause game
+		Pending_t* pending = nullptr;
+		int len = 0;
+		int count = 0;
+		int spent = 0;
+		for ( auto& candidate : candidates )
+		{
+			const Captured_t& capture = captured[candidate.index];
+			const Uint32 uid = capture.uid;
+			const Uint16 fields = candidate.fields;
+
+			const int recordLen = SNAPSHOT_RECORD_HEADER_LEN + snapshotFieldsLength(fields);
+			if ( budget > 0 && spent > 0 && spent + recordLen > budget )
+			{
+				// its score keeps growing, so it'll be near the front next round
+				++recordsDeferred;
+				continue;
+			}
+			spent += recordLen;
+			peer.priority.erase(uid);
+
+			if ( pending && (len + recordLen > NET_PACKET_SIZE || count == 255) )
+			{
+				buf[12] = count;
+				flush(c, buf, len);
+				pending = nullptr;
+			}
+			if ( !pending )
+			{
+				++peer.seq;
+				pending = &peer.history[peer.seq % HISTORY];
+				pending->seq = peer.seq;
+				pending->acked = false;
+				pending->entities.clear();
+				memcpy(buf, "SNAP", 4);
+				SDLNet_Write32(peer.seq, &buf[4]);
+				SDLNet_Write32((Uint32)ticks, &buf[8]);
+				len = SNAPSHOT_HEADER_LEN;
+				count = 0;
+			}
+
+			SDLNet_Write32(uid, &buf[len]);
+			SDLNet_Write16(fields, &buf[len + 4]);
+			len += SNAPSHOT_RECORD_HEADER_LEN;
+			for ( int f = 0; f < NUM_FIELDS; ++f )
+			{
+				if ( fields & (1 << f) )
+				{
+					memcpy(&buf[len], &capture.image.data[snapshotFields[f].offset], snapshotFields[f].len);
+					len += snapshotFields[f].len;
+				}
+			}
+			++count;
+			++recordsSent;
+			pending->entities.push_back(Sent_t{ uid, fields, capture.image });
+		}
+		if ( pending )
+		{
+			buf[12] = count;
+			flush(c, buf, len);
+		}
+
+		// forget entities that no longer exist
+		if ( rounds % 64 == 0 )
+		{
+			for ( auto it = peer.baselines.begin(); it != peer.baselines.end(); )
+			{
+				if ( !uidToEntity(it->first) )
+				{
+					it = peer.baselines.erase(it);
+				}
+				else
+				{
+					++it;
+				}
+			}
+			for ( auto it = peer.priority.begin(); it != peer.priority.end(); )
+			{
+				if ( !uidToEntity(it->first) )
+				{
+					it = peer.priority.erase(it);
+				}
+				else
+				{
+					++it;
+				}
+			}
+		}
 	}
+}
 
-	// hack to fix these things from breaking everything...
-	for ( int i = 0; i < MAXPLAYERS; ++i )
+void EntitySnapshotStream::applyAck(Peer_t& peer, Uint32 seq)
+{
+	if ( seq == 0 || seq <= peer.lastAcked )
 	{
-		players[i]->hud.arm = nullptr;
-		players[i]->hud.weapon = nullptr;
-		players[i]->hud.magicLeftHand = nullptr;
-		players[i]->hud.magicRightHand = nullptr;
-		players[i]->ghost.reset();
-		FollowerMenu[i].recentEntity = nullptr;
-		FollowerMenu[i].followerToCommand = nullptr;
-		FollowerMenu[i].entityToInteractWith = nullptr;
-		CalloutMenu[i].closeCalloutMenuGUI();
-		CalloutMenu[i].callouts.clear();
+		// acks only move forward, or an old packet could overwrite newer fields
+		return;
 	}
-
-	// stop all sounds
-#ifdef USE_FMOD
-	if ( sound_group )
+	Pending_t& pending = peer.history[seq % HISTORY];
+	if ( pending.seq != seq || pending.acked )
 	{
-		sound_group->stop();
+		return;
 	}
-	if ( soundAmbient_group )
+	pending.acked = true;
+	peer.lastAcked = seq;
+	for ( auto& sent : pending.entities )
 	{
-		soundAmbient_group->stop();
+		Baseline_t& baseline = peer.baselines[sent.uid];
+		snapshotFieldsCopy(baseline.acked.data, sent.image.data, sent.fields);
+		baseline.known |= sent.fields;
 	}
-	if ( soundEnvironment_group )
+}
+
+void EntitySnapshotStream::serverReceiveAck(PacketReader& packet)
+{
+	const int player = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+	const Uint32 latest = packet.read32();
+	const Uint64 high = packet.read32();
+	const Uint64 bits = (high << 32) | packet.read32();
+	if ( player <= 0 || !packet.ok() )
 	{
-		soundEnvironment_group->stop();
+		return;
 	}
-	if ( soundNotification_group )
+
+	// oldest first
+	Peer_t& peer = peers[player];
+	for ( int n = ACK_BITS - 1; n >= 0; --n )
 	{
-		soundNotification_group->stop();
+		if ( (bits & ((Uint64)1 << n)) && latest > (Uint32)n + 1 )
+		{
+			applyAck(peer, latest - n - 1);
+		}
 	}
-#elif defined USE_OPENAL
-	if ( sound_group )
+	applyAck(peer, latest);
+
+	// forgetting the baseline makes the next update for each of these a full one.
+	// after the acks, so one in this packet can't bring partial fields back
+	const int refreshes = packet.remaining() > 0 ? std::min((int)packet.read8(), MAX_REFRESH_REQUESTS) : 0;
+	for ( int i = 0; i < refreshes; ++i )
 	{
-		OPENAL_ChannelGroup_Stop(sound_group);
+		const Uint32 uid = packet.read32();
+		if ( !packet.ok() )
+		{
+			break;
+		}
+		peer.baselines.erase(uid);
 	}
-	if ( soundAmbient_group )
+}
+
+void EntitySnapshotStream::clientReceive(PacketReader& packet)
+{
+	client_keepalive[0] = ticks; // don't timeout
+
+	// the ENTU handler reuses net_packet, so work from a copy
+	Uint8 buf[NET_PACKET_SIZE];
+	const int len = std::min(packet.size(), NET_PACKET_SIZE);
+	if ( len < SNAPSHOT_HEADER_LEN )
 	{
-		OPENAL_ChannelGroup_Stop(soundAmbient_group);
+		return;
 	}
-	if ( soundEnvironment_group )
+	memcpy(buf, packet.data(), len);
+	PacketReader snapshot(buf, len);
+	snapshot.seek(4);
+
+	const Uint32 seq = snapshot.read32();
+	if ( seq <= receivedSeq )
 	{
-		OPENAL_ChannelGroup_Stop(soundEnvironment_group);
+		// late or duplicate. not acking it means the server sends its fields again
+		return;
 	}
-#endif
-	if ( openedChest[clientnum] )
+	const Uint32 shift = seq - receivedSeq;
+	receivedBits = shift >= ACK_BITS ? 0 : (receivedBits << shift);
+	if ( receivedSeq && shift <= ACK_BITS )
 	{
-		closeChestClientside(clientnum);
+		receivedBits |= (Uint64)1 << (shift - 1);
 	}
+	receivedSeq = seq;
+	ackPending = true;
 
-	// unlock some steam achievements
-	if ( !secretlevel )
+	const Uint32 serverTicks = snapshot.read32();
+	const int count = snapshot.read8();
+	for ( int i = 0; i < count; ++i )
 	{
-		switch ( currentlevel )
+		const Uint32 uid = snapshot.read32();
+		const Uint16 fields = snapshot.read16() & FIELDS_ALL;
+		const int fieldsLen = snapshotFieldsLength(fields);
+		if ( !snapshot.ok() || fieldsLen > snapshot.remaining() )
 		{
-		case 0:
-			steamAchievement("BARONY_ACH_ENTER_THE_DUNGEON");
-			break;
-		default:
 			break;
 		}
-	}
-
-	MainMenu::destroyMainMenu();
-	movie = false;
 
-	// setup level change
-	const int newlevel = static_cast<Sint8>(net_packet->data[13]);
-	printlog("Received order to change level to %d (from %d).\n", newlevel, currentlevel);
-	currentlevel = newlevel;
-
-	if ( !secretlevel )
-	{
-		switch ( currentlevel )
+		auto find = images.find(uid);
+		if ( find == images.end() )
 		{
-			case 5:
-				steamAchievement("BARONY_ACH_TWISTY_PASSAGES");
-				break;
-			case 10:
-				steamAchievement("BARONY_ACH_JUNGLE_FEVER");
-				break;
-			case 15:
-				steamAchievement("BARONY_ACH_SANDMAN");
-				break;
-			case 30:
-				steamAchievement("BARONY_ACH_SPELUNKY");
-				break;
-			case 35:
-				if ( ((completionTime / TICKS_PER_SECOND) / 60) <= 45 )
+			if ( fields != FIELDS_ALL )
+			{
+				// a partial update for something we never got in full. ask for all of it with our next ack
+				snapshot.skip(fieldsLen);
+				if ( (int)refreshRequests.size() < MAX_REFRESH_REQUESTS
+					&& std::find(refreshRequests.begin(), refreshRequests.end(), uid) == refreshRequests.end() )
 				{
-					conductGameChallenges[CONDUCT_BLESSED_BOOTS_SPEED] = 1;
+					refreshRequests.push_back(uid);
 				}
-				break;
-			default:
-				break;
+				continue;
+			}
+			find = images.emplace(uid, Image_t()).first;
+		}
+		Uint8* image = find->second.data;
+		for ( int f = 0; f < NUM_FIELDS; ++f )
+		{
+			if ( fields & (1 << f) )
+			{
+				snapshot.readBytes(image + snapshotFields[f].offset, snapshotFields[f].len);
+			}
 		}
+		memcpy(image, "ENTU", 4);
+		SDLNet_Write32(uid, &image[4]);
+		SDLNet_Write32(serverTicks, &image[36]);
+
+		memcpy(net_packet->data, image, ENTITY_PACKET_LENGTH);
+		net_packet->len = ENTITY_PACKET_LENGTH;
+		clientHandleEntityUpdate();
 	}
+}
 
-	list_FreeAll(&removedEntities);
-	for ( auto node = map.entities->first; node != nullptr; node = node->next )
+void EntitySnapshotStream::clientForget(Uint32 uid)
+{
+	images.erase(uid);
+}
+
+void EntitySnapshotStream::clientSendAck()
+{
+	if ( ticks % TICKS_PER_SECOND == 0 )
 	{
-		auto entity = (Entity*)node->element;
-		auto entity2 = newEntity(entity->sprite, 1, &removedEntities, nullptr);
-		entity2->setUID(entity->getUID());
+		// forget entities that went without an ENTD, the server stops sending them anyway
+		for ( auto it = images.begin(); it != images.end(); )
+		{
+			if ( !uidToEntity(it->first) )
+			{
+				it = images.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
 	}
-	for ( int i = 0; i < MAXPLAYERS; ++i )
+	if ( !ackPending || !net_packet || !net_packet->data )
 	{
-		list_FreeAll(&stats[i]->FOLLOWERS);
+		return;
 	}
-
-	// load next level
-	darkmap = false;
-	secretlevel = net_packet->data[4];
-	mapseed = SDLNet_Read32(&net_packet->data[5]);
-	numplayers = 0;
-	entity_uids = (Uint32)SDLNet_Read32(&net_packet->data[9]);
-	printlog("Received map seed: %d. Entity UID start: %d\n", mapseed, entity_uids);
-
-	for ( int i = 0; i < MAXPLAYERS; ++i )
+	ackPending = false;
+	PacketWriter packet(net_packet);
+	packet.writeId("SNPA");
+	packet.write8(clientnum);
+	packet.write32(receivedSeq);
+	packet.write32((Uint32)(receivedBits >> 32));
+	packet.write32((Uint32)(receivedBits & 0xFFFFFFFF));
+	packet.write8((Uint8)refreshRequests.size());
+	for ( Uint32 uid : refreshRequests )
 	{
-		minimapPings[i].clear(); // clear minimap pings
-        auto& camera = players[i]->camera();
-        camera.globalLightModifierActive = GLOBAL_LIGHT_MODIFIER_STOPPED;
-        camera.luminance = defaultLuminance;
-		players[i]->hud.followerBars.clear();
+		packet.write32(uid);
 	}
-	EnemyHPDamageBarHandler::dumpCache();
-	monsterAllyFormations.reset();
-
-	// clear follower menu entities.
-	FollowerMenu[clientnum].closeFollowerMenuGUI(true);
-	CalloutMenu[clientnum].closeCalloutMenuGUI();
-
-    // load map file
-	loading = true;
-    createLevelLoadScreen(5);
-    std::atomic_bool loading_done {false};
-    auto loading_task = std::async(std::launch::async, [&loading_done](){
-	    gameplayCustomManager.readFromFile();
-        updateLoadingScreen(10);
-
-	    int checkMapHash = -1;
-	    int result = physfsLoadMapFile(currentlevel, mapseed, false, &checkMapHash);
-	    if (!verifyMapHash(map.filename, checkMapHash))
-	    {
-		    conductGameChallenges[CONDUCT_MODDED] = 1;
-			Mods::disableSteamAchievements = true;
-	    }
-        updateLoadingScreen(50);
-
-	    numplayers = 0;
-	    assignActions(&map);
-        updateLoadingScreen(55);
+	refreshRequests.clear();
+	packet.finish(net_packet);
+	net_packet->address.host = net_server.host;
+	net_packet->address.port = net_server.port;
+	sendPacket(net_sock, -1, net_packet, 0);
+}
 
-	    generatePathMaps();
-        updateLoadingScreen(80);
+static ConsoleCommand ccmd_net_snapshot_stats("/net_snapshot_stats", "print entity snapshot counters since last asked",
+	[](int argc, const char** argv) {
+	const Uint32 updates = EntitySnapshots.recordsSent + EntitySnapshots.recordsSkipped;
+	messagePlayer(clientnum, MESSAGE_MISC, "entity snapshots: %u packets, %u bytes, %u entity records (%u unchanged and skipped)",
+		EntitySnapshots.packetsSent, EntitySnapshots.bytesSent, EntitySnapshots.recordsSent, EntitySnapshots.recordsSkipped);
+	messagePlayer(clientnum, MESSAGE_MISC, "as ENTU packets that would have been %u packets, %u bytes",
+		updates, updates * ENTITY_PACKET_LENGTH);
+	messagePlayer(clientnum, MESSAGE_MISC, "%u records held back by the byte budget, %u as out of range and sight",
+		EntitySnapshots.recordsDeferred, EntitySnapshots.recordsCulled);
+	EntitySnapshots.packetsSent = 0;
+	EntitySnapshots.bytesSent = 0;
+	EntitySnapshots.recordsSent = 0;
+	EntitySnapshots.recordsSkipped = 0;
+	EntitySnapshots.recordsDeferred = 0;
+	EntitySnapshots.recordsCulled = 0;
+	});
 
-        node_t *node, *nextnode;
-	    for ( node = map.entities->first; node != nullptr; node = nextnode )
-	    {
-		    nextnode = node->next;
-		    Entity* entity = (Entity*)node->element;
-		    if ( entity->flags[NOUPDATE] )
-		    {
-			    list_RemoveNode(entity->mynode);    // we're anticipating this entity data from server
-		    }
-	    }
-        updateLoadingScreen(99);
+/*-------------------------------------------------------------------------------
 
-	    loading_done = true;
-	    return result;
-	});
-    while (!loading_done)
-    {
-	    doLoadingScreen();
-	    std::this_thread::sleep_for(std::chrono::milliseconds(1));
-    }
-    destroyLoadingScreen();
-	loading = false;
-    int result = loading_task.get();
-    
-    clearChunks();
-    createChunks();
+	EntityInterpolation
 
-	// (special) unlock temple achievement
-	if ( secretlevel && currentlevel == 8 )
-	{
-		steamAchievement("BARONY_ACH_TRICKS_AND_TRAPS");
-	}
+	The server's clock is estimated from the stamps on arriving updates: the
+	largest (server ticks - local ticks) seen belongs to the quickest packet,
+	and it's allowed to creep down by a little each tick so clocks that run
+	at slightly different speeds don't drift apart. Entities are then drawn
+	at that clock minus /net_interp_delay, which should cover at least one
+	entity send interval plus jitter so there's nearly always an update on
+	either side of the moment being drawn.
 
-	Player::Minimap_t::mapDetails.clear();
+-------------------------------------------------------------------------------*/
 
-	if ( !secretlevel )
-	{
-		messagePlayer(clientnum, MESSAGE_PROGRESSION, Language::get(710), currentlevel);
-	}
-	else
-	{
-		messagePlayer(clientnum, MESSAGE_PROGRESSION, Language::get(711), map.name);
-	}
-	if ( !secretlevel && result )
-	{
-		switch ( currentlevel )
-		{
-			case 2:
-				messagePlayer(clientnum, MESSAGE_HINT, Language::get(712));
-				Player::Minimap_t::mapDetails.push_back(std::make_pair("secret_exit_description", Language::get(712)));
-				break;
-			case 3:
-				messagePlayer(clientnum, MESSAGE_HINT, Language::get(713));
-				Player::Minimap_t::mapDetails.push_back(std::make_pair("secret_exit_description", Language::get(713)));
-				break;
-			case 7:
-				messagePlayer(clientnum, MESSAGE_HINT, Language::get(714));
-				Player::Minimap_t::mapDetails.push_back(std::make_pair("secret_exit_description", Language::get(714)));
-				break;
-			case 8:
-				messagePlayer(clientnum, MESSAGE_HINT, Language::get(715));
-				Player::Minimap_t::mapDetails.push_back(std::make_pair("secret_exit_description", Language::get(715)));
-				break;
-			case 11:
-				messagePlayer(clientnum, MESSAGE_HINT, Language::get(716));
-				Player::Minimap_t::mapDetails.push_back(std::make_pair("secret_exit_description", Language::get(716)));
-				break;
-			case 13:
-				messagePlayer(clientnum, MESSAGE_HINT, Language::get(717));
-				Player::Minimap_t::mapDetails.push_back(std::make_pair("secret_exit_description", Language::get(717)));
-				break;
-			case 16:
-				messagePlayer(clientnum, MESSAGE_HINT, Language::get(718));
-				Player::Minimap_t::mapDetails.push_back(std::make_pair("secret_exit_description", Language::get(718)));
-				break;
-			case 18:
-				messagePlayer(clientnum, MESSAGE_HINT, Language::get(719));
-				Player::Minimap_t::mapDetails.push_back(std::make_pair("secret_exit_description", Language::get(719)));
-				break;
-			default:
-				break;
-		}
-	}
-	if ( MFLAG_DISABLETELEPORT )
+EntityInterpolation EntityInterp;
+
+static ConsoleVariable<bool> cvar_net_interp("/net_interp", true);
+static ConsoleVariable<int> cvar_net_interp_delay("/net_interp_delay", TICKS_PER_SECOND / 4); // ticks behind the server
+static ConsoleVariable<int> cvar_net_interp_extrapolate("/net_interp_extrapolate", TICKS_PER_SECOND / 8); // ticks to carry on past the newest update
+
+static const double INTERP_CLOCK_DRIFT = 0.02; // ticks per tick the clock estimate gives back
+
+bool EntityInterpolation::buffered(const Entity& entity)
+{
+	if ( entity.behavior == &actMonster )
 	{
-		Player::Minimap_t::mapDetails.push_back(std::make_pair("map_flag_disable_teleport", Language::get(2382)));
+		return true;
 	}
-	if ( MFLAG_DISABLEOPENING )
+	if ( entity.behavior == &actPlayer || entity.behavior == &actDeathGhost )
 	{
-		Player::Minimap_t::mapDetails.push_back(std::make_pair("map_flag_disable_opening", Language::get(2382)));
+		return entity.skill[2] != clientnum;
 	}
-	if ( MFLAG_DISABLETELEPORT || MFLAG_DISABLEOPENING )
+	return false;
+}
+
+void EntityInterpolation::receive(Entity& entity)
+{
+	if ( !*cvar_net_interp || !buffered(entity) )
 	{
-		messagePlayer(clientnum, MESSAGE_HINT, Language::get(2382));
+		buffers.erase(entity.getUID());
+		return;
 	}
-	if ( MFLAG_DISABLELEVITATION )
+
+	const Uint32 tick = entity.lastupdateserver;
+	const double offset = (double)tick - (double)ticks;
+	if ( !clockKnown || offset > clockOffset )
 	{
-		messagePlayer(clientnum, MESSAGE_HINT, Language::get(2383));
-		Player::Minimap_t::mapDetails.push_back(std::make_pair("map_flag_disable_levitation", Language::get(2383)));
+		clockOffset = offset;
+		clockKnown = true;
 	}
-	if ( MFLAG_DISABLEDIGGING )
+
+	Buffer_t& buffer = buffers[entity.getUID()];
+	buffer.lastReceived = ticks;
+	if ( buffer.count > 0 )
 	{
-		messagePlayer(clientnum, MESSAGE_HINT, Language::get(2450));
-		Player::Minimap_t::mapDetails.push_back(std::make_pair("map_flag_disable_digging", Language::get(2450)));
+		const Uint32 newest = buffer.samples[buffer.newest].tick;
+		if ( tick < newest )
+		{
+			return;
+		}
+		if ( tick > newest )
+		{
+			buffer.newest = (buffer.newest + 1) % SAMPLES;
+			buffer.count = std::min(buffer.count + 1, SAMPLES);
+		}
+		// the same tick again is a resend or an ENTU alongside a snapshot, the later one wins
 	}
-	if ( MFLAG_DISABLEHUNGER )
+	else
 	{
-		Player::Minimap_t::mapDetails.push_back(std::make_pair("map_flag_disable_hunger", ""));
+		buffer.newest = 0;
+		buffer.count = 1;
 	}
 
-	if ( gameModeManager.allowsSaves() )
-	{
-		saveGame();
-	}
-#ifdef LOCAL_ACHIEVEMENTS
-	LocalAchievements_t::writeToFile();
-#endif
-	printlog("Done.\n");
+	Sample_t& sample = buffer.samples[buffer.newest];
+	sample.tick = tick;
+	sample.x = entity.new_x;
+	sample.y = entity.new_y;
+	sample.z = entity.new_z;
+	sample.yaw = entity.new_yaw;
+	sample.vel_x = entity.vel_x;
+	sample.vel_y = entity.vel_y;
+	sample.vel_z = entity.vel_z;
+}
 
-	if ( !strncmp(map.name, "Mages Guild", 11) )
+void EntityInterpolation::update()
+{
+	if ( !clockKnown )
 	{
-		messagePlayer(clientnum, MESSAGE_HINT, Language::get(2599));
+		return;
 	}
-	fadeout = false;
-	fadealpha = 255;
-}
-
-static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
-	// keep alive
-	{'KPAL', [](){
-		client_keepalive[0] = ticks;
-	}},
+	clockOffset -= INTERP_CLOCK_DRIFT;
+	renderTick = (double)ticks + clockOffset - std::max(0, *cvar_net_interp_delay);
 
-	// entity update
-	{'ENTU', [](){
-		client_keepalive[0] = ticks; // don't timeout
-		Entity *entity = uidToEntity((int)SDLNet_Read32(&net_packet->data[4]));
-		if ( entity )
+	if ( ticks % TICKS_PER_SECOND == 0 )
+	{
+		// forget entities that have gone
+		for ( auto it = buffers.begin(); it != buffers.end(); )
 		{
-			if ( (Uint32)SDLNet_Read32(&net_packet->data[36]) < (Uint32)entity->lastupdateserver )
-			{
-				// old packet, not used
-			}
-			else if ( entity->behavior == &actPlayer && entity->skill[2] == clientnum )
-			{
-				// don't update my player
-			}
-			else if ( entity->behavior == &actDeathGhost && entity->skill[2] == clientnum )
-			{
-				// don't update my ghost
-			}
-			else if ( entity->flags[NOUPDATE] )
+			if ( !uidToEntity(it->first) )
 			{
-				// inform the server that it tried to update a no-update entity
-				strcpy((char*)net_packet->data, "NOUP");
-				net_packet->data[4] = clientnum;
-				SDLNet_Write32(entity->getUID(), &net_packet->data[5]);
-				net_packet->address.host = net_server.host;
-				net_packet->address.port = net_server.port;
-				net_packet->len = 9;
-				sendPacket(net_sock, -1, net_packet, 0);
+				it = buffers.erase(it);
 			}
 			else
 			{
-				// receive the entity
-				receiveEntity(entity);
-				entity->behavior = NULL;
-				clientActions(entity);
+				++it;
 			}
-			return;
 		}
+	}
+}
+
+bool EntityInterpolation::apply(Entity& entity)
+{
+	if ( !*cvar_net_interp || !clockKnown || !buffered(entity) )
+	{
+		return false;
+	}
+	auto find = buffers.find(entity.getUID());
+	if ( find == buffers.end() || find->second.count < 2 )
+	{
+		return false;
+	}
+	const Buffer_t& buffer = find->second;
+	const Sample_t& newest = buffer.samples[buffer.newest];
 
-		for ( auto node = removedEntities.first; node != NULL; node = node->next )
+	real_t x, y, z, yaw;
+	if ( renderTick >= newest.tick )
+	{
+		// nothing that new yet, carry on along the last velocity for a bit
+		const double extrapolate = std::max(0, *cvar_net_interp_extrapolate);
+		const double over = renderTick - newest.tick;
+		double t = over;
+		if ( over > extrapolate )
+		{
+			// still nothing, it most likely stopped where it was last seen
+			t = std::max(0.0, 2 * extrapolate - over);
+		}
+		x = newest.x;
+		y = newest.y;
+		if ( t > 0.0 )
 		{
-			auto entity2 = (Entity*)node->element;
-			if ( entity2->getUID() == (int)SDLNet_Read32(&net_packet->data[4]) )
+			clipMove(&x, &y, newest.vel_x * t, newest.vel_y * t, &entity);
+			++extrapolated;
+		}
+		else
+		{
+			++held;
+		}
+		z = newest.z;
+		yaw = newest.yaw;
+	}
+	else
+	{
+		// walk back to the pair either side of renderTick
+		int to = buffer.newest;
+		int from = to;
+		for ( int n = 1; n < buffer.count; ++n )
+		{
+			from = (buffer.newest - n + SAMPLES) % SAMPLES;
+			if ( buffer.samples[from].tick <= renderTick )
 			{
-				return;
+				break;
 			}
+			to = from;
+		}
+		const Sample_t& a = buffer.samples[from];
+		const Sample_t& b = buffer.samples[to];
+		double t = 0.0;
+		if ( b.tick > a.tick )
+		{
+			t = std::min(std::max((renderTick - a.tick) / (double)(b.tick - a.tick), 0.0), 1.0);
+		}
+		x = a.x + (b.x - a.x) * t;
+		y = a.y + (b.y - a.y) * t;
+		z = a.z + (b.z - a.z) * t;
+		double dirYaw = fmod(b.yaw - a.yaw, 2 * PI);
+		while ( dirYaw >= PI )
+		{
+			dirYaw -= PI * 2;
+		}
+		while ( dirYaw < -PI )
+		{
+			dirYaw += PI * 2;
 		}
+		yaw = a.yaw + dirYaw * t;
+		while ( yaw < 0 )
+		{
+			yaw += 2 * PI;
+		}
+		while ( yaw >= 2 * PI )
+		{
+			yaw -= 2 * PI;
+		}
+		++interpolated;
+	}
+
+	// move the bodyparts too, otherwise the limbs get left behind
+	for ( Entity* bodypart : entity.bodyparts )
+	{
+		bodypart->x += x - entity.x;
+		bodypart->y += y - entity.y;
+		bodypart->new_x += x - entity.new_x;
+		bodypart->new_y += y - entity.new_y;
+	}
+	entity.x = entity.new_x = x;
+	entity.y = entity.new_y = y;
+	entity.z = entity.new_z = z;
+	entity.yaw = entity.new_yaw = yaw;
+	return true;
+}
+
+void EntityInterpolation::reset()
+{
+	buffers.clear();
+	clockOffset = 0.0;
+	clockKnown = false;
+	renderTick = 0.0;
+}
+
+static ConsoleCommand ccmd_net_interp_stats("/net_interp_stats", "print entity interpolation counters since last asked",
+	[](int argc, const char** argv) {
+	const Uint32 total = EntityInterp.interpolated + EntityInterp.extrapolated + EntityInterp.held;
+	messagePlayer(clientnum, MESSAGE_MISC, "entity interpolation: %u entity ticks, %u between updates, %u extrapolated, %u held (%.1f%% without a newer update)",
+		total, EntityInterp.interpolated, EntityInterp.extrapolated, EntityInterp.held,
+		total ? 100.0 * (EntityInterp.extrapolated + EntityInterp.held) / total : 0.0);
+	EntityInterp.interpolated = 0;
+	EntityInterp.extrapolated = 0;
+	EntityInterp.held = 0;
+	});
+
+static std::unordered_map<Uint32, void(*)(PacketReader&)> clientPacketHandlers = {
+	// keep alive
+	{'KPAL', [](PacketReader& packet){
+		client_keepalive[0] = ticks;
+	}},
+
+	// entity update
+	{'ENTU', [](PacketReader& packet){
+		clientHandleEntityUpdate();
+	}},
+
+	// entity snapshot
+	{'SNAP', [](PacketReader& packet){
+		EntitySnapshots.clientReceive(packet);
+	}},
 
-		entity = receiveEntity(NULL);
-		// IMPORTANT! Assign actions to the objects the client has control over
-		clientActions(entity);
+	// fragment of a bulk transfer
+	{'BULK', [](PacketReader& packet){
+		BulkTransfers.receive(packet);
 	}},
     
     // raise/lower shield
-    {'SHLD', [](){
-        const int player = std::min(net_packet->data[4], (Uint8)(MAXPLAYERS - 1));
-        stats[player]->defending = net_packet->data[5];
+    {'SHLD', [](PacketReader& packet){
+        const int player = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+        const Uint8 defending = packet.read8();
+        if ( packet.ok() )
+        {
+            stats[player]->defending = defending;
+        }
     }},
 
     // sneaking
-    {'SNEK', [](){
-        const int player = std::min(net_packet->data[4], (Uint8)(MAXPLAYERS - 1));
-        stats[player]->sneaking = net_packet->data[5];
-        return;
+    {'SNEK', [](PacketReader& packet){
+        const int player = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+        const Uint8 sneaking = packet.read8();
+        if ( packet.ok() )
+        {
+            stats[player]->sneaking = sneaking;
+        }
     }},
 
 	// ghost sneaking
-	{ 'GHOD', []() {
-		const int player = std::min(net_packet->data[4], (Uint8)(MAXPLAYERS - 1));
-		if ( players[player]->ghost.my )
+	{ 'GHOD', [](PacketReader& packet) {
+		const int player = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+		const Uint8 sneaking = packet.read8();
+		if ( packet.ok() && players[player]->ghost.my )
 		{
-			players[player]->ghost.my->skill[3] = net_packet->data[5];
+			players[player]->ghost.my->skill[3] = sneaking;
 		}
 	}},
 
 	// update ghost bounce
-	{'GHFS', []() {
-		Entity* entity = uidToEntity((int)SDLNet_Read32(&net_packet->data[4]));
-		if ( entity )
+	{'GHFS', [](PacketReader& packet) {
+		Entity* entity = uidToEntity((int)packet.read32());
+		const Uint8 fskill = packet.read8();
+		const Uint16 value = packet.read16();
+		if ( entity && packet.ok() && fskill < NUMENTITYFSKILLS )
 		{
-			entity->fskill[net_packet->data[8]] = (SDLNet_Read16(&net_packet->data[9]) / 256.0);
+			entity->fskill[fskill] = (value / 256.0);
 			playSoundEntityLocal(entity, 612 + local_rng.rand() % 3, 64);
 		}
 	}},
 
-	{'EFFE', [](){
+	{'EFFE', [](PacketReader& packet){
 		/*
 		* Packet breakdown:
 		* [0][1][2][3]: "EFFE"
@@ -2443,25 +4523,29 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// update entity skill
-	{'ENTS', [](){
-		Entity *entity = uidToEntity((int)SDLNet_Read32(&net_packet->data[4]));
-		if ( entity )
+	{'ENTS', [](PacketReader& packet){
+		Entity *entity = uidToEntity((int)packet.read32());
+		const Uint8 skill = packet.read8();
+		const Sint32 value = (Sint32)packet.read32();
+		if ( entity && packet.ok() && skill < NUMENTITYSKILLS )
 		{
-			entity->skill[net_packet->data[8]] = SDLNet_Read32(&net_packet->data[9]);
+			entity->skill[skill] = value;
 		}
 	}},
 
 	// update entity fskill
-	{'ENFS', [](){
-		Entity *entity = uidToEntity((int)SDLNet_Read32(&net_packet->data[4]));
-		if ( entity )
+	{'ENFS', [](PacketReader& packet){
+		Entity *entity = uidToEntity((int)packet.read32());
+		const Uint8 fskill = packet.read8();
+		const Uint16 value = packet.read16();
+		if ( entity && packet.ok() && fskill < NUMENTITYFSKILLS )
 		{
-			entity->fskill[net_packet->data[8]] = (SDLNet_Read16(&net_packet->data[9]) / 256.0);
+			entity->fskill[fskill] = (value / 256.0);
 		}
 	}},
 
 	// update entity bodypart
-	{'ENTB', [](){
+	{'ENTB', [](PacketReader& packet){
 		Entity *entity = uidToEntity((int)SDLNet_Read32(&net_packet->data[4]));
 		if ( entity )
 		{
@@ -2477,7 +4561,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// bodypart ids
-	{'BDYI', [](){
+	{'BDYI', [](PacketReader& packet){
 		Entity *entity = uidToEntity((int)SDLNet_Read32(&net_packet->data[4]));
 		if ( entity )
 		{
@@ -2506,7 +4590,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// update entity flag
-	{'ENTF', [](){
+	{'ENTF', [](PacketReader& packet){
 		Entity *entity = uidToEntity((int)SDLNet_Read32(&net_packet->data[4]));
 		if ( entity )
 		{
@@ -2535,7 +4619,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// player movement correction
-	{'PMOV', [](){
+	{'PMOV', [](PacketReader& packet){
 		if ( players[clientnum] == nullptr || players[clientnum]->entity == nullptr )
 		{
 			return;
@@ -2545,7 +4629,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// player ghost movement correction
-	{'GMOV', []() {
+	{'GMOV', [](PacketReader& packet) {
 		if ( players[clientnum] == nullptr || players[clientnum]->ghost.my == nullptr )
 		{
 			return;
@@ -2555,7 +4639,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// update health
-	{'UPHP', [](){
+	{'UPHP', [](PacketReader& packet){
 		if ( (Monster)SDLNet_Read32(&net_packet->data[8]) != NOTHING )
 		{
 			if ( SDLNet_Read32(&net_packet->data[4]) < stats[clientnum]->HP )
@@ -2574,7 +4658,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// server sent item details.
-	{'ITMU', [](){
+	{'ITMU', [](PacketReader& packet){
 		Uint32 uid = SDLNet_Read32(&net_packet->data[4]);
 		Entity* entity = uidToEntity(uid);
 		if ( entity )
@@ -2593,7 +4677,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// ghost interact item
-	{ 'GHOI', []() {
+	{ 'GHOI', [](PacketReader& packet) {
 		Uint32 uid = SDLNet_Read32(&net_packet->data[4]);
 		Entity* entity = uidToEntity(uid);
 		if ( entity )
@@ -2613,7 +4697,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// spawn an explosion
-	{'EXPL', [](){
+	{'EXPL', [](PacketReader& packet){
 		Sint16 x = (Sint16)SDLNet_Read16(&net_packet->data[4]);
 		Sint16 y = (Sint16)SDLNet_Read16(&net_packet->data[6]);
 		Sint16 z = (Sint16)SDLNet_Read16(&net_packet->data[8]);
@@ -2621,7 +4705,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// spawn an explosion, custom sprite
-	{'EXPS', [](){
+	{'EXPS', [](PacketReader& packet){
 		Uint16 sprite = (Uint16)SDLNet_Read16(&net_packet->data[4]);
 		Sint16 x = (Sint16)SDLNet_Read16(&net_packet->data[6]);
 		Sint16 y = (Sint16)SDLNet_Read16(&net_packet->data[8]);
@@ -2630,7 +4714,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// spawn a bang sprite
-	{'BANG', [](){
+	{'BANG', [](PacketReader& packet){
 		Sint16 x = (Sint16)SDLNet_Read16(&net_packet->data[4]);
 		Sint16 y = (Sint16)SDLNet_Read16(&net_packet->data[6]);
 		Sint16 z = (Sint16)SDLNet_Read16(&net_packet->data[8]);
@@ -2638,7 +4722,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// spawn a gib
-	{'SPGB', [](){
+	{'SPGB', [](PacketReader& packet){
 		Sint16 x = (Sint16)SDLNet_Read16(&net_packet->data[4]);
 		Sint16 y = (Sint16)SDLNet_Read16(&net_packet->data[6]);
 		Sint16 z = (Sint16)SDLNet_Read16(&net_packet->data[8]);
@@ -2652,7 +4736,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// spawn a sleep Z
-	{'SLEZ', [](){
+	{'SLEZ', [](PacketReader& packet){
 		Sint16 x = (Sint16)SDLNet_Read16(&net_packet->data[4]);
 		Sint16 y = (Sint16)SDLNet_Read16(&net_packet->data[6]);
 		Sint16 z = (Sint16)SDLNet_Read16(&net_packet->data[8]);
@@ -2660,7 +4744,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// spawn a poof
-	{ 'PUFF', []() {
+	{ 'PUFF', [](PacketReader& packet) {
 		Sint16 x = (Sint16)SDLNet_Read16(&net_packet->data[4]);
 		Sint16 y = (Sint16)SDLNet_Read16(&net_packet->data[6]);
 		Sint16 z = (Sint16)SDLNet_Read16(&net_packet->data[8]);
@@ -2669,7 +4753,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// spawn a misc sprite like the sleep Z
-	{'SLEM', [](){
+	{'SLEM', [](PacketReader& packet){
 		Sint16 x = (Sint16)SDLNet_Read16(&net_packet->data[4]);
 		Sint16 y = (Sint16)SDLNet_Read16(&net_packet->data[6]);
 		Sint16 z = (Sint16)SDLNet_Read16(&net_packet->data[8]);
@@ -2678,7 +4762,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// spawn magical effect particles
-	{'MAGE', [](){
+	{'MAGE', [](PacketReader& packet){
 		Sint16 x = (Sint16)SDLNet_Read16(&net_packet->data[4]);
 		Sint16 y = (Sint16)SDLNet_Read16(&net_packet->data[6]);
 		Sint16 z = (Sint16)SDLNet_Read16(&net_packet->data[8]);
@@ -2687,7 +4771,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// spawn misc particle effect 
-	{'SPPE', [](){
+	{'SPPE', [](PacketReader& packet){
 		Entity *entity = uidToEntity((int)SDLNet_Read32(&net_packet->data[4]));
 		if ( entity )
 		{
@@ -2816,7 +4900,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// spawn misc particle effect at fixed location
-	{'SPPL', [](){
+	{'SPPL', [](PacketReader& packet){
 		Sint16 particle_x = static_cast<Sint16>(SDLNet_Read16(&net_packet->data[4]));
 		Sint16 particle_y = static_cast<Sint16>(SDLNet_Read16(&net_packet->data[6]));
 		Sint16 particle_z = static_cast<Sint16>(SDLNet_Read16(&net_packet->data[8]));
@@ -2881,7 +4965,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// enemy hp bar
-	{'ENHP', [](){
+	{'ENHP', [](PacketReader& packet){
 		Sint16 enemy_hp = SDLNet_Read16(&net_packet->data[4]);
 		Sint16 enemy_maxhp = SDLNet_Read16(&net_packet->data[6]);
 		Sint16 oldhp = SDLNet_Read16(&net_packet->data[8]);
@@ -2917,34 +5001,34 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// ping
-	{'PING', [](){
+	{'PING', [](PacketReader& packet){
 		messagePlayer(clientnum, MESSAGE_MISC, Language::get(1117), (SDL_GetTicks() - pingtime));
 	}},
 
 	// automated ping
-	{'PNGU', [](){
-		PingNetworkStatus_t::respond();
+	{'PNGU', [](PacketReader& packet){
+		PingNetworkStatus_t::respond(packet);
 	}},
 
 	// automated ping response
-	{'PNGR', [](){
-		PingNetworkStatus_t::receive();
+	{'PNGR', [](PacketReader& packet){
+		PingNetworkStatus_t::receive(packet);
 	}},
 
 	// unlock steam achievement
-	{'SACH', [](){
+	{'SACH', [](PacketReader& packet){
 		steamAchievement((char*)(&net_packet->data[4]));
 	}},
 
 	// update steam statistic
-	{'SSTA', []() {
+	{'SSTA', [](PacketReader& packet) {
 		const int statisticNum = static_cast<int>(net_packet->data[4]);
 		int value = static_cast<int>(SDLNet_Read16(&net_packet->data[6]));
 		steamStatisticUpdate(statisticNum, static_cast<ESteamStatTypes>(net_packet->data[5]), value);
 	}},
 
 	// update challenge counter
-	{ 'CHCT', []() {
+	{ 'CHCT', [](PacketReader& packet) {
 		int value = static_cast<int>(SDLNet_Read16(&net_packet->data[4]));
 		int max = static_cast<int>(SDLNet_Read16(&net_packet->data[6]));
 		const char* challengeName = "CHALLENGE_MONSTER_KILLS";
@@ -2957,21 +5041,21 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// pause game
-	{'PAUS', [](){
+	{'PAUS', [](PacketReader& packet){
 	    const int player = std::min(net_packet->data[4], (Uint8)(MAXPLAYERS - 1));
 		messagePlayer(clientnum, MESSAGE_MISC, Language::get(1118), stats[player]->name);
 		pauseGame(2, 0);
 	}},
 
 	// unpause game
-	{'UNPS', [](){
+	{'UNPS', [](PacketReader& packet){
 	    const int player = std::min(net_packet->data[4], (Uint8)(MAXPLAYERS - 1));
 		messagePlayer(clientnum, MESSAGE_MISC, Language::get(1119), stats[player]->name);
 		pauseGame(1, 0);
 	}},
 
 	// server or player shut down
-	{'DISC', [](){
+	{'DISC', [](PacketReader& packet){
 	    const int player = std::min(net_packet->data[4], (Uint8)(MAXPLAYERS - 1));
 		client_disconnected[player] = true;
 		if (player == 0)
@@ -2986,7 +5070,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// teleport player
-	{'TELE', [](){
+	{'TELE', [](PacketReader& packet){
 		if (players[clientnum] == nullptr || !Player::getPlayerInteractEntity(clientnum) )
 		{
 			return;
@@ -3014,7 +5098,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// teleport player
-	{'TELM', [](){
+	{'TELM', [](PacketReader& packet){
 		if ( players[clientnum] == nullptr || !Player::getPlayerInteractEntity(clientnum) )
 		{
 			return;
@@ -3051,8 +5135,9 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// delete entity
-	{'ENTD', [](){
+	{'ENTD', [](PacketReader& packet){
 		Entity *entity = uidToEntity((int)SDLNet_Read32(&net_packet->data[4]));
+		EntitySnapshots.clientForget(SDLNet_Read32(&net_packet->data[4]));
 		if ( entity )
 		{
 			auto entity2 = newEntity(entity->sprite, 1, &removedEntities, nullptr);
@@ -3103,13 +5188,13 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// shake screen
-	{'SHAK', [](){
+	{'SHAK', [](PacketReader& packet){
 		cameravars[clientnum].shakex += ((Sint8)(net_packet->data[4])) / 100.f;
 		cameravars[clientnum].shakey += ((Sint8)(net_packet->data[5]));
 	}},
 
 	// a torch burns out
-	{'TORC', [](){
+	{'TORC', [](PacketReader& packet){
 		ItemType itemType = static_cast<ItemType>(SDLNet_Read16(&net_packet->data[4]));
 		Status itemStatus = static_cast<Status>(net_packet->data[6]);
 		int qty = static_cast<int>(net_packet->data[7]);
@@ -3132,7 +5217,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// update armor quality
-	{'ARMR', [](){
+	{'ARMR', [](PacketReader& packet){
 	    Item* item;
 		switch ( net_packet->data[4] )
 		{
@@ -3226,7 +5311,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// steal armor (destroy it)
-	{'STLA', [](){
+	{'STLA', [](PacketReader& packet){
 	    Item* item = nullptr;
 		int armornum = net_packet->data[4];
 		switch ( armornum )
@@ -3356,19 +5441,19 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// damage indicator
-	{'DAMI', [](){
+	{'DAMI', [](PacketReader& packet){
 		DamageIndicatorHandler.insert(clientnum, SDLNet_Read32(&net_packet->data[4]), 
 			SDLNet_Read32(&net_packet->data[8]), net_packet->data[12] == 1 ? true : false);
 	} },
 
 	// remote vibration
-	{ 'BRRR', []() {
+	{ 'BRRR', [](PacketReader& packet) {
 		inputs.addRumbleForHapticType(clientnum, SDLNet_Read32(&net_packet->data[4]),
 			SDLNet_Read32(&net_packet->data[8]));
 	}},
 
 		// play sound position
-	{'SNDP', [](){
+	{'SNDP', [](PacketReader& packet){
 		playSoundPos(
 		    SDLNet_Read32(&net_packet->data[4]),
 		    SDLNet_Read32(&net_packet->data[8]),
@@ -3377,21 +5462,21 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 		// play sound global
-	{'SNDG', [](){
+	{'SNDG', [](PacketReader& packet){
 		playSound(
 		    SDLNet_Read16(&net_packet->data[4]),
 		    (Uint8)net_packet->data[6]);
 	}},
 
 	// play sound notification global
-	{ 'SNDN', []() {
+	{ 'SNDN', [](PacketReader& packet) {
 		playSoundNotification(
 			SDLNet_Read16(&net_packet->data[4]),
 			(Uint8)net_packet->data[6]);
 	} },
 
 	// play sound entity local
-	{'SNEL', [](){
+	{'SNEL', [](PacketReader& packet){
 		Entity* tmp = uidToEntity(SDLNet_Read32(&net_packet->data[6]));
 		int sfx = SDLNet_Read16(&net_packet->data[4]);
 		if ( tmp )
@@ -3445,7 +5530,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// add light
-	{'ALIT', [](){
+	{'ALIT', [](PacketReader& packet){
         std::vector<char> data;
         const auto len = SDLNet_Read16(&net_packet->data[8]);
         data.resize(len);
@@ -3457,12 +5542,14 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// create wall
-	{'WALC', [](){
+	{'WALC', [](PacketReader& packet){
 		int y = SDLNet_Read16(&net_packet->data[6]);
 		int x = SDLNet_Read16(&net_packet->data[4]);
 		if ( x >= 0 && x < map.width && y >= 0 && y < map.height )
 		{
 			map.tiles[OBSTACLELAYER + y * MAPLAYERS + x * MAPLAYERS * map.height] = map.tiles[y * MAPLAYERS + x * MAPLAYERS * map.height];
+			mapTileChanged(x, y);
+			markChunksDirty(x, y);
 		}
 
 		const real_t effectOffset = 2.0;
@@ -3473,34 +5560,38 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// destroy wall
-	{'WALD', [](){
+	{'WALD', [](PacketReader& packet){
 		int y = SDLNet_Read16(&net_packet->data[6]);
 		int x = SDLNet_Read16(&net_packet->data[4]);
 		if ( x >= 0 && x < map.width && y >= 0 && y < map.height )
 		{
 			map.tiles[OBSTACLELAYER + y * MAPLAYERS + x * MAPLAYERS * map.height] = 0;
+			mapTileChanged(x, y);
+			markChunksDirty(x, y);
 		}
 	}},
 
 	// destroy wall + ceiling
-	{'WACD', [](){
+	{'WACD', [](PacketReader& packet){
 		int y = SDLNet_Read16(&net_packet->data[6]);
 		int x = SDLNet_Read16(&net_packet->data[4]);
 		if ( x >= 0 && x < map.width && y >= 0 && y < map.height )
 		{
 			map.tiles[OBSTACLELAYER + y * MAPLAYERS + x * MAPLAYERS * map.height] = 0;
 			map.tiles[(MAPLAYERS - 1) + y * MAPLAYERS + x * MAPLAYERS * map.height] = 0;
+			mapTileChanged(x, y);
+			markChunksDirty(x, y);
 		}
 	}},
 
 	// monster music
-	{'MUSM', [](){
+	{'MUSM', [](PacketReader& packet){
 	    Uint8 assailant = net_packet->data[4];
 		combat = assailant;
 	}},
 
 	// get item
-	{'ITEM', [](){
+	{'ITEM', [](PacketReader& packet){
 		Item* item = newItem(
 		    static_cast<ItemType>(SDLNet_Read32(&net_packet->data[4])),
 		    static_cast<Status>(SDLNet_Read32(&net_packet->data[8])),
@@ -3537,7 +5628,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// unequip and remove item
-	{'DROP', [](){
+	{'DROP', [](PacketReader& packet){
 		Item** armor = NULL;
 		switch ( net_packet->data[4] )
 		{
@@ -3606,12 +5697,12 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// get gold
-	{'GOLD', [](){
+	{'GOLD', [](PacketReader& packet){
 		stats[clientnum]->GOLD = SDLNet_Read32(&net_packet->data[4]);
 	}},
 
 	// open shop
-	{'SHOP', [](){
+	{'SHOP', [](PacketReader& packet){
 		players[clientnum]->closeAllGUIs(DONT_CHANGE_SHOOTMODE, CLOSEGUI_DONT_CLOSE_INVENTORY);
 		players[clientnum]->openStatusScreen(GUI_MODE_SHOP, INVENTORY_MODE_ITEM, Player::GUI_t::MODULE_SHOP);
 
@@ -3627,7 +5718,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// shop item
-	{'SHPI', [](){
+	{'SHPI', [](PacketReader& packet){
 		if ( !shopInv[clientnum] )
 		{
 			return;
@@ -3655,7 +5746,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// close shop
-	{'SHPC', [](){
+	{'SHPC', [](PacketReader& packet){
 		Uint32 id = SDLNet_Read32(&net_packet->data[4]);
 		if ( id == shopkeeper[clientnum] )
 		{
@@ -3665,7 +5756,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// you died
-	{'UDIE', [](){
+	{'UDIE', [](PacketReader& packet){
 		KilledBy killer = (KilledBy)SDLNet_Read32(&net_packet->data[4]);
 		stats[clientnum]->killer = killer;
 
@@ -3797,7 +5888,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// server forwarded a player callout
-	{ 'CALL', []() {
+	{ 'CALL', [](PacketReader& packet) {
 		const int pnum = std::min(net_packet->data[4], (Uint8)(MAXPLAYERS - 1));
 		if ( pnum != clientnum )
 		{
@@ -3832,7 +5923,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// textbox message
-	{'MSGS', [](){
+	{'MSGS', [](PacketReader& packet){
 		Uint32 color = SDLNet_Read32(&net_packet->data[4]);
 		MessageType type = (MessageType)SDLNet_Read32(&net_packet->data[8]);
 		const char* msg = (const char*)(&net_packet->data[12]);
@@ -3886,13 +5977,13 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// update magic
-	{'UPMP', [](){
+	{'UPMP', [](PacketReader& packet){
 		stats[clientnum]->MP = SDLNet_Read32(&net_packet->data[4]);
 		return;
 	}},
 
 	// update effects flags
-	{'UPEF', [](){
+	{'UPEF', [](PacketReader& packet){
 		for (int c = 0; c < NUMEFFECTS; c++)
 		{
 			if ( net_packet->data[4 + c / 8]&power(2, c - (c / 8) * 8) )
@@ -3915,7 +6006,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// update entity stat flag
-	{'ENSF', [](){
+	{'ENSF', [](PacketReader& packet){
 		Entity *entity = uidToEntity((int)SDLNet_Read32(&net_packet->data[4]));
 		if ( entity )
 		{
@@ -3927,7 +6018,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// update attributes
-	{'ATTR', [](){
+	{'ATTR', [](PacketReader& packet){
 		stats[clientnum]->STR = (Sint8)net_packet->data[5];
 		stats[clientnum]->DEX = (Sint8)net_packet->data[6];
 		stats[clientnum]->CON = (Sint8)net_packet->data[7];
@@ -3943,7 +6034,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// level up icon timers, sets second row of icons if double stat gain is rolled.
-	{'LVLI', [](){
+	{'LVLI', [](PacketReader& packet){
 		// Note - set to 250 ticks, higher values will require resending/using 16 bit data.
 		players[clientnum]->hud.xpBar.animateState = Player::HUD_t::AnimateStates::ANIMATE_LEVELUP_RISING;
 		players[clientnum]->hud.xpBar.xpLevelups++;
@@ -4002,7 +6093,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// killed a monster
-	{'MKIL', [](){
+	{'MKIL', [](PacketReader& packet){
 		const int monster = (int)net_packet->data[4];
 		if ( monster >= 0 && monster < NUMMONSTERS )
 		{
@@ -4011,7 +6102,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// update skill
-	{'SKIL', [](){
+	{'SKIL', [](PacketReader& packet){
 	    const int pro = std::min(net_packet->data[5], (Uint8)(NUMPROFICIENCIES - 1));
 		int oldSkill = stats[clientnum]->getProficiency(pro);
 		stats[clientnum]->setProficiency(pro, (net_packet->data[6] & 0x7F));
@@ -4040,17 +6131,17 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	//Add spell.
-	{'ASPL', [](){
+	{'ASPL', [](PacketReader& packet){
 		addSpell(net_packet->data[5], clientnum, true);
 	}},
 
 	// update hunger
-	{'HNGR', [](){
+	{'HNGR', [](PacketReader& packet){
 		stats[clientnum]->HUNGER = (Sint32)SDLNet_Read32(&net_packet->data[4]);
 	}},
 
 	// update player stat values
-	{'STAT', [](){
+	{'STAT', [](PacketReader& packet){
 		Sint32 buffer = 0;
 		for ( int i = 0; i < MAXPLAYERS; ++i )
 		{
@@ -4064,7 +6155,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// update sex
-	{'SEXU', [](){
+	{'SEXU', [](PacketReader& packet){
 		int player = static_cast<int>(net_packet->data[4]);
 		if ( player < 0 || player >= MAXPLAYERS || !stats[player] )
 		{
@@ -4075,7 +6166,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 		return;
 	}},
 
-	{'COND', [](){
+	{'COND', [](PacketReader& packet){
 		int conduct = SDLNet_Read16(&net_packet->data[4]);
 		int value = SDLNet_Read16(&net_packet->data[6]);
 		conductGameChallenges[conduct] = value;
@@ -4083,7 +6174,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// update player statistics
-	{'GPST', [](){
+	{'GPST', [](PacketReader& packet){
 		int gameplayStat = SDLNet_Read32(&net_packet->data[4]);
 		int changeval = SDLNet_Read32(&net_packet->data[8]);
 		if ( gameplayStat == STATISTICS_TEMPT_FATE )
@@ -4151,7 +6242,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// update player levels
-	{'UPLV', [](){
+	{'UPLV', [](PacketReader& packet){
 		Sint32 buffer = SDLNet_Read32(&net_packet->data[4]);
 		for ( int i = 0; i < MAXPLAYERS; ++i )
 		{
@@ -4160,7 +6251,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// level change
-	{'LVLC', [](){
+	{'LVLC', [](PacketReader& packet){
 		if ( currentlevel == net_packet->data[13] && secretlevel == net_packet->data[4] )
 		{
 			// the server's just doing a routine check
@@ -4171,12 +6262,12 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// level reminder
-	{'LVLR', [](){
+	{'LVLR', [](PacketReader& packet){
 		changeLevel();
 	}},
 
 	// lead a monster
-	{'LEAD', [](){
+	{'LEAD', [](PacketReader& packet){
 		Uint32* uidnum = (Uint32*) malloc(sizeof(Uint32));
 		*uidnum = (Uint32)SDLNet_Read32(&net_packet->data[4]);
 		node_t* node = list_AddNodeLast(&stats[clientnum]->FOLLOWERS);
@@ -4247,7 +6338,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// remove a monster from followers list
-	{'LDEL', [](){
+	{'LDEL', [](PacketReader& packet){
 		Uint32 uidnum = (Uint32)SDLNet_Read32(&net_packet->data[4]);
 		if ( stats[clientnum] )
 		{
@@ -4272,7 +6363,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// update client's follower data on level up or initial follow.
-	{'NPCI', [](){
+	{'NPCI', [](PacketReader& packet){
 		Uint32 uidnum = (Uint32)SDLNet_Read32(&net_packet->data[4]);
 		Entity* monster = uidToEntity(uidnum);
 		if ( monster )
@@ -4292,7 +6383,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// update client's follower hp/maxhp data at intervals
-	{'NPCU', [](){
+	{'NPCU', [](PacketReader& packet){
 		Uint32 uidnum = (Uint32)SDLNet_Read32(&net_packet->data[4]);
 		Entity* monster = uidToEntity(uidnum);
 		if ( monster )
@@ -4310,7 +6401,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// bless my equipment
-	{'BLES', [](){
+	{'BLES', [](PacketReader& packet){
 		if ( stats[clientnum]->helmet )
 		{
 			stats[clientnum]->helmet->beatitude++;
@@ -4354,7 +6445,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// bless one piece of my equipment
-	{'BLE1', [](){
+	{'BLE1', [](PacketReader& packet){
 		Uint32 chosen = static_cast<Uint32>(SDLNet_Read32(&net_packet->data[4]));
 		switch ( chosen )
 		{
@@ -4424,7 +6515,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// update entity appearance (sprite)
-	{'ENTA', [](){
+	{'ENTA', [](PacketReader& packet){
 		Entity *entity = uidToEntity((int)SDLNet_Read32(&net_packet->data[4]));
 		if ( entity )
 		{
@@ -4433,7 +6524,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// monster summon
-	{'SUMM', [](){
+	{'SUMM', [](PacketReader& packet){
 		Monster monster = (Monster)SDLNet_Read32(&net_packet->data[4]);
 		Sint32 x = (Sint32)SDLNet_Read32(&net_packet->data[8]);
 		Sint32 y = (Sint32)SDLNet_Read32(&net_packet->data[12]);
@@ -4442,7 +6533,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// monster summon
-	{'SUMS', [](){
+	{'SUMS', [](PacketReader& packet){
 		if ( stats[clientnum] )
 		{
 			stats[clientnum]->playerSummonLVLHP = (Sint32)SDLNet_Read32(&net_packet->data[4]);
@@ -4455,7 +6546,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	//Multiplayer chest code (client).
-	{'CHST', [](){
+	{'CHST', [](PacketReader& packet){
 		if ( openedChest[clientnum] )
 		{
 			//Close the chest.
@@ -4477,7 +6568,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	//Add an item to the chest.
-	{'CITM', [](){
+	{'CITM', [](PacketReader& packet){
 		ItemType itemType = static_cast<ItemType>(SDLNet_Read32(&net_packet->data[4]));
 		Status status = static_cast<Status>(SDLNet_Read32(&net_packet->data[8]));
 		Sint16 beatitude = SDLNet_Read32(&net_packet->data[12]);
@@ -4500,12 +6591,12 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	//Close the chest.
-	{'CCLS', [](){
+	{'CCLS', [](PacketReader& packet){
 		closeChestClientside(clientnum);
 	}},
 
 	//Open up the GUI to identify an item.
-	{'IDEN', [](){
+	{'IDEN', [](PacketReader& packet){
 		if ( net_packet->data[4] == 1 ) // spellbook
 		{
 			int beatitude = static_cast<Sint8>(net_packet->data[5]);
@@ -4518,7 +6609,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// Open up the Remove Curse GUI
-	{'CRCU', [](){
+	{'CRCU', [](PacketReader& packet){
 		//Uncurse an item
 		if ( net_packet->data[4] == 1 ) // spellbook
 		{
@@ -4532,7 +6623,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	//Add a spell to the channeled spells list.
-	{'CHAN', [](){
+	{'CHAN', [](PacketReader& packet){
 		spell_t* thespell = getSpellFromID(SDLNet_Read32(&net_packet->data[5]));
 		auto node = list_AddNodeLast(&channeledSpells[clientnum]);
 		node->element = thespell;
@@ -4543,7 +6634,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	//Remove a spell from the channeled spells list.
-	{'UNCH', [](){
+	{'UNCH', [](PacketReader& packet){
 		spell_t* thespell = getSpellFromID(SDLNet_Read32(&net_packet->data[5]));
 		if (spellInList(&channeledSpells[clientnum], thespell))
 		{
@@ -4562,20 +6653,20 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	//Map the magic. I mean magic the map. I mean magically map the level (client).
-	{'MMAP', [](){
+	{'MMAP', [](PacketReader& packet){
 		spell_magicMap(clientnum);
 	}},
 
-	{'MFOD', [](){
+	{'MFOD', [](PacketReader& packet){
 		mapFoodOnLevel(clientnum);
 	}},
 
-	{'TKIT', [](){
+	{'TKIT', [](PacketReader& packet){
 		GenericGUI[clientnum].tinkeringKitDegradeOnUse(clientnum);
 	}},
 
 	// boss death
-	{'BDTH', [](){
+	{'BDTH', [](PacketReader& packet){
 		for ( auto node = map.entities->first; node != nullptr; node = node->next )
 		{
 			Entity* entity = (Entity*)node->element;
@@ -4604,6 +6695,8 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 					if ( !map.tiles[y * MAPLAYERS + x * MAPLAYERS * map.height] )
 					{
 						map.tiles[y * MAPLAYERS + x * MAPLAYERS * map.height] = 72;
+						mapTileChanged(x, y);
+						markChunksDirty(x, y);
 					}
 				}
 			}
@@ -4611,18 +6704,18 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// update svFlags
-	{'SVFL', [](){
+	{'SVFL', [](PacketReader& packet){
 		svFlags = SDLNet_Read32(&net_packet->data[4]);
 		lobbyWindowSvFlags = svFlags;
 	}},
 
 	// kick
-	{'KICK', [](){
+	{'KICK', [](PacketReader& packet){
 		MainMenu::timedOut();
 	}},
 
 	// win the game
-	{'WING', [](){
+	{'WING', [](PacketReader& packet){
 		if ( net_packet->data[4] == 100 || net_packet->data[4] == 101 )
 		{
 			movie = true;
@@ -4749,7 +6842,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// mid game cutscene
-	{'MIDG', [](){
+	{'MIDG', [](PacketReader& packet){
 		int race = RACE_HUMAN;
 		if ( stats[clientnum]->playerRace != RACE_HUMAN && stats[clientnum]->appearance == 0 )
 		{
@@ -4805,7 +6898,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 		pauseGame(2, false);
 	}},
 
-	{'PMAP', [](){
+	{'PMAP', [](PacketReader& packet){
 		MinimapPing newPing(ticks, net_packet->data[4], 
 			net_packet->data[5], 
 			net_packet->data[6],
@@ -4821,21 +6914,21 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// the server sent a game player preferences update
-	{'GPPR', []() {
-		GameplayPreferences_t::receivePacket();
+	{'GPPR', [](PacketReader& packet) {
+		GameplayPreferences_t::receivePacket(packet);
 	}},
 
 	// the server requested a game player preferences update
-	{'GPPU', []() {
+	{'GPPU', [](PacketReader& packet) {
 		gameplayPreferences[clientnum].sendToServer();
 	}},
 
 	// the server sent a game config update
-	{ 'GOPT', []() {
+	{ 'GOPT', [](PacketReader& packet) {
 		GameplayPreferences_t::receiveGameConfig();
 	} },
 
-	{'DASH', [](){
+	{'DASH', [](PacketReader& packet){
 		if ( players[clientnum] && players[clientnum]->entity && stats[clientnum] )
 		{
 			real_t vel = sqrt(pow(players[clientnum]->entity->vel_y, 2) + pow(players[clientnum]->entity->vel_x, 2));
@@ -4849,7 +6942,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// get item
-	{'ITEQ', [](){
+	{'ITEQ', [](PacketReader& packet){
 		auto item = newItem(
 		    static_cast<ItemType>(SDLNet_Read32(&net_packet->data[4])),
 		    static_cast<Status>(SDLNet_Read32(&net_packet->data[8])),
@@ -4871,7 +6964,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// update attributes from script
-	{'SCRU', [](){
+	{'SCRU', [](PacketReader& packet){
 		if ( net_packet->data[25] )
 		{
 			bool clearStats = false;
@@ -4901,7 +6994,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	} },
 
 	// update class from script
-	{ 'SCRC', []() {
+	{ 'SCRC', [](PacketReader& packet) {
 		int player = net_packet->data[4];
 		int classnum = net_packet->data[5];
 		if ( player >= 0 && player < MAXPLAYERS )
@@ -4915,7 +7008,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// open fullscreen sign
-	{'SIGN', []() {
+	{'SIGN', [](PacketReader& packet) {
 		Uint32 uid = SDLNet_Read32(&net_packet->data[4]);
 		if ( Entity* sign = uidToEntity(uid) )
 		{
@@ -4925,7 +7018,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// game restart
-	{'RSTR', [](){
+	{'RSTR', [](PacketReader& packet){
 		svFlags = SDLNet_Read32(&net_packet->data[4]);
 		uniqueGameKey = SDLNet_Read32(&net_packet->data[8]);
 		local_rng.seedBytes(&uniqueGameKey, sizeof(uniqueGameKey));
@@ -4944,7 +7037,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// delete multiplayer save
-	{'DSAV', [](){
+	{'DSAV', [](PacketReader& packet){
 		if ( multiplayer == CLIENT )
 		{
 			if ( gameModeManager.allowsSaves() )
@@ -4955,7 +7048,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// post online hiscore
-	{ 'DEND', []() {
+	{ 'DEND', [](PacketReader& packet) {
 		if ( multiplayer == CLIENT )
 		{
 #ifdef USE_PLAYFAB
@@ -4965,7 +7058,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// text bubbles
-	{'BUBL', []() {
+	{'BUBL', [](PacketReader& packet) {
 		Uint32 uid = SDLNet_Read32(&net_packet->data[4]);
 		Player::WorldUI_t::WorldTooltipDialogue_t::DialogueType_t type = 
 			(Player::WorldUI_t::WorldTooltipDialogue_t::DialogueType_t)net_packet->data[8];
@@ -4975,7 +7068,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 	}},
 
 	// shopkeeper player hostility
-	{ 'SHPH', []() {
+	{ 'SHPH', [](PacketReader& packet) {
 		ShopkeeperPlayerHostility_t::WantedLevel wantedLevel = (ShopkeeperPlayerHostility_t::WantedLevel)net_packet->data[4];
 		Uint16 numKills = SDLNet_Read16(&net_packet->data[5]);
 		Uint16 numAggressions = SDLNet_Read16(&net_packet->data[7]);
@@ -4995,7 +7088,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 		return;
 	} },
 
-	{ 'BNTY', []() {
+	{ 'BNTY', [](PacketReader& packet) {
 		int player = (int)net_packet->data[4];
 		if ( player >= 0 && player < MAXPLAYERS )
 		{
@@ -5012,7 +7105,7 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 		}
 	}},
 
-	{ 'BNTH', []() {
+	{ 'BNTH', [](PacketReader& packet) {
 		int player = (int)net_packet->data[4];
 		if ( player >= 0 && player < MAXPLAYERS )
 		{
@@ -5023,10 +7116,18 @@ static std::unordered_map<Uint32, void(*)()> clientPacketHandlers = {
 
 void clientHandlePacket()
 {
+	if ( !unpackDepth )
+	{
+		NetStats.count(NetTelemetry::RECEIVED, net_packet->data, net_packet->len);
+	}
 	if (handleSafePacket())
 	{
 		return;
 	}
+	if ( NetMessageQueue::unpack(&clientHandlePacket) )
+	{
+		return;
+	}
 
 	Uint32 packetId = SDLNet_Read32(&net_packet->data[0]);
 
@@ -5038,26 +7139,6 @@ void clientHandlePacket()
 #endif
 	if ( logCheckMainLoopTimers )
 	{
-		char packetinfo[NET_PACKET_SIZE];
-		memcpy(packetinfo, (char*)net_packet->data, net_packet->len);
-		packetinfo[net_packet->len] = '\0';
-
-		char packetHeader[5];
-		memcpy(packetHeader, packetinfo, 4);
-		packetHeader[4] = '\0';
-
-		std::string tmp = packetHeader;
-		unsigned long hash = djb2Hash(packetHeader);
-		auto find = DebugStats.networkPackets.find(hash);
-		if ( find != DebugStats.networkPackets.end() )
-		{
-			++DebugStats.networkPackets[hash].second;
-		}
-		else
-		{
-			DebugStats.networkPackets.insert(std::make_pair(hash, std::make_pair(tmp, 0)));
-			messagePlayer(clientnum, MESSAGE_DEBUG, "%s", tmp.c_str());
-		}
 		if ( packetId == 'ENTU' )
 		{
 			int sprite = 0;
@@ -5087,7 +7168,11 @@ void clientHandlePacket()
             (char)net_packet->data[2],
             (char)net_packet->data[3]);
     } else {
-        (*(find->second))(); // handle packet
+        PacketReader packet(net_packet->data, net_packet->len);
+        packet.skip(4); // the id
+        const Uint64 start = SDL_GetPerformanceCounter();
+        (*(find->second))(packet); // handle packet
+        NetStats.handled(packetId, SDL_GetPerformanceCounter() - start);
     }
 }
 
@@ -5101,6 +7186,7 @@ void clientHandlePacket()
 
 void clientHandleMessages(Uint32 framerateBreakInterval)
 {
+	NetLinkSim.update();
 #ifdef STEAMWORKS
 	if (!directConnect && !net_handler)
 	{
@@ -5136,19 +7222,14 @@ void clientHandleMessages(Uint32 framerateBreakInterval)
 			EOSPacketThread(static_cast<void*>(net_handler));
 #endif
 		}
-		SteamPacketWrapper* packet = nullptr;
-
 		if ( logCheckMainLoopTimers )
 		{
 			DebugStats.messagesT1 = std::chrono::high_resolution_clock::now();
 			DebugStats.handlePacketStartLoop = true;
 		}
 
-		while (packet = net_handler->getGamePacket())
+		while ( net_handler->getGamePacket(net_packet) )
 		{
-			memcpy(net_packet->data, packet->data(), packet->len());
-			net_packet->len = packet->len();
-
 			clientHandlePacket(); //Uses net_packet.
 
 			if ( logCheckMainLoopTimers )
@@ -5156,7 +7237,6 @@ void clientHandleMessages(Uint32 framerateBreakInterval)
 				DebugStats.messagesT2WhileLoop = std::chrono::high_resolution_clock::now();
 				DebugStats.handlePacketStartLoop = false;
 			}
-			delete packet;
 			if ( !net_handler )
 			{
 				break;
@@ -5189,6 +7269,8 @@ void clientHandleMessages(Uint32 framerateBreakInterval)
 			clientHandlePacket();
 		}
 	}
+	NetMessages.flush(); // replies queued by the handlers
+	SafePackets.flushAcks(); // one ack for everything that came in
 }
 
 /*-------------------------------------------------------------------------------
@@ -5196,20 +7278,64 @@ void clientHandleMessages(Uint32 framerateBreakInterval)
 	serverHandlePacket
 
 	Called by serverHandleMessages. Does the actual handling of a packet.
+	Every handler here decodes through the PacketReader it is given and
+	drops the packet if a read runs off the end; net_packet is only used
+	to write replies and relay the packet on.
 
 -------------------------------------------------------------------------------*/
 
-static std::unordered_map<Uint32, void(*)()> serverPacketHandlers = {
+// the item most client item packets carry: type, status, beatitude, count
+// and appearance as 32 bit values followed by the identified flag
+struct PacketItem_t
+{
+	Uint32 type = 0;
+	Uint32 status = 0;
+	Uint32 beatitude = 0;
+	Uint32 count = 0;
+	Uint32 appearance = 0;
+	Uint8 identified = 0;
+
+	void read(PacketReader& packet)
+	{
+		type = packet.read32();
+		status = packet.read32();
+		beatitude = packet.read32();
+		count = packet.read32();
+		appearance = packet.read32();
+		identified = packet.read8();
+	}
+	Item* create(list_t* inventory) const
+	{
+		return newItem(static_cast<ItemType>(type), static_cast<Status>(status),
+			beatitude, count, appearance, identified, inventory);
+	}
+};
+
+static std::unordered_map<Uint32, void(*)(PacketReader&)> serverPacketHandlers = {
 	// keep alive
-	{'KPAL', [](){
-	    const int player = std::min(net_packet->data[4], (Uint8)(MAXPLAYERS - 1));
+	{'KPAL', [](PacketReader& packet){
+	    const int player = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+		if ( !packet.ok() )
+		{
+			return;
+		}
 		client_keepalive[player] = ticks;
 	}},
 
+	// entity snapshot ack
+	{'SNPA', [](PacketReader& packet){
+		EntitySnapshots.serverReceiveAck(packet);
+	}},
+
+	// fragment of a bulk transfer
+	{'BULK', [](PacketReader& packet){
+		BulkTransfers.receive(packet);
+	}},
+
 	// ping
-	{'PING', [](){
-		const int j = net_packet->data[4];
-		if (j <= 0 || j >= MAXPLAYERS )
+	{'PING', [](PacketReader& packet){
+		const int j = packet.read8();
+		if ( !packet.ok() || j <= 0 || j >= MAXPLAYERS )
 		{
 			return;
 		}
@@ -5225,38 +7351,47 @@ static std::unordered_map<Uint32, void(*)()> serverPacketHandlers = {
 	}},
 
 	// automated ping
-	{'PNGU', []() {
-		PingNetworkStatus_t::respond();
+	{'PNGU', [](PacketReader& packet) {
+		PingNetworkStatus_t::respond(packet);
 	}},
 
 	// automated ping response
-	{'PNGR', []() {
-		PingNetworkStatus_t::receive();
+	{'PNGR', [](PacketReader& packet) {
+		PingNetworkStatus_t::receive(packet);
 	}},
 
 	// network scan
-	{'SCAN', [](){
+	{'SCAN', [](PacketReader& packet){
 	    handleScanPacket();
 	}},
 
 	// pause game
-	{'PAUS', [](){
-		messagePlayer(clientnum, MESSAGE_MISC, Language::get(1118), stats[net_packet->data[4]]->name);
-		const int j = std::min(net_packet->data[4], (Uint8)(MAXPLAYERS - 1));
+	{'PAUS', [](PacketReader& packet){
+		const int j = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+		if ( !packet.ok() )
+		{
+			return;
+		}
+		messagePlayer(clientnum, MESSAGE_MISC, Language::get(1118), stats[j]->name);
 		pauseGame(2, j);
 	}},
 
 	// unpause game
-	{'UNPS', [](){
-		messagePlayer(clientnum, MESSAGE_MISC, Language::get(1119), stats[net_packet->data[4]]->name);
-		const int j = std::min(net_packet->data[4], (Uint8)(MAXPLAYERS - 1));
+	{'UNPS', [](PacketReader& packet){
+		const int j = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+		if ( !packet.ok() )
+		{
+			return;
+		}
+		messagePlayer(clientnum, MESSAGE_MISC, Language::get(1119), stats[j]->name);
 		pauseGame(1, j);
 	}},
 
 	// check entity existence
-	{'ENTE', [](){
-		const int x = net_packet->data[4];
-		if ( x <= 0 || x >= MAXPLAYERS )
+	{'ENTE', [](PacketReader& packet){
+		const int x = packet.read8();
+		Uint32 uid = packet.read32();
+		if ( !packet.ok() || x <= 0 || x >= MAXPLAYERS )
 		{
 			return;
 		}
@@ -5264,7 +7399,6 @@ static std::unordered_map<Uint32, void(*)()> serverPacketHandlers = {
 		{
 			return;
 		}
-		Uint32 uid = SDLNet_Read32(&net_packet->data[5]);
 		Entity* entity = uidToEntity(uid);
 		if ( entity )
 		{
@@ -5280,13 +7414,13 @@ static std::unordered_map<Uint32, void(*)()> serverPacketHandlers = {
 	}},
 
 	// client request item details.
-	{'ITMU', [](){
-		const int x = net_packet->data[4];
-		if ( x <= 0 || x >= MAXPLAYERS )
+	{'ITMU', [](PacketReader& packet){
+		const int x = packet.read8();
+		Uint32 uid = packet.read32();
+		if ( !packet.ok() || x <= 0 || x >= MAXPLAYERS )
 		{
 			return;
 		}
-		Uint32 uid = SDLNet_Read32(&net_packet->data[5]);
 		Entity* entity = uidToEntity(uid);
 		if ( entity )
 		{
@@ -5319,9 +7453,17 @@ static std::unordered_map<Uint32, void(*)()> serverPacketHandlers = {
 	}},
 
 	// player move
-	{'PMOV', [](){
-		const int player = net_packet->data[4];
-		if ( player < 0 || player >= MAXPLAYERS )
+	{'PMOV', [](PacketReader& packet){
+		const int player = packet.read8();
+		const int level = packet.read8();
+		auto dx = ((Sint16)packet.read16()) / 32.0;
+		auto dy = ((Sint16)packet.read16()) / 32.0;
+		auto velx = ((Sint16)packet.read16()) / 128.0;
+		auto vely = ((Sint16)packet.read16()) / 128.0;
+		auto yaw = ((Sint16)packet.read16()) / 128.0;
+		auto pitch = ((Sint16)packet.read16()) / 128.0;
+		const int secret = packet.read8();
+		if ( !packet.ok() || player < 0 || player >= MAXPLAYERS )
 		{
 			return;
 		}
@@ -5332,19 +7474,11 @@ static std::unordered_map<Uint32, void(*)()> serverPacketHandlers = {
 		}
 
 		// check if the info is outdated
-		if ( net_packet->data[5] != currentlevel || net_packet->data[18] != secretlevel )
+		if ( level != currentlevel || secret != secretlevel )
 		{
 			return;
 		}
 
-		// get info from client
-		auto dx = ((Sint16)SDLNet_Read16(&net_packet->data[6])) / 32.0;
-		auto dy = ((Sint16)SDLNet_Read16(&net_packet->data[8])) / 32.0;
-		auto velx = ((Sint16)SDLNet_Read16(&net_packet->data[10])) / 128.0;
-		auto vely = ((Sint16)SDLNet_Read16(&net_packet->data[12])) / 128.0;
-		auto yaw = ((Sint16)SDLNet_Read16(&net_packet->data[14])) / 128.0;
-		auto pitch = ((Sint16)SDLNet_Read16(&net_packet->data[16])) / 128.0;
-
 		// update rotation
 		players[player]->entity->yaw = yaw;
 		players[player]->entity->pitch = pitch;
@@ -5371,7 +7505,7 @@ static std::unordered_map<Uint32, void(*)()> serverPacketHandlers = {
 		{
 			// player encountered obstacle on path
 			// stop updating position on server side and send client corrected position
-			const int j = net_packet->data[4];
+			const int j = player;
 			if ( j > 0 && j < MAXPLAYERS )
 			{
 				strcpy((char*)net_packet->data, "PMOV");
@@ -5418,9 +7552,18 @@ static std::unordered_map<Uint32, void(*)()> serverPacketHandlers = {
 	}},
 
 	// player ghost move
-	{'GMOV', []() {
-		const int player = net_packet->data[4];
-		if ( player < 0 || player >= MAXPLAYERS )
+	{'GMOV', [](PacketReader& packet) {
+		const int player = packet.read8();
+		const int level = packet.read8();
+		auto dx = ((Sint16)packet.read16()) / 32.0;
+		auto dy = ((Sint16)packet.read16()) / 32.0;
+		auto velx = ((Sint16)packet.read16()) / 128.0;
+		auto vely = ((Sint16)packet.read16()) / 128.0;
+		auto yaw = ((Sint16)packet.read16()) / 128.0;
+		auto pitch = ((Sint16)packet.read16()) / 128.0;
+		const int secret = packet.read8();
+		const Uint8 flags = packet.read8();
+		if ( !packet.ok() || player < 0 || player >= MAXPLAYERS )
 		{
 			return;
 		}
@@ -5431,20 +7574,13 @@ static std::unordered_map<Uint32, void(*)()> serverPacketHandlers = {
 		}
 
 		// check if the info is outdated
-		if ( net_packet->data[5] != currentlevel || net_packet->data[18] != secretlevel )
+		if ( level != currentlevel || secret != secretlevel )
 		{
 			return;
 		}
 
-		// get info from client
-		auto dx = ((Sint16)SDLNet_Read16(&net_packet->data[6])) / 32.0;
-		auto dy = ((Sint16)SDLNet_Read16(&net_packet->data[8])) / 32.0;
-		auto velx = ((Sint16)SDLNet_Read16(&net_packet->data[10])) / 128.0;
-		auto vely = ((Sint16)SDLNet_Read16(&net_packet->data[12])) / 128.0;
-		auto yaw = ((Sint16)SDLNet_Read16(&net_packet->data[14])) / 128.0;
-		auto pitch = ((Sint16)SDLNet_Read16(&net_packet->data[16])) / 128.0;
-		bool bounce = ((int)(net_packet->data[19] & 1) == 1) ? true : false;
-		int deactivated = ((int)((net_packet->data[19] >> 1) & 1) == 1) ? 1 : 0;
+		bool bounce = ((int)(flags & 1) == 1) ? true : false;
+		int deactivated = ((int)((flags >> 1) & 1) == 1) ? 1 : 0;
 
 		// update rotation
 		players[player]->ghost.my->yaw = yaw;
@@ -5472,7 +7608,7 @@ static std::unordered_map<Uint32, void(*)()> serverPacketHandlers = {
 		{
 			// player encountered obstacle on path
 			// stop updating position on server side and send client corrected position
-			const int j = net_packet->data[4];
+			const int j = player;
 			if ( j > 0 && j < MAXPLAYERS )
 			{
 				strcpy((char*)net_packet->data, "GMOV");
@@ -5534,14 +7670,22 @@ static std::unordered_map<Uint32, void(*)()> serverPacketHandlers = {
 	}},
 
 	// player created ghost
-	{'GHOS', []() {
+	{'GHOS', [](PacketReader& packet) {
+		int player = packet.read8();
+		const int level = packet.read8();
+		const int tilex = packet.read16();
+		const int tiley = packet.read16();
+		const int secret = packet.read8();
+		if ( !packet.ok() )
+		{
+			return;
+		}
+
 		// check if the info is outdated
-		if ( net_packet->data[5] != currentlevel || net_packet->data[10] != secretlevel )
+		if ( level != currentlevel || secret != secretlevel )
 		{
 			return;
 		}
-		
-		int player = net_packet->data[4];
 
 		if ( player < 0 || player >= MAXPLAYERS )
 		{
@@ -5560,8 +7704,8 @@ static std::unordered_map<Uint32, void(*)()> serverPacketHandlers = {
 		Entity* entity = newEntity(sprite, 1, map.entities, nullptr); //Ghost entity.
 		players[player]->ghost.my = entity;
 		players[player]->ghost.uid = entity->getUID();
-		entity->x = (SDLNet_Read16(&net_packet->data[6]) * 16) + 8;
-		entity->y = (SDLNet_Read16(&net_packet->data[8]) * 16) + 8;
+		entity->x = (tilex * 16) + 8;
+		entity->y = (tiley * 16) + 8;
 		entity->new_x = entity->x;
 		entity->new_y = entity->y;
 		entity->z = -4;
@@ -5578,9 +7722,10 @@ static std::unordered_map<Uint32, void(*)()> serverPacketHandlers = {
 	}},
 
 	// tried to update
-	{'NOUP', [](){
-		Uint32 uid = SDLNet_Read32(&net_packet->data[5]);
-		Entity* entity = uidToEntity(uid);
+	{'NOUP', [](PacketReader& packet){
+		packet.skip(1); // player
+		Uint32 uid = packet.read32();
+		Entity* entity = packet.ok() ? uidToEntity(uid) : nullptr;
 		if ( entity )
 		{
 			entity->flags[UPDATENEEDED] = false;
@@ -5588,12 +7733,17 @@ static std::unordered_map<Uint32, void(*)()> serverPacketHandlers = {
 	}},
 
 	// client deleted entity
-	{'ENTD', [](){
-	    const int player = std::min(net_packet->data[4], (Uint8)(MAXPLAYERS - 1));
+	{'ENTD', [](PacketReader& packet){
+	    const int player = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+		const Uint32 uid = packet.read32();
+		if ( !packet.ok() )
+		{
+			return;
+		}
 		for ( auto node = entitiesToDelete[player].first; node != NULL; node = node->next )
 		{
 			auto deleteent = (deleteent_t*)node->element;
-			if ( deleteent->uid == SDLNet_Read32(&net_packet->data[5]) )
+			if ( deleteent->uid == uid )
 			{
 				list_RemoveNode(node);
 				break;
@@ -5602,10 +7752,14 @@ static std::unordered_map<Uint32, void(*)()> serverPacketHandlers = {
 	}},
 
 	// clicked entity in range
-	{'CKIR', [](){
-	    const int player = std::min(net_packet->data[4], (Uint8)(MAXPLAYERS - 1));
+	{'CKIR', [](PacketReader& packet){
+	    const int player = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+		Uint32 uid = packet.read32();
+		if ( !packet.ok() )
+		{
+			return;
+		}
 		client_keepalive[player] = ticks;
-		Uint32 uid = SDLNet_Read32(&net_packet->data[5]);
 		Entity* entity = uidToEntity(uid);
 		if ( entity )
 		{
@@ -5615,10 +7769,14 @@ static std::unordered_map<Uint32, void(*)()> serverPacketHandlers = {
 	}},
 
 	// tinker salvage
-	{'SALV', [](){
-	    const int player = std::min(net_packet->data[4], (Uint8)(MAXPLAYERS - 1));
+	{'SALV', [](PacketReader& packet){
+	    const int player = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+		Uint32 uid = packet.read32();
+		if ( !packet.ok() )
+		{
+			return;
+		}
 		client_keepalive[player] = ticks;
-		Uint32 uid = SDLNet_Read32(&net_packet->data[5]);
 		Entity* entity = uidToEntity(uid);
 		if ( entity )
 		{
@@ -5636,10 +7794,14 @@ static std::unordered_map<Uint32, void(*)()> serverPacketHandlers = {
 	}},
 
 	// rat feed
-	{'RATF', [](){
-	    const int player = std::min(net_packet->data[4], (Uint8)(MAXPLAYERS - 1));
+	{'RATF', [](PacketReader& packet){
+	    const int player = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+		Uint32 uid = packet.read32();
+		if ( !packet.ok() )
+		{
+			return;
+		}
 		client_keepalive[player] = ticks;
-		Uint32 uid = SDLNet_Read32(&net_packet->data[5]);
 		Entity* entity = uidToEntity(uid);
 		if ( entity )
 		{
@@ -5650,22 +7812,27 @@ static std::unordered_map<Uint32, void(*)()> serverPacketHandlers = {
 	}},
 
 	// clicked entity out of range
-	{'CKOR', [](){
-		Uint32 uid = SDLNet_Read32(&net_packet->data[5]);
+	{'CKOR', [](PacketReader& packet){
+	    const int player = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+		Uint32 uid = packet.read32();
+		if ( !packet.ok() )
+		{
+			return;
+		}
 		Entity* entity = uidToEntity(uid);
 		if ( entity )
 		{
-			client_selected[net_packet->data[4]] = entity;
-			inrange[net_packet->data[4]] = false;
+			client_selected[player] = entity;
+			inrange[player] = false;
 		}
 	}},
 
 	// disconnect
-	{'DISC', [](){
+	{'DISC', [](PacketReader& packet){
 	    // TODO verify packet origin
 		char shortname[32];
-		const int playerDisconnected = std::min(net_packet->data[4], (Uint8)(MAXPLAYERS - 1));
-	    if (playerDisconnected == 0) {
+		const int playerDisconnected = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+	    if (!packet.ok() || playerDisconnected == 0) {
 	        // yeah right
 	        return;
 	    }
@@ -5689,11 +7856,24 @@ static std::unordered_map<Uint32, void(*)()> serverPacketHandlers = {
 	}},
 
 	// client callout
-	{'CALL', []() {
-		const int pnum = std::min(net_packet->data[4], (Uint8)(MAXPLAYERS - 1));
+	{'CALL', [](PacketReader& packet) {
+		const int pnum = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+		Uint32 uid = packet.read32();
+		CalloutRadialMenu::CalloutCommand cmd = (CalloutRadialMenu::CalloutCommand)packet.read8();
+		const Uint32 helpFlags = packet.read32();
+		real_t x = 0.0;
+		real_t y = 0.0;
+		if ( uid == 0 )
+		{
+			x = packet.read16();
+			y = packet.read16();
+		}
+		if ( !packet.ok() )
+		{
+			return;
+		}
 		if ( pnum != clientnum )
 		{
-			Uint32 uid = SDLNet_Read32(&net_packet->data[5]);
 			Entity* entity = uidToEntity(uid);
 			if ( uid != 0 )
 			{
@@ -5703,12 +7883,9 @@ static std::unordered_map<Uint32, void(*)()> serverPacketHandlers = {
 				}
 			}
 			CalloutMenu[pnum].lockOnEntityUid = uid;
-			CalloutRadialMenu::CalloutCommand cmd = (CalloutRadialMenu::CalloutCommand)net_packet->data[9];
-			CalloutMenu[pnum].clientCalloutHelpFlags = SDLNet_Read32(&net_packet->data[10]);
+			CalloutMenu[pnum].clientCalloutHelpFlags = helpFlags;
 			if ( uid == 0 )
 			{
-				real_t x = SDLNet_Read16(&net_packet->data[14]);
-				real_t y = SDLNet_Read16(&net_packet->data[16]);
 				if ( CalloutMenu[pnum].createParticleCallout(x * 16.0 + 8.0, y * 16.0 + 8.0, -4, 0, cmd) )
 				{
 					CalloutMenu[pnum].sendCalloutText(cmd);
@@ -5750,17 +7927,23 @@ static std::unordered_map<Uint32, void(*)()> serverPacketHandlers = {
 	}},
 
 	// message
-	{'MSGS', [](){
-		const int pnum = std::min(net_packet->data[4], (Uint8)(MAXPLAYERS - 1));
+	{'MSGS', [](PacketReader& packet){
+		const int pnum = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+		Uint32 color = packet.read32();
+		char text[NET_PACKET_SIZE];
+		packet.readString(text, sizeof(text));
+		if ( !packet.ok() )
+		{
+			return;
+		}
 		client_keepalive[pnum] = ticks;
-		Uint32 color = SDLNet_Read32(&net_packet->data[5]);
 		MessageType type = MESSAGE_CHAT; // the only kind of message you can get from a client.
 
 		char shortname[32];
 		stringCopy(shortname, stats[pnum]->name, sizeof(shortname), 22);
 
 		char fmt[1024];
-		const int len = snprintf(fmt, sizeof(fmt), "%s: %s", shortname, (char*)(&net_packet->data[9]));
+		const int len = snprintf(fmt, sizeof(fmt), "%s: %s", shortname, text);
 		messagePlayerColor(clientnum, type, color, fmt);
 
 		playSound(Message::CHAT_MESSAGE_SFX, 64);
@@ -5784,10 +7967,14 @@ static std::unordered_map<Uint32, void(*)()> serverPacketHandlers = {
 	}},
 
 	// spotting (examining)
-	{'SPOT', [](){
-		const int player = std::min(net_packet->data[4], (Uint8)(MAXPLAYERS - 1));
+	{'SPOT', [](PacketReader& packet){
+		const int player = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+		Uint32 uid = packet.read32();
+		if ( !packet.ok() )
+		{
+			return;
+		}
 		client_keepalive[player] = ticks;
-		Uint32 uid = SDLNet_Read32(&net_packet->data[5]);
 		Entity* entity = uidToEntity(uid);
 		if ( entity )
 		{
@@ -5796,35 +7983,33 @@ static std::unordered_map<Uint32, void(*)()> serverPacketHandlers = {
 	}},
 
 	// item drop
-	{'DROP', [](){
-	    const int player = std::min(net_packet->data[25], (Uint8)(MAXPLAYERS - 1));
+	{'DROP', [](PacketReader& packet){
+		PacketItem_t fields;
+		fields.read(packet);
+	    const int player = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+		if ( !packet.ok() )
+		{
+			return;
+		}
 		client_keepalive[player] = ticks;
-		auto item = newItem(static_cast<ItemType>(SDLNet_Read32(&net_packet->data[4])),
-		    static_cast<Status>(SDLNet_Read32(&net_packet->data[8])),
-		    SDLNet_Read32(&net_packet->data[12]),
-		    SDLNet_Read32(&net_packet->data[16]),
-		    SDLNet_Read32(&net_packet->data[20]),
-		    net_packet->data[24],
-		    &stats[player]->inventory);
+		auto item = fields.create(&stats[player]->inventory);
 		dropItem(item, player);
 	}},
 
 	// item drop (on death)
-	{'DIEI', [](){
-	    const int player = std::min(net_packet->data[25], (Uint8)(MAXPLAYERS - 1));
-		auto item = newItem(
-		    static_cast<ItemType>(SDLNet_Read32(&net_packet->data[4])),
-		    static_cast<Status>(SDLNet_Read32(&net_packet->data[8])),
-		    SDLNet_Read32(&net_packet->data[12]),
-		    SDLNet_Read32(&net_packet->data[16]),
-		    SDLNet_Read32(&net_packet->data[20]),
-		    net_packet->data[24],
-		    nullptr);
-
-		real_t x = net_packet->data[26];
+	{'DIEI', [](PacketReader& packet){
+		PacketItem_t fields;
+		fields.read(packet);
+	    const int player = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+		real_t x = packet.read8();
 		x = (x * 16) + 8;
-		real_t y = net_packet->data[27];
+		real_t y = packet.read8();
 		y = (y * 16) + 8;
+		if ( !packet.ok() )
+		{
+			return;
+		}
+		auto item = fields.create(nullptr);
 
 		stats[0]->addItemToLootingBag(player, x, y, *item);
 		if ( item->node )
@@ -5864,9 +8049,14 @@ static std::unordered_map<Uint32, void(*)()> serverPacketHandlers = {
 	}},
 
 	// raise/lower shield
-	{'SHLD', [](){
-		const int player = std::min(net_packet->data[4], (Uint8)(MAXPLAYERS - 1));
-		stats[player]->defending = net_packet->data[5];
+	{'SHLD', [](PacketReader& packet){
+		const int player = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+		const Uint8 defending = packet.read8();
+		if ( !packet.ok() )
+		{
+			return;
+		}
+		stats[player]->defending = defending;
         for (int c = 1; c < MAXPLAYERS; ++c) {
             // relay packet to other players
             if (client_disconnected[c] || c == player) {
@@ -5879,9 +8069,14 @@ static std::unordered_map<Uint32, void(*)()> serverPacketHandlers = {
 	}},
 
 	// sneaking
-	{'SNEK', [](){
-		const int player = std::min(net_packet->data[4], (Uint8)(MAXPLAYERS - 1));
-		stats[player]->sneaking = net_packet->data[5];
+	{'SNEK', [](PacketReader& packet){
+		const int player = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+		const Uint8 sneaking = packet.read8();
+		if ( !packet.ok() )
+		{
+			return;
+		}
+		stats[player]->sneaking = sneaking;
         for (int c = 1; c < MAXPLAYERS; ++c) {
             // relay packet to other players
             if (client_disconnected[c] || c == player) {
@@ -5894,11 +8089,12 @@ static std::unordered_map<Uint32, void(*)()> serverPacketHandlers = {
 	}},
 
 	// ghost sneaking
-	{ 'GHOD', []() {
-		const int player = std::min(net_packet->data[4], (Uint8)(MAXPLAYERS - 1));
-		if ( players[player]->ghost.my )
+	{ 'GHOD', [](PacketReader& packet) {
+		const int player = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+		const Uint8 sneaking = packet.read8();
+		if ( packet.ok() && players[player]->ghost.my )
 		{
-			players[player]->ghost.my->skill[3] = net_packet->data[5];
+			players[player]->ghost.my->skill[3] = sneaking;
 			for ( int c = 1; c < MAXPLAYERS; ++c ) {
 				// relay packet to other players
 				if ( client_disconnected[c] || c == player ) {
@@ -5912,8 +8108,9 @@ static std::unordered_map<Uint32, void(*)()> serverPacketHandlers = {
 	}},
 
 	// close shop
-	{'SHPC', [](){
-		Entity* entity = uidToEntity((Uint32)SDLNet_Read32(&net_packet->data[4]));
+	{'SHPC', [](PacketReader& packet){
+		const Uint32 uid = packet.read32();
+		Entity* entity = packet.ok() ? uidToEntity(uid) : nullptr;
 		if ( entity )
 		{
 			entity->skill[0] = 0;
@@ -5924,9 +8121,21 @@ static std::unordered_map<Uint32, void(*)()> serverPacketHandlers = {
 	}},
 
 	// buy item from shop
-	{'SHPB', [](){
-		Uint32 uidnum = (Uint32)SDLNet_Read32(&net_packet->data[4]);
-		const int client = std::min(net_packet->data[29], (Uint8)(MAXPLAYERS - 1));
+	{'SHPB', [](PacketReader& packet){
+		Uint32 uidnum = packet.read32();
+		const Uint32 type = packet.read32();
+		const Uint32 status = packet.read32();
+		const Sint16 beatitude = packet.read16();
+		const Sint8 shopx = (Sint8)packet.read8();
+		const Sint8 shopy = (Sint8)packet.read8();
+		const Uint32 appearance = packet.read32();
+		const Uint32 count = packet.read32();
+		const Uint8 flags = packet.read8();
+		const int client = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+		if ( !packet.ok() )
+		{
+			return;
+		}
 		Entity* entity = uidToEntity(uidnum);
 		if ( !entity )
 		{
@@ -5940,23 +8149,23 @@ static std::unordered_map<Uint32, void(*)()> serverPacketHandlers = {
 			return;
 		}
 		Item* item = newItem(WOODEN_SHIELD, BROKEN, 0, 1, 0, true, nullptr);
-		item->type = static_cast<ItemType>(SDLNet_Read32(&net_packet->data[8]));
-		item->status = static_cast<Status>(SDLNet_Read32(&net_packet->data[12]));
-		item->beatitude = SDLNet_Read16(&net_packet->data[16]);
-		item->appearance = SDLNet_Read32(&net_packet->data[20]);
-		item->count = SDLNet_Read32(&net_packet->data[24]);
+		item->type = static_cast<ItemType>(type);
+		item->status = static_cast<Status>(status);
+		item->beatitude = beatitude;
+		item->appearance = appearance;
+		item->count = count;
 		item->identified = false;
-		if ( net_packet->data[28] & 1 )
+		if ( flags & 1 )
 		{
 			item->identified = true;
 		}
 		item->playerSoldItemToShop = false;
-		if ( (net_packet->data[28] >> 4) & 1 )
+		if ( (flags >> 4) & 1 )
 		{
 			item->playerSoldItemToShop = true;
 		}
-		item->x = (Sint8)net_packet->data[18];
-		item->y = (Sint8)net_packet->data[19];
+		item->x = shopx;
+		item->y = shopy;
 		node_t* nextnode;
 		for ( auto node = entitystats->inventory.first; node != NULL; node = nextnode )
 		{
@@ -6049,9 +8258,14 @@ static std::unordered_map<Uint32, void(*)()> serverPacketHandlers = {
 	}},
 
 	//Remove a spell from the channeled spells list.
-	{'UNCH', [](){
-		const int client = std::min(net_packet->data[4], (Uint8)(MAXPLAYERS - 1));
-		spell_t* thespell = getSpellFromID(SDLNet_Read32(&net_packet->data[5]));
+	{'UNCH', [](PacketReader& packet){
+		const int client = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+		const Uint32 spellID = packet.read32();
+		if ( !packet.ok() )
+		{
+			return;
+		}
+		spell_t* thespell = getSpellFromID(spellID);
 		if (spellInList(&channeledSpells[client], thespell))
 		{
 			node_t *node, *nextnode;
@@ -6068,9 +8282,20 @@ static std::unordered_map<Uint32, void(*)()> serverPacketHandlers = {
 	}},
 
 	// sell item to shop
-	{'SHPS', [](){
-		Uint32 uidnum = (Uint32)SDLNet_Read32(&net_packet->data[4]);
-		const int client = std::min(net_packet->data[29], (Uint8)(MAXPLAYERS - 1));
+	{'SHPS', [](PacketReader& packet){
+		Uint32 uidnum = packet.read32();
+		const Uint32 type = packet.read32();
+		const Uint32 status = packet.read32();
+		const Sint16 beatitude = packet.read16();
+		packet.skip(2);
+		const Uint32 appearance = packet.read32();
+		const Uint32 count = packet.read32();
+		bool identified = packet.read8() == 1;
+		const int client = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+		if ( !packet.ok() )
+		{
+			return;
+		}
 		Entity* entity = uidToEntity(uidnum);
 		if ( !entity )
 		{
@@ -6084,13 +8309,12 @@ static std::unordered_map<Uint32, void(*)()> serverPacketHandlers = {
 			return;
 		}
 
-		bool identified = net_packet->data[28] == 1;
 		auto item = newItem(
-		    static_cast<ItemType>(SDLNet_Read32(&net_packet->data[8])),
-		    static_cast<Status>(SDLNet_Read32(&net_packet->data[12])),
-			SDLNet_Read16(&net_packet->data[16]),
-			SDLNet_Read32(&net_packet->data[24]),
-			SDLNet_Read32(&net_packet->data[20]),
+		    static_cast<ItemType>(type),
+		    static_cast<Status>(status),
+			beatitude,
+			count,
+			appearance,
 			identified, nullptr);
 
 		if ( !item )
@@ -6146,67 +8370,69 @@ static std::unordered_map<Uint32, void(*)()> serverPacketHandlers = {
 	}},
 
 	// use item
-	{'USEI', [](){
-		const int client = std::min(net_packet->data[25], (Uint8)(MAXPLAYERS - 1));
-		auto item = newItem(
-		    static_cast<ItemType>(SDLNet_Read32(&net_packet->data[4])),
-		    static_cast<Status>(SDLNet_Read32(&net_packet->data[8])),
-		    SDLNet_Read32(&net_packet->data[12]),
-		    SDLNet_Read32(&net_packet->data[16]),
-		    SDLNet_Read32(&net_packet->data[20]),
-		    net_packet->data[24],
-		    &stats[client]->inventory);
+	{'USEI', [](PacketReader& packet){
+		PacketItem_t fields;
+		fields.read(packet);
+		const int client = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+		if ( !packet.ok() )
+		{
+			return;
+		}
+		auto item = fields.create(&stats[client]->inventory);
 		useItem(item, client);
 	}},
 
 	// use loot bag
-	{ 'LOOT', []() {
-		const int client = std::min(net_packet->data[8], (Uint8)(MAXPLAYERS - 1));
-		Uint32 appearance = SDLNet_Read32(&net_packet->data[4]);
+	{ 'LOOT', [](PacketReader& packet) {
+		Uint32 appearance = packet.read32();
+		const int client = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+		if ( !packet.ok() )
+		{
+			return;
+		}
 		Stat::emptyLootingBag(client, appearance);
 	} },
 
 	// equip item (as a weapon)
-	{'EQUI', [](){
-		const int client = std::min(net_packet->data[25], (Uint8)(MAXPLAYERS - 1));
-		auto item = newItem(
-		    static_cast<ItemType>(SDLNet_Read32(&net_packet->data[4])),
-		    static_cast<Status>(SDLNet_Read32(&net_packet->data[8])),
-		    SDLNet_Read32(&net_packet->data[12]),
-		    SDLNet_Read32(&net_packet->data[16]),
-		    SDLNet_Read32(&net_packet->data[20]),
-		    net_packet->data[24],
-		    &stats[client]->inventory);
+	{'EQUI', [](PacketReader& packet){
+		PacketItem_t fields;
+		fields.read(packet);
+		const int client = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+		if ( !packet.ok() )
+		{
+			return;
+		}
+		auto item = fields.create(&stats[client]->inventory);
 		equipItem(item, &stats[client]->weapon, client, false);
 	}},
 
 	// equip item (as a shield)
-	{'EQUS', [](){
-		const int client = std::min(net_packet->data[25], (Uint8)(MAXPLAYERS - 1));
-		auto item = newItem(
-		    static_cast<ItemType>(SDLNet_Read32(&net_packet->data[4])),
-		    static_cast<Status>(SDLNet_Read32(&net_packet->data[8])),
-		    SDLNet_Read32(&net_packet->data[12]),
-		    SDLNet_Read32(&net_packet->data[16]),
-		    SDLNet_Read32(&net_packet->data[20]),
-		    net_packet->data[24],
-		    &stats[client]->inventory);
+	{'EQUS', [](PacketReader& packet){
+		PacketItem_t fields;
+		fields.read(packet);
+		const int client = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+		if ( !packet.ok() )
+		{
+			return;
+		}
+		auto item = fields.create(&stats[client]->inventory);
 		equipItem(item, &stats[client]->shield, client, false);
 	}},
 
 	// equip item (any other slot)
-	{'EQUM', [](){
-		const int client = std::min(net_packet->data[25], (Uint8)(MAXPLAYERS - 1));
-		auto item = newItem(
-		    static_cast<ItemType>(SDLNet_Read32(&net_packet->data[4])),
-		    static_cast<Status>(SDLNet_Read32(&net_packet->data[8])),
-		    SDLNet_Read32(&net_packet->data[12]),
-		    SDLNet_Read32(&net_packet->data[16]),
-		    SDLNet_Read32(&net_packet->data[20]),
-		    net_packet->data[24],
-		    &stats[client]->inventory);
+	{'EQUM', [](PacketReader& packet){
+		PacketItem_t fields;
+		fields.read(packet);
+		const int client = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+		packet.skip(1);
+		const Uint8 slot = packet.read8();
+		if ( !packet.ok() )
+		{
+			return;
+		}
+		auto item = fields.create(&stats[client]->inventory);
 		
-		switch ( net_packet->data[27] )
+		switch ( slot )
 		{
 			case EQUIP_ITEM_SLOT_WEAPON:
 				equipItem(item, &stats[client]->weapon, client, false);
@@ -6244,21 +8470,21 @@ static std::unordered_map<Uint32, void(*)()> serverPacketHandlers = {
 	}},
 
 	// update appearance of item
-	{ 'EQUA', []() {
-		const int client = std::min(net_packet->data[25], (Uint8)(MAXPLAYERS - 1));
-		auto item = newItem(
-			static_cast<ItemType>(SDLNet_Read32(&net_packet->data[4])),
-			static_cast<Status>(SDLNet_Read32(&net_packet->data[8])),
-			SDLNet_Read32(&net_packet->data[12]),
-			SDLNet_Read32(&net_packet->data[16]),
-			SDLNet_Read32(&net_packet->data[20]),
-			net_packet->data[24],
-			nullptr);
-
-		const bool onIdentify = net_packet->data[27];
+	{ 'EQUA', [](PacketReader& packet) {
+		PacketItem_t fields;
+		fields.read(packet);
+		const int client = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+		const Uint8 equipSlot = packet.read8();
+		const bool onIdentify = packet.read8();
+		if ( !packet.ok() )
+		{
+			return;
+		}
+		auto item = fields.create(nullptr);
+
 		Item* slot = nullptr;
 
-		switch ( net_packet->data[26] )
+		switch ( equipSlot )
 		{
 			case ItemEquippableSlot::EQUIPPABLE_IN_SLOT_WEAPON:
 				slot = stats[client]->weapon;
@@ -6315,17 +8541,17 @@ static std::unordered_map<Uint32, void(*)()> serverPacketHandlers = {
 	} },
 
 	// apply item to entity
-	{'APIT', [](){
-		const int client = std::min(net_packet->data[25], (Uint8)(MAXPLAYERS - 1));
-		auto item = newItem(
-		    static_cast<ItemType>(SDLNet_Read32(&net_packet->data[4])),
-		    static_cast<Status>(SDLNet_Read32(&net_packet->data[8])),
-		    SDLNet_Read32(&net_packet->data[12]),
-		    SDLNet_Read32(&net_packet->data[16]),
-		    SDLNet_Read32(&net_packet->data[20]),
-		    net_packet->data[24],
-		    NULL);
-		Entity* entity = uidToEntity(SDLNet_Read32(&net_packet->data[26]));
+	{'APIT', [](PacketReader& packet){
+		PacketItem_t fields;
+		fields.read(packet);
+		const int client = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+		const Uint32 uid = packet.read32();
+		if ( !packet.ok() )
+		{
+			return;
+		}
+		auto item = fields.create(NULL);
+		Entity* entity = uidToEntity(uid);
 		if ( entity )
 		{
 			item->apply(client, entity);
@@ -6338,34 +8564,39 @@ static std::unordered_map<Uint32, void(*)()> serverPacketHandlers = {
 	}},
 
 	// apply item to entity
-	{'APIW', [](){
-		const int client = std::min(net_packet->data[25], (Uint8)(MAXPLAYERS - 1));
-		auto item = newItem(
-		    static_cast<ItemType>(SDLNet_Read32(&net_packet->data[4])),
-		    static_cast<Status>(SDLNet_Read32(&net_packet->data[8])),
-		    SDLNet_Read32(&net_packet->data[12]),
-		    SDLNet_Read32(&net_packet->data[16]),
-		    SDLNet_Read32(&net_packet->data[20]),
-		    net_packet->data[24],
-		    NULL);
-		int wallx = (SDLNet_Read16(&net_packet->data[26]));
-		int wally = (SDLNet_Read16(&net_packet->data[28]));
+	{'APIW', [](PacketReader& packet){
+		PacketItem_t fields;
+		fields.read(packet);
+		const int client = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+		int wallx = packet.read16();
+		int wally = packet.read16();
+		if ( !packet.ok() )
+		{
+			return;
+		}
+		auto item = fields.create(NULL);
 		item->applyLockpickToWall(client, wallx, wally);
 		free(item);
 	}},
 
 	// attacking
-	{'ATAK', [](){
-	    const int player = std::min(net_packet->data[4], (Uint8)(MAXPLAYERS - 1));
-		if (players[player] && players[player]->entity)
+	{'ATAK', [](PacketReader& packet){
+	    const int player = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+		const Uint8 pose = packet.read8();
+		const Uint8 charge = packet.read8();
+		if (packet.ok() && players[player] && players[player]->entity)
 		{
-			players[player]->entity->attack(net_packet->data[5], net_packet->data[6], nullptr);
+			players[player]->entity->attack(pose, charge, nullptr);
 		}
 	}},
 
 	//Multiplayer chest code (server).
-	{'CCLS', [](){
-	    const int player = std::min(net_packet->data[4], (Uint8)(MAXPLAYERS - 1));
+	{'CCLS', [](PacketReader& packet){
+	    const int player = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+		if ( !packet.ok() )
+		{
+			return;
+		}
 		if (openedChest[player])
 		{
 			openedChest[player]->closeChestServer();
@@ -6373,8 +8604,12 @@ static std::unordered_map<Uint32, void(*)()> serverPacketHandlers = {
 	}},
 
 	//The client failed some alchemy.
-	{'BOOM', [](){
-	    const int player = std::min(net_packet->data[4], (Uint8)(MAXPLAYERS - 1));
+	{'BOOM', [](PacketReader& packet){
+	    const int player = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+		if ( !packet.ok() )
+		{
+			return;
+		}
 		if ( players[player] && players[player]->entity )
 		{
 			bool protection = false;
@@ -6402,13 +8637,19 @@ static std::unordered_map<Uint32, void(*)()> serverPacketHandlers = {
 	}},
 
 	//The client cast a spell.
-	{'SPEL', [](){
-	    const int player = std::min(net_packet->data[4], (Uint8)(MAXPLAYERS - 1));
+	{'SPEL', [](PacketReader& packet){
+	    const int player = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+		const Uint32 spellID = packet.read32();
+		const Uint8 trap = packet.read8();
+		if ( !packet.ok() )
+		{
+			return;
+		}
 
-		spell_t* thespell = getSpellFromID(SDLNet_Read32(&net_packet->data[5]));
+		spell_t* thespell = getSpellFromID(spellID);
 		if ( players[player] && players[player]->entity )
 		{
-			if ( net_packet->data[9] == 1 )
+			if ( trap == 1 )
 			{
 				castSpell(players[player]->entity->getUID(), thespell, false, false, true);
 			}
@@ -6420,10 +8661,15 @@ static std::unordered_map<Uint32, void(*)()> serverPacketHandlers = {
 	}},
 
 	//The client ghost cast a spell.
-	{'GHSP', []() {
-		const int player = std::min(net_packet->data[4], (Uint8)(MAXPLAYERS - 1));
+	{'GHSP', [](PacketReader& packet) {
+		const int player = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+		const Uint32 spellID = packet.read32();
+		if ( !packet.ok() )
+		{
+			return;
+		}
 
-		spell_t* thespell = getSpellFromID(SDLNet_Read32(&net_packet->data[5]));
+		spell_t* thespell = getSpellFromID(spellID);
 		if ( players[player] && players[player]->ghost.isActive() )
 		{
 			castSpell(players[player]->ghost.my->getUID(), thespell, false, true);
@@ -6431,48 +8677,57 @@ static std::unordered_map<Uint32, void(*)()> serverPacketHandlers = {
 	}},
 
 	//The client added an item to the chest.
-	{'CITM', [](){
-	    const int player = std::min(net_packet->data[4], (Uint8)(MAXPLAYERS - 1));
-		if (!openedChest[player])
+	{'CITM', [](PacketReader& packet){
+	    const int player = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+		PacketItem_t fields;
+		fields.read(packet);
+		bool forceNewStack = packet.read8() ? true : false;
+		if (!packet.ok() || !openedChest[player])
 		{
 			return;
 		}
 
 		Item* newitem = newItem(WOODEN_SHIELD, BROKEN, 0, 1, 0, true, nullptr);
-		newitem->type = static_cast<ItemType>(SDLNet_Read32(&net_packet->data[5]));
-		newitem->status = static_cast<Status>(SDLNet_Read32(&net_packet->data[9]));
-		newitem->beatitude = SDLNet_Read32(&net_packet->data[13]);
-		newitem->count = SDLNet_Read32(&net_packet->data[17]);
-		newitem->appearance = SDLNet_Read32(&net_packet->data[21]);
-		newitem->identified = net_packet->data[25];
-		bool forceNewStack = net_packet->data[26] ? true : false;
+		newitem->type = static_cast<ItemType>(fields.type);
+		newitem->status = static_cast<Status>(fields.status);
+		newitem->beatitude = fields.beatitude;
+		newitem->count = fields.count;
+		newitem->appearance = fields.appearance;
+		newitem->identified = fields.identified;
 		openedChest[player]->addItemToChestServer(newitem, forceNewStack, nullptr);
 	}},
 
 	//The client removed an item from the chest.
-	{'RCIT', [](){
-	    const int player = std::min(net_packet->data[4], (Uint8)(MAXPLAYERS - 1));
-		if (!openedChest[player])
+	{'RCIT', [](PacketReader& packet){
+	    const int player = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+		PacketItem_t fields;
+		fields.read(packet);
+		if (!packet.ok() || !openedChest[player])
 		{
 			return;
 		}
 
 		Item* item = newItem(WOODEN_SHIELD, BROKEN, 0, 1, 0, true, nullptr);
-		item->type = static_cast<ItemType>(SDLNet_Read32(&net_packet->data[5]));
-		item->status = static_cast<Status>(SDLNet_Read32(&net_packet->data[9]));
-		item->beatitude = SDLNet_Read32(&net_packet->data[13]);
-		item->count = SDLNet_Read32(&net_packet->data[17]);
-		item->appearance = SDLNet_Read32(&net_packet->data[21]);
-		item->identified = net_packet->data[25];
+		item->type = static_cast<ItemType>(fields.type);
+		item->status = static_cast<Status>(fields.status);
+		item->beatitude = fields.beatitude;
+		item->count = fields.count;
+		item->appearance = fields.appearance;
+		item->identified = fields.identified;
 
 		openedChest[player]->removeItemFromChestServer(item, item->count);
 	}},
 
 	// the client removed a curse on his equipment
-	{'RCUR', [](){
+	{'RCUR', [](PacketReader& packet){
 	    Item* item;
-	    const int player = std::min(net_packet->data[4], (Uint8)(MAXPLAYERS - 1));
-		switch ( net_packet->data[5] )
+	    const int player = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+		const Uint8 slot = packet.read8();
+		if ( !packet.ok() )
+		{
+			return;
+		}
+		switch ( slot )
 		{
 			case 0:
 				item = stats[player]->helmet;
@@ -6515,11 +8770,17 @@ static std::unordered_map<Uint32, void(*)()> serverPacketHandlers = {
 	}},
 
 	// the client repaired equipment or otherwise modified status of equipment.
-	{'REPA', [](){
-	    const int player = std::min(net_packet->data[4], (Uint8)(MAXPLAYERS - 1));
+	{'REPA', [](PacketReader& packet){
+	    const int player = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+		const Uint8 slot = packet.read8();
+		const int status = packet.read8();
+		if ( !packet.ok() )
+		{
+			return;
+		}
 		Item* equipment = nullptr;
 
-		switch ( net_packet->data[5] )
+		switch ( slot )
 		{
 			case 0:
 				equipment = stats[player]->weapon;
@@ -6555,24 +8816,31 @@ static std::unordered_map<Uint32, void(*)()> serverPacketHandlers = {
 			return;
 		}
 		
-		if ( static_cast<int>(net_packet->data[6]) > EXCELLENT )
+		if ( status > EXCELLENT )
 		{
 			equipment->status = EXCELLENT;
 		}
-		else if ( static_cast<int>(net_packet->data[6]) < BROKEN )
+		else if ( status < BROKEN )
 		{
 			equipment->status = BROKEN;
 		}
-		equipment->status = static_cast<Status>(net_packet->data[6]);
+		equipment->status = static_cast<Status>(status);
 		return;
 	}},
 
 	// the client repaired tinkering bots
-	{ 'REPT', []() {
-		const int player = std::min(net_packet->data[4], (Uint8)(MAXPLAYERS - 1));
+	{ 'REPT', [](PacketReader& packet) {
+		const int player = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+		const Uint8 slot = packet.read8();
+		const int status = packet.read8();
+		const Uint32 appearance = packet.read32();
+		if ( !packet.ok() )
+		{
+			return;
+		}
 		Item* equipment = nullptr;
 
-		switch ( net_packet->data[5] )
+		switch ( slot )
 		{
 			case 0:
 				equipment = stats[player]->weapon;
@@ -6615,26 +8883,32 @@ static std::unordered_map<Uint32, void(*)()> serverPacketHandlers = {
 			return;
 		}
 
-		if ( static_cast<int>(net_packet->data[6]) > EXCELLENT )
+		if ( status > EXCELLENT )
 		{
 			equipment->status = EXCELLENT;
 		}
-		else if ( static_cast<int>(net_packet->data[6]) < BROKEN )
+		else if ( status < BROKEN )
 		{
 			equipment->status = BROKEN;
 		}
-		equipment->status = static_cast<Status>(net_packet->data[6]);
-		equipment->appearance = static_cast<Uint32>(SDLNet_Read32(&net_packet->data[7]));
+		equipment->status = static_cast<Status>(status);
+		equipment->appearance = appearance;
 		return;
 	} },
 
 	// the client changed beatitude of equipment.
-	{'BEAT', [](){
-	    const int player = std::min(net_packet->data[4], (Uint8)(MAXPLAYERS - 1));
+	{'BEAT', [](PacketReader& packet){
+	    const int player = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+		const Uint8 slot = packet.read8();
+		const int beatitude = packet.read8();
+		if ( !packet.ok() )
+		{
+			return;
+		}
 		Item* equipment = nullptr;
-		//messagePlayer(0, "client: %d, armornum: %d, status %d", player, net_packet->data[5], net_packet->data[6]);
+		//messagePlayer(0, "client: %d, armornum: %d, status %d", player, slot, beatitude);
 
-		switch ( net_packet->data[5] )
+		switch ( slot )
 		{
 			case 0:
 				equipment = stats[player]->weapon;
@@ -6670,14 +8944,18 @@ static std::unordered_map<Uint32, void(*)()> serverPacketHandlers = {
 			return;
 		}
 
-		equipment->beatitude = net_packet->data[6] - 100; // we sent the data beatitude + 100
+		equipment->beatitude = beatitude - 100; // we sent the data beatitude + 100
 		//messagePlayer(0, "%d", equipment->beatitude);
 	}},
 
 	// client dropped gold
-	{'DGLD', [](){
-	    const int player = std::min(net_packet->data[4], (Uint8)(MAXPLAYERS - 1));
-		int amount = SDLNet_Read32(&net_packet->data[5]);
+	{'DGLD', [](PacketReader& packet){
+	    const int player = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+		int amount = packet.read32();
+		if ( !packet.ok() )
+		{
+			return;
+		}
 
 		if ( stats[player]->GOLD < 0 )
 		{
@@ -6712,9 +8990,13 @@ static std::unordered_map<Uint32, void(*)()> serverPacketHandlers = {
 	}},
 
 	// client played a sound
-	{'EMOT', [](){
-	    const int player = std::min(net_packet->data[4], (Uint8)(MAXPLAYERS - 1));
-		const int sfx = SDLNet_Read16(&net_packet->data[5]);
+	{'EMOT', [](PacketReader& packet){
+	    const int player = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+		const int sfx = packet.read16();
+		if ( !packet.ok() )
+		{
+			return;
+		}
 		if ( players[player] && players[player]->entity )
 		{
 			playSoundEntityLocal(players[player]->entity, sfx, 92);
@@ -6737,8 +9019,12 @@ static std::unordered_map<Uint32, void(*)()> serverPacketHandlers = {
 	}},
 
 	// the client asked for a level up
-	{'CLVL', [](){
-	    const int player = std::min(net_packet->data[4], (Uint8)(MAXPLAYERS - 1));
+	{'CLVL', [](PacketReader& packet){
+	    const int player = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+		if ( !packet.ok() )
+		{
+			return;
+		}
 		if ( players[player] && players[player]->entity )
 		{
 			players[player]->entity->getStats()->EXP += 100;
@@ -6746,10 +9032,10 @@ static std::unordered_map<Uint32, void(*)()> serverPacketHandlers = {
 	}},
 
 	// the client asked for a level up
-	{'CSKL', [](){
-	    const int player = std::min(net_packet->data[4], (Uint8)(MAXPLAYERS - 1));
-		const int skill = net_packet->data[5];
-		if ( player > 0 && player < MAXPLAYERS && players[player] && players[player]->entity )
+	{'CSKL', [](PacketReader& packet){
+	    const int player = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+		const int skill = packet.read8();
+		if ( packet.ok() && player > 0 && player < MAXPLAYERS && players[player] && players[player]->entity )
 		{
 			if ( skill >= 0 && skill < NUMPROFICIENCIES )
 			{
@@ -6759,25 +9045,33 @@ static std::unordered_map<Uint32, void(*)()> serverPacketHandlers = {
 	}},
 
 	// the client sent a minimap ping packet.
-	{'PMAP', [](){
-		MinimapPing newPing(ticks, net_packet->data[4], 
-			net_packet->data[5], 
-			net_packet->data[6],
+	{'PMAP', [](PacketReader& packet){
+		const Uint8 player = packet.read8();
+		const Uint8 x = packet.read8();
+		const Uint8 y = packet.read8();
+		const Uint8 pingType = packet.read8();
+		if ( !packet.ok() )
+		{
+			return;
+		}
+		MinimapPing newPing(ticks, player, 
+			x, 
+			y,
 			false,
-			(MinimapPing::PingType)net_packet->data[7]);
-		sendMinimapPing(net_packet->data[4], newPing.x, newPing.y, newPing.pingType); // relay self and to other clients.
+			(MinimapPing::PingType)pingType);
+		sendMinimapPing(player, newPing.x, newPing.y, newPing.pingType); // relay self and to other clients.
 	}},
 
 	// the client sent a gameplayer preferences update
-	{ 'GPPR', []() {
-		GameplayPreferences_t::receivePacket();
+	{ 'GPPR', [](PacketReader& packet) {
+		GameplayPreferences_t::receivePacket(packet);
 	}},
 
 	//Remove vampiric aura
-	{'VAMP', [](){
-	    const int player = std::min(net_packet->data[4], (Uint8)(MAXPLAYERS - 1));
-		const int spellID = SDLNet_Read32(&net_packet->data[5]);
-		if ( players[player] && players[player]->entity && stats[player] )
+	{'VAMP', [](PacketReader& packet){
+	    const int player = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+		const int spellID = packet.read32();
+		if ( packet.ok() && players[player] && players[player]->entity && stats[player] )
 		{
 			if ( client_classes[player] == CLASS_ACCURSED &&
 				stats[player]->EFFECTS[EFF_VAMPIRICAURA] && players[player]->entity->playerVampireCurse == 1 )
@@ -6796,31 +9090,41 @@ static std::unordered_map<Uint32, void(*)()> serverPacketHandlers = {
 	}},
 
 	// the client sent a monster command.
-	{'ALLY', [](){
-	    const int player = std::min(net_packet->data[4], (Uint8)(MAXPLAYERS - 1));
-		const int allyCmd = net_packet->data[5];
-		const Uint32 uid = SDLNet_Read32(&net_packet->data[8]);
-		//messagePlayer(0, " received %d, %d, %d, %d, %d", player, allyCmd, net_packet->data[6], net_packet->data[7], uid);
+	{'ALLY', [](PacketReader& packet){
+	    const int player = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+		const int allyCmd = packet.read8();
+		const Uint8 destX = packet.read8();
+		const Uint8 destY = packet.read8();
+		const Uint32 uid = packet.read32();
+		if ( !packet.ok() )
+		{
+			return;
+		}
+		//messagePlayer(0, " received %d, %d, %d, %d, %d", player, allyCmd, destX, destY, uid);
 		Entity* entity = uidToEntity(uid);
 		if ( entity )
 		{
-			if ( net_packet->len > 12 )
+			if ( packet.remaining() > 0 )
 			{
-				Uint32 interactUid = SDLNet_Read32(&net_packet->data[12]);
-				entity->monsterAllySendCommand(allyCmd, net_packet->data[6], net_packet->data[7], interactUid);
+				Uint32 interactUid = packet.read32();
+				if ( !packet.ok() )
+				{
+					return;
+				}
+				entity->monsterAllySendCommand(allyCmd, destX, destY, interactUid);
 				//messagePlayer(0, "received UID of target: %d, applying...", uid);
 				entity->monsterAllyInteractTarget = interactUid;
 			}
 			else
 			{
-				entity->monsterAllySendCommand(allyCmd, net_packet->data[6], net_packet->data[7]);
+				entity->monsterAllySendCommand(allyCmd, destX, destY);
 			}
 		}
 	}},
 
-	{'IDIE', [](){
-		const int playerDie = net_packet->data[4];
-		if ( playerDie >= 1 && playerDie < MAXPLAYERS )
+	{'IDIE', [](PacketReader& packet){
+		const int playerDie = packet.read8();
+		if ( packet.ok() && playerDie >= 1 && playerDie < MAXPLAYERS )
 		{
 			if ( players[playerDie] && players[playerDie]->entity )
 			{
@@ -6830,22 +9134,25 @@ static std::unordered_map<Uint32, void(*)()> serverPacketHandlers = {
 	}},
 
 	// use automaton food item
-	{'FODA', [](){
-	    const int player = std::min(net_packet->data[25], (Uint8)(MAXPLAYERS - 1));
-		auto item = newItem(
-		    static_cast<ItemType>(SDLNet_Read32(&net_packet->data[4])),
-		    static_cast<Status>(SDLNet_Read32(&net_packet->data[8])),
-		    SDLNet_Read32(&net_packet->data[12]),
-		    SDLNet_Read32(&net_packet->data[16]),
-		    SDLNet_Read32(&net_packet->data[20]),
-		    net_packet->data[24],
-		    &stats[player]->inventory);
+	{'FODA', [](PacketReader& packet){
+		PacketItem_t fields;
+		fields.read(packet);
+	    const int player = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+		if ( !packet.ok() )
+		{
+			return;
+		}
+		auto item = fields.create(&stats[player]->inventory);
 		item_FoodAutomaton(item, player);
 	}},
 
 	// broke a mirror
-	{ 'MIRR', []() {
-		const int player = std::min(net_packet->data[4], (Uint8)(MAXPLAYERS - 1));
+	{ 'MIRR', [](PacketReader& packet) {
+		const int player = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+		if ( !packet.ok() )
+		{
+			return;
+		}
 		if ( players[player]->entity )
 		{
 			if ( players[player]->entity->setEffect(EFF_BLEEDING, true, TICKS_PER_SECOND * 15, true) )
@@ -6860,10 +9167,18 @@ static std::unordered_map<Uint32, void(*)()> serverPacketHandlers = {
 
 void serverHandlePacket()
 {
+	if ( !unpackDepth )
+	{
+		NetStats.count(NetTelemetry::RECEIVED, net_packet->data, net_packet->len);
+	}
 	if (handleSafePacket())
 	{
 		return;
 	}
+	if ( NetMessageQueue::unpack(&serverHandlePacket) )
+	{
+		return;
+	}
 
 #ifdef PACKETINFO
 	char packetinfo[NET_PACKET_SIZE];
@@ -6883,7 +9198,11 @@ void serverHandlePacket()
             (char)net_packet->data[2],
             (char)net_packet->data[3]);
     } else {
-        (*(find->second))(); // handle packet
+        PacketReader packet(net_packet->data, net_packet->len);
+        packet.skip(4); // the id
+        const Uint64 start = SDL_GetPerformanceCounter();
+        (*(find->second))(packet); // handle packet
+        NetStats.handled(packetId, SDL_GetPerformanceCounter() - start);
     }
 }
 
@@ -6897,6 +9216,7 @@ void serverHandlePacket()
 
 void serverHandleMessages(Uint32 framerateBreakInterval)
 {
+	NetLinkSim.update();
 #ifdef STEAMWORKS
 	if (!directConnect && !net_handler)
 	{
@@ -6932,19 +9252,14 @@ void serverHandleMessages(Uint32 framerateBreakInterval)
 			EOSPacketThread(static_cast<void*>(net_handler));
 #endif // USE_EOS
 		}
-		SteamPacketWrapper* packet = nullptr;
-
 		if ( logCheckMainLoopTimers )
 		{
 			DebugStats.messagesT1 = std::chrono::high_resolution_clock::now();
 			DebugStats.handlePacketStartLoop = true;
 		}
 
-		while ( packet = net_handler->getGamePacket() )
+		while ( net_handler->getGamePacket(net_packet) )
 		{
-			memcpy(net_packet->data, packet->data(), packet->len());
-			net_packet->len = packet->len();
-
 			serverHandlePacket(); //Uses net_packet;
 
 			if ( logCheckMainLoopTimers )
@@ -6952,7 +9267,6 @@ void serverHandleMessages(Uint32 framerateBreakInterval)
 				DebugStats.messagesT2WhileLoop = std::chrono::high_resolution_clock::now();
 				DebugStats.handlePacketStartLoop = false;
 			}
-			delete packet;
 			if ( !net_handler )
 			{
 				break;
@@ -6984,6 +9298,8 @@ void serverHandleMessages(Uint32 framerateBreakInterval)
 			serverHandlePacket(); //Uses net_packet.
 		}
 	}
+	NetMessages.flush(); // replies queued by the handlers
+	SafePackets.flushAcks(); // one ack for everything that came in
 }
 
 /*-------------------------------------------------------------------------------
@@ -6997,129 +9313,7 @@ void serverHandleMessages(Uint32 framerateBreakInterval)
 
 bool handleSafePacket()
 {
-	node_t* node;
-	int c, j;
-
-	// safe packet
-	Uint32 packetId = SDLNet_Read32(&net_packet->data[0]);
-	if (packetId == 'SAFE')
-	{
-		if ( net_packet->data[4] != MAXPLAYERS )
-		{
-			int receivedPacketNum = SDLNet_Read32(&net_packet->data[5]);
-			Uint8 fromClientnum = net_packet->data[4];
-
-			if ( ticks > (60 * TICKS_PER_SECOND) && (ticks % (TICKS_PER_SECOND / 2) == 0) )
-			{
-				// clear old packets > 60 secs
-				for ( auto it = safePacketsReceivedMap[fromClientnum].begin(); it != safePacketsReceivedMap[fromClientnum].end(); )
-				{
-					if ( it->second < (ticks - 60 * TICKS_PER_SECOND) )
-					{
-						it = safePacketsReceivedMap[fromClientnum].erase(it);
-					}
-					else
-					{
-						++it;
-					}
-				}
-			}
-
-			//auto tmp1 = std::chrono::high_resolution_clock::now();
-			auto find = safePacketsReceivedMap[fromClientnum].find(receivedPacketNum);
-			if ( find != safePacketsReceivedMap[fromClientnum].end() )
-			{
-				return true;
-			}
-
-			/*auto tmp2 = std::chrono::high_resolution_clock::now();
-			std::chrono::duration<double> time_span =
-				std::chrono::duration_cast<std::chrono::duration<double>>(tmp2 - tmp1);
-			double timer = time_span.count() * 1000;*/
-
-			safePacketsReceivedMap[fromClientnum].insert(std::make_pair(receivedPacketNum, ticks));
-
-			// send an ack
-			j = net_packet->data[4];
-			net_packet->data[4] = clientnum;
-			strcpy((char*)net_packet->data, "GOTP");
-			if ( multiplayer == CLIENT )
-			{
-				net_packet->address.host = net_server.host;
-				net_packet->address.port = net_server.port;
-			}
-			else
-			{
-				if ( j > 0 )
-				{
-					net_packet->address.host = net_clients[j - 1].host;
-					net_packet->address.port = net_clients[j - 1].port;
-				}
-			}
-			c = net_packet->len;
-			net_packet->len = 9;
-			if ( multiplayer == CLIENT )
-			{
-				sendPacket(net_sock, -1, net_packet, 0);
-			}
-			else
-			{
-				if ( j > 0 )
-				{
-					sendPacket(net_sock, -1, net_packet, j - 1);
-				}
-			}
-			net_packet->len = c - 9;
-			Uint8 bytedata[NET_PACKET_SIZE];
-			memcpy(&bytedata, net_packet->data + 9, net_packet->len);
-			memcpy(net_packet->data, &bytedata, net_packet->len);
-
-			/*int sprite = -9999;
-			char chr[5];
-			chr[0] = '\0';
-			strncpy(chr, (char*)net_packet->data, 4);
-			chr[4] = '\0';
-			if ( packetId == 'ENTU' )
-			{
-				Entity *entity = uidToEntity((int)SDLNet_Read32(&net_packet->data[4]));
-				if ( entity )
-				{
-					sprite = entity->sprite;
-				}
-			}
-
-			if ( packetId == 'ENTS' )
-			{
-				Entity *entity = uidToEntity((int)SDLNet_Read32(&net_packet->data[4]));
-				if ( entity )
-				{
-					messagePlayer(clientnum, "%s | %d : %d - %d | %d %.8f", chr, entity->sprite, net_packet->data[8],
-						SDLNet_Read32(&net_packet->data[9]), safePacketsReceivedMap[fromClientnum].size(), timer);
-				}
-			}
-			else
-			{
-				messagePlayer(clientnum, "%s | %d %.8f", chr, safePacketsReceivedMap[fromClientnum].size(), timer);
-			}*/
-		}
-	}
-
-	// they got the safe packet
-	else if (packetId == 'GOTP')
-	{
-		for ( node = safePacketsSent.first; node != NULL; node = node->next )
-		{
-			packetsend_t* packet = (packetsend_t*)node->element;
-			if ( packet->num == SDLNet_Read32(&net_packet->data[5]) )
-			{
-				list_RemoveNode(node);
-				break;
-			}
-		}
-		return true;
-	}
-
-	return false;
+	return SafePackets.receive();
 }
 
 /*-------------------------------------------------------------------------------
@@ -7135,6 +9329,11 @@ void closeNetworkInterfaces()
 	printlog("closing network interfaces...\n");
 
 	receivedclientnum = false;
+	NetMessages.clear();
+	BulkTransfers.clear();
+	EntityInterp.reset();
+	NetLinkSim.clear();
+	SafePackets.reset();
 
 	if (net_handler)
 	{
@@ -7195,32 +9394,58 @@ void closeNetworkInterfaces()
 
 /* ***** MULTITHREADED STEAM PACKET HANDLING ***** */
 
-SteamPacketWrapper::SteamPacketWrapper(Uint8* data, int len)
+PacketRing::PacketRing() :
+	slots(new Slot_t[CAPACITY])
+{
+}
+
+PacketRing::Slot_t* PacketRing::beginWrite()
+{
+	const Uint32 h = head.load(std::memory_order_relaxed);
+	if ( h - tail.load(std::memory_order_acquire) >= CAPACITY )
+	{
+		overflows.fetch_add(1, std::memory_order_relaxed);
+		return nullptr;
+	}
+	return &slots[h & (CAPACITY - 1)];
+}
+
+void PacketRing::commitWrite()
 {
-	_data = data;
-	_len = len;
+	head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	received.fetch_add(1, std::memory_order_relaxed);
 }
 
-SteamPacketWrapper::~SteamPacketWrapper()
+bool PacketRing::read(UDPpacket* packet)
 {
-	free(_data);
+	const Uint32 t = tail.load(std::memory_order_relaxed);
+	const Uint32 waiting = head.load(std::memory_order_acquire) - t;
+	if ( !waiting )
+	{
+		return false;
+	}
+	peak = std::max(peak, waiting);
+	const Slot_t& slot = slots[t & (CAPACITY - 1)];
+	memcpy(packet->data, slot.data, slot.len);
+	packet->len = slot.len;
+	tail.store(t + 1, std::memory_order_release);
+	return true;
 }
 
-Uint8*& SteamPacketWrapper::data()
+Uint32 PacketRing::size() const
 {
-	return _data;
+	return head.load(std::memory_order_acquire) - tail.load(std::memory_order_relaxed);
 }
 
-int& SteamPacketWrapper::len()
+void PacketRing::clear()
 {
-	return _len;
+	tail.store(head.load(std::memory_order_acquire), std::memory_order_release);
 }
 
 NetHandler::NetHandler()
 {
 	steam_packet_thread = nullptr;
 	continue_multithreading_steam_packets = false;
-	game_packets_lock = SDL_CreateMutex();
 	continue_multithreading_steam_packets_lock = SDL_CreateMutex();
 }
 
@@ -7235,18 +9460,8 @@ NetHandler::~NetHandler()
 	}
 	printlog("Done.\n");
 
-	SDL_DestroyMutex(game_packets_lock);
-	game_packets_lock = nullptr;
 	SDL_DestroyMutex(continue_multithreading_steam_packets_lock);
 	continue_multithreading_steam_packets_lock = nullptr;
-
-	//Free up packet memory.
-	while (!game_packets.empty())
-	{
-		SteamPacketWrapper* packet = game_packets.front();
-		delete packet;
-		game_packets.pop();
-	}
 }
 
 void NetHandler::toggleMultithreading(bool disableMultithreading)
@@ -7263,8 +9478,6 @@ void NetHandler::toggleMultithreading(bool disableMultithreading)
 				SDL_WaitThread(steam_packet_thread, NULL); //Wait for the thread to finish.
 			}
 			printlog("Done.\n");
-			SDL_DestroyMutex(game_packets_lock);
-			game_packets_lock = nullptr;
 			SDL_DestroyMutex(continue_multithreading_steam_packets_lock);
 			continue_multithreading_steam_packets_lock = nullptr;
 			steam_packet_thread = nullptr;
@@ -7275,7 +9488,6 @@ void NetHandler::toggleMultithreading(bool disableMultithreading)
 		// create the new thread...
 		steam_packet_thread = nullptr;
 		continue_multithreading_steam_packets = false;
-		game_packets_lock = SDL_CreateMutex();
 		continue_multithreading_steam_packets_lock = SDL_CreateMutex();
 		initializeMultithreadedPacketHandling();
 	}
@@ -7306,43 +9518,23 @@ bool NetHandler::getContinueMultithreadingSteamPackets()
 	//SDL_UnlockMutex(continue_multithreading_steam_packets_lock);
 }
 
-void NetHandler::addGamePacket(SteamPacketWrapper* packet)
+bool NetHandler::getGamePacket(UDPpacket* packet)
 {
-	if ( !disableMultithreadedSteamNetworking )
-	{
-		SDL_LockMutex(game_packets_lock);
-		game_packets.push(packet);
-		SDL_UnlockMutex(game_packets_lock);
-	}
-	else
-	{
-		game_packets.push(packet);
-	}
+	// only the game thread reads, only the packet thread writes, so no lock needed
+	return game_packets.read(packet);
 }
 
-SteamPacketWrapper* NetHandler::getGamePacket()
-{
-	SteamPacketWrapper* packet = nullptr;
-	if ( !disableMultithreadedSteamNetworking )
-	{
-		SDL_LockMutex(game_packets_lock);
-		if (!game_packets.empty())
-		{
-			packet = game_packets.front();
-			game_packets.pop();
-		}
-		SDL_UnlockMutex(game_packets_lock);
-	}
-	else
+static ConsoleCommand ccmd_net_handler_stats("/net_handler_stats", "print the steam/EOS receive queue counters",
+	[](int argc, const char** argv) {
+	if ( !net_handler )
 	{
-		if ( !game_packets.empty() )
-		{
-			packet = game_packets.front();
-			game_packets.pop();
-		}
+		messagePlayer(clientnum, MESSAGE_MISC, "no receive queue, not on a steam/EOS connection");
+		return;
 	}
-	return packet;
-}
+	const PacketRing& ring = net_handler->game_packets;
+	messagePlayer(clientnum, MESSAGE_MISC, "receive queue: %u waiting, %u at most, %u received, %u dropped (%u slots)",
+		ring.size(), ring.peak, ring.received.load(), ring.overflows.load(), PacketRing::CAPACITY);
+	});
 
 int EOSPacketThread(void* data)
 {
@@ -7361,10 +9553,7 @@ int EOSPacketThread(void* data)
 	NetHandler& handler = *static_cast<NetHandler*>(data); //Basically, our this.
 	EOS_ProductUserId remoteId = nullptr;
 	Uint32 packetlen = 0;
-	Uint32 bytes_read = 0;
-	Uint8* packet = nullptr;
 	bool run = true;
-	std::queue<SteamPacketWrapper* > packets; //TODO: Expose to game? Use lock-free packets?
 
 	while ( run )   //1. Check if thread is supposed to be running.
 	{
@@ -7374,37 +9563,20 @@ int EOSPacketThread(void* data)
 		while (EOS.HandleReceivedMessages(&remoteId) )
 		{
 			packetlen = std::min<uint32_t>(net_packet->len, NET_PACKET_SIZE - 1);
-			//Read packets and push into queue.
-			packet = static_cast<Uint8*>(malloc(packetlen));
-			memcpy(packet, net_packet->data, packetlen);
 			if ( !EOSFuncs::Helpers_t::isMatchingProductIds(remoteId, EOS.CurrentUserInfo.getProductUserIdHandle())
 				&& net_packet->data[0] )
 			{
-				//Push packet into queue.
-				//TODO: Use lock-free queues?
-				packets.push(new SteamPacketWrapper(packet, packetlen));
-				packet = nullptr;
-			}
-			if ( packet )
-			{
-				free(packet);
+				//Copy the packet straight into the game's queue.
+				PacketRing::Slot_t* slot = handler.game_packets.beginWrite();
+				if ( slot )
+				{
+					memcpy(slot->data, net_packet->data, packetlen);
+					slot->len = packetlen;
+					handler.game_packets.commitWrite();
+				}
 			}
 		}
 
-
-		//3. Now push our local packetstack onto the game's network stack.
-		//Well, that is: analyze packet.
-		//If packet is good, push into queue.
-		//If packet is bad, loop back to start of function.
-
-		while ( !packets.empty() )
-		{
-			//Copy over the packets read in so far, and expose them to the game.
-			SteamPacketWrapper* packet = packets.front();
-			packets.pop();
-			handler.addGamePacket(packet);
-		}
-
 		run = false; // only run thread once if multithreading disabled.
 	}
 #endif // USE_EOS
@@ -7426,10 +9598,9 @@ int steamPacketThread(void* data)
 	Uint32 packetlen = 0;
 	Uint32 bytes_read = 0;
 	CSteamID steam_id_remote;
-	Uint8* packet = nullptr;
+	Uint8 overflow[NET_PACKET_SIZE]; // somewhere to read packets into when the game's queue is full
 	CSteamID mySteamID = SteamUser()->GetSteamID();
 	bool run = true;
-	std::queue<SteamPacketWrapper* > packets; //TODO: Expose to game? Use lock-free packets?
 
 	while (run)   //1. Check if thread is supposed to be running.
 	{
@@ -7439,36 +9610,18 @@ int steamPacketThread(void* data)
 		while (SteamNetworking()->IsP2PPacketAvailable(&packetlen))
 		{
 			packetlen = std::min<uint32_t>(packetlen, NET_PACKET_SIZE - 1);
-			//Read packets and push into queue.
-			packet = static_cast<Uint8* >(malloc(packetlen));
+			//Read packets straight into the game's queue. A full queue still has
+			//to be drained from steam, those packets are dropped.
+			PacketRing::Slot_t* slot = handler.game_packets.beginWrite();
+			Uint8* packet = slot ? slot->data : overflow;
 			if (SteamNetworking()->ReadP2PPacket(packet, packetlen, &bytes_read, &steam_id_remote, 0))
 			{
-				if (packetlen > sizeof(uint32_t) && mySteamID.ConvertToUint64() != steam_id_remote.ConvertToUint64() && net_packet->data[0])
+				if (slot && packetlen > sizeof(uint32_t) && mySteamID.ConvertToUint64() != steam_id_remote.ConvertToUint64() && net_packet->data[0])
 				{
-					//Push packet into queue.
-					//TODO: Use lock-free queues?
-					packets.push(new SteamPacketWrapper(packet, packetlen));
-					packet = nullptr;
+					slot->len = packetlen;
+					handler.game_packets.commitWrite();
 				}
 			}
-			if (packet)
-			{
-				free(packet);
-			}
-		}
-
-
-		//3. Now push our local packetstack onto the game's network stack.
-		//Well, that is: analyze packet.
-		//If packet is good, push into queue.
-		//If packet is bad, loop back to start of function.
-
-		while (!packets.empty())
-		{
-			//Copy over the packets read in so far, and expose them to the game.
-			SteamPacketWrapper* packet = packets.front();
-			packets.pop();
-			handler.addGamePacket(packet);
 		}
 
 		if ( !disableMultithreadedSteamNetworking )
@@ -7593,15 +9746,15 @@ void PingNetworkStatus_t::reset()
 	}
 }
 
-void PingNetworkStatus_t::receive()
+void PingNetworkStatus_t::receive(PacketReader& packet)
 {
-	int player = net_packet->data[4];
-	if ( player < 0 || player >= MAXPLAYERS )
+	int player = packet.read8();
+	Uint32 seq = packet.read32();
+	if ( !packet.ok() || player < 0 || player >= MAXPLAYERS )
 	{
 		return;
 	}
 	auto& p = PingNetworkStatus[player];
-	Uint32 seq = SDLNet_Read32(&net_packet->data[5]);
 
 	auto find = p.pings.find(seq);
 	if ( find != p.pings.end() )
@@ -7629,10 +9782,10 @@ void PingNetworkStatus_t::receive()
 	}
 }
 
-void PingNetworkStatus_t::respond()
+void PingNetworkStatus_t::respond(PacketReader& packet)
 {
-	int player = net_packet->data[4];
-	if ( player < 0 || player >= MAXPLAYERS )
+	int player = packet.read8();
+	if ( !packet.ok() || player < 0 || player >= MAXPLAYERS )
 	{
 		return;
 	}
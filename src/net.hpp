@@ -12,7 +12,12 @@
 #pragma once
 
 #include "game.hpp"
+#include "prng.hpp"
 #include <queue>
+#include <deque>
+#include <bitset>
+#include <atomic>
+#include <memory>
 
 #define DEFAULT_PORT 57165
 #define LOBBY_CHATBOX_LENGTH 62
@@ -27,6 +32,7 @@ extern list_t lobbyChatboxMessages;
 int power(int a, int b);
 int sendPacket(UDPsocket sock, int channel, UDPpacket* packet, int hostnum, bool tryReliable = false);
 int sendPacketSafe(UDPsocket sock, int channel, UDPpacket* packet, int hostnum);
+void resendSafePackets();
 bool messagePlayer(int player, Uint32 type, char const * const message, ...);
 bool messageLocalPlayers(Uint32 type, char const * const message, ...);
 bool messagePlayerColor(int player, Uint32 type, Uint32 color, char const * const message, ...);
@@ -66,6 +72,7 @@ enum NetworkingLobbyJoinRequestResult : int
 	NET_LOBBY_JOIN_DIRECTIP_SUCCESS
 };
 NetworkingLobbyJoinRequestResult lobbyPlayerJoinRequest(int& outResult, bool lockedSlots[4]);
+int directConnectSender(); // player slot net_packet came from, or -1
 Entity* receiveEntity(Entity* entity);
 void clientActions(Entity* entity);
 void clientHandleMessages(Uint32 framerateBreakInterval);
@@ -91,28 +98,253 @@ const Uint32 NUM_SERVER_FLAGS =  9;
 
 extern bool keepInventoryGlobal;
 
-class SteamPacketWrapper
+/*
+ * Bounds checked cursor over a received packet, in the same big endian
+ * byte order as SDLNet_Read16/32. It doesn't own or copy the bytes, so it
+ * can walk net_packet, a slice of a batch, or a buffer on another thread.
+ * A read past the end returns 0 (or an empty string) and marks the reader
+ * failed rather than touching memory outside the packet; handlers check
+ * ok() once after reading instead of checking lengths up front.
+ */
+class PacketReader
 {
-	Uint8* _data;
-	int _len;
-	//TODO: Encapsulate CSteam ID?
 public:
-	SteamPacketWrapper(Uint8* data, int len);
-	~SteamPacketWrapper(); //NOTE: DOES free _data. Don't keep it somewhere else or segfaults will ensue. If you're lucky.
+	PacketReader(const Uint8* data, int len) :
+		buf(data), len(len > 0 ? len : 0)
+	{
+	}
+
+	Uint8 read8()
+	{
+		if ( !need(1) )
+		{
+			return 0;
+		}
+		return buf[pos++];
+	}
+	Uint16 read16()
+	{
+		if ( !need(2) )
+		{
+			return 0;
+		}
+		const Uint16 result = SDLNet_Read16(buf + pos);
+		pos += 2;
+		return result;
+	}
+	Uint32 read32()
+	{
+		if ( !need(4) )
+		{
+			return 0;
+		}
+		const Uint32 result = SDLNet_Read32(buf + pos);
+		pos += 4;
+		return result;
+	}
+	bool readBytes(void* out, int n)
+	{
+		if ( !need(n) )
+		{
+			return false;
+		}
+		memcpy(out, buf + pos, n);
+		pos += n;
+		return true;
+	}
+
+	// copies a nul terminated string of at most size - 1 characters, and
+	// always terminates out. A string that runs off the end fails the read
+	bool readString(char* out, int size)
+	{
+		int n = 0;
+		while ( pos + n < len && buf[pos + n] )
+		{
+			++n;
+		}
+		if ( pos + n >= len || size <= 0 )
+		{
+			failed = true;
+			pos = len;
+			if ( size > 0 )
+			{
+				out[0] = '\0';
+			}
+			return false;
+		}
+		const int copied = n < size - 1 ? n : size - 1;
+		memcpy(out, buf + pos, copied);
+		out[copied] = '\0';
+		pos += n + 1;
+		return true;
+	}
+
+	void skip(int n)
+	{
+		if ( need(n) )
+		{
+			pos += n;
+		}
+	}
+	void seek(int offset) // absolute, from the start of the packet
+	{
+		if ( offset < 0 || offset > len )
+		{
+			failed = true;
+			pos = len;
+			return;
+		}
+		pos = offset;
+	}
+
+	bool ok() const { return !failed; }
+	int offset() const { return pos; }
+	int remaining() const { return len - pos; }
+	int size() const { return len; }
+	const Uint8* data() const { return buf; }
+	const Uint8* current() const { return buf + pos; }
+private:
+	const Uint8* buf;
+	int len;
+	int pos = 0;
+	bool failed = false;
+
+	bool need(int n)
+	{
+		if ( failed || n < 0 || n > len - pos )
+		{
+			failed = true;
+			pos = len;
+			return false;
+		}
+		return true;
+	}
+};
+
+/*
+ * The writing half: appends to a buffer the caller owns and stops with
+ * failed set instead of writing past capacity. finish() copies the length
+ * into a UDPpacket whose data the writer was pointed at.
+ */
+class PacketWriter
+{
+public:
+	PacketWriter(Uint8* data, int capacity) :
+		buf(data), cap(capacity > 0 ? capacity : 0)
+	{
+	}
+	explicit PacketWriter(UDPpacket* packet) :
+		buf(packet->data), cap(packet->maxlen > 0 ? packet->maxlen : NET_PACKET_SIZE)
+	{
+	}
+
+	void writeId(const char* id) // the four character packet id
+	{
+		writeBytes(id, 4);
+	}
+	void write8(Uint8 value)
+	{
+		if ( need(1) )
+		{
+			buf[pos++] = value;
+		}
+	}
+	void write16(Uint16 value)
+	{
+		if ( need(2) )
+		{
+			SDLNet_Write16(value, buf + pos);
+			pos += 2;
+		}
+	}
+	void write32(Uint32 value)
+	{
+		if ( need(4) )
+		{
+			SDLNet_Write32(value, buf + pos);
+			pos += 4;
+		}
+	}
+	void writeBytes(const void* data, int n)
+	{
+		if ( need(n) )
+		{
+			memcpy(buf + pos, data, n);
+			pos += n;
+		}
+	}
+	void writeString(const char* str) // with its nul
+	{
+		writeBytes(str, (int)strlen(str) + 1);
+	}
 
-	Uint8*& data();
-	int& len();
+	bool ok() const { return !failed; }
+	int size() const { return pos; }
+	const Uint8* data() const { return buf; }
+	void finish(UDPpacket* packet) const { packet->len = pos; }
+private:
+	Uint8* buf;
+	int cap;
+	int pos = 0;
+	bool failed = false;
+
+	bool need(int n)
+	{
+		if ( failed || n < 0 || n > cap - pos )
+		{
+			failed = true;
+			return false;
+		}
+		return true;
+	}
+};
+
+/*
+ * Fixed size queue of received packets between one producer (the steam/EOS
+ * receive thread) and one consumer (the game thread). The producer reads
+ * straight into a free slot and publishes it, the consumer copies the oldest
+ * slot out and releases it. No locks, and nothing is allocated after the
+ * ring is made.
+ */
+class PacketRing
+{
+public:
+	static const Uint32 CAPACITY = 1024; // must be a power of two
+
+	struct Slot_t
+	{
+		int len = 0;
+		Uint8 data[NET_PACKET_SIZE];
+	};
+
+	PacketRing();
+
+	// producer
+	Slot_t* beginWrite(); // slot to fill, or nullptr if the ring is full (and counts the overflow)
+	void commitWrite(); // publishes the slot from beginWrite()
+
+	// consumer
+	bool read(UDPpacket* packet); // pops the oldest packet into packet, false if empty
+	Uint32 size() const;
+	void clear(); // only while the producer isn't running
+
+	std::atomic<Uint32> received{ 0 }; // packets published
+	std::atomic<Uint32> overflows{ 0 }; // packets dropped because the ring was full
+	Uint32 peak = 0; // most packets waiting at once, as seen by the consumer
+private:
+	std::unique_ptr<Slot_t[]> slots;
+	alignas(64) std::atomic<Uint32> head{ 0 }; // next slot to write, producer only
+	alignas(64) std::atomic<Uint32> tail{ 0 }; // next slot to read, consumer only
 };
 
 class NetHandler
 {
 	SDL_Thread* steam_packet_thread;
 	bool continue_multithreading_steam_packets;
-	SDL_mutex* game_packets_lock;
 public:
 	NetHandler();
 	~NetHandler();
-	std::queue<SteamPacketWrapper* > game_packets;
+	PacketRing game_packets;
 
 	void initializeMultithreadedPacketHandling();
 	void stopMultithreadedPacketHandling();
@@ -120,14 +352,11 @@ public:
 
 	bool getContinueMultithreadingSteamPackets();
 
-	void addGamePacket(SteamPacketWrapper* packet);
-
 	/*
-	 * This function will take the next packet in the queue, pop it off, and then return it.
-	 * Returns nullptr if no packets.
-	 * NOTE: You *MUST* free the data returned by this, or else you will leak memory! Such is the way of things.
+	 * Copies the next packet in the queue into packet and pops it off.
+	 * Returns false if there are no packets.
 	 */
-	SteamPacketWrapper* getGamePacket();
+	bool getGamePacket(UDPpacket* packet);
 
 	SDL_mutex* continue_multithreading_steam_packets_lock;
 };
@@ -177,9 +406,491 @@ struct PingNetworkStatus_t
 	static bool pingHUDDisplayRed;
 	static bool pingHUDShowOKBriefly;
 	static bool pingHUDShowNumericValue;
-	static void receive();
-	static void respond();
+	static void receive(PacketReader& packet);
+	static void respond(PacketReader& packet);
 	static void update();
 	static void reset();
 };
-extern PingNetworkStatus_t PingNetworkStatus[MAXPLAYERS];
\ No newline at end of file
+extern PingNetworkStatus_t PingNetworkStatus[MAXPLAYERS];
+
+/*
+ * Reliable delivery behind sendPacketSafe(). Every peer has its own sequence
+ * numbers and a fixed ring of packet buffers, packets are retransmitted when
+ * an RTT based timer runs out, and acks ride along in the header of every
+ * SAFE packet as the newest sequence received plus a bitfield of the ones
+ * before it. GOTP only goes out when there was nothing to piggyback on.
+ *
+ * SAFE header:
+ * [0][1][2][3]: "SAFE"
+ * [4]: sender's player number, MAXPLAYERS if it doesn't have one yet
+ * [5][6][7][8]: sequence number
+ * [9][10][11][12]: newest sequence received from the destination
+ * [13][14][15][16]: bit n set = (newest - n - 1) was received too
+ */
+class SafePacketChannel
+{
+public:
+	static const int HEADER_LEN = 17;
+	static const int WINDOW = 128; // packets in flight per peer, the rest wait in the backlog
+	static const int MAX_BACKLOG = 1024; // packets waiting for room in the window before new ones are dropped
+	static const int RECEIVE_WINDOW = WINDOW * 4; // sequence numbers remembered for duplicate checks
+	static const Uint32 MIN_RTO = 40;
+	static const Uint32 MAX_RTO = 1000;
+	static const Uint32 INITIAL_RTO = 100;
+
+	struct Stats_t
+	{
+		Uint32 sent = 0;
+		Uint32 resent = 0;
+		Uint32 acked = 0;
+		Uint32 expired = 0; // gave up after MAXTRIES, or dropped with the backlog full
+		Uint32 held = 0; // waited in the backlog for room in the window
+		Uint32 duplicates = 0; // received again after we'd already handled it
+	};
+
+	int send(UDPsocket sock, int channel, UDPpacket* packet, int hostnum);
+	bool receive(); // SAFE/GOTP in net_packet. true if the caller has nothing left to handle
+	void update(); // retransmit whatever's overdue and flush acks
+	void flushAcks();
+	void clear(); // forget queued packets, sequence numbers carry on
+	void reset(); // new session, start everything over
+	void resetPeer(int player);
+
+	int inFlight(int player) const { return peers[player].inFlight; }
+	float rtt(int player) const { return peers[player].srtt; }
+	float rttVariance(int player) const { return peers[player].rttvar; }
+	Uint32 rto(int player) const { return peers[player].rto; }
+	const Stats_t& stats(int player) const { return peers[player].stats; }
+private:
+	struct Outgoing_t
+	{
+		bool inUse = false;
+		Uint32 seq = 0;
+		UDPsocket sock = nullptr;
+		int channel = -1;
+		int hostnum = 0;
+		IPaddress address;
+		int len = 0;
+		int tries = 0;
+		Uint32 sentAt = 0;
+		Uint8 data[NET_PACKET_SIZE];
+	};
+	struct Held_t
+	{
+		UDPsocket sock = nullptr;
+		int channel = -1;
+		int hostnum = 0;
+		IPaddress address;
+		std::vector<Uint8> data;
+	};
+	struct Peer_t
+	{
+		Uint32 nextSeq = 1;
+		int inFlight = 0;
+		Outgoing_t outgoing[WINDOW];
+		std::deque<Held_t> backlog; // in send order, waiting for the oldest in-flight packets to be acked
+
+		Uint32 received = 0; // newest sequence received
+		std::bitset<RECEIVE_WINDOW> receivedBits; // indexed by sequence % RECEIVE_WINDOW
+		bool ackPending = false;
+
+		float srtt = 0.f;
+		float rttvar = 0.f;
+		Uint32 rto = INITIAL_RTO;
+		Stats_t stats;
+	};
+	Peer_t peers[MAXPLAYERS];
+
+	int peerForHost(int hostnum, const IPaddress& address) const;
+	void writeAck(Peer_t& peer, Uint8* data);
+	void applyAcks(Peer_t& peer, Uint32 ack, Uint32 bits);
+	bool markReceived(Peer_t& peer, Uint32 seq); // false if it's a duplicate
+	int transmit(Peer_t& peer, Outgoing_t& out);
+	int start(Peer_t& peer, UDPsocket sock, int channel, int hostnum, const IPaddress& address, const Uint8* data, int len);
+	void drainBacklog(Peer_t& peer);
+};
+extern SafePacketChannel SafePackets;
+
+/*
+ * Outbound message queue. Small server -> client updates (entity skills,
+ * flags, particles, ally HP...) are queued per peer with queuePacket() and
+ * queuePacketSafe() instead of each going out as its own datagram, then
+ * packed into one BTCH packet per peer and lane when the tick or message
+ * pump ends. A reliable batch travels as one SAFE packet.
+ *
+ * BTCH layout:
+ * [0][1][2][3]: "BTCH"
+ * then for each message: length (2 bytes) and the message itself
+ */
+class NetMessageQueue
+{
+public:
+	static const int HEADER_LEN = 4;
+	static const int FRAME_LEN = 2; // length prefix of each message
+
+	int queue(UDPsocket sock, int channel, UDPpacket* packet, int hostnum, bool safe);
+	void flush(); // send everything queued
+	void clear(); // drop everything queued
+	static bool unpack(void (*handler)()); // BTCH in net_packet: runs handler on each message, false if it isn't one
+	static void unpackMessages(const Uint8* data, int len, void (*handler)()); // the same for a run of length-prefixed messages
+
+	// between these, everything queued for a peer is gathered into one
+	// payload and sent through BulkTransfers if it won't fit in a packet
+	void beginBulk();
+	void endBulk();
+
+	// counters for /net_batch_stats
+	Uint32 messagesQueued = 0;
+	Uint32 packetsSent = 0;
+private:
+	struct Bulk_t
+	{
+		UDPsocket sock = nullptr;
+		int channel = -1;
+		IPaddress address;
+		std::vector<Uint8> data; // length-prefixed messages, as in BTCH
+	};
+	Bulk_t bulk[MAXPLAYERS]; // by hostnum
+	int bulkDepth = 0;
+
+	struct Lane_t
+	{
+		UDPsocket sock = nullptr;
+		int channel = -1;
+		IPaddress address;
+		int len = 0;
+		int count = 0;
+		Uint8 data[NET_PACKET_SIZE];
+	};
+	Lane_t lanes[MAXPLAYERS][2]; // by hostnum, then unreliable/safe
+
+	void flushLane(Lane_t& lane, int hostnum, bool safe);
+};
+extern NetMessageQueue NetMessages;
+int queuePacket(UDPsocket sock, int channel, UDPpacket* packet, int hostnum);
+int queuePacketSafe(UDPsocket sock, int channel, UDPpacket* packet, int hostnum);
+
+/*
+ * HELO layout, sent to a client that just joined:
+ * [0][1][2][3]: "HELO"
+ * [4][5][6][7]: the client's player number, or an error code
+ * then for every player slot: connectedness, locked state, class, sex,
+ * appearance and race (a byte each), a 32 byte name, and when loading a saved
+ * game and HELO_SENDS_EQUIPMENT, type (2 bytes) and appearance (4 bytes) of
+ * each of the 10 equipment slots
+ *
+ * The client reads it before it handles anything else, so it can't come
+ * through BulkTransfers and has to fit in one packet. The equipment is only
+ * for the lobby's preview of each saved character, and is left out when
+ * there are too many players for it to fit.
+ */
+static const int HELO_HEADER_LEN = 8;
+static const int HELO_PLAYER_LEN = 6 + 32;
+static const int HELO_EQUIPMENT_LEN = 6 * 10;
+static const bool HELO_SENDS_EQUIPMENT = HELO_HEADER_LEN + MAXPLAYERS * (HELO_PLAYER_LEN + HELO_EQUIPMENT_LEN) <= NET_PACKET_SIZE;
+static_assert(HELO_HEADER_LEN + MAXPLAYERS * HELO_PLAYER_LEN <= NET_PACKET_SIZE, "HELO has to fit in one packet");
+
+/*
+ * Payloads too big for one packet. A payload is deflated with zlib, cut
+ * into fragments that each go out as a safe packet, and put back together
+ * and inflated on the other end before it's handed to the handler for its
+ * type. Fragments are paced by how many safe packets the peer still has in
+ * flight, so a big transfer doesn't push older packets out of the window.
+ *
+ * BULK layout:
+ * [0][1][2][3]: "BULK"
+ * [4]: sender's player number
+ * [5][6]: transfer id, per sender
+ * [7][8]: fragment number
+ * [9][10]: number of fragments
+ * [11][12][13][14]: payload type
+ * [15][16][17][18]: payload length, before compression
+ * [19]: 1 if the payload is deflated
+ * then up to FRAGMENT_LEN bytes of the (deflated) payload
+ *
+ * Payload types:
+ * 'BTCH': length-prefixed messages, as in a BTCH packet
+ *
+ * Only bursts sent in game between NetMessages.beginBulk()/endBulk() use it,
+ * which today is the follower restore. The lobby doesn't handle BULK, and
+ * HELO, LVLC and the lobby's player, seed and scenario packets each have a
+ * fixed layout that is checked to fit in one packet where it's written.
+ */
+class BulkTransferChannel
+{
+public:
+	static const int HEADER_LEN = 20;
+	static const int FRAGMENT_LEN = NET_PACKET_SIZE - SafePacketChannel::HEADER_LEN - HEADER_LEN;
+	static const int MAX_PAYLOAD = 1 << 20;
+	static const int MAX_IN_FLIGHT = SafePacketChannel::WINDOW / 2; // safe packets in flight to a peer before we hold fragments back
+	static const Uint32 TIMEOUT = 30000; // ms without a fragment before a transfer is given up on
+	static const int MAX_INCOMING = 8; // transfers from one peer being reassembled at once
+
+	bool send(UDPsocket sock, int hostnum, const IPaddress& address, Uint32 type, const Uint8* data, int len);
+	void receive(PacketReader& packet); // BULK, positioned after the id
+	void update(); // once a tick: sends whatever fragments the window allows
+	void clear(); // drop every transfer both ways
+	void resetPeer(int player);
+
+	float progress(int player) const; // how much of what's coming from this player has arrived, 1 if nothing is
+	int waiting(int player) const { return (int)peers[player].outgoing.size(); } // fragments not sent yet
+
+	// counters for /net_bulk_stats
+	Uint32 transfersSent = 0;
+	Uint32 transfersReceived = 0;
+	Uint32 transfersDropped = 0;
+	Uint32 rawBytesSent = 0;
+	Uint32 compressedBytesSent = 0;
+	Uint32 fragmentsSent = 0;
+private:
+	struct Fragment_t
+	{
+		UDPsocket sock;
+		int hostnum;
+		IPaddress address;
+		int len;
+		Uint8 data[HEADER_LEN + FRAGMENT_LEN];
+	};
+	struct Incoming_t
+	{
+		Uint32 type = 0;
+		Uint32 rawLen = 0;
+		bool deflated = false;
+		int fragments = 0;
+		int received = 0;
+		int len = 0; // bytes so far
+		std::vector<bool> have;
+		std::vector<Uint8> data;
+		Uint32 startedAt = 0;
+		Uint32 lastHeard = 0;
+	};
+	struct Peer_t
+	{
+		Uint16 nextId = 1;
+		std::deque<Fragment_t> outgoing;
+		std::map<Uint16, Incoming_t> incoming; // by transfer id
+	};
+	Peer_t peers[MAXPLAYERS];
+
+	int peerForHost(int hostnum) const;
+	void complete(int player, Uint16 id, Incoming_t& transfer);
+};
+extern BulkTransferChannel BulkTransfers;
+
+/*
+ * Simulated network link for direct connections, so netcode can be tested
+ * on one machine. Everything sendPacket() sends over a direct connection
+ * goes through it: packets are held back by a latency plus random jitter,
+ * dropped at a loss rate, and paced out to a bandwidth cap per destination.
+ * Does nothing unless /net_sim is on. Steam and EOS traffic is not affected.
+ */
+class NetLinkSimulator
+{
+public:
+	bool enabled() const;
+	int send(UDPsocket sock, int channel, UDPpacket* packet); // like SDLNet_UDP_Send, but through the link
+	void update(); // sends whatever has arrived at the other end by now
+	void clear(); // drops everything in flight
+
+	// counters for /net_sim_stats
+	Uint32 packetsDelayed = 0;
+	Uint32 packetsLost = 0; // to the loss rate
+	Uint32 packetsOverflowed = 0; // over a second behind on the bandwidth cap
+private:
+	struct Delayed_t
+	{
+		Uint32 due; // SDL_GetTicks() to send at
+		UDPsocket sock;
+		int channel;
+		IPaddress address;
+		int len;
+		Uint8 data[NET_PACKET_SIZE];
+	};
+	std::vector<Delayed_t> inFlight;
+	std::unordered_map<Uint64, double> linkFreeAt; // by destination, when the last packet finishes going out
+	BaronyRNG rng;
+};
+extern NetLinkSimulator NetLinkSim;
+
+/*
+ * Always-on traffic counters keyed by packet id, for both directions.
+ * Everything is counted as it crosses the wire, with SAFE and BTCH opened
+ * up: the wrapper's own bytes count under its id, and each message inside
+ * counts under its own. Received messages also time their handler.
+ */
+class NetTelemetry
+{
+public:
+	enum Direction_t
+	{
+		SENT,
+		RECEIVED,
+		NUM_DIRECTIONS
+	};
+	struct Counter_t
+	{
+		Uint64 count = 0;
+		Uint64 bytes = 0;
+		Uint64 handlerTime = 0; // performance counter ticks spent in the handler
+		Uint64 worstHandlerTime = 0;
+	};
+
+	void count(Direction_t direction, const Uint8* data, int len);
+	void handled(Uint32 packetId, Uint64 elapsed);
+	void update(); // once a tick, writes the periodic dump if /net_telemetry_interval is set
+	bool dump(); // writes net_telemetry.csv and net_telemetry.json to the output dir
+	void print(int max, bool toLog); // biggest by bytes first, to the message log or the log file
+	void reset();
+private:
+	std::unordered_map<Uint32, Counter_t> table[NUM_DIRECTIONS];
+	std::unordered_map<Uint32, Counter_t> lastDump[NUM_DIRECTIONS]; // for rates between dumps
+	Uint32 lastDumpTime = 0; // SDL_GetTicks()
+	Uint32 lastDumpTicks = 0;
+};
+extern NetTelemetry NetStats;
+/*
+ * Entity snapshot stream, the server's replacement for sending one ENTU
+ * packet per entity per client. Every update round the server packs all
+ * entities needing an update into as few SNAP packets as it can, and each
+ * entity only carries the ENTU fields that differ from what that client has
+ * acknowledged. Clients ack SNAP sequence numbers with a bitfield, and
+ * rebuild a full ENTU image per entity so the ENTU handler does the rest.
+ *
+ * Each client also gets its own order and budget: entities are scored by
+ * kind, distance from that client's player and line of sight, the scores
+ * accumulate while an entity waits, and the highest go out first until the
+ * client's byte budget for the round is spent. Entities out of range and
+ * out of sight only go out on an occasional refresh.
+ */
+class EntitySnapshotStream
+{
+public:
+	static const int NUM_FIELDS = 13;
+	static const Uint16 FIELDS_ALL = (1 << NUM_FIELDS) - 1;
+	static const int HISTORY = 128; // sent packets remembered per client, awaiting acks
+	static const int ACK_BITS = 64; // packets before the latest one covered by an ack
+	static const int MAX_REFRESH_REQUESTS = 32; // uids a client asks to be resent in full, per ack
+
+	void serverSend(); // every entity update round, from gameLogic()
+	void serverReceiveAck(PacketReader& packet); // SNPA
+	void clientReceive(PacketReader& packet); // SNAP
+	void clientSendAck(); // once a tick, if anything arrived
+	void clientForget(Uint32 uid); // ENTD: the entity is gone, drop its image
+	void reset(); // new level: forget every baseline on both ends
+	void resetPeer(int player);
+
+	// counters for /net_snapshot_stats
+	Uint32 packetsSent = 0;
+	Uint32 bytesSent = 0;
+	Uint32 recordsSent = 0;
+	Uint32 recordsSkipped = 0; // entities that had nothing new for a client
+	Uint32 recordsDeferred = 0; // held back by a client's byte budget
+	Uint32 recordsCulled = 0; // held back as irrelevant to a client
+private:
+	struct Image_t
+	{
+		Uint8 data[ENTITY_PACKET_LENGTH];
+	};
+	struct Baseline_t
+	{
+		Image_t acked; // what the client is known to have
+		Uint16 known = 0; // fields of acked that are valid
+	};
+	struct Sent_t
+	{
+		Uint32 uid;
+		Uint16 fields;
+		Image_t image;
+	};
+	struct Pending_t
+	{
+		Uint32 seq = 0;
+		bool acked = false;
+		std::vector<Sent_t> entities;
+	};
+	struct Peer_t
+	{
+		Uint32 seq = 0; // last sequence number sent
+		Uint32 lastAcked = 0;
+		std::unordered_map<Uint32, Baseline_t> baselines;
+		std::unordered_map<Uint32, float> priority; // accumulated score of entities waiting to be sent
+		Pending_t history[HISTORY];
+	};
+	struct Captured_t
+	{
+		Uint32 uid;
+		Image_t image;
+		real_t x, y;
+		float weight; // how much this kind of entity matters
+		int allyOf; // player whose follower it is, or -1
+		bool global; // every client needs it wherever they are
+	};
+	struct Candidate_t
+	{
+		int index; // into captured
+		Uint16 fields;
+		float priority;
+	};
+	Peer_t peers[MAXPLAYERS];
+	std::vector<Captured_t> captured; // this round's entity images
+	std::vector<Candidate_t> candidates; // scratch for serverSend
+	Uint32 rounds = 0;
+
+	// client side
+	std::unordered_map<Uint32, Image_t> images;
+	Uint32 receivedSeq = 0; // newest SNAP applied
+	Uint64 receivedBits = 0; // which of the ACK_BITS before it also arrived
+	bool ackPending = false;
+	std::vector<Uint32> refreshRequests; // partial updates arrived for these, but we never had them in full
+
+	void flush(int player, Uint8* buf, int len);
+	void applyAck(Peer_t& peer, Uint32 seq);
+	float relevance(const Captured_t& entity, int player) const; // 0 if the client doesn't need it
+};
+extern EntitySnapshotStream EntitySnapshots;
+
+/*
+ * Client side buffer of the positions the server sent for each remote
+ * monster and player, stamped with the server tick from ENTU's [36].
+ * Instead of chasing the newest update, those entities are drawn a fixed
+ * delay behind the server's clock, between the two updates either side of
+ * that moment. When updates stop coming the entity carries on along its
+ * last velocity for a short while, then settles back where it was last seen.
+ */
+class EntityInterpolation
+{
+public:
+	static const int SAMPLES = 8; // updates kept per entity
+
+	void receive(Entity& entity); // after receiveEntity() applied an update
+	void update(); // once a client tick, before entities act
+	bool apply(Entity& entity); // true if it placed the entity, the usual chase and dead reckoning should be skipped
+	void reset(); // new level or disconnect
+
+	// counters for /net_interp_stats
+	Uint32 interpolated = 0; // entity ticks spent between two updates
+	Uint32 extrapolated = 0; // entity ticks spent past the newest update
+	Uint32 held = 0; // entity ticks spent settled on the newest update
+private:
+	struct Sample_t
+	{
+		Uint32 tick; // server ticks
+		real_t x, y, z;
+		real_t yaw;
+		real_t vel_x, vel_y, vel_z;
+	};
+	struct Buffer_t
+	{
+		Sample_t samples[SAMPLES];
+		int count = 0;
+		int newest = -1;
+		Uint32 lastReceived = 0; // local ticks
+	};
+	std::unordered_map<Uint32, Buffer_t> buffers;
+	double clockOffset = 0.0; // server ticks minus local ticks, as best we can tell
+	bool clockKnown = false;
+	double renderTick = 0.0; // server tick entities are drawn at this tick
+
+	static bool buffered(const Entity& entity);
+};
+extern EntityInterpolation EntityInterp;
@@ -0,0 +1,550 @@
+/*-------------------------------------------------------------------------------
+
+	BARONY
+	File: netbots.cpp
+	Desc: scripted bot clients that join our own server over loopback udp.
+	They speak just enough of the client protocol to get into a game (join,
+	ready, keepalives, safe packet and snapshot acks) and then send scripted
+	movement and attacks, measuring what the server sends back.
+
+	Copyright 2013-2016 (c) Turning Wheel LLC, all rights reserved.
+	See LICENSE for details.
+
+-------------------------------------------------------------------------------*/
+
+#include "main.hpp"
+#include "game.hpp"
+#include "stat.hpp"
+#include "net.hpp"
+#include "player.hpp"
+#include "entity.hpp"
+#include "netbots.hpp"
+
+namespace NetBots
+{
+	enum Script_t
+	{
+		SCRIPT_IDLE,
+		SCRIPT_WANDER,
+		SCRIPT_CIRCLE,
+		SCRIPT_FIGHT
+	};
+
+	enum State_t
+	{
+		BOT_JOINING,
+		BOT_LOBBY,
+		BOT_PLAYING,
+		BOT_GONE
+	};
+
+	static int botsWanted = 0;
+	static Script_t script = SCRIPT_WANDER;
+
+	static const real_t BOT_SPEED = 0.5; // units per tick, a bit under a walking player
+
+	struct Bot_t
+	{
+		UDPsocket sock = nullptr;
+		UDPpacket* packet = nullptr; // bots have their own, net_packet belongs to the server
+		State_t state = BOT_JOINING;
+		int player = 0; // our clientnum, from HELO
+		Uint32 lastJoin = 0;
+
+		// safe packets received, acked with GOTP
+		Uint32 safeReceived = 0;
+		Uint32 safeBits = 0;
+		bool safeAckPending = false;
+
+		// snapshots received, acked with SNPA
+		Uint32 snapReceived = 0;
+		Uint64 snapBits = 0;
+		bool snapAckPending = false;
+		std::unordered_map<Uint32, Uint32> lastUpdate; // entity uid -> server tick of its last update
+
+		// movement
+		bool placed = false;
+		real_t x = 0.0;
+		real_t y = 0.0;
+		real_t yaw = 0.0;
+		Uint32 nextTurn = 0;
+
+		// counters since the last report
+		Uint32 bytesIn = 0;
+		Uint32 packetsIn = 0;
+		Uint32 safeDuplicates = 0;
+		Uint32 updates = 0; // entity updates received
+		double updateGapTotal = 0.0; // server ticks between updates of the same entity
+		Uint32 updateGapWorst = 0;
+		double delayTotal = 0.0; // server ticks between sending an update and us reading it
+		Uint32 delayWorst = 0;
+		Uint32 reportedAt = 0;
+	};
+	static Bot_t bots[MAXPLAYERS];
+	static int numBots = 0;
+	static IPaddress serverAddress;
+	static BaronyRNG botRng;
+
+	bool parseArg(const char* arg)
+	{
+		if ( !strncmp(arg, "-bots=", 6) )
+		{
+			botsWanted = std::min(std::max(0, atoi(arg + 6)), MAXPLAYERS - 1);
+		}
+		else if ( !strncmp(arg, "-botscript=", 11) )
+		{
+			const char* name = arg + 11;
+			if ( !strcmp(name, "idle") )
+			{
+				script = SCRIPT_IDLE;
+			}
+			else if ( !strcmp(name, "circle") )
+			{
+				script = SCRIPT_CIRCLE;
+			}
+			else if ( !strcmp(name, "fight") )
+			{
+				script = SCRIPT_FIGHT;
+			}
+			else
+			{
+				script = SCRIPT_WANDER;
+			}
+		}
+		else
+		{
+			return false;
+		}
+		return true;
+	}
+
+	int count()
+	{
+		return botsWanted;
+	}
+
+	static void send(Bot_t& bot, int len)
+	{
+		bot.packet->address = serverAddress;
+		bot.packet->len = len;
+		NetLinkSim.send(bot.sock, -1, bot.packet);
+	}
+
+	static void sendJoin(Bot_t& bot, int index)
+	{
+		Uint8* data = bot.packet->data;
+		memset(data, 0, 69);
+		memcpy(data, "JOIN", 4);
+		char name[32];
+		snprintf(name, sizeof(name), "bot%d", index + 1);
+		stringCopy((char*)data + 4, name, 32, sizeof(name));
+		SDLNet_Write32((Uint32)(index % 10), &data[36]); // one of the base game classes
+		SDLNet_Write32((Uint32)(index % 2), &data[40]);
+		SDLNet_Write32(0, &data[44]); // human, default appearance
+		stringCopy((char*)data + 48, VERSION, 8, sizeof(VERSION));
+		data[56] = 0; // any slot
+		SDLNet_Write32(0, &data[57]);
+		SDLNet_Write32(0, &data[61]);
+		SDLNet_Write32(0, &data[65]);
+		send(bot, 69);
+		bot.lastJoin = ticks;
+	}
+
+	// the same bookkeeping as SafePacketChannel::markReceived, in 32 bits. false for duplicates
+	static bool markSafe(Bot_t& bot, Uint32 seq)
+	{
+		if ( seq > bot.safeReceived )
+		{
+			const Uint32 shift = seq - bot.safeReceived;
+			bot.safeBits = shift >= 32 ? 0 : (bot.safeBits << shift);
+			if ( bot.safeReceived && shift <= 32 )
+			{
+				bot.safeBits |= 1u << (shift - 1);
+			}
+			bot.safeReceived = seq;
+			return true;
+		}
+		const Uint32 behind = bot.safeReceived - seq;
+		if ( behind == 0 || behind > 32 )
+		{
+			return false;
+		}
+		if ( bot.safeBits & (1u << (behind - 1)) )
+		{
+			return false;
+		}
+		bot.safeBits |= 1u << (behind - 1);
+		return true;
+	}
+
+	static void entityUpdated(Bot_t& bot, Uint32 uid, Uint32 serverTick)
+	{
+		auto find = bot.lastUpdate.find(uid);
+		if ( find != bot.lastUpdate.end() && serverTick > find->second )
+		{
+			const Uint32 gap = serverTick - find->second;
+			bot.updateGapTotal += gap;
+			bot.updateGapWorst = std::max(bot.updateGapWorst, gap);
+		}
+		bot.lastUpdate[uid] = serverTick;
+		const Uint32 delay = ticks >= serverTick ? ticks - serverTick : 0;
+		bot.delayTotal += delay;
+		bot.delayWorst = std::max(bot.delayWorst, delay);
+		++bot.updates;
+	}
+
+	static void receiveSnapshot(Bot_t& bot, const Uint8* data, int len)
+	{
+		if ( len < 13 )
+		{
+			return;
+		}
+		const Uint32 seq = SDLNet_Read32(&data[4]);
+		if ( seq <= bot.snapReceived )
+		{
+			return;
+		}
+		const Uint32 shift = seq - bot.snapReceived;
+		bot.snapBits = shift >= 64 ? 0 : (bot.snapBits << shift);
+		if ( bot.snapReceived && shift <= 64 )
+		{
+			bot.snapBits |= (Uint64)1 << (shift - 1);
+		}
+		bot.snapReceived = seq;
+		bot.snapAckPending = true;
+
+		// same layout EntitySnapshotStream writes: uid, field mask, then the fields
+		static const Uint8 fieldLengths[] = { 2, 2, 2, 2, 2, 3, 2, 2, 2, 3, 4, 2, 6 };
+		const Uint32 serverTick = SDLNet_Read32(&data[8]);
+		const int count = data[12];
+		int offset = 13;
+		for ( int i = 0; i < count && offset + 6 <= len; ++i )
+		{
+			const Uint32 uid = SDLNet_Read32(&data[offset]);
+			const Uint16 fields = SDLNet_Read16(&data[offset + 4]);
+			offset += 6;
+			for ( int f = 0; f < (int)sizeof(fieldLengths); ++f )
+			{
+				if ( fields & (1 << f) )
+				{
+					offset += fieldLengths[f];
+				}
+			}
+			entityUpdated(bot, uid, serverTick);
+		}
+	}
+
+	static void receive(Bot_t& bot, const Uint8* data, int len)
+	{
+		if ( len < 4 )
+		{
+			return;
+		}
+		switch ( SDLNet_Read32(&data[0]) )
+		{
+			case 'SAFE':
+			{
+				if ( len < SafePacketChannel::HEADER_LEN )
+				{
+					break;
+				}
+				bot.safeAckPending = true;
+				if ( !markSafe(bot, SDLNet_Read32(&data[5])) )
+				{
+					++bot.safeDuplicates;
+					break;
+				}
+				receive(bot, data + SafePacketChannel::HEADER_LEN, len - SafePacketChannel::HEADER_LEN);
+				break;
+			}
+			case 'BTCH':
+			{
+				for ( int offset = NetMessageQueue::HEADER_LEN; offset + NetMessageQueue::FRAME_LEN <= len; )
+				{
+					const int messageLen = SDLNet_Read16(&data[offset]);
+					offset += NetMessageQueue::FRAME_LEN;
+					if ( offset + messageLen > len )
+					{
+						break;
+					}
+					receive(bot, data + offset, messageLen);
+					offset += messageLen;
+				}
+				break;
+			}
+			case 'HELO':
+			{
+				if ( bot.state != BOT_JOINING || len < 8 )
+				{
+					break;
+				}
+				const Uint32 result = SDLNet_Read32(&data[4]);
+				if ( result == 0 || result >= MAXPLAYERS )
+				{
+					printlog("[BOTS]: join refused with code %u", result);
+					bot.state = BOT_GONE;
+					break;
+				}
+				bot.player = result;
+				bot.state = BOT_LOBBY;
+				printlog("[BOTS]: joined as player %d", bot.player);
+
+				memcpy(bot.packet->data, "REDY", 4);
+				bot.packet->data[4] = bot.player;
+				bot.packet->data[5] = 1;
+				send(bot, 6);
+				break;
+			}
+			case 'STRT':
+				bot.state = BOT_PLAYING;
+				bot.placed = false;
+				break;
+			case 'LVLC':
+			case 'LVLR':
+				bot.placed = false;
+				bot.lastUpdate.clear();
+				break;
+			case 'SNAP':
+				receiveSnapshot(bot, data, len);
+				break;
+			case 'ENTU':
+				if ( len >= 40 )
+				{
+					entityUpdated(bot, SDLNet_Read32(&data[4]), SDLNet_Read32(&data[36]));
+				}
+				break;
+			case 'PMOV':
+				// the server bumped us back, find somewhere else to go
+				if ( len == 8 )
+				{
+					bot.x = ((Sint16)SDLNet_Read16(&data[4])) / 32.0;
+					bot.y = ((Sint16)SDLNet_Read16(&data[6])) / 32.0;
+					bot.nextTurn = ticks;
+				}
+				break;
+			case 'DISC':
+				if ( len >= 5 && data[4] == 0 )
+				{
+					bot.state = BOT_GONE;
+				}
+				break;
+			default:
+				break;
+		}
+	}
+
+	// one tick of whatever the script says
+	static void play(Bot_t& bot)
+	{
+		if ( !players[bot.player] || !players[bot.player]->entity )
+		{
+			return; // dead or between levels
+		}
+		if ( !bot.placed )
+		{
+			// we share the server's process, so read our spawn point instead of simulating a client
+			bot.x = players[bot.player]->entity->x;
+			bot.y = players[bot.player]->entity->y;
+			bot.yaw = botRng.getF64() * PI * 2;
+			bot.placed = true;
+		}
+
+		real_t velx = 0.0;
+		real_t vely = 0.0;
+		if ( script == SCRIPT_WANDER || script == SCRIPT_FIGHT )
+		{
+			if ( ticks >= bot.nextTurn )
+			{
+				bot.yaw = botRng.getF64() * PI * 2;
+				bot.nextTurn = ticks + TICKS_PER_SECOND * 2 + botRng.uniform(0, TICKS_PER_SECOND * 2);
+			}
+		}
+		else if ( script == SCRIPT_CIRCLE )
+		{
+			bot.yaw = fmod(bot.yaw + 0.05, PI * 2);
+		}
+		if ( script != SCRIPT_IDLE )
+		{
+			velx = cos(bot.yaw) * BOT_SPEED;
+			vely = sin(bot.yaw) * BOT_SPEED;
+			bot.x += velx;
+			bot.y += vely;
+		}
+
+		Uint8* data = bot.packet->data;
+		memcpy(data, "PMOV", 4);
+		data[4] = bot.player;
+		data[5] = currentlevel;
+		SDLNet_Write16((Sint16)(bot.x * 32), &data[6]);
+		SDLNet_Write16((Sint16)(bot.y * 32), &data[8]);
+		SDLNet_Write16((Sint16)(velx * 128), &data[10]);
+		SDLNet_Write16((Sint16)(vely * 128), &data[12]);
+		SDLNet_Write16((Sint16)(bot.yaw * 128), &data[14]);
+		SDLNet_Write16(0, &data[16]);
+		data[18] = secretlevel;
+		send(bot, 19);
+
+		if ( script == SCRIPT_FIGHT && (ticks + bot.player * 13) % TICKS_PER_SECOND == 0 )
+		{
+			memcpy(data, "ATAK", 4);
+			data[4] = bot.player;
+			data[5] = 1; // swing
+			data[6] = 0;
+			send(bot, 7);
+		}
+	}
+
+	static void sendAcks(Bot_t& bot)
+	{
+		Uint8* data = bot.packet->data;
+		if ( bot.safeAckPending && bot.player )
+		{
+			memcpy(data, "GOTP", 4);
+			data[4] = bot.player;
+			SDLNet_Write32(bot.safeReceived, &data[5]);
+			SDLNet_Write32(bot.safeBits, &data[9]);
+			send(bot, 13);
+			bot.safeAckPending = false;
+		}
+		if ( bot.snapAckPending )
+		{
+			memcpy(data, "SNPA", 4);
+			data[4] = bot.player;
+			SDLNet_Write32(bot.snapReceived, &data[5]);
+			SDLNet_Write32((Uint32)(bot.snapBits >> 32), &data[9]);
+			SDLNet_Write32((Uint32)(bot.snapBits & 0xFFFFFFFF), &data[13]);
+			send(bot, 17);
+			bot.snapAckPending = false;
+		}
+	}
+
+	bool start(Uint16 port)
+	{
+		if ( SDLNet_ResolveHost(&serverAddress, "127.0.0.1", port) == -1 )
+		{
+			printlog("[BOTS]: failed to resolve loopback address: %s", SDLNet_GetError());
+			return false;
+		}
+		botRng.seedTime();
+		for ( numBots = 0; numBots < botsWanted; ++numBots )
+		{
+			Bot_t& bot = bots[numBots];
+			bot = Bot_t();
+			bot.sock = SDLNet_UDP_Open(0);
+			bot.packet = SDLNet_AllocPacket(NET_PACKET_SIZE);
+			if ( !bot.sock || !bot.packet )
+			{
+				printlog("[BOTS]: failed to open a socket for bot %d: %s", numBots + 1, SDLNet_GetError());
+				stop();
+				return false;
+			}
+			bot.reportedAt = ticks;
+			sendJoin(bot, numBots);
+		}
+		printlog("[BOTS]: %d bot(s) connecting to port %d", numBots, port);
+		return true;
+	}
+
+	void update()
+	{
+		for ( int i = 0; i < numBots; ++i )
+		{
+			Bot_t& bot = bots[i];
+			if ( bot.state == BOT_GONE )
+			{
+				continue;
+			}
+			for ( int numpacket = 0; numpacket < PACKET_LIMIT; ++numpacket )
+			{
+				if ( !SDLNet_UDP_Recv(bot.sock, bot.packet) )
+				{
+					break;
+				}
+				++bot.packetsIn;
+				bot.bytesIn += bot.packet->len;
+				Uint8 data[NET_PACKET_SIZE];
+				const int len = std::min(bot.packet->len, NET_PACKET_SIZE);
+				memcpy(data, bot.packet->data, len);
+				receive(bot, data, len);
+			}
+
+			if ( bot.state == BOT_JOINING )
+			{
+				if ( ticks - bot.lastJoin >= TICKS_PER_SECOND )
+				{
+					sendJoin(bot, i);
+				}
+				continue;
+			}
+			if ( bot.state == BOT_PLAYING )
+			{
+				play(bot);
+			}
+			if ( ticks % TICKS_PER_SECOND == 0 && bot.player )
+			{
+				memcpy(bot.packet->data, "KPAL", 4);
+				bot.packet->data[4] = bot.player;
+				send(bot, 5);
+			}
+			sendAcks(bot);
+		}
+	}
+
+	void report(const char* label)
+	{
+		for ( int i = 0; i < numBots; ++i )
+		{
+			Bot_t& bot = bots[i];
+			if ( !bot.player )
+			{
+				continue;
+			}
+			const double seconds = std::max(1u, ticks - bot.reportedAt) / (double)TICKS_PER_SECOND;
+			const auto& safe = SafePackets.stats(bot.player);
+			printlog("[BOTS]: %s: player %d: %.2f KB/s, %.1f packets/s in, %u safe packets resent, %u given up, %u duplicates",
+				label, bot.player, bot.bytesIn / 1024.0 / seconds, bot.packetsIn / seconds,
+				safe.resent, safe.expired, bot.safeDuplicates);
+			if ( bot.updates )
+			{
+				printlog("[BOTS]: %s: player %d: %u entity updates, every %.1f ticks per entity (worst %u), %.1f ticks in transit (worst %u)",
+					label, bot.player, bot.updates, bot.updateGapTotal / bot.updates, bot.updateGapWorst,
+					bot.delayTotal / bot.updates, bot.delayWorst);
+			}
+			bot.bytesIn = 0;
+			bot.packetsIn = 0;
+			bot.safeDuplicates = 0;
+			bot.updates = 0;
+			bot.updateGapTotal = 0.0;
+			bot.updateGapWorst = 0;
+			bot.delayTotal = 0.0;
+			bot.delayWorst = 0;
+			bot.reportedAt = ticks;
+		}
+	}
+
+	void stop()
+	{
+		for ( int i = 0; i < numBots; ++i )
+		{
+			Bot_t& bot = bots[i];
+			if ( bot.sock && bot.packet && bot.player && bot.state != BOT_GONE )
+			{
+				memcpy(bot.packet->data, "DISC", 4);
+				bot.packet->data[4] = bot.player;
+				bot.packet->address = serverAddress;
+				bot.packet->len = 5;
+				SDLNet_UDP_Send(bot.sock, -1, bot.packet);
+			}
+			if ( bot.sock )
+			{
+				SDLNet_UDP_Close(bot.sock);
+			}
+			if ( bot.packet )
+			{
+				SDLNet_FreePacket(bot.packet);
+			}
+			bot = Bot_t();
+		}
+		numBots = 0;
+	}
+}
@@ -0,0 +1,27 @@
+/*-------------------------------------------------------------------------------
+
+	BARONY
+	File: netbots.hpp
+	Desc: prototypes for netbots.cpp, scripted loopback clients for load
+	testing the server's netcode
+
+	Copyright 2013-2016 (c) Turning Wheel LLC, all rights reserved.
+	See LICENSE for details.
+
+-------------------------------------------------------------------------------*/
+
+#pragma once
+
+namespace NetBots
+{
+	// command line options:
+	//   -bots=N          connect N bot clients to our own server (1-3)
+	//   -botscript=NAME  what the bots do once in game: idle, wander (default), circle or fight
+	bool parseArg(const char* arg); // true if arg was a bot option
+	int count(); // bots asked for on the command line
+
+	bool start(Uint16 port); // opens a socket per bot and asks to join the server on this port
+	void update(); // once a server tick: reads what the server sent, sends inputs, keepalives and acks
+	void report(const char* label); // logs each bot's traffic and entity update staleness, then resets the counters
+	void stop(); // says goodbye and closes the sockets
+}
@@ -123,36 +123,7 @@ void lightDeconstructor(void* data)
 	if (data != nullptr) {
         light_t* light = (light_t*)data;
 		if (light->tiles != nullptr) {
-            const auto lightsize = (light->radius * 2 + 1) * (light->radius * 2 + 1);
-            const auto mapsize = map.width * map.height;
-			for (int y = 0; y < light->radius * 2; y++) {
-				for (int x = 0; x < light->radius * 2; x++) {
-                    const auto soff = y + x * (light->radius * 2 + 1);
-                    if (soff < 0 || soff >= lightsize) {
-                        continue;
-                    }
-                    const auto& s = light->tiles[soff];
-                    const auto doff = (y + light->y - light->radius) + (x + light->x - light->radius) * map.height;
-                    if (doff < 0 || doff >= mapsize) {
-                        continue;
-                    }
-                    if (light->index) {
-                        auto& d = lightmaps[light->index][doff];
-                        d.x -= s.x;
-                        d.y -= s.y;
-                        d.z -= s.z;
-                        d.w -= s.w;
-                    } else {
-                        for (int c = 0; c < MAXPLAYERS + 1; ++c) {
-                            auto& d = lightmaps[c][doff];
-                            d.x -= s.x;
-                            d.y -= s.y;
-                            d.z -= s.z;
-                            d.w -= s.w;
-                        }
-                    }
-				}
-			}
+            removeLightFromLightmap(light);
 			free(light->tiles);
 		}
 		free(data);
@@ -217,6 +188,44 @@ void listDeconstructor(void* data)
 	}
 }
 
+/*-------------------------------------------------------------------------------
+
+	Entity::operator new / delete
+
+	Entities are allocated out of entityPool so the thousands of short-lived
+	particles and gibs don't churn the general heap.
+
+-------------------------------------------------------------------------------*/
+
+void* Entity::operator new(size_t size)
+{
+	if ( size != sizeof(Entity) )
+	{
+		return ::operator new(size);
+	}
+	void* data = entityPool.allocate();
+	if ( !data )
+	{
+#ifndef NINTENDO
+		throw std::bad_alloc();
+#else
+		printlog("failed to allocate memory for new entity!\n");
+		exit(1);
+#endif
+	}
+	return data;
+}
+
+void Entity::operator delete(void* data, size_t size)
+{
+	if ( size != sizeof(Entity) )
+	{
+		::operator delete(data);
+		return;
+	}
+	entityPool.release(data);
+}
+
 /*-------------------------------------------------------------------------------
 
 	newEntity
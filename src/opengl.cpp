@@ -571,11 +571,203 @@ vec4_t unproject(
 
 -------------------------------------------------------------------------------*/
 
+/*-------------------------------------------------------------------------------
+
+	lightmap pipeline
+
+	Each camera eases lightmapsSmoothed toward lightmapBase plus its own
+	overlay (see light.hpp) and turns the result into a float texture, averaging every open tile with its open
+	neighbors. Only what changed is redone: lights record the tiles they
+	touch in lightmapsDirty, smoothing keeps the box of tiles still easing
+	in, and a copy of map.tiles catches walls that open or close. Texels are
+	rebuilt over the changed tiles plus a one-tile border, and only those
+	rows are uploaded.
+
+-------------------------------------------------------------------------------*/
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#ifndef EDITOR
+static ConsoleVariable<bool> cvar_lightmapDirtyRegions("/lightmap_dirty_regions", true);
+#endif
+
+struct LightmapState {
+    LightmapRegion converging; // smoothed tiles still easing toward the lightmap
+    LightmapRegion stale; // texels to rebuild
+    std::vector<float> pixels; // texture data, row by row
+    int width = 0;
+    int height = 0;
+    bool fullbright = false;
+};
+static LightmapState lightmapStates[MAXPLAYERS + 1];
+
+// what the texels were last built against: a copy of map.tiles, and
+// whether each tile (v + u * map.height) is filled on every layer
+static std::vector<Sint32> lightmapTiles;
+static std::vector<Uint8> lightmapOccluders;
+
+static bool useLightmapDirtyRegions() {
+#ifdef EDITOR
+    return true;
+#else
+    return *cvar_lightmapDirtyRegions;
+#endif
+}
+
+static inline Uint8 tileOccludes(const Sint32* tile) {
+    for (int z = 0; z < MAPLAYERS; ++z) {
+        if (!tile[z]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void markLightmapTexelsStale(int x0, int y0, int x1, int y1) {
+    for (auto& state : lightmapStates) {
+        state.stale.add(x0, y0, x1, y1);
+    }
+}
+
+static void updateLightmapOccluders() {
+    const int size = map.width * map.height;
+    const int columnSize = map.height * MAPLAYERS;
+    if (lightmapOccluders.size() != size || lightmapTiles.size() != size * MAPLAYERS) {
+        lightmapTiles.assign(map.tiles, map.tiles + size * MAPLAYERS);
+        lightmapOccluders.resize(size);
+        for (int index = 0; index < size; ++index) {
+            lightmapOccluders[index] = tileOccludes(&map.tiles[index * MAPLAYERS]);
+        }
+        markLightmapTexelsStale(0, 0, map.width - 1, map.height - 1);
+        return;
+    }
+    for (int u = 0; u < map.width; ++u) {
+        Sint32* copy = &lightmapTiles[u * columnSize];
+        const Sint32* tiles = &map.tiles[u * columnSize];
+        if (!memcmp(copy, tiles, columnSize * sizeof(Sint32))) {
+            continue;
+        }
+        for (int v = 0; v < map.height; ++v) {
+            auto& occludes = lightmapOccluders[v + u * map.height];
+            const Uint8 now = tileOccludes(&tiles[v * MAPLAYERS]);
+            if (occludes != now) {
+                occludes = now;
+                markLightmapTexelsStale(u - 1, v - 1, u + 1, v + 1);
+                
+                // neighbors are looked up by index, so the ends of a column
+                // are next to the ends of the columns on either side
+                if (v == 0) { markLightmapTexelsStale(u - 1, map.height - 1, u - 1, map.height - 1); }
+                if (v == map.height - 1) { markLightmapTexelsStale(u + 1, 0, u + 1, 0); }
+            }
+        }
+        memcpy(copy, tiles, columnSize * sizeof(Sint32));
+    }
+}
+
+static inline bool testTileOccludes(int index) {
+    if (index < 0 || index >= (int)lightmapOccluders.size()) {
+        return true;
+    }
+    return lightmapOccluders[index];
+}
+
+static void clampLightmapRegion(LightmapRegion& region) {
+    region.x0 = std::max(region.x0, 0);
+    region.y0 = std::max(region.y0, 0);
+    region.x1 = std::min(region.x1, (int)map.width - 1);
+    region.y1 = std::min(region.y1, (int)map.height - 1);
+}
+
+// eases d toward s, snapping to s once every channel is within epsilon.
+// returns true if d now equals s
+static inline bool smoothLightmapTile(vec4_t& d, const vec4_t& s, float rate) {
+    constexpr float epsilon = 1.f;
+#if defined(__SSE2__) || defined(_M_X64)
+    const __m128 vs = _mm_loadu_ps(&s.x);
+    const __m128 vd = _mm_loadu_ps(&d.x);
+    const __m128 diff = _mm_sub_ps(vs, vd);
+    const __m128 snap = _mm_cmplt_ps(_mm_andnot_ps(_mm_set1_ps(-0.f), diff), _mm_set1_ps(epsilon));
+    const __m128 eased = _mm_add_ps(vd, _mm_mul_ps(diff, _mm_set1_ps(rate)));
+    _mm_storeu_ps(&d.x, _mm_or_ps(_mm_and_ps(snap, vs), _mm_andnot_ps(snap, eased)));
+    return _mm_movemask_ps(snap) == 0xf;
+#elif defined(__ARM_NEON__)
+    const float32x4_t vs = vld1q_f32(&s.x);
+    const float32x4_t vd = vld1q_f32(&d.x);
+    const float32x4_t diff = vsubq_f32(vs, vd);
+    const uint32x4_t snap = vcltq_f32(vabsq_f32(diff), vdupq_n_f32(epsilon));
+    vst1q_f32(&d.x, vbslq_f32(snap, vs, vmlaq_n_f32(vd, diff, rate)));
+    const uint32x2_t all = vand_u32(vget_low_u32(snap), vget_high_u32(snap));
+    return vget_lane_u32(all, 0) && vget_lane_u32(all, 1);
+#else
+    bool converged = true;
+    for (int c = 0; c < 4; ++c) {
+        auto& dc = *(&d.x + c);
+        const auto& sc = *(&s.x + c);
+        const auto diff = sc - dc;
+        if (fabsf(diff) < epsilon) { dc = sc; }
+        else { dc += diff * rate; converged = false; }
+    }
+    return converged;
+#endif
+}
+
+// writes the average of a tile and its open neighbors, scaled to [0-1]
+static inline void averageLightmapTexel(float* texel, const vec4_t& tile, const vec4_t* const neighbors[4], const bool open[4]) {
+    constexpr float div = 1.f / 255.f;
+    int count = 1;
+    for (int c = 0; c < 4; ++c) {
+        count += open[c] ? 1 : 0;
+    }
+#if defined(__SSE2__) || defined(_M_X64)
+    __m128 total = _mm_loadu_ps(&tile.x);
+    for (int c = 0; c < 4; ++c) {
+        const __m128 mask = _mm_castsi128_ps(_mm_set1_epi32(open[c] ? -1 : 0));
+        total = _mm_add_ps(total, _mm_and_ps(mask, _mm_loadu_ps(&neighbors[c]->x)));
+    }
+    _mm_storeu_ps(texel, _mm_mul_ps(total, _mm_set1_ps(div / count)));
+#elif defined(__ARM_NEON__)
+    float32x4_t total = vld1q_f32(&tile.x);
+    for (int c = 0; c < 4; ++c) {
+        const uint32x4_t mask = vdupq_n_u32(open[c] ? 0xffffffff : 0);
+        total = vaddq_f32(total, vreinterpretq_f32_u32(vandq_u32(mask, vreinterpretq_u32_f32(vld1q_f32(&neighbors[c]->x)))));
+    }
+    vst1q_f32(texel, vmulq_n_f32(total, div / count));
+#else
+    vec4_t total = tile;
+    for (int c = 0; c < 4; ++c) {
+        if (open[c]) {
+            total.x += neighbors[c]->x;
+            total.y += neighbors[c]->y;
+            total.z += neighbors[c]->z;
+        }
+    }
+    texel[0] = total.x * (div / count);
+    texel[1] = total.y * (div / count);
+    texel[2] = total.z * (div / count);
+#endif
+    texel[3] = 1.f;
+}
+
 static void fillSmoothLightmap(int which) {
-    auto lightmap = lightmaps[which].data();
+    if (lightmapBase.size() < map.width * map.height) {
+        return;
+    }
+    auto& state = lightmapStates[which];
+    const auto lightmap = lightmapBase.data();
+    const auto& overlay = lightmapOverlays[which];
+    
+    // a view's smoothed lightmap only exists once the view draws
+    const int smoothedSize = (map.width + 2) * (map.height + 2);
+    if (lightmapsSmoothed[which].size() != smoothedSize) {
+        lightmapsSmoothed[which].assign(smoothedSize, lightmapSmoothedFill);
+        state.converging.add(0, 0, map.width - 1, map.height - 1);
+    }
     auto lightmapSmoothed = lightmapsSmoothed[which].data();
     
-    constexpr float epsilon = 1.f;
     constexpr float defaultSmoothRate = 4.f;
 #ifndef EDITOR
     static ConsoleVariable<float> cvar_smoothingRate("/lightupdate", defaultSmoothRate);
@@ -585,91 +777,169 @@ static void fillSmoothLightmap(int which) {
 #endif
     const float rate = smoothingRate * (1.f / fpsLimit);
     
-    int v = 0;
-    int index = 0;
-    int smoothindex = 2 + map.height + 1;
-    const int size = map.width * map.height;
-    for ( ; index < size; ++index, ++v, ++smoothindex )
-    {
-        if ( v == map.height ) {
-            smoothindex += 2;
-            v = 0;
-        }
-        
-        auto& d = lightmapSmoothed[smoothindex];
-        const auto& s = lightmap[index];
-        for (int c = 0; c < 4; ++c) {
-            auto& dc = *(&d.x + c);
-            const auto& sc = *(&s.x + c);
-            const auto diff = sc - dc;
-            if (fabsf(diff) < epsilon) { dc += diff; }
-            else { dc += diff * rate; }
+    LightmapRegion region = state.converging;
+    region.add(lightmapsDirty[which]);
+    lightmapsDirty[which].clear();
+    if (!useLightmapDirtyRegions()) {
+        region.add(0, 0, map.width - 1, map.height - 1);
+    }
+    clampLightmapRegion(region);
+    state.converging.clear();
+    if (region.empty()) {
+        return;
+    }
+    
+    for (int x = region.x0; x <= region.x1; ++x) {
+        const auto src = lightmap + x * map.height;
+        const auto dest = lightmapSmoothed + (x + 1) * (map.height + 2) + 1;
+        const auto over = overlay.column(x);
+        for (int y = region.y0; y <= region.y1; ++y) {
+            bool converged;
+            if (over && y >= overlay.region.y0 && y <= overlay.region.y1) {
+                const auto& o = over[y - overlay.region.y0];
+                const vec4_t target(src[y].x + o.x, src[y].y + o.y, src[y].z + o.z, src[y].w + o.w);
+                converged = smoothLightmapTile(dest[y], target, rate);
+            } else {
+                converged = smoothLightmapTile(dest[y], src[y], rate);
+            }
+            if (!converged) {
+                state.converging.add(x, y, x, y);
+            }
         }
     }
+    state.stale.add(region.x0 - 1, region.y0 - 1, region.x1 + 1, region.y1 + 1);
 }
 
-static inline bool testTileOccludes(const map_t& map, int index) {
-    if (index < 0 || index > map.width * map.height * MAPLAYERS - MAPLAYERS) {
-        return true;
+// brings lightmapStates[which].pixels up to date and returns the texels it rebuilt
+static LightmapRegion updateLightmapPixels(int which, bool fullbright) {
+    auto lightmapSmoothed = lightmapsSmoothed[which].data();
+    auto& state = lightmapStates[which];
+    if (state.width != map.width || state.height != map.height || state.fullbright != fullbright) {
+        state.width = map.width;
+        state.height = map.height;
+        state.fullbright = fullbright;
+        state.pixels.resize(map.width * map.height * 4);
+        state.stale.add(0, 0, map.width - 1, map.height - 1);
+    }
+    if (!useLightmapDirtyRegions()) {
+        state.stale.add(0, 0, map.width - 1, map.height - 1);
+    }
+    LightmapRegion region = state.stale;
+    state.stale.clear();
+    clampLightmapRegion(region);
+    if (region.empty() || lightmapsSmoothed[which].size() < (map.width + 2) * (map.height + 2)) {
+        return region;
+    }
+    
+    const int h = map.height + 2;
+    for (int y = region.y0; y <= region.y1; ++y) {
+        float* texel = &state.pixels[(y * map.width + region.x0) * 4];
+        for (int x = region.x0, index = y + x * map.height; x <= region.x1; ++x, index += map.height, texel += 4) {
+            if (fullbright) {
+                texel[0] = 1.f; texel[1] = 1.f; texel[2] = 1.f; texel[3] = 1.f;
+            } else if (testTileOccludes(index)) {
+                texel[0] = 0.f; texel[1] = 0.f; texel[2] = 0.f; texel[3] = 1.f;
+            } else {
+                const vec4_t* const neighbors[4] = {
+                    &lightmapSmoothed[(y + 2) + (x + 1) * h],
+                    &lightmapSmoothed[(y + 1) + (x + 2) * h],
+                    &lightmapSmoothed[(y + 0) + (x + 1) * h],
+                    &lightmapSmoothed[(y + 1) + (x + 0) * h],
+                };
+                const bool open[4] = {
+                    !testTileOccludes(index + 1),
+                    !testTileOccludes(index + map.height),
+                    !testTileOccludes(index - 1),
+                    !testTileOccludes(index - map.height),
+                };
+                averageLightmapTexel(texel, lightmapSmoothed[(y + 1) + (x + 1) * h], neighbors, open);
+            }
+        }
     }
-    const Uint64& t0 = *(Uint64*)&map.tiles[index];
-    const Uint32& t1 = *(Uint32*)&map.tiles[index + 2];
-    return (t0 & 0xffffffff00000000) && (t0 & 0x00000000ffffffff) && t1;
+    return region;
 }
 
 static void loadLightmapTexture(int which) {
-    auto lightmapSmoothed = lightmapsSmoothed[which].data();
-    
-    // allocate lightmap pixel data
-    static std::vector<float> pixels;
-    pixels.clear();
-    pixels.reserve(map.width * map.height * 4);
-    
 #ifdef EDITOR
     const bool fullbright = false;
 #else
     const bool fullbright = conductGameChallenges[CONDUCT_CHEATS_ENABLED] ? *cvar_fullBright : false;
 #endif
     
-    // build lightmap texture data
-    const float div = 1.f / 255.f;
-    const int xoff = MAPLAYERS * map.height;
-    const int yoff = MAPLAYERS;
-    if (fullbright) {
-        for (int y = 0; y < map.height; ++y) {
-            for (int x = 0; x < map.width; ++x) {
-                pixels.insert(pixels.end(), {1.f, 1.f, 1.f, 1.f});
-            }
-        }
-    } else {
-        for (int y = 0; y < map.height; ++y) {
-            for (int x = 0, index = y * yoff; x < map.width; ++x, index += xoff) {
-                if (!testTileOccludes(map, index)) {
-                    float count = 1.f;
-                    vec4_t t, total = lightmapSmoothed[(y + 1) + (x + 1) * (map.height + 2)];
-                    if (!testTileOccludes(map, index + yoff)) { (void)add_vec4(&t, &total, &lightmapSmoothed[(y + 2) + (x + 1) * (map.height + 2)]); total = t; ++count; }
-                    if (!testTileOccludes(map, index + xoff)) { (void)add_vec4(&t, &total, &lightmapSmoothed[(y + 1) + (x + 2) * (map.height + 2)]); total = t; ++count; }
-                    if (!testTileOccludes(map, index - yoff)) { (void)add_vec4(&t, &total, &lightmapSmoothed[(y + 0) + (x + 1) * (map.height + 2)]); total = t; ++count; }
-                    if (!testTileOccludes(map, index - xoff)) { (void)add_vec4(&t, &total, &lightmapSmoothed[(y + 1) + (x + 0) * (map.height + 2)]); total = t; ++count; }
-                    total.x = (total.x / count) * div;
-                    total.y = (total.y / count) * div;
-                    total.z = (total.z / count) * div;
-                    total.w = 1.f;
-                    pixels.insert(pixels.end(), {total.x, total.y, total.z, total.w});
-                } else {
-                    pixels.insert(pixels.end(), {0.f, 0.f, 0.f, 1.f});
-                }
-            }
-        }
-    }
+    const auto region = updateLightmapPixels(which, fullbright);
+    auto& state = lightmapStates[which];
+    auto texture = lightmapTexture[which];
     
-    // load lightmap texture data
+    // upload the rows that changed, or everything if the texture is new
     GL_CHECK_ERR(glActiveTexture(GL_TEXTURE1));
-    lightmapTexture[which]->loadFloat(pixels.data(), map.width, map.height, true, false);
-    lightmapTexture[which]->bind();
+    if (texture->w != map.width || texture->h != map.height) {
+        texture->loadFloat(state.pixels.data(), map.width, map.height, true, false);
+    } else if (!region.empty()) {
+        texture->updateFloat(&state.pixels[region.y0 * map.width * 4], 0, region.y0, map.width, region.y1 - region.y0 + 1);
+    }
+    texture->bind();
     GL_CHECK_ERR(glActiveTexture(GL_TEXTURE0));
 }
 
+#ifndef EDITOR
+static ConsoleCommand ccmd_lightmapBench("/lightmap_bench", "time lightmap smoothing and texel rebuilds on the CPU (frames, percent of lights rebuilt per frame)",
+    [](int argc, const char** argv) {
+    if (!map.tiles || map.width <= 0 || map.height <= 0) {
+        messagePlayer(clientnum, MESSAGE_MISC, "lightmap bench: no level loaded");
+        return;
+    }
+    const int frames = argc > 1 ? std::max(1, atoi(argv[1])) : 100;
+    const int percent = argc > 2 ? std::min(std::max(atoi(argv[2]), 0), 100) : 10;
+    
+    // the lightmaps the renderer would use for the local players
+    std::vector<int> indices;
+    for (int c = 0; c < MAXPLAYERS; ++c) {
+        if (players[c]->isLocalPlayer()) {
+            indices.push_back(c + 1);
+        }
+    }
+    if (indices.empty()) {
+        indices.push_back(0);
+    }
+    
+    auto run = [&](bool dirtyRegions) {
+        const Uint64 start = SDL_GetPerformanceCounter();
+        for (int frame = 0; frame < frames; ++frame) {
+            if (dirtyRegions) {
+                int count = 0;
+                for (auto node = light_l.first; node; node = node->next, ++count) {
+                    auto light = (light_t*)node->element;
+                    if ((count + frame) % 100 < percent) {
+                        markLightmapDirty(light->index, light->x - light->radius, light->y - light->radius,
+                            light->x + light->radius, light->y + light->radius);
+                    }
+                }
+            } else {
+                markLightmapsDirty();
+                markLightmapTexelsStale(0, 0, map.width - 1, map.height - 1);
+            }
+            updateLightmapOccluders();
+            for (auto which : indices) {
+                fillSmoothLightmap(which);
+                (void)updateLightmapPixels(which, false);
+            }
+        }
+        const Uint64 elapsed = SDL_GetPerformanceCounter() - start;
+        return 1000000.0 * elapsed / SDL_GetPerformanceFrequency() / frames;
+    };
+    const double full = run(false);
+    const double dirty = run(true);
+    
+    // the textures never saw what was built here
+    markLightmapTexelsStale(0, 0, map.width - 1, map.height - 1);
+    
+    messagePlayer(clientnum, MESSAGE_MISC, "lightmap bench: %dx%d map, %d lightmap(s), %d lights, %d frames",
+        (int)map.width, (int)map.height, (int)indices.size(), (int)list_Size(&light_l), frames);
+    messagePlayer(clientnum, MESSAGE_MISC, "whole map: %.1f us/frame, dirty regions with %d%% of lights rebuilt: %.1f us/frame",
+        full, percent, dirty);
+    });
+#endif
+
 static void updateChunks();
 
 void beginGraphics() {
@@ -1013,6 +1283,7 @@ void glBeginCamera(view_t* camera, bool useHDR)
             break;
         }
     }
+    updateLightmapOccluders();
     fillSmoothLightmap(lightmapIndex);
     loadLightmapTexture(lightmapIndex);
     
@@ -1030,8 +1301,7 @@ void glBeginCamera(view_t* camera, bool useHDR)
     uploadUniforms(spriteUIShader, (float*)&proj, (float*)&view, nullptr);
 }
 
-#include <thread>
-#include <future>
+#include "jobs.hpp"
 
 void glEndCamera(view_t* camera, bool useHDR)
 {
@@ -1103,29 +1373,25 @@ void glEndCamera(view_t* camera, bool useHDR)
             std::vector<float> v(4);
             int samplesCollected = 0;
             if (hdr_multithread) {
-                // spawn jobs to count samples
-                const auto cores = std::thread::hardware_concurrency();
-                std::vector<std::future<std::vector<float>>> jobs;
+                // split the samples between the job workers
+                const int sections = Jobs.workers() + 1;
+                std::vector<std::vector<float>> results(sections);
                 const int size = camera->winw * camera->winh * 4;
                 const int step = ((size / 4) / hdr_samples) * 4;
-                const int section = ((size / cores) / 4) * 4;
-                auto begin = pixels;
-                for (int c = 0; c < cores; ++c, begin += section) {
-                    jobs.emplace_back(std::async(std::launch::async, fn,
-                        begin, begin + section, step));
-                    samplesCollected += section / step;
-                }
+                const int section = ((size / sections) / 4) * 4;
+                Jobs.parallel_for("hdr luminance", 0, sections, 1, [&](size_t first, size_t last) {
+                    for (size_t c = first; c < last; ++c) {
+                        results[c] = fn(pixels + c * section, pixels + (c + 1) * section, step);
+                    }
+                });
                 
                 // add samples together
-                for (int c = 0; c < cores; ++c) {
-                    auto& job = jobs[c];
-                    if (job.valid()) {
-                        auto r = job.get();
-                        v[0] += r[0];
-                        v[1] += r[1];
-                        v[2] += r[2];
-                        v[3] += r[3];
-                    }
+                for (auto& r : results) {
+                    v[0] += r[0];
+                    v[1] += r[1];
+                    v[2] += r[2];
+                    v[3] += r[3];
+                    samplesCollected += step > 0 ? section / step : 0;
                 }
             } else {
                 // synchronized sample collection
@@ -1997,9 +2263,7 @@ Mesh skyMesh = {
     }, // colors
 };
 
-#ifndef EDITOR
-static ConsoleVariable<bool> cvar_allowChunkRebuild("/allow_chunk_rebuild", true);
-#endif
+static void uploadChunkMeshes();
 
 void glDrawWorld(view_t* camera, int mode)
 {
@@ -2043,8 +2307,7 @@ void glDrawWorld(view_t* camera, int mode)
     
     const bool ditheringDisabled = ticks - ditherDisabledTime < TICKS_PER_SECOND;
     
-    // update chunk dithering & mark chunks for rebuilding
-    std::set<std::pair<int, Chunk*>> chunksToBuild;
+    // update chunk dithering
     for (int index = 0; index < chunks.size(); ++index) {
         auto& chunk = chunks[index];
         auto& dither = chunk.dithering[camera];
@@ -2069,59 +2332,10 @@ void glDrawWorld(view_t* camera, int mode)
             }
         end:;
         }
-        if (dither.value) {
-            if (chunk.isDirty(map)) {
-                chunksToBuild.emplace(0, &chunk);
-            }
-        }
     }
     
-    // mark chunk neighbors for building (in-case of shared walls)
-    const int dim = 4; // size of chunk in tiles
-    const int yoff = 1;
-    const int xoff = (map.height / dim) + ((map.height % dim) ? 1 : 0);
-    for (auto it = chunksToBuild.begin(); it != chunksToBuild.end();) {
-        const int index = it->first;
-        bool foundDirtyNeighbor = false; // call the police
-        for (int x = -xoff; x <= xoff; x += xoff) {
-            for (int y = -yoff; y <= yoff; y += yoff) {
-                if ((x && y) || (!x && !y)) {
-                    continue;
-                }
-                const int off = index + x + y;
-                if (off < 0 || off >= chunks.size()) {
-                    continue;
-                }
-                auto& neighbor = chunks[off];
-                if (chunksToBuild.emplace(off, &neighbor).second) {
-                    if (neighbor.isDirty(map)) {
-                        // if this neighbor chunk needs rebuilding,
-                        // it's possible _its_ neighbors need rebuilding too.
-                        // therefore, restart the search for adjacent chunks.
-                        it = chunksToBuild.begin();
-                        foundDirtyNeighbor = true;
-                    }
-                }
-            }
-        }
-        if (!foundDirtyNeighbor) {
-            ++it;
-        }
-    }
-    
-#ifdef EDITOR
-    constexpr bool allowChunkRebuild = true;
-#else
-    const bool allowChunkRebuild = *cvar_allowChunkRebuild;
-#endif
-    
-    // build chunks
-    if (allowChunkRebuild) {
-        for (auto& pair : chunksToBuild) {
-            auto& chunk = *pair.second;
-            chunk.build(map, !clouds, chunk.x, chunk.y, chunk.w, chunk.h);
-        }
-    }
+    // pick up any meshes the workers finished since beginGraphics()
+    uploadChunkMeshes();
     
     // draw chunks
     for (auto& chunk : chunks) {
@@ -2271,76 +2485,92 @@ void GO_SwapBuffers(SDL_Window* screen)
     }
 }
 
-static float chunkTexCoords[3];
-static inline void makeTexCoords(float x, float y, float tile) {
-#define fdivf(A, B) A / B
-    constexpr float dim = 32.f;
-    chunkTexCoords[0] = floorf(fmodf(tile, dim) + x) / dim;
-    chunkTexCoords[1] = floorf(fdivf(tile, dim) + y) / dim;
+ChunkSource::ChunkSource(const map_t& map, bool ceiling, bool snapshot):
+    width((int)map.width),
+    height((int)map.height),
+    ceiling(ceiling)
+{
+    // determine ceiling texture
+    if (map.flags[MAP_FLAG_CEILINGTILE] > 0 && map.flags[MAP_FLAG_CEILINGTILE] < numtiles) {
+        ceilingTile = map.flags[MAP_FLAG_CEILINGTILE];
+    }
+    if (snapshot) {
+        copy.assign(map.tiles, map.tiles + width * height * MAPLAYERS);
+        tiles = copy.data();
+    } else {
+        tiles = map.tiles;
+    }
 }
 
-void Chunk::build(const map_t& map, bool ceiling, int startX, int startY, int w, int h) {
-    std::vector<float> positions;
-    std::vector<float> texcoords;
-    std::vector<float> colors;
+void Chunk::buildMesh(const ChunkSource& src, int startX, int startY, int w, int h, ChunkMesh& mesh) {
+    auto& positions = mesh.positions;
+    auto& texcoords = mesh.texcoords;
+    auto& colors = mesh.colors;
+    positions.clear();
+    texcoords.clear();
+    colors.clear();
     
     positions.reserve(1200);
     texcoords.reserve(800);
     colors.reserve(1200);
     
-    // determine ceiling texture
-    int mapceilingtile = 50;
-    if (map.flags[MAP_FLAG_CEILINGTILE] > 0 && map.flags[MAP_FLAG_CEILINGTILE] < numtiles) {
-        mapceilingtile = map.flags[MAP_FLAG_CEILINGTILE];
-    }
+    float chunkTexCoords[2];
+    auto makeTexCoords = [&chunkTexCoords](float x, float y, float tile) {
+        constexpr float dim = 32.f;
+        chunkTexCoords[0] = floorf(fmodf(tile, dim) + x) / dim;
+        chunkTexCoords[1] = floorf(tile / dim + y) / dim;
+    };
+    
+    const int mapceilingtile = src.ceilingTile;
+    const bool ceiling = src.ceiling;
     
     int index2 = 0;
-    const int endX = std::min((int)map.width, startX + w);
-    const int endY = std::min((int)map.height, startY + h);
+    const int endX = std::min(src.width, startX + w);
+    const int endY = std::min(src.height, startY + h);
     
     // copy tiles
-    this->x = startX;
-    this->y = startY;
-    this->w = endX - startX;
-    this->h = endY - startY;
-    const int sizeOfTiles = this->w * this->h * MAPLAYERS;
-    this->tiles.clear();
-    this->tiles.resize(sizeOfTiles);
+    mesh.x = startX;
+    mesh.y = startY;
+    mesh.w = endX - startX;
+    mesh.h = endY - startY;
+    const int sizeOfTiles = mesh.w * mesh.h * MAPLAYERS;
+    mesh.tiles.clear();
+    mesh.tiles.resize(sizeOfTiles);
     
     for (int x = startX; x < endX; ++x) {
         for (int y = startY; y < endY; ++y) {
             for (int z = 0; z < MAPLAYERS + 1; ++z) {
-                const int index = z + y * MAPLAYERS + x * map.height * MAPLAYERS;
+                const int index = z + y * MAPLAYERS + x * src.height * MAPLAYERS;
 
                 // build walls
                 if (z >= 0 && z < MAPLAYERS) {
                     assert(index2 < sizeOfTiles);
-                    this->tiles[index2] = map.tiles[index];
+                    mesh.tiles[index2] = src.tiles[index];
                     ++index2;
                     
                     // skip empty tiles
-                    if (map.tiles[index] == 0) {
+                    if (src.tiles[index] == 0) {
                         continue;
                     }
 
                     // skip special transparent tile
-                    if (map.tiles[index] == TRANSPARENT_TILE) {
+                    if (src.tiles[index] == TRANSPARENT_TILE) {
                         continue;
                     }
 
                     // select texture
                     float tile = mapceilingtile;
-                    if (map.tiles[index] >= 0 && map.tiles[index] < numtiles) {
-                        if (map.tiles[index] >= 22 && map.tiles[index] < 30) {
+                    if (src.tiles[index] >= 0 && src.tiles[index] < numtiles) {
+                        if (src.tiles[index] >= 22 && src.tiles[index] < 30) {
                             // water special case
-                            tile = 267 + map.tiles[index] - 22;
+                            tile = 267 + src.tiles[index] - 22;
                         }
-                        else if (map.tiles[index] >= 64 && map.tiles[index] < 72) {
+                        else if (src.tiles[index] >= 64 && src.tiles[index] < 72) {
                             // lava special case
-                            tile = 285 + map.tiles[index] - 64;
+                            tile = 285 + src.tiles[index] - 64;
                         }
                         else {
-                            tile = map.tiles[index];
+                            tile = src.tiles[index];
                         }
                     }
                     
@@ -2355,8 +2585,8 @@ void Chunk::build(const map_t& map, bool ceiling, int startX, int startY, int w,
                     }
 
                     // draw east wall
-                    const int easter = index + MAPLAYERS * map.height;
-                    if (x == map.width - 1 || !map.tiles[easter] || map.tiles[easter] == TRANSPARENT_TILE) {
+                    const int easter = index + MAPLAYERS * src.height;
+                    if (x == src.width - 1 || !src.tiles[easter] || src.tiles[easter] == TRANSPARENT_TILE) {
                         if (z) { // normal wall
                             colors.insert(colors.end(), {1.f, 1.f, 1.f});
                             makeTexCoords(0.f, 0.f, tile);
@@ -2428,7 +2658,7 @@ void Chunk::build(const map_t& map, bool ceiling, int startX, int startY, int w,
 
                     // draw south wall
                     const int souther = index + MAPLAYERS;
-                    if (y == map.height - 1 || !map.tiles[souther] || map.tiles[souther] == TRANSPARENT_TILE) {
+                    if (y == src.height - 1 || !src.tiles[souther] || src.tiles[souther] == TRANSPARENT_TILE) {
                         if (z) { // normal wall
                             colors.insert(colors.end(), {1.f, 1.f, 1.f});
                             makeTexCoords(0.f, 0.f, tile);
@@ -2499,8 +2729,8 @@ void Chunk::build(const map_t& map, bool ceiling, int startX, int startY, int w,
                     }
 
                     // draw west wall
-                    const int wester = index - MAPLAYERS * map.height;
-                    if (x == 0 || !map.tiles[wester] || map.tiles[wester] == TRANSPARENT_TILE) {
+                    const int wester = index - MAPLAYERS * src.height;
+                    if (x == 0 || !src.tiles[wester] || src.tiles[wester] == TRANSPARENT_TILE) {
                         if (z) { // normal wall
                             colors.insert(colors.end(), {1.f, 1.f, 1.f});
                             makeTexCoords(0.f, 0.f, tile);
@@ -2572,7 +2802,7 @@ void Chunk::build(const map_t& map, bool ceiling, int startX, int startY, int w,
 
                     // draw north wall
                     const int norther = index - MAPLAYERS;
-                    if (y == 0 || !map.tiles[norther] || map.tiles[norther] == TRANSPARENT_TILE) {
+                    if (y == 0 || !src.tiles[norther] || src.tiles[norther] == TRANSPARENT_TILE) {
                         if (z) { // normal wall
                             colors.insert(colors.end(), {1.f, 1.f, 1.f});
                             makeTexCoords(0.f, 0.f, tile);
@@ -2648,10 +2878,10 @@ void Chunk::build(const map_t& map, bool ceiling, int startX, int startY, int w,
                     // select floor/ceiling texture
                     float tile = mapceilingtile;
                     if (z >= 0 && z < MAPLAYERS) {
-                        if (map.tiles[index] < 0 || map.tiles[index] >= numtiles) {
+                        if (src.tiles[index] < 0 || src.tiles[index] >= numtiles) {
                             tile = 0;
                         } else {
-                            tile = map.tiles[index];
+                            tile = src.tiles[index];
                         }
                     }
                     
@@ -2667,7 +2897,7 @@ void Chunk::build(const map_t& map, bool ceiling, int startX, int startY, int w,
                     
                     // build floor
                     if (z < OBSTACLELAYER) {
-                        if (!map.tiles[index + 1] || map.tiles[index + 1] == TRANSPARENT_TILE) {
+                        if (!src.tiles[index + 1] || src.tiles[index + 1] == TRANSPARENT_TILE) {
                             colors.insert(colors.end(), {1.f, 1.f, 1.f});
                             makeTexCoords(0.f, 0.f, tile);
                             texcoords.insert(texcoords.end(), &chunkTexCoords[0], &chunkTexCoords[2]);
@@ -2702,7 +2932,7 @@ void Chunk::build(const map_t& map, bool ceiling, int startX, int startY, int w,
                     
                     // build ceiling
                     else if (z > OBSTACLELAYER && (ceiling || z < MAPLAYERS)) {
-                        if (!map.tiles[index - 1] || map.tiles[index - 1] == TRANSPARENT_TILE) {
+                        if (!src.tiles[index - 1] || src.tiles[index - 1] == TRANSPARENT_TILE) {
                             colors.insert(colors.end(), {1.f, 1.f, 1.f});
                             makeTexCoords(0.f, 0.f, tile);
                             texcoords.insert(texcoords.end(), &chunkTexCoords[0], &chunkTexCoords[2]);
@@ -2738,11 +2968,25 @@ void Chunk::build(const map_t& map, bool ceiling, int startX, int startY, int w,
             }
         }
     }
-    indices = (int)texcoords.size() / 2;
-    buildBuffers(positions, texcoords, colors);
+}
+
+void Chunk::upload(ChunkMesh& mesh) {
+    x = mesh.x;
+    y = mesh.y;
+    w = mesh.w;
+    h = mesh.h;
+    tiles.swap(mesh.tiles);
+    indices = (int)mesh.texcoords.size() / 2;
+    buildBuffers(mesh.positions, mesh.texcoords, mesh.colors);
     //printlog("built chunk with %d tris", indices);
 }
 
+void Chunk::build(const map_t& map, bool ceiling, int startX, int startY, int w, int h) {
+    ChunkMesh mesh;
+    buildMesh(ChunkSource(map, ceiling, false), startX, startY, w, h, mesh);
+    upload(mesh);
+}
+
 void Chunk::buildBuffers(const std::vector<float>& positions, const std::vector<float>& texcoords, const std::vector<float>& colors) {
     // create buffers
 #ifdef VERTEX_ARRAYS_ENABLED
@@ -2858,19 +3102,104 @@ bool Chunk::isDirty(const map_t& map) {
     return false;
 }
 
+static constexpr int chunkSize = 4; // in tiles
+
+#ifndef EDITOR
+static ConsoleVariable<bool> cvar_allowChunkRebuild("/allow_chunk_rebuild", true);
+static ConsoleVariable<bool> cvar_chunkJobs("/chunk_jobs", true);
+static ConsoleVariable<int> cvar_chunkDirtyScan("/chunk_dirty_scan", 8);
+#endif
+
+// one per chunk, in the same order as chunks
+struct ChunkState {
+    bool dirty = false;    // tiles changed since the mesh was last built
+    bool building = false; // a worker has a mesh in flight for it
+};
+static std::vector<ChunkState> chunkStates;
+
+struct ChunkJob {
+    int index;
+    JobSystem::Handle job;
+    std::shared_ptr<ChunkMesh> mesh;
+};
+static std::vector<ChunkJob> chunkJobs;
+static int chunkScan = 0; // next chunk for the dirty scan to check
+
+static int chunksTall() {
+    return ((int)map.height + chunkSize - 1) / chunkSize;
+}
+
+void markChunksDirty(int x, int y) {
+    if (chunkStates.empty() || x < 0 || y < 0 || x >= map.width || y >= map.height) {
+        return;
+    }
+    
+    // walls are only built on faces next to open tiles, so the chunks on
+    // either side of a border both depend on the tiles along it
+    const int tall = chunksTall();
+    const int x0 = std::max(0, x - 1) / chunkSize;
+    const int x1 = std::min((int)map.width - 1, x + 1) / chunkSize;
+    const int y0 = std::max(0, y - 1) / chunkSize;
+    const int y1 = std::min((int)map.height - 1, y + 1) / chunkSize;
+    for (int u = x0; u <= x1; ++u) {
+        for (int v = y0; v <= y1; ++v) {
+            const int index = v + u * tall;
+            if (index < chunkStates.size()) {
+                chunkStates[index].dirty = true;
+            }
+        }
+    }
+}
+
+void markChunksDirty() {
+    for (auto& state : chunkStates) {
+        state.dirty = true;
+    }
+}
+
 void clearChunks() {
+    // jobs still in flight own their source and mesh, so let them finish
+    // on their own and ignore the results
+    chunkJobs.clear();
+    chunkStates.clear();
+    chunkScan = 0;
     chunks.clear();
 }
 
 void createChunks() {
-    constexpr int chunkSize = 4;
-    chunks.reserve((map.width / chunkSize + 1) * (map.height / chunkSize + 1));
-    for (int x = 0; x < map.width; x += chunkSize) {
-        for (int y = 0; y < map.height; y += chunkSize) {
-            chunks.emplace_back();
-            auto& chunk = chunks.back();
-            chunk.build(map, !shouldDrawClouds(map), x, y, chunkSize, chunkSize);
+#ifdef BARONY_HEADLESS
+    return; // chunks only hold vertex buffers
+#endif
+    const int tall = chunksTall();
+    const int count = tall * (((int)map.width + chunkSize - 1) / chunkSize);
+    
+    // build every mesh across the workers, then upload them here
+    const ChunkSource source(map, !shouldDrawClouds(map), false);
+    std::vector<ChunkMesh> meshes(count);
+    Jobs.parallel_for("chunk mesh", 0, count, 16, [&](size_t begin, size_t end) {
+        for (size_t index = begin; index < end; ++index) {
+            const int x = (int)index / tall * chunkSize;
+            const int y = (int)index % tall * chunkSize;
+            Chunk::buildMesh(source, x, y, chunkSize, chunkSize, meshes[index]);
         }
+    });
+    chunks.reserve(count);
+    for (auto& mesh : meshes) {
+        chunks.emplace_back();
+        chunks.back().upload(mesh);
+    }
+    chunkStates.resize(chunks.size());
+}
+
+static void uploadChunkMeshes() {
+    for (auto it = chunkJobs.begin(); it != chunkJobs.end();) {
+        if (!Jobs.done(it->job)) {
+            ++it;
+            continue;
+        }
+        chunks[it->index].upload(*it->mesh);
+        chunkStates[it->index].building = false;
+        it = chunkJobs.erase(it);
     }
 }
 
@@ -2883,6 +3212,76 @@ void updateChunks() {
         clearChunks();
         createChunks();
     }
+    if (chunkStates.empty()) {
+        return;
+    }
+    
+#ifdef EDITOR
+    constexpr bool allowChunkRebuild = true;
+    constexpr bool useJobs = true;
+    constexpr int dirtyScan = 8;
+#else
+    const bool allowChunkRebuild = *cvar_allowChunkRebuild;
+    const bool useJobs = *cvar_chunkJobs;
+    const int dirtyScan = *cvar_chunkDirtyScan;
+#endif
+    
+    uploadChunkMeshes();
+    if (!allowChunkRebuild) {
+        return;
+    }
+    
+    // anything that changes tiles should call markChunksDirty(), but as a
+    // safety net compare a few chunks against the map every frame
+    const int tall = chunksTall();
+    const int scan = std::min(std::max(dirtyScan, 0), (int)chunkStates.size());
+    for (int c = 0; c < scan; ++c) {
+        chunkScan = (chunkScan + 1) % (int)chunkStates.size();
+        auto& state = chunkStates[chunkScan];
+        if (state.dirty || state.building || !chunks[chunkScan].isDirty(map)) {
+            continue;
+        }
+        state.dirty = true;
+        
+        // in case of shared walls
+        const int neighbors[4] = {chunkScan - tall, chunkScan + tall, chunkScan - 1, chunkScan + 1};
+        for (int i = 0; i < 4; ++i) {
+            const int index = neighbors[i];
+            if (i >= 2 && index / tall != chunkScan / tall) {
+                continue; // other end of the neighboring column
+            }
+            if (index >= 0 && index < chunkStates.size()) {
+                chunkStates[index].dirty = true;
+            }
+        }
+    }
+    
+    // hand dirty chunks to the workers. a chunk that changes again while
+    // its mesh is in flight waits for that one to land, then goes again
+    std::shared_ptr<ChunkSource> source;
+    for (int index = 0; index < chunkStates.size(); ++index) {
+        auto& state = chunkStates[index];
+        if (!state.dirty || state.building) {
+            continue;
+        }
+        if (!source) {
+            source = std::make_shared<ChunkSource>(map, !shouldDrawClouds(map), useJobs);
+        }
+        state.dirty = false;
+        auto& chunk = chunks[index];
+        auto mesh = std::make_shared<ChunkMesh>();
+        if (useJobs) {
+            const int x = chunk.x, y = chunk.y, w = chunk.w, h = chunk.h;
+            auto job = Jobs.submit("chunk mesh", [source, mesh, x, y, w, h]() {
+                Chunk::buildMesh(*source, x, y, w, h, *mesh);
+            });
+            state.building = true;
+            chunkJobs.push_back({index, job, mesh});
+        } else {
+            Chunk::buildMesh(*source, chunk.x, chunk.y, chunk.w, chunk.h, *mesh);
+            chunk.upload(*mesh);
+        }
+    }
 }
 
 #ifndef EDITOR
@@ -2898,4 +3297,45 @@ static ConsoleCommand ccmd_update_chunks("/updatechunks", "rebuilds all chunks",
     clearChunks();
     createChunks();
     });
+
+static ConsoleCommand ccmd_chunk_bench("/chunk_bench", "time building every chunk mesh on the CPU (passes)",
+    [](int argc, const char* argv[]){
+    if (!map.tiles || map.width <= 0 || map.height <= 0) {
+        messagePlayer(clientnum, MESSAGE_MISC, "chunk bench: no level loaded");
+        return;
+    }
+    const int passes = argc > 1 ? std::max(1, atoi(argv[1])) : 10;
+    const int tall = chunksTall();
+    const int count = tall * (((int)map.width + chunkSize - 1) / chunkSize);
+    const ChunkSource source(map, !shouldDrawClouds(map), true);
+    std::vector<ChunkMesh> meshes(count);
+    auto build = [&](size_t begin, size_t end) {
+        for (size_t index = begin; index < end; ++index) {
+            const int x = (int)index / tall * chunkSize;
+            const int y = (int)index % tall * chunkSize;
+            Chunk::buildMesh(source, x, y, chunkSize, chunkSize, meshes[index]);
+        }
+    };
+    
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (int pass = 0; pass < passes; ++pass) {
+        build(0, count);
+    }
+    const double serial = (SDL_GetPerformanceCounter() - start) * 1000000.0 / SDL_GetPerformanceFrequency() / passes;
+    
+    start = SDL_GetPerformanceCounter();
+    for (int pass = 0; pass < passes; ++pass) {
+        Jobs.parallel_for("chunk mesh", 0, count, 16, build);
+    }
+    const double parallel = (SDL_GetPerformanceCounter() - start) * 1000000.0 / SDL_GetPerformanceFrequency() / passes;
+    
+    size_t vertices = 0;
+    for (auto& mesh : meshes) {
+        vertices += mesh.positions.size() / 3;
+    }
+    messagePlayer(clientnum, MESSAGE_MISC, "chunk bench: %dx%d map, %d chunks, %u vertices, %d passes",
+        (int)map.width, (int)map.height, count, (unsigned)vertices, passes);
+    messagePlayer(clientnum, MESSAGE_MISC, "one thread: %.1f us/map, %d workers: %.1f us/map",
+        serial, Jobs.workers() + 1, parallel);
+    });
 #endif
@@ -20,6 +20,8 @@
 #include "net.hpp"
 #include "magic/magic.hpp"
 
+#include <atomic>
+
 int* pathMapFlying = NULL;
 int* pathMapGrounded = NULL;
 int pathMapZone = 1;
@@ -80,6 +82,7 @@ public:
 	std::unordered_map<int, std::unordered_set<int>> connectedZones;
 	void buildGraph(const int parentMapType);
 	void fillPathMap(int x, int y);
+	bool updateTile(int x, int y);
 	bool generatePath(Entity* my, int x1, int y1, int x2, int y2);
 	void reset()
 	{
@@ -261,6 +264,149 @@ public:
 };
 GateGraph gateGraph[GateGraph::GATE_GRAPH_NUM_PATHMAPS];
 GateGraph::GateNode_t GateGraph::defaultGate(-1, -1, -1, -1, 0, GateGraph::DIR_EASTWEST);
+
+/*-------------------------------------------------------------------------------
+
+	SectorGraph
+
+	hierarchical layer used for long-distance paths. The map is cut into
+	SECTOR_SIZE square sectors; abstract nodes are placed on each side of
+	every passable opening between two sectors and on both sides of every
+	gate from the GateGraph. Tile routes and costs between nodes sharing a
+	sector are cached when the path maps are generated, so a long search
+	only has to do tile-level work inside the first and last sectors.
+
+-------------------------------------------------------------------------------*/
+
+class SectorGraph
+{
+public:
+	static constexpr int SECTOR_SIZE = 10;
+	static constexpr int SECTOR_TILES = SECTOR_SIZE * SECTOR_SIZE;
+
+	struct Edge_t
+	{
+		int to = -1;
+		Uint32 cost = 0;
+		Uint32 gateUid = 0; // crossing this edge requires the gate to be open
+		int route = -1;		// index into routes
+	};
+	struct Node_t
+	{
+		int x = 0, y = 0;
+		int sector = 0;
+		bool isGate = false;
+		std::vector<Edge_t> edges;
+	};
+
+	// tile-restricted Dijkstra within a single sector
+	struct SectorSearch_t
+	{
+		Uint32 cost[SECTOR_TILES];
+		Sint16 parent[SECTOR_TILES];
+		bool reached[SECTOR_TILES];
+		int originX = 0, originY = 0;
+		int width = 0, height = 0;
+		bool contains(int x, int y) const
+		{
+			return x >= originX && y >= originY && x < originX + width && y < originY + height;
+		}
+		int local(int x, int y) const { return (x - originX) + (y - originY) * SECTOR_SIZE; }
+	};
+
+	std::vector<Node_t> nodes;
+	std::vector<std::vector<int>> routes; // tile indices, excluding the source node and including the destination
+	std::vector<int> freeRoutes; // slots in routes left empty by updateTile, reused by addEdge
+	std::vector<std::vector<int>> sectorNodes;
+	std::unordered_map<int, int> nodeAtTile;
+	std::vector<Uint8> gateTiles;
+	int sectorsWide = 0;
+	int sectorsHigh = 0;
+	int parentMapType = 0;
+	bool bIsInit = false;
+
+	void reset()
+	{
+		nodes.clear();
+		routes.clear();
+		freeRoutes.clear();
+		sectorNodes.clear();
+		nodeAtTile.clear();
+		gateTiles.clear();
+		sectorsWide = 0;
+		sectorsHigh = 0;
+		bIsInit = false;
+	}
+	int getSector(int x, int y) const
+	{
+		return (x / SECTOR_SIZE) + (y / SECTOR_SIZE) * sectorsWide;
+	}
+	int addNode(int x, int y, bool isGate);
+	void addEdge(int from, int to, Uint32 cost, Uint32 gateUid, std::vector<int>&& route);
+	void buildSectorEdges(int sector);
+	void build(const int parentMapType);
+	bool updateTile(int x, int y);
+	void searchSector(SectorSearch_t& search, int x, int y, const std::function<bool(int, int)>& blocked) const;
+	bool generatePath(int x1, int y1, int x2, int y2, bool ignoreGates,
+		const std::function<bool(int, int)>& blocked, std::vector<int>& outTiles, int& outExpanded);
+};
+SectorGraph sectorGraph[GateGraph::GATE_GRAPH_NUM_PATHMAPS];
+static ConsoleVariable<bool> cvar_pathing_hierarchical("/pathing_hierarchical", true);
+
+/*-------------------------------------------------------------------------------
+
+	FlowFieldCache
+
+	when many monsters hunt the same player each would otherwise run its own
+	A* towards the same tile. Instead a Dijkstra distance field is built
+	outwards from the target once per target tile and path map type, and each
+	hunter walks downhill from its own tile. Fields are rebuilt when the
+	target changes tile, the path maps are regenerated, or they go stale.
+
+-------------------------------------------------------------------------------*/
+
+class FlowFieldCache
+{
+public:
+	static constexpr Uint32 UNREACHABLE = 0xFFFFFFFF;
+	static constexpr Uint32 FIELD_MAX_AGE = TICKS_PER_SECOND; // picks up gates/boulders changing state
+	struct FlowField_t
+	{
+		int targetX = -1, targetY = -1;
+		Uint32 builtOnTick = 0;
+		Uint32 lastUsedTick = 0;
+		Uint32 pathMapGeneration = 0;
+		std::vector<Uint32> distance;
+	};
+	std::unordered_map<Uint32, FlowField_t> fields; // key: target uid * GATE_GRAPH_NUM_PATHMAPS + map type
+	Uint32 numBuilds = 0;
+	Uint32 numHits = 0;
+
+	const FlowField_t& getField(Entity& target, int targetX, int targetY, int pathMapType);
+	int estimateExpansions(const FlowField_t& field, int x, int y, int limit) const;
+	void build(FlowField_t& field, int pathMapType);
+	void prune();
+	void reset() { fields.clear(); }
+};
+FlowFieldCache flowFieldCache;
+static Uint32 pathMapGeneration = 0;
+static std::vector<int> pathMapZoneSize; // tiles per zone, indexed by zone for both path maps
+static int& pathMapZoneSizeOf(int zone)
+{
+	if ( (int)pathMapZoneSize.size() <= zone )
+	{
+		pathMapZoneSize.resize(zone + 1, 0);
+	}
+	return pathMapZoneSize[zone];
+}
+
+
+// full vs incremental path map rebuilds for /pathing_report
+static Uint32 pathMapStatsFullRebuilds = 0;
+static Uint64 pathMapStatsFullMicroseconds = 0;
+static Uint32 pathMapStatsIncrementalUpdates = 0;
+static Uint64 pathMapStatsIncrementalMicroseconds = 0;
+static ConsoleVariable<bool> cvar_pathing_flowfield("/pathing_flowfield", true);
 void updateGatePath(Entity& entity)
 {
 	return;
@@ -377,44 +523,259 @@ int pathCheckObstacle(int x, int y, Entity* my, Entity* target)
 
 -------------------------------------------------------------------------------*/
 
-typedef std::pair<int, int> pairtype;
-struct pair_hash
+/*-------------------------------------------------------------------------------
+
+	PathSearchContext
+
+	scratch storage reused by every generatePath() call made on a thread.
+	Nodes are addressed by tile index (y + x * map.height). Rather than
+	clearing the arrays between searches, each search bumps a generation
+	counter and a tile only counts as touched when its stamp matches the
+	current generation. The open set is a binary min-heap of tile indices
+	keyed on g + h, so no per-node allocations are made during a search.
+
+-------------------------------------------------------------------------------*/
+
+class PathSearchContext
 {
-    template <class T1, class T2>
-    std::size_t operator() (const std::pair<T1, T2> &pair) const {
-        return std::hash<T1>()(pair.first) ^ std::hash<T2>()(pair.second);
-    }
+	std::vector<Uint32> openStamp;		// tile has been added to the open set
+	std::vector<Uint32> closedStamp;	// tile has been expanded
+	std::vector<Uint32> blockedStamp;	// tile is occupied by an obstacle entity
+	std::vector<Uint32> costG;
+	std::vector<Uint32> costH;
+	std::vector<int> parent;
+	std::vector<int> heapPos;
+	std::vector<int> heap;
+	Uint32 generation = 0;
+
+	bool heapLess(const int a, const int b) const
+	{
+		return costG[a] + costH[a] < costG[b] + costH[b];
+	}
+	void heapSwap(const int i, const int j)
+	{
+		std::swap(heap[i], heap[j]);
+		heapPos[heap[i]] = i;
+		heapPos[heap[j]] = j;
+	}
+	void siftUp(int i)
+	{
+		while ( i > 0 )
+		{
+			const int p = (i - 1) / 2;
+			if ( !heapLess(heap[i], heap[p]) )
+			{
+				break;
+			}
+			heapSwap(i, p);
+			i = p;
+		}
+	}
+	void siftDown(int i)
+	{
+		const int size = heap.size();
+		while ( true )
+		{
+			const int l = 2 * i + 1;
+			const int r = l + 1;
+			int smallest = i;
+			if ( l < size && heapLess(heap[l], heap[smallest]) )
+			{
+				smallest = l;
+			}
+			if ( r < size && heapLess(heap[r], heap[smallest]) )
+			{
+				smallest = r;
+			}
+			if ( smallest == i )
+			{
+				break;
+			}
+			heapSwap(i, smallest);
+			i = smallest;
+		}
+	}
+public:
+	// prepares the context for a new search over a map of numTiles tiles
+	void begin(const int numTiles)
+	{
+		if ( (int)openStamp.size() < numTiles )
+		{
+			openStamp.resize(numTiles, 0);
+			closedStamp.resize(numTiles, 0);
+			blockedStamp.resize(numTiles, 0);
+			costG.resize(numTiles, 0);
+			costH.resize(numTiles, 0);
+			parent.resize(numTiles, -1);
+			heapPos.resize(numTiles, -1);
+			heap.reserve(numTiles);
+		}
+		++generation;
+		if ( generation == 0 )
+		{
+			// counter wrapped, stale stamps could now collide
+			std::fill(openStamp.begin(), openStamp.end(), 0);
+			std::fill(closedStamp.begin(), closedStamp.end(), 0);
+			std::fill(blockedStamp.begin(), blockedStamp.end(), 0);
+			generation = 1;
+		}
+		heap.clear();
+	}
+
+	void setBlocked(const int index) { blockedStamp[index] = generation; }
+	bool isBlocked(const int index) const { return blockedStamp[index] == generation; }
+	bool isOpen(const int index) const { return openStamp[index] == generation && closedStamp[index] != generation; }
+	bool isClosed(const int index) const { return closedStamp[index] == generation; }
+	bool empty() const { return heap.empty(); }
+	Uint32 getG(const int index) const { return costG[index]; }
+	int getParent(const int index) const { return parent[index]; }
+
+	void push(const int index, const Uint32 g, const Uint32 h, const int parentIndex)
+	{
+		openStamp[index] = generation;
+		costG[index] = g;
+		costH[index] = h;
+		parent[index] = parentIndex;
+		heap.push_back(index);
+		heapPos[index] = heap.size() - 1;
+		siftUp(heap.size() - 1);
+	}
+
+	// lower the cost of a node already in the open set
+	void relax(const int index, const Uint32 g, const int parentIndex)
+	{
+		costG[index] = g;
+		parent[index] = parentIndex;
+		siftUp(heapPos[index]);
+	}
+
+	// removes the cheapest node from the open set and marks it closed
+	int pop()
+	{
+		const int index = heap.front();
+		heapSwap(0, heap.size() - 1);
+		heap.pop_back();
+		if ( !heap.empty() )
+		{
+			siftDown(0);
+		}
+		closedStamp[index] = generation;
+		return index;
+	}
 };
+static thread_local PathSearchContext pathSearchContext;
 
-static std::chrono::high_resolution_clock::time_point pathtime;
-static std::chrono::high_resolution_clock::time_point starttime;
-static std::chrono::microseconds ms(0);
-static Uint32 updatedOnTick = 0;
+// running totals for /pathing_report, shared by all threads
+static std::atomic<Uint32> pathStatsCalls(0);
+static std::atomic<Uint64> pathStatsNodes(0);
+static std::atomic<Uint64> pathStatsMicroseconds(0);
+static std::atomic<Uint32> pathStatsMaxNodes(0);
+static std::atomic<Uint64> pathStatsMaxMicroseconds(0);
+
+// /pathing_debug time for the current tick, from any thread. handed to DebugStats by updatePathDebugStats()
+static std::atomic<Uint64> pathDebugMicroseconds(0);
 static ConsoleVariable<int> cvar_pathlimit("/pathlimit", 200);
 static ConsoleVariable<bool> cvar_pathing_debug("/pathing_debug", false);
-int lastGeneratePathTries = 0;
-list_t* generatePath(int x1, int y1, int x2, int y2, Entity* my, Entity* target, GeneratePathTypes pathingType, bool lavaIsPassable)
+thread_local int lastGeneratePathTries = 0;
+
+static Uint64 recordPathStats(const std::chrono::high_resolution_clock::time_point& pathtime, const int tries)
 {
+	auto now = std::chrono::high_resolution_clock::now();
+	const Uint64 elapsed = std::chrono::duration_cast<std::chrono::microseconds>(now - pathtime).count();
 	if ( *cvar_pathing_debug )
 	{
-		pathtime = std::chrono::high_resolution_clock::now();
-		if ( updatedOnTick != ticks )
-		{
-			DebugStats.gui1 = starttime;
-			DebugStats.gui2 = {};
-			starttime = std::chrono::high_resolution_clock::now();
-			updatedOnTick = ticks;
-		}
+		pathDebugMicroseconds += elapsed;
+	}
+
+	++pathStatsCalls;
+	pathStatsNodes += tries;
+	pathStatsMicroseconds += elapsed;
+	Uint32 maxNodes = pathStatsMaxNodes;
+	while ( (Uint32)tries > maxNodes && !pathStatsMaxNodes.compare_exchange_weak(maxNodes, tries) );
+	Uint64 maxUs = pathStatsMaxMicroseconds;
+	while ( elapsed > maxUs && !pathStatsMaxMicroseconds.compare_exchange_weak(maxUs, elapsed) );
+	lastGeneratePathTries = tries;
+	return elapsed;
+}
+
+void updatePathDebugStats()
+{
+	const Uint64 us = pathDebugMicroseconds.exchange(0);
+	if ( *cvar_pathing_debug )
+	{
+		DebugStats.gui2 = std::chrono::high_resolution_clock::time_point(std::chrono::microseconds(us));
+	}
+}
+
+static ConsoleCommand ccmd_pathing_report("/pathing_report", "print generatePath node/time totals (args: reset)",
+	[](int argc, const char** argv) {
+	const Uint32 calls = pathStatsCalls;
+	const Uint64 nodes = pathStatsNodes;
+	const Uint64 us = pathStatsMicroseconds;
+	messagePlayer(clientnum, MESSAGE_MISC, "generatePath: %u calls, %llu nodes expanded, %llu us total",
+		calls, (unsigned long long)nodes, (unsigned long long)us);
+	if ( calls > 0 )
+	{
+		messagePlayer(clientnum, MESSAGE_MISC, "avg %.1f nodes / %.1f us per call, max %u nodes / %llu us",
+			nodes / (double)calls, us / (double)calls,
+			(Uint32)pathStatsMaxNodes, (unsigned long long)pathStatsMaxMicroseconds);
+	}
+	messagePlayer(clientnum, MESSAGE_MISC, "flow fields: %d cached, %u builds, %u reuses",
+		(int)flowFieldCache.fields.size(), flowFieldCache.numBuilds, flowFieldCache.numHits);
+	messagePlayer(clientnum, MESSAGE_MISC, "path maps: %u full rebuilds (%llu us), %u incremental updates (%llu us)",
+		pathMapStatsFullRebuilds, (unsigned long long)pathMapStatsFullMicroseconds,
+		pathMapStatsIncrementalUpdates, (unsigned long long)pathMapStatsIncrementalMicroseconds);
+	if ( argc > 1 && !strcmp(argv[1], "reset") )
+	{
+		pathStatsCalls = 0;
+		pathStatsNodes = 0;
+		pathStatsMicroseconds = 0;
+		pathStatsMaxNodes = 0;
+		pathStatsMaxMicroseconds = 0;
+		flowFieldCache.numBuilds = 0;
+		flowFieldCache.numHits = 0;
+		pathMapStatsFullRebuilds = 0;
+		pathMapStatsFullMicroseconds = 0;
+		pathMapStatsIncrementalUpdates = 0;
+		pathMapStatsIncrementalMicroseconds = 0;
+	}
+	});
+
+// converts a sequence of tile indices (excluding the start tile) to a pathnode list
+static list_t* pathListFromTiles(const std::vector<int>& tiles, int x1, int y1, int x2, int y2)
+{
+	auto path = (list_t*) malloc(sizeof(list_t));
+	path->first = nullptr;
+	path->last = nullptr;
+	int px = x1;
+	int py = y1;
+	Uint32 g = 0;
+	for ( int index : tiles )
+	{
+		auto pathnode = (pathnode_t*)malloc(sizeof(pathnode_t));
+		pathnode->x = index / map.height;
+		pathnode->y = index % map.height;
+		g += (pathnode->x != px && pathnode->y != py) ? DIAGONALCOST : STRAIGHTCOST;
+		pathnode->g = g;
+		pathnode->h = heuristic(pathnode->x, pathnode->y, x2, y2);
+		pathnode->px = px;
+		pathnode->py = py;
+		px = pathnode->x;
+		py = pathnode->y;
+		auto node = list_AddNodeLast(path);
+		node->size = sizeof(pathnode_t);
+		node->deconstructor = defaultDeconstructor;
+		node->element = pathnode;
 	}
+	return path;
+}
+
+list_t* generatePath(int x1, int y1, int x2, int y2, Entity* my, Entity* target, GeneratePathTypes pathingType, bool lavaIsPassable)
+{
+	const auto pathtime = std::chrono::high_resolution_clock::now();
 	if (!my)
 	{
-		if ( *cvar_pathing_debug )
-		{
-			auto now = std::chrono::high_resolution_clock::now();
-			ms = std::chrono::duration_cast<std::chrono::microseconds>(now - pathtime);
-			DebugStats.gui2 = DebugStats.gui2 + ms;
-		}
-		lastGeneratePathTries = 0;
+		recordPathStats(pathtime, 0);
 		return NULL;
 	}
 
@@ -444,34 +805,30 @@ list_t* generatePath(int x1, int y1, int x2, int y2, Entity* my, Entity* target,
 	bool playerCheckAchievement = (my && my->behavior == &actPlayer
 		&& target && (target->behavior == &actBomb || target->behavior == &actPlayerLimb || target->behavior == &actItem || target->behavior == &actSwitch));
 
-	int* pathMap = (int*) calloc(map.width * map.height, sizeof(int));
+	// the zone maps are read in place, tiles made impassable by entities
+	// for this search only are stamped into the search context instead.
+	const int numTiles = map.width * map.height;
+	const int* pathMap = nullptr;
 	int pathMapType = GateGraph::GATE_GRAPH_GROUNDED;
 	if ( !loading )
 	{
 		if ( levitating || playerCheckPathToExit )
 		{
-			memcpy(pathMap, pathMapFlying, map.width * map.height * sizeof(int));
+			pathMap = pathMapFlying;
 			pathMapType = GateGraph::GATE_GRAPH_FLYING;
 		}
 		else
 		{
-			memcpy(pathMap, pathMapGrounded, map.width * map.height * sizeof(int));
+			pathMap = pathMapGrounded;
 		}
 	}
 
-	int myPathMap = pathMap[y1 + x1 * map.height];
 	if ( !loading )
 	{
+		int myPathMap = pathMap[y1 + x1 * map.height];
 		if ( !myPathMap || myPathMap != pathMap[y2 + x2 * map.height] || !pathMap[y2 + x2 * map.height] || (x1 == x2 && y1 == y2) )
 		{
-			free(pathMap);
-			if ( *cvar_pathing_debug )
-			{
-				auto now = std::chrono::high_resolution_clock::now();
-				ms = std::chrono::duration_cast<std::chrono::microseconds>(now - pathtime);
-				DebugStats.gui2 = DebugStats.gui2 + ms;
-			}
-			lastGeneratePathTries = 0;
+			recordPathStats(pathtime, 0);
 			if ( my->behavior == &actMonster
 				&& (pathingType == GENERATE_PATH_ALLY_FOLLOW
 					|| pathingType == GENERATE_PATH_ALLY_FOLLOW2) )
@@ -488,14 +845,7 @@ list_t* generatePath(int x1, int y1, int x2, int y2, Entity* my, Entity* target,
 				if ( !bGatePath )
 				{
 					//messagePlayer(0, MESSAGE_DEBUG, "GATE GRAPH: %.4f", out1);
-					free(pathMap);
-					if ( *cvar_pathing_debug )
-					{
-						auto now = std::chrono::high_resolution_clock::now();
-						ms = std::chrono::duration_cast<std::chrono::microseconds>(now - pathtime);
-						DebugStats.gui2 = DebugStats.gui2 + ms;
-					}
-					lastGeneratePathTries = 0;
+					recordPathStats(pathtime, 0);
 					if ( my->behavior == &actMonster
 						&& (pathingType == GENERATE_PATH_ALLY_FOLLOW
 							|| pathingType == GENERATE_PATH_ALLY_FOLLOW2) )
@@ -508,9 +858,12 @@ list_t* generatePath(int x1, int y1, int x2, int y2, Entity* my, Entity* target,
 		}
 	}
 
+	PathSearchContext& context = pathSearchContext;
+	context.begin(numTiles);
+
 	// for boulders falling and checking if a player can reach the ladder.
 	// if we're not levitating, we use the flying path map (for water/lava) and here we remove the empty air tiles from the pathMap.
-	if ( playerCheckPathToExit && !levitating )
+	if ( playerCheckPathToExit && !levitating && !loading )
 	{
 		for ( int y = 0; y < map.height; ++y )
 		{
@@ -518,7 +871,7 @@ list_t* generatePath(int x1, int y1, int x2, int y2, Entity* my, Entity* target,
 			{
 				if ( !map.tiles[y * MAPLAYERS + x * MAPLAYERS * map.height] )
 				{
-					pathMap[y + x * map.height] = 0;
+					context.setBlocked(y + x * map.height);
 				}
 			}
 		}
@@ -617,36 +970,25 @@ list_t* generatePath(int x1, int y1, int x2, int y2, Entity* my, Entity* target,
 		}
 		int x = std::min<unsigned int>(std::max<int>(0, entity->x / 16), map.width - 1); //TODO: Why are int and double being compared? And why are int and unsigned int being compared?
 		int y = std::min<unsigned int>(std::max<int>(0, entity->y / 16), map.height - 1); //TODO: Why are int and double being compared? And why are int and unsigned int being compared?
-		pathMap[y + x * map.height] = 0;
-	}
-
-    // here begins actual A* code:
-    struct queue_type {
-        int x, y;
-        std::unordered_map<pairtype, pathnode_t, pair_hash>& openSet;
-        bool operator>(const queue_type& rhs) const {
-            const auto find1 = openSet.find({x, y});
-            assert(find1 != openSet.end());
-            const auto& lhs_node = find1->second;
-            const auto find2 = rhs.openSet.find({rhs.x, rhs.y});
-            assert(find2 != openSet.end());
-            const auto& rhs_node = find2->second;
-            return lhs_node.g + lhs_node.h > rhs_node.g + rhs_node.h;
-        }
-        queue_type& operator=(const queue_type& rhs) {
-            x = rhs.x;
-            y = rhs.y;
-            return *this;
-        }
-    };
-    std::priority_queue<queue_type, std::vector<queue_type>, std::greater<queue_type>> queue;
-	std::unordered_map<pairtype, pathnode_t, pair_hash> openSet, closedSet;
-
-	// create starting node in list
-    const auto firstNode = pathnode_t{x1, y1, 0, heuristic(x1, y1, x2, y2), -1, -1};
-    openSet.insert({pairtype{firstNode.x, firstNode.y}, firstNode});
-	queue.push({x1, y1, openSet});
-	int tries = 0;
+		context.setBlocked(y + x * map.height);
+	}
+
+	// tile is walkable for this search
+	auto passable = [&](const int x, const int y) -> bool
+	{
+		if ( x < 0 || y < 0 || x >= (int)map.width || y >= (int)map.height )
+		{
+			return false;
+		}
+		if ( loading )
+		{
+			return !pathCheckObstacle((x << 4) + 8, (y << 4) + 8, my, target);
+		}
+		const int index = y + x * map.height;
+		return pathMap[index] && !context.isBlocked(index);
+	};
+
+	// how far A* may search before giving up
 	int maxtries = *cvar_pathlimit;
 	static ConsoleVariable<int> cvar_pathlimit_idlewalk("/pathlimit_idlewalk", 40);
 	static ConsoleVariable<int> cvar_pathlimit_allyfollow("/pathlimit_allyfollow", 200);
@@ -696,52 +1038,149 @@ list_t* generatePath(int x1, int y1, int x2, int y2, Entity* my, Entity* target,
 	{
 		maxtries = *cvar_pathlimit_bosses;
 	}
-	while (!openSet.empty()) {
+
+	// long distance follow/tracking paths go through the sector graph first
+	if ( !loading && *cvar_pathing_hierarchical && my->behavior == &actMonster
+		&& (pathingType == GENERATE_PATH_ALLY_FOLLOW
+			|| pathingType == GENERATE_PATH_ALLY_FOLLOW2
+			|| pathingType == GENERATE_PATH_BOSS_TRACKING_HUNT
+			|| pathingType == GENERATE_PATH_BOSS_TRACKING_IDLE
+			|| pathingType == GENERATE_PATH_PLAYER_ALLY_MOVETO) )
+	{
+		static thread_local std::vector<int> sectorPath;
+		int expanded = 0;
+		auto blocked = [&context](int x, int y) { return context.isBlocked(y + x * map.height); };
+		if ( sectorGraph[pathMapType].generatePath(x1, y1, x2, y2, false, blocked, sectorPath, expanded) )
+		{
+			list_t* path = pathListFromTiles(sectorPath, x1, y1, x2, y2);
+			const Uint64 us = recordPathStats(pathtime, expanded);
+			if ( *cvar_pathing_debug ) {
+				messagePlayer(0, MESSAGE_DEBUG, "PASS (%d): sector path nodes: %d, tiles: %d (%llu us)",
+					(int)pathingType, expanded, (int)sectorPath.size(), (unsigned long long)us);
+			}
+			monsterAllyFormations.updateOnPathSucceed(my->getUID(), my);
+			return path;
+		}
+	}
+
+	// hunters chasing a player walk down a distance field shared between them
+	if ( !loading && *cvar_pathing_flowfield && my->behavior == &actMonster
+		&& pathingType == GENERATE_PATH_TO_HUNT_MONSTER_TARGET
+		&& target && target->behavior == &actPlayer )
+	{
+		// only take paths A* could have found within maxtries, so hunters don't
+		// start tracking players from further away than they used to
+		const auto& field = flowFieldCache.getField(*target, x2, y2, pathMapType);
+		if ( flowFieldCache.estimateExpansions(field, x1, y1, maxtries) <= maxtries )
+		{
+			static thread_local std::vector<int> fieldPath;
+			fieldPath.clear();
+			int cx = x1;
+			int cy = y1;
+			bool reached = true;
+			while ( cx != x2 || cy != y2 )
+			{
+				// step to the neighbour closest to the target that this entity can enter
+				const Uint32 here = field.distance[cy + cx * map.height];
+				int next = -1;
+				Uint32 best = FlowFieldCache::UNREACHABLE;
+				for ( int y = -1; y <= 1; ++y )
+				{
+					for ( int x = -1; x <= 1; ++x )
+					{
+						const int newx = cx + x;
+						const int newy = cy + y;
+						if ( (x == 0 && y == 0) || !passable(newx, newy) )
+						{
+							continue;
+						}
+						if ( x && y && (!passable(cx, newy) || !passable(newx, cy)) )
+						{
+							continue;
+						}
+						const int index = newy + newx * map.height;
+						const Uint32 dist = field.distance[index];
+						if ( dist >= here )
+						{
+							continue;
+						}
+						const Uint32 total = dist + ((x && y) ? DIAGONALCOST : STRAIGHTCOST);
+						if ( total < best )
+						{
+							best = total;
+							next = index;
+						}
+					}
+				}
+				if ( next < 0 )
+				{
+					reached = false; // boxed in by something the field doesn't know about
+					break;
+				}
+				fieldPath.push_back(next);
+				cx = next / map.height;
+				cy = next % map.height;
+			}
+			if ( reached )
+			{
+				list_t* path = pathListFromTiles(fieldPath, x1, y1, x2, y2);
+				const Uint64 us = recordPathStats(pathtime, fieldPath.size());
+				if ( *cvar_pathing_debug ) {
+					messagePlayer(0, MESSAGE_DEBUG, "PASS (%d): flow field tiles: %d (%llu us)",
+						(int)pathingType, (int)fieldPath.size(), (unsigned long long)us);
+				}
+				monsterAllyFormations.updateOnPathSucceed(my->getUID(), my);
+				return path;
+			}
+		}
+	}
+
+	// here begins actual A* code:
+	const int startIndex = y1 + x1 * map.height;
+	const int goalIndex = y2 + x2 * map.height;
+	context.push(startIndex, 0, heuristic(x1, y1, x2, y2), -1);
+	int tries = 0;
+	while (!context.empty()) {
         if ((tries >= maxtries && !playerCheckPathToExit && !loading) ||
 			(tries >= 10000 && (playerCheckPathToExit || loading))) {
             // early abort, this path is taking too long!
             break;
         }
+
+		const int current = context.pop();
+		const int cx = current / map.height;
+		const int cy = current % map.height;
         
-        const auto key = queue.top(); queue.pop();
-		const auto find = openSet.find({key.x, key.y});
-        assert(find != openSet.end());
-        const auto pathnode = find->second;
-        openSet.erase({key.x, key.y});
-        closedSet.insert({{key.x, key.y}, pathnode});
-        
-		if (pathnode.x == x2 && pathnode.y == y2) {
+		if (current == goalIndex) {
 			// found target, retrace path
 			auto path = (list_t*) malloc(sizeof(list_t));
 			path->first = nullptr;
 			path->last = nullptr;
-            auto find = closedSet.find(pairtype{pathnode.x, pathnode.y});
-			while (find != closedSet.end()) {
-                if (find->second.px == -1 || find->second.py == -1) {
-                    // don't bother including the very first node on the path.
-                    // the reason is, the starting tile isn't necessary to
-                    // begin the path; and if an entity happens to be on
-                    // the edge of its starting tile, it will actually
-                    // double-back before going to the next one!
-                    break;
-                }
+			for (int index = current; context.getParent(index) != -1; index = context.getParent(index)) {
+                // don't bother including the very first node on the path.
+                // the reason is, the starting tile isn't necessary to
+                // begin the path; and if an entity happens to be on
+                // the edge of its starting tile, it will actually
+                // double-back before going to the next one!
+                const int parentIndex = context.getParent(index);
                 auto pathnode = (pathnode_t*)malloc(sizeof(pathnode_t));
-                *pathnode = find->second;
+                pathnode->x = index / map.height;
+                pathnode->y = index % map.height;
+                pathnode->g = context.getG(index);
+                pathnode->h = heuristic(pathnode->x, pathnode->y, x2, y2);
+                pathnode->px = parentIndex / map.height;
+                pathnode->py = parentIndex % map.height;
                 auto node = list_AddNodeFirst(path);
                 node->size = sizeof(pathnode_t);
                 node->deconstructor = defaultDeconstructor;
                 node->element = pathnode;
-                find = closedSet.find(pairtype{pathnode->px, pathnode->py});
 			}
-			free(pathMap);
 
+			const Uint64 us = recordPathStats(pathtime, tries);
 			if ( *cvar_pathing_debug ) {
-				auto now = std::chrono::high_resolution_clock::now();
-				ms = std::chrono::duration_cast<std::chrono::microseconds>(now - pathtime);
-				DebugStats.gui2 = DebugStats.gui2 + ms;
-				messagePlayer(0, MESSAGE_DEBUG, "PASS (%d): path tries: %d", (int)pathingType, tries);
+				messagePlayer(0, MESSAGE_DEBUG, "PASS (%d): path tries: %d (%llu us)",
+					(int)pathingType, tries, (unsigned long long)us);
 			}
-			lastGeneratePathTries = tries;
 			if ( my->behavior == &actMonster ) {
 				monsterAllyFormations.updateOnPathSucceed(my->getUID(), my);
 			}
@@ -751,102 +1190,51 @@ list_t* generatePath(int x1, int y1, int x2, int y2, Entity* my, Entity* target,
 		// expand search
 		for (int y = -1; y <= 1; y++) {
 			for (int x = -1; x <= 1; x++) {
-                const int newx = pathnode.x + x;
-                const int newy = pathnode.y + y;
+                const int newx = cx + x;
+                const int newy = cy + y;
 				if (x == 0 && y == 0) {
 					continue;
 				}
-				int z = 0;
-				if (!loading) {
-					int index;
-					index = newy + newx * map.height;
-					index = std::min(std::max(0, index),
-                        (int)map.width * (int)map.height - 1);
-					if (!pathMap[index]) {
-						z++;
-					}
-					if (x && y) {
-						index = pathnode.y + newx * map.height;
-						index = std::min(std::max(0, index),
-                            (int)map.width * (int)map.height - 1);
-						if (!pathMap[index]) {
-							z++;
-						}
-						index = newy + x * map.height;
-						index = std::min(std::max(0, index),
-                            (int)map.width * (int)map.height - 1);
-						if (!pathMap[index]) {
-							z++;
-						}
-					}
+				if (!passable(newx, newy)) {
+					continue;
 				}
-				else { // if (!loading)
-					if (pathCheckObstacle((newx << 4) + 8, (newy << 4) + 8, my, target)) {
-						z++;
-					}
-					if (x && y) {
-						if (pathCheckObstacle((pathnode.x << 4) + 8, (newy << 4) + 8, my, target)) {
-							z++;
-						}
-						if (pathCheckObstacle((newx << 4) + 8, (pathnode.y << 4) + 8, my, target)) {
-							z++;
-						}
-					}
+				if (x && y && (!passable(cx, newy) || !passable(newx, cy))) {
+					// no cutting corners
+					continue;
 				}
-				if (!z) {
-                    const auto key = pairtype{newx, newy};
-					bool alreadyadded = closedSet.find(key) != closedSet.end();
-                    auto find = openSet.find(key);
-					if (find != openSet.end()) {
-                        alreadyadded = true;
-						auto& childnode = find->second;
-                        if (x && y) {
-                            if (childnode.g > pathnode.g + DIAGONALCOST) {
-                                childnode.px = pathnode.x;
-                                childnode.py = pathnode.y;
-                                childnode.g = pathnode.g + DIAGONALCOST;
-                            }
-                        } else {
-                            if (childnode.g > pathnode.g + STRAIGHTCOST) {
-                                childnode.px = pathnode.x;
-                                childnode.py = pathnode.y;
-                                childnode.g = pathnode.g + STRAIGHTCOST;
-                            }
-                        }
-					}
-					if (alreadyadded == false) {
-						if (enableDebugKeys && *cvar_pathing_debug && keystatus[SDLK_g]) {
-							Entity* particle = spawnMagicParticle(my);
-							particle->sprite = 576;
-							particle->x = (pathnode.x + x) * 16.0 + 8.0;
-							particle->y = (pathnode.y + y) * 16.0 + 8.0;
-							particle->z = 0;
-							particle->scalex = 2.0;
-							particle->scaley = 2.0;
-							particle->scalez = 2.0;
-						}
-                        const auto newNode = pathnode_t{newx, newy,
-                            (x && y) ? (pathnode.g + DIAGONALCOST) : (pathnode.g + STRAIGHTCOST),
-                            heuristic(newx, newy, x2, y2), pathnode.x, pathnode.y};
-                        openSet.insert({pairtype{newx, newy}, newNode});
-                        queue.push({newx, newy, openSet});
+				const int index = newy + newx * map.height;
+				if (context.isClosed(index)) {
+					continue;
+				}
+				const Uint32 g = context.getG(current) + ((x && y) ? DIAGONALCOST : STRAIGHTCOST);
+				if (context.isOpen(index)) {
+					if (context.getG(index) > g) {
+						context.relax(index, g, current);
 					}
+					continue;
 				}
+				if (enableDebugKeys && *cvar_pathing_debug && keystatus[SDLK_g]) {
+					Entity* particle = spawnMagicParticle(my);
+					particle->sprite = 576;
+					particle->x = newx * 16.0 + 8.0;
+					particle->y = newy * 16.0 + 8.0;
+					particle->z = 0;
+					particle->scalex = 2.0;
+					particle->scaley = 2.0;
+					particle->scalez = 2.0;
+				}
+				context.push(index, g, heuristic(newx, newy, x2, y2), current);
 			}
 		}
 		++tries;
 	}
  
     // path failed
-	free(pathMap);
+	const Uint64 us = recordPathStats(pathtime, tries);
 	if ( *cvar_pathing_debug ) {
-		auto now = std::chrono::high_resolution_clock::now();
-		ms = std::chrono::duration_cast<std::chrono::microseconds>(now - pathtime);
-		DebugStats.gui2 = DebugStats.gui2 + ms;
-		messagePlayer(0, MESSAGE_DEBUG, "FAIL (%d) uid: %d : path tries: %d (%d, %d) to (%d, %d)",
-            (int)pathingType, my->getUID(), tries, x1, y1, x2, y2);
+		messagePlayer(0, MESSAGE_DEBUG, "FAIL (%d) uid: %d : path tries: %d (%llu us) (%d, %d) to (%d, %d)",
+            (int)pathingType, my->getUID(), tries, (unsigned long long)us, x1, y1, x2, y2);
 	}
-	lastGeneratePathTries = tries;
 	if (my->behavior == &actMonster) {
 		if (pathingType == GENERATE_PATH_ALLY_FOLLOW ||
             pathingType == GENERATE_PATH_ALLY_FOLLOW2) {
@@ -869,6 +1257,7 @@ void fillPathMap(int* pathMap, int x, int y, int zone);
 void generatePathMaps()
 {
 	int x, y;
+	auto buildtime = std::chrono::high_resolution_clock::now();
 
 	if ( pathMapGrounded )
 	{
@@ -882,6 +1271,8 @@ void generatePathMaps()
 	pathMapFlying = (int*)calloc(map.width * map.height, sizeof(int));
 
 	pathMapZone = 1;
+	pathMapZoneSize.clear();
+	++pathMapGeneration;
 	for ( y = 0; y < map.height; y++ )
 	{
 		for ( x = 0; x < map.width; x++ )
@@ -903,263 +1294,448 @@ void generatePathMaps()
 		graph.reset();
 		graph.buildGraph(i);
 		graph.debugPaths();
+		sectorGraph[i].build(i);
 	}
+
+	auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - buildtime);
+	++pathMapStatsFullRebuilds;
+	pathMapStatsFullMicroseconds += us.count();
 }
 
-void fillPathMap(int* pathMap, int x, int y, int zone)
+// whether a tile can be part of a zone in the given path map
+static bool pathMapTilePassable(const int* pathMap, int x, int y)
 {
-	bool obstacle = true;
-
-	int index = y * MAPLAYERS + x * MAPLAYERS * map.height;
-	if ( !map.tiles[OBSTACLELAYER + index] && map.tiles[index] 
-		&& !(swimmingtiles[map.tiles[index]] || lavatiles[map.tiles[index]]) )
+	const int index = y * MAPLAYERS + x * MAPLAYERS * map.height;
+	if ( map.tiles[OBSTACLELAYER + index] )
 	{
-		obstacle = false;
+		return false;
 	}
-	else if ( pathMap == pathMapFlying && !map.tiles[OBSTACLELAYER + index] )
+	if ( pathMap != pathMapFlying
+		&& (!map.tiles[index] || swimmingtiles[map.tiles[index]] || lavatiles[map.tiles[index]]) )
 	{
-		obstacle = false;
+		return false;
 	}
-	if ( obstacle == false )
+	if ( list_t* list = checkTileForEntity(x, y) )
 	{
-		node_t* node;
-		list_t* list = checkTileForEntity(x, y);
-		if ( list )
+		for ( node_t* node = list->first; node != nullptr; node = node->next )
 		{
-			for ( node = list->first; node != NULL; node = node->next )
+			Entity* entity = (Entity*)node->element;
+			if ( entity && isPathObstacle(entity) )
 			{
-				Entity* entity = (Entity*)node->element;
-				if ( entity )
-				{
-					if ( isPathObstacle(entity) )
-					{
-						obstacle = true;
-						break;
-					}
-					/*else if ( entity->behavior == &actWallBuilder || entity->behavior == &actWallBuster )
-					{
-						obstacle = false;
-						break;
-					}*/
-				}
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+// floods outwards from x, y across tiles holding fromZone and writes toZone
+// into them. a fromZone of 0 fills unassigned tiles that are passable.
+// returns the number of tiles written, optionally appending their indices.
+static int floodPathMapZone(int* pathMap, int x, int y, int fromZone, int toZone, std::vector<int>* outTiles = nullptr)
+{
+	static std::vector<int> stack;
+	stack.clear();
+
+	const int height = map.height;
+	pathMap[y + x * height] = toZone;
+	stack.push_back(y + x * height);
+	int count = 0;
+	while ( !stack.empty() )
+	{
+		const int tile = stack.back();
+		stack.pop_back();
+		++count;
+		if ( outTiles )
+		{
+			outTiles->push_back(tile);
+		}
+		const int u = tile / height;
+		const int v = tile % height;
+		const int neighbours[4][2] = { { u + 1, v }, { u - 1, v }, { u, v + 1 }, { u, v - 1 } };
+		for ( auto& n : neighbours )
+		{
+			if ( n[0] < 0 || n[1] < 0 || n[0] >= (int)map.width || n[1] >= height )
+			{
+				continue;
+			}
+			const int next = n[1] + n[0] * height;
+			if ( pathMap[next] != fromZone )
+			{
+				continue;
+			}
+			if ( fromZone == 0 && !pathMapTilePassable(pathMap, n[0], n[1]) )
+			{
+				continue;
 			}
-			//list_FreeAll(list);
-			//free(list);
+			pathMap[next] = toZone;
+			stack.push_back(next);
 		}
 	}
+	return count;
+}
 
-	if ( obstacle )
+void fillPathMap(int* pathMap, int x, int y, int zone)
+{
+	if ( !pathMapTilePassable(pathMap, x, y) )
 	{
 		return;
 	}
 
-	pathMap[y + x * map.height] = zone;
-	bool repeat;
-	do
+	pathMapZoneSizeOf(zone) = floodPathMapZone(pathMap, x, y, 0, zone);
+	pathMapZone++;
+}
+
+/*-------------------------------------------------------------------------------
+
+	updatePathMaps
+
+	Updates the path maps after a single tile changes passability (a wall dug
+	out or built up) without re-flooding the whole map. A tile opening up
+	joins the largest neighbouring zone and relabels any others into it. A
+	tile closing off only needs a re-flood when its neighbours aren't joined
+	around it, and then floods from each side in turn until the sides meet
+	or all but one have run out of tiles.
+
+-------------------------------------------------------------------------------*/
+
+enum PathMapChange
+{
+	PATHMAP_UNCHANGED,
+	PATHMAP_TILE_CHANGED,	// the tile joined or left a zone, zones otherwise intact
+	PATHMAP_ZONES_CHANGED	// zones were created, merged or split
+};
+
+// the 8 tiles around a tile, in order. odd entries are the direct neighbours
+static const int pathMapRing[8][2] = {
+	{ -1, -1 }, { 0, -1 }, { 1, -1 }, { 1, 0 }, { 1, 1 }, { 0, 1 }, { -1, 1 }, { -1, 0 }
+};
+
+// floods out of oldZone from each seed in turn, one tile each, joining
+// searches that touch. returns true if the zone came apart, in which case
+// every piece but one gets a new zone
+static bool splitPathMapZone(int* pathMap, const int oldZone, const int seeds[][2], const int numSeeds)
+{
+	struct Search_t
+	{
+		std::vector<int> tiles;
+		size_t head = 0;
+		int group = 0;
+	};
+	static Search_t searches[4];
+	static std::vector<Uint32> visitStamp;
+	static std::vector<Uint8> visitOwner;
+	static Uint32 visitGeneration = 0;
+
+	const int height = map.height;
+	const size_t numTiles = map.width * map.height;
+	if ( visitStamp.size() != numTiles || visitGeneration == 0xFFFFFFFF )
 	{
-		repeat = false;
+		visitStamp.assign(numTiles, 0);
+		visitOwner.assign(numTiles, 0);
+		visitGeneration = 0;
+	}
+	++visitGeneration;
 
-		int u, v;
-		for ( u = 0; u < map.width; u++ )
+	auto find = [&](int s) -> int
+	{
+		while ( searches[s].group != s )
+		{
+			s = searches[s].group;
+		}
+		return s;
+	};
+	auto growing = [&](int group) -> bool
+	{
+		for ( int s = 0; s < numSeeds; ++s )
 		{
-			for ( v = 0; v < map.height; v++ )
+			if ( find(s) == group && searches[s].head < searches[s].tiles.size() )
 			{
-				if ( pathMap[v + u * map.height] == zone )
-				{
-					if ( u < map.width - 1 )
-					{
-						if ( !pathMap[v + (u + 1)*map.height] )
-						{
-							bool foundObstacle = false;
-							bool foundWallModifier = false;
-							list_t* list = checkTileForEntity(u + 1, v);
-							if ( list )
-							{
-								node_t* node;
-								for ( node = list->first; node != NULL; node = node->next )
-								{
-									Entity* entity = (Entity*)node->element;
-									if ( entity )
-									{
-										if ( isPathObstacle(entity) )
-										{
-											foundObstacle = true;
-											break;
-										}
-										/*else if ( entity->behavior == &actWallBuilder || entity->behavior == &actWallBuster )
-										{
-											foundWallModifier = true;
-											break;
-										}*/
-									}
-								}
-								if ( foundWallModifier )
-								{
-									pathMap[v + (u + 1)*map.height] = zone;
-									repeat = true;
-								}
-								//list_FreeAll(list);
-								//free(list);
-							}
-							if ( !foundWallModifier && !foundObstacle )
-							{
-								int index = v * MAPLAYERS + (u + 1) * MAPLAYERS * map.height;
-								if ( !map.tiles[OBSTACLELAYER + index] && (pathMap == pathMapFlying 
-									|| (map.tiles[index] && !(swimmingtiles[map.tiles[index]] || lavatiles[map.tiles[index]]) )) )
-								{
-									pathMap[v + (u + 1)*map.height] = zone;
-									repeat = true;
-								}
-							}
-						}
-					}
-					if ( u > 0 )
-					{
-						if ( !pathMap[v + (u - 1)*map.height] )
-						{
-							bool foundObstacle = false;
-							bool foundWallModifier = false;
-							list_t* list = checkTileForEntity(u - 1, v);
-							if ( list )
-							{
-								node_t* node;
-								for ( node = list->first; node != NULL; node = node->next )
-								{
-									Entity* entity = (Entity*)node->element;
-									if ( entity )
-									{
-										if ( isPathObstacle(entity) )
-										{
-											foundObstacle = true;
-											break;
-										}
-										/*else if ( entity->behavior == &actWallBuilder || entity->behavior == &actWallBuster )
-										{
-											foundWallModifier = true;
-											break;
-										}*/
-									}
-								}
-								if ( foundWallModifier )
-								{
-									pathMap[v + (u - 1)*map.height] = zone;
-									repeat = true;
-								}
-								//list_FreeAll(list);
-								//free(list);
-							}
-							if ( !foundWallModifier && !foundObstacle )
-							{
-								int index = v * MAPLAYERS + (u - 1) * MAPLAYERS * map.height;
-								if ( !map.tiles[OBSTACLELAYER + index] && (pathMap == pathMapFlying 
-									|| (map.tiles[index] && !(swimmingtiles[map.tiles[index]] || lavatiles[map.tiles[index]])) ) )
-								{
-									pathMap[v + (u - 1)*map.height] = zone;
-									repeat = true;
-								}
-							}
-						}
-					}
-					if ( v < map.height - 1 )
-					{
-						if ( !pathMap[(v + 1) + u * map.height] )
-						{
-							bool foundObstacle = false;
-							bool foundWallModifier = false;
-							list_t* list = checkTileForEntity(u, v + 1);
-							if ( list )
-							{
-								node_t* node;
-								for ( node = list->first; node != NULL; node = node->next )
-								{
-									Entity* entity = (Entity*)node->element;
-									if ( entity )
-									{
-										if ( isPathObstacle(entity) )
-										{
-											foundObstacle = true;
-											break;
-										}
-										/*else if ( entity->behavior == &actWallBuilder || entity->behavior == &actWallBuster )
-										{
-											foundWallModifier = true;
-											break;
-										}*/
-									}
-								}
-								if ( foundWallModifier )
-								{
-									pathMap[(v + 1) + u * map.height] = zone;
-									repeat = true;
-								}
-								//list_FreeAll(list);
-								//free(list);
-							}
-							if ( !foundWallModifier && !foundObstacle )
-							{
-								int index = (v + 1) * MAPLAYERS + u * MAPLAYERS * map.height;
-								if ( !map.tiles[OBSTACLELAYER + index] && (pathMap == pathMapFlying 
-									|| (map.tiles[index] && !(swimmingtiles[map.tiles[index]] || lavatiles[map.tiles[index]])) ) )
-								{
-									pathMap[(v + 1) + u * map.height] = zone;
-									repeat = true;
-								}
-							}
-						}
-					}
-					if ( v > 0 )
+				return true;
+			}
+		}
+		return false;
+	};
+
+	for ( int s = 0; s < numSeeds; ++s )
+	{
+		const int tile = seeds[s][1] + seeds[s][0] * height;
+		searches[s].tiles.clear();
+		searches[s].tiles.push_back(tile);
+		searches[s].head = 0;
+		searches[s].group = s;
+		visitStamp[tile] = visitGeneration;
+		visitOwner[tile] = s;
+	}
+
+	while ( true )
+	{
+		int numGroups = 0;
+		int numGrowing = 0;
+		for ( int s = 0; s < numSeeds; ++s )
+		{
+			if ( find(s) == s )
+			{
+				++numGroups;
+				if ( growing(s) )
+				{
+					++numGrowing;
+				}
+			}
+		}
+		if ( numGroups == 1 )
+		{
+			return false; // every side met up again
+		}
+		if ( numGrowing <= 1 )
+		{
+			break; // every side but one has been flooded completely
+		}
+
+		for ( int s = 0; s < numSeeds; ++s )
+		{
+			auto& search = searches[s];
+			if ( search.head >= search.tiles.size() )
+			{
+				continue;
+			}
+			const int tile = search.tiles[search.head++];
+			const int u = tile / height;
+			const int v = tile % height;
+			const int neighbours[4][2] = { { u + 1, v }, { u - 1, v }, { u, v + 1 }, { u, v - 1 } };
+			for ( auto& n : neighbours )
+			{
+				if ( n[0] < 0 || n[1] < 0 || n[0] >= (int)map.width || n[1] >= height )
+				{
+					continue;
+				}
+				const int next = n[1] + n[0] * height;
+				if ( pathMap[next] != oldZone )
+				{
+					continue;
+				}
+				if ( visitStamp[next] == visitGeneration )
+				{
+					const int a = find(s);
+					const int b = find(visitOwner[next]);
+					if ( a != b )
 					{
-						if ( !pathMap[(v - 1) + u * map.height] )
-						{
-							bool foundObstacle = false;
-							bool foundWallModifier = false;
-							list_t* list = checkTileForEntity(u, v - 1);
-							if ( list )
-							{
-								node_t* node;
-								for ( node = list->first; node != NULL; node = node->next )
-								{
-									Entity* entity = (Entity*)node->element;
-									if ( entity )
-									{
-										if ( isPathObstacle(entity) )
-										{
-											foundObstacle = true;
-											break;
-										}
-										/*else if ( entity->behavior == &actWallBuilder || entity->behavior == &actWallBuster )
-										{
-											foundWallModifier = true;
-											break;
-										}*/
-									}
-								}
-								if ( foundWallModifier )
-								{
-									pathMap[(v - 1) + u * map.height] = zone;
-									repeat = true;
-								}
-								//list_FreeAll(list);
-								//free(list);
-							}
-							if ( !foundWallModifier && !foundObstacle )
-							{
-								int index = (v - 1) * MAPLAYERS + u * MAPLAYERS * map.height;
-								if ( !map.tiles[OBSTACLELAYER + index] && (pathMap == pathMapFlying 
-									|| (map.tiles[index] && !(swimmingtiles[map.tiles[index]] || lavatiles[map.tiles[index]]) )) )
-								{
-									pathMap[(v - 1) + u * map.height] = zone;
-									repeat = true;
-								}
-							}
-						}
+						searches[b].group = a;
 					}
+					continue;
 				}
+				visitStamp[next] = visitGeneration;
+				visitOwner[next] = s;
+				search.tiles.push_back(next);
 			}
 		}
 	}
-	while ( repeat );
-	pathMapZone++;
+
+	// the side still growing keeps the old zone, or the largest if all finished
+	int keep = -1;
+	size_t keepSize = 0;
+	for ( int s = 0; s < numSeeds; ++s )
+	{
+		if ( find(s) != s )
+		{
+			continue;
+		}
+		size_t size = 0;
+		for ( int t = 0; t < numSeeds; ++t )
+		{
+			if ( find(t) == s )
+			{
+				size += searches[t].tiles.size();
+			}
+		}
+		if ( growing(s) )
+		{
+			keep = s;
+			break;
+		}
+		if ( keep < 0 || size > keepSize )
+		{
+			keep = s;
+			keepSize = size;
+		}
+	}
+	for ( int s = 0; s < numSeeds; ++s )
+	{
+		if ( find(s) != s || s == keep )
+		{
+			continue;
+		}
+		const int zone = pathMapZone++;
+		int size = 0;
+		for ( int t = 0; t < numSeeds; ++t )
+		{
+			if ( find(t) != s )
+			{
+				continue;
+			}
+			for ( int tile : searches[t].tiles )
+			{
+				pathMap[tile] = zone;
+			}
+			size += searches[t].tiles.size();
+		}
+		pathMapZoneSizeOf(zone) = size;
+		pathMapZoneSizeOf(oldZone) -= size;
+	}
+	return true;
+}
+
+static PathMapChange updatePathMapTile(int* pathMap, int x, int y)
+{
+	const int height = map.height;
+	const int tile = y + x * height;
+	const int oldZone = pathMap[tile];
+	const bool passable = pathMapTilePassable(pathMap, x, y);
+	if ( (oldZone != 0) == passable )
+	{
+		return PATHMAP_UNCHANGED;
+	}
+
+	int ringZone[8];
+	for ( int i = 0; i < 8; ++i )
+	{
+		const int u = x + pathMapRing[i][0];
+		const int v = y + pathMapRing[i][1];
+		ringZone[i] = (u < 0 || v < 0 || u >= (int)map.width || v >= height) ? 0 : pathMap[v + u * height];
+	}
+
+	if ( passable )
+	{
+		int zone = 0;
+		for ( int i = 1; i < 8; i += 2 )
+		{
+			if ( ringZone[i] && (!zone || pathMapZoneSizeOf(ringZone[i]) > pathMapZoneSizeOf(zone)) )
+			{
+				zone = ringZone[i];
+			}
+		}
+		if ( !zone )
+		{
+			pathMap[tile] = pathMapZone;
+			pathMapZoneSizeOf(pathMapZone) = 1;
+			++pathMapZone;
+			return PATHMAP_ZONES_CHANGED;
+		}
+
+		pathMap[tile] = zone;
+		++pathMapZoneSizeOf(zone);
+		PathMapChange result = PATHMAP_TILE_CHANGED;
+		for ( int i = 1; i < 8; i += 2 )
+		{
+			const int u = x + pathMapRing[i][0];
+			const int v = y + pathMapRing[i][1];
+			if ( !ringZone[i] || pathMap[v + u * height] == zone )
+			{
+				continue;
+			}
+			// union by size: the smaller zone is relabelled into the larger
+			const int other = pathMap[v + u * height];
+			pathMapZoneSizeOf(zone) += floodPathMapZone(pathMap, u, v, other, zone);
+			pathMapZoneSizeOf(other) = 0;
+			result = PATHMAP_ZONES_CHANGED;
+		}
+		return result;
+	}
+
+	pathMap[tile] = 0;
+	--pathMapZoneSizeOf(oldZone);
+
+	// neighbours joined through the ring around the tile stay connected to
+	// each other, so only one seed per run of the ring needs flooding
+	int start = -1;
+	for ( int i = 0; i < 8; ++i )
+	{
+		if ( ringZone[i] != oldZone )
+		{
+			start = i;
+			break;
+		}
+	}
+	if ( start < 0 )
+	{
+		return PATHMAP_TILE_CHANGED;
+	}
+	int seeds[4][2];
+	int numSeeds = 0;
+	bool seededRun = false;
+	for ( int k = 1; k <= 8; ++k )
+	{
+		const int i = (start + k) % 8;
+		if ( ringZone[i] != oldZone )
+		{
+			seededRun = false;
+			continue;
+		}
+		if ( (i & 1) && !seededRun )
+		{
+			seeds[numSeeds][0] = x + pathMapRing[i][0];
+			seeds[numSeeds][1] = y + pathMapRing[i][1];
+			++numSeeds;
+			seededRun = true;
+		}
+	}
+	if ( numSeeds == 0 )
+	{
+		return PATHMAP_ZONES_CHANGED; // the tile was a zone of its own
+	}
+	if ( numSeeds == 1 )
+	{
+		return PATHMAP_TILE_CHANGED;
+	}
+	return splitPathMapZone(pathMap, oldZone, seeds, numSeeds) ? PATHMAP_ZONES_CHANGED : PATHMAP_TILE_CHANGED;
+}
+
+void updatePathMaps(int x, int y)
+{
+	if ( !pathMapGrounded || !pathMapFlying
+		|| x < 0 || y < 0 || x >= (int)map.width || y >= (int)map.height )
+	{
+		generatePathMaps();
+		return;
+	}
+
+	auto updatetime = std::chrono::high_resolution_clock::now();
+	bool changed = false;
+	for ( int i = 0; i < GateGraph::GATE_GRAPH_NUM_PATHMAPS; ++i )
+	{
+		int* pathMap = (i == GateGraph::GATE_GRAPH_FLYING) ? pathMapFlying : pathMapGrounded;
+		const PathMapChange change = updatePathMapTile(pathMap, x, y);
+		if ( change == PATHMAP_UNCHANGED )
+		{
+			continue;
+		}
+		changed = true;
+
+		auto& graph = gateGraph[i];
+		if ( change == PATHMAP_ZONES_CHANGED || !graph.updateTile(x, y) )
+		{
+			graph.reset();
+			graph.buildGraph(i);
+			graph.debugPaths();
+		}
+		if ( !sectorGraph[i].updateTile(x, y) )
+		{
+			sectorGraph[i].build(i);
+		}
+	}
+	if ( !changed )
+	{
+		return;
+	}
+
+	++pathMapGeneration;
+	auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - updatetime);
+	++pathMapStatsIncrementalUpdates;
+	pathMapStatsIncrementalMicroseconds += us.count();
+	if ( *cvar_pathing_debug )
+	{
+		messagePlayer(0, MESSAGE_DEBUG, "[Path Maps]: Updated tile (%d, %d) in %llu us", x, y, (unsigned long long)us.count());
+	}
 }
 
 
@@ -1332,170 +1908,153 @@ void GateGraph::fillPathMap(int x, int y)
 		parentMap = pathMapFlying;
 	}
 
-	node_t* node;
-	list_t* list = checkTileForEntity(x, y);
-	if ( list )
+	auto isGateTile = [](int u, int v) -> bool
 	{
-		for ( node = list->first; node != NULL; node = node->next )
+		if ( list_t* list = checkTileForEntity(u, v) )
 		{
-			Entity* entity = (Entity*)node->element;
-			if ( entity )
+			for ( node_t* node = list->first; node != nullptr; node = node->next )
 			{
-				if ( entity->behavior == &actGate )
+				Entity* entity = (Entity*)node->element;
+				if ( entity && entity->behavior == &actGate )
 				{
-					return;
+					return true;
 				}
 			}
 		}
+		return false;
+	};
+
+	if ( isGateTile(x, y) )
+	{
+		return;
+	}
+
+	static std::vector<int> stack;
+	stack.clear();
+
+	const int height = map.height;
+	mapSubzones[y + x * height] = numSubzones;
+	stack.push_back(y + x * height);
+	while ( !stack.empty() )
+	{
+		const int tile = stack.back();
+		stack.pop_back();
+		const int u = tile / height;
+		const int v = tile % height;
+		const int neighbours[4][2] = { { u + 1, v }, { u - 1, v }, { u, v + 1 }, { u, v - 1 } };
+		for ( auto& n : neighbours )
+		{
+			if ( n[0] < 0 || n[1] < 0 || n[0] >= (int)map.width || n[1] >= height )
+			{
+				continue;
+			}
+			const int next = n[1] + n[0] * height;
+			if ( mapSubzones[next] || !parentMap[next] || isGateTile(n[0], n[1]) )
+			{
+				continue;
+			}
+			mapSubzones[next] = numSubzones;
+			stack.push_back(next);
+		}
 	}
+	++numSubzones;
+}
 
-	mapSubzones[y + x * map.height] = numSubzones;
+// patches mapSubzones after a single tile of the parent map changed.
+// returns false if the change may have joined or split subzones, in which
+// case the graph needs rebuilding
+bool GateGraph::updateTile(int x, int y)
+{
+	if ( !bIsInit || !mapSubzones )
+	{
+		return false;
+	}
+	const int* parentMap = (parentMapType == GateGraph::GATE_GRAPH_FLYING) ? pathMapFlying : pathMapGrounded;
+	const int height = map.height;
+	const int tile = y + x * height;
+	if ( mapSubzones[tile] >= numSubzones )
+	{
+		return false; // gate tile
+	}
 
-	bool repeat;
-	do
+	int ring[8];
+	for ( int i = 0; i < 8; ++i )
 	{
-		repeat = false;
+		const int u = x + pathMapRing[i][0];
+		const int v = y + pathMapRing[i][1];
+		ring[i] = (u < 0 || v < 0 || u >= (int)map.width || v >= height) ? 0 : mapSubzones[v + u * height];
+		if ( ring[i] >= numSubzones )
+		{
+			return false; // next to a gate
+		}
+	}
 
-		int u, v;
-		for ( u = 0; u < map.width; u++ )
+	if ( parentMap[tile] )
+	{
+		int subzone = 0;
+		for ( int i = 1; i < 8; i += 2 )
 		{
-			for ( v = 0; v < map.height; v++ )
+			if ( !ring[i] )
 			{
-				if ( mapSubzones[v + u * map.height] == numSubzones )
-				{
-					if ( u < map.width - 1 )
-					{
-						if ( !mapSubzones[v + (u + 1)*map.height] )
-						{
-							bool foundObstacle = false;
-							list_t* list = checkTileForEntity(u + 1, v);
-							if ( list )
-							{
-								node_t* node;
-								for ( node = list->first; node != NULL; node = node->next )
-								{
-									Entity* entity = (Entity*)node->element;
-									if ( entity )
-									{
-										if ( entity->behavior == &actGate )
-										{
-											foundObstacle = true;
-											break;
-										}
-									}
-								}
-							}
-							if ( !foundObstacle )
-							{
-								if ( parentMap[v + (u + 1)*map.height] )
-								{
-									mapSubzones[v + (u + 1)*map.height] = numSubzones;
-									repeat = true;
-								}
-							}
-						}
-					}
-					if ( u > 0 )
-					{
-						if ( !mapSubzones[v + (u - 1)*map.height] )
-						{
-							bool foundObstacle = false;
-							list_t* list = checkTileForEntity(u - 1, v);
-							if ( list )
-							{
-								node_t* node;
-								for ( node = list->first; node != NULL; node = node->next )
-								{
-									Entity* entity = (Entity*)node->element;
-									if ( entity )
-									{
-										if ( entity->behavior == &actGate )
-										{
-											foundObstacle = true;
-											break;
-										}
-									}
-								}
-							}
-							if ( !foundObstacle )
-							{
-								if ( parentMap[v + (u - 1)*map.height] )
-								{
-									mapSubzones[v + (u - 1)*map.height] = numSubzones;
-									repeat = true;
-								}
-							}
-						}
-					}
-					if ( v < map.height - 1 )
-					{
-						if ( !mapSubzones[(v + 1) + u * map.height] )
-						{
-							bool foundObstacle = false;
-							list_t* list = checkTileForEntity(u, v + 1);
-							if ( list )
-							{
-								node_t* node;
-								for ( node = list->first; node != NULL; node = node->next )
-								{
-									Entity* entity = (Entity*)node->element;
-									if ( entity )
-									{
-										if ( entity->behavior == &actGate )
-										{
-											foundObstacle = true;
-											break;
-										}
-									}
-								}
-							}
-							if ( !foundObstacle )
-							{
-								if ( parentMap[(v + 1) + u*map.height] )
-								{
-									mapSubzones[(v + 1) + u * map.height] = numSubzones;
-									repeat = true;
-								}
-							}
-						}
-					}
-					if ( v > 0 )
-					{
-						if ( !mapSubzones[(v - 1) + u * map.height] )
-						{
-							bool foundObstacle = false;
-							list_t* list = checkTileForEntity(u, v - 1);
-							if ( list )
-							{
-								node_t* node;
-								for ( node = list->first; node != NULL; node = node->next )
-								{
-									Entity* entity = (Entity*)node->element;
-									if ( entity )
-									{
-										if ( entity->behavior == &actGate )
-										{
-											foundObstacle = true;
-											break;
-										}
-									}
-								}
-							}
-							if ( !foundObstacle )
-							{
-								if ( parentMap[(v - 1) + u*map.height] )
-								{
-									mapSubzones[(v - 1) + u * map.height] = numSubzones;
-									repeat = true;
-								}
-							}
-						}
-					}
-				}
+				continue;
+			}
+			if ( subzone && ring[i] != subzone )
+			{
+				return false;
 			}
+			subzone = ring[i];
 		}
-	} while ( repeat );
-	++numSubzones;
+		if ( !subzone )
+		{
+			return false;
+		}
+		mapSubzones[tile] = subzone;
+		return true;
+	}
+
+	const int subzone = mapSubzones[tile];
+	mapSubzones[tile] = 0;
+	if ( !subzone )
+	{
+		return true;
+	}
+	// the direct neighbours must all still be joined through the ring
+	int start = -1;
+	for ( int i = 0; i < 8; ++i )
+	{
+		if ( ring[i] != subzone )
+		{
+			start = i;
+			break;
+		}
+	}
+	if ( start < 0 )
+	{
+		return true;
+	}
+	int runs = 0;
+	bool inRun = false;
+	bool runCounted = false;
+	for ( int k = 1; k <= 8; ++k )
+	{
+		const int i = (start + k) % 8;
+		if ( ring[i] != subzone )
+		{
+			inRun = false;
+			continue;
+		}
+		if ( !inRun )
+		{
+			inRun = true;
+			runCounted = false;
+		}
+		if ( (i & 1) && !runCounted )
+		{
+			++runs;
+			runCounted = true;
+		}
+	}
+	return runs == 1;
 }
 
 void GateGraph::debugPaths()
@@ -1735,3 +2294,694 @@ bool GateGraph::generatePath(Entity* my, int x1, int y1, int x2, int y2)
 	}
 	return false;
 }
+
+int SectorGraph::addNode(int x, int y, bool isGate)
+{
+	const int tile = y + x * map.height;
+	auto find = nodeAtTile.find(tile);
+	if ( find != nodeAtTile.end() )
+	{
+		return find->second;
+	}
+	Node_t node;
+	node.x = x;
+	node.y = y;
+	node.sector = getSector(x, y);
+	node.isGate = isGate;
+	nodes.push_back(node);
+	const int id = nodes.size() - 1;
+	nodeAtTile[tile] = id;
+	if ( !isGate )
+	{
+		sectorNodes[node.sector].push_back(id);
+	}
+	return id;
+}
+
+void SectorGraph::addEdge(int from, int to, Uint32 cost, Uint32 gateUid, std::vector<int>&& route)
+{
+	for ( auto& edge : nodes[from].edges )
+	{
+		if ( edge.to == to )
+		{
+			return;
+		}
+	}
+	Edge_t edge;
+	edge.to = to;
+	edge.cost = cost;
+	edge.gateUid = gateUid;
+	if ( !freeRoutes.empty() )
+	{
+		edge.route = freeRoutes.back();
+		freeRoutes.pop_back();
+		routes[edge.route] = std::move(route);
+	}
+	else
+	{
+		edge.route = routes.size();
+		routes.push_back(std::move(route));
+	}
+	nodes[from].edges.push_back(edge);
+}
+
+// appends the tiles leading from the search origin (exclusive) to x, y (inclusive)
+static void traceSectorRoute(const SectorGraph::SectorSearch_t& search, int x, int y, std::vector<int>& out)
+{
+	const size_t start = out.size();
+	for ( int l = search.local(x, y); search.parent[l] != -1; l = search.parent[l] )
+	{
+		const int u = search.originX + l % SectorGraph::SECTOR_SIZE;
+		const int v = search.originY + l / SectorGraph::SECTOR_SIZE;
+		out.push_back(v + u * map.height);
+	}
+	std::reverse(out.begin() + start, out.end());
+}
+
+void SectorGraph::searchSector(SectorSearch_t& search, int x, int y, const std::function<bool(int, int)>& blocked) const
+{
+	const int* parentMap = (parentMapType == GateGraph::GATE_GRAPH_FLYING) ? pathMapFlying : pathMapGrounded;
+	search.originX = (x / SECTOR_SIZE) * SECTOR_SIZE;
+	search.originY = (y / SECTOR_SIZE) * SECTOR_SIZE;
+	search.width = std::min(SECTOR_SIZE, (int)map.width - search.originX);
+	search.height = std::min(SECTOR_SIZE, (int)map.height - search.originY);
+	for ( int i = 0; i < SECTOR_TILES; ++i )
+	{
+		search.cost[i] = 0xFFFFFFFF;
+		search.parent[i] = -1;
+		search.reached[i] = false;
+	}
+
+	auto passable = [&](int u, int v) -> bool
+	{
+		if ( !search.contains(u, v) )
+		{
+			return false;
+		}
+		const int tile = v + u * map.height;
+		if ( !parentMap[tile] || gateTiles[tile] )
+		{
+			return false;
+		}
+		return !(blocked && blocked(u, v));
+	};
+
+	static thread_local std::vector<std::pair<Uint32, int>> heap;
+	heap.clear();
+	const int start = search.local(x, y);
+	search.cost[start] = 0;
+	heap.push_back({ 0, start });
+	while ( !heap.empty() )
+	{
+		std::pop_heap(heap.begin(), heap.end(), std::greater<std::pair<Uint32, int>>());
+		const int current = heap.back().second;
+		heap.pop_back();
+		if ( search.reached[current] )
+		{
+			continue;
+		}
+		search.reached[current] = true;
+		const int cx = search.originX + current % SECTOR_SIZE;
+		const int cy = search.originY + current / SECTOR_SIZE;
+		for ( int dy = -1; dy <= 1; ++dy )
+		{
+			for ( int dx = -1; dx <= 1; ++dx )
+			{
+				if ( dx == 0 && dy == 0 )
+				{
+					continue;
+				}
+				const int nx = cx + dx;
+				const int ny = cy + dy;
+				if ( !passable(nx, ny) )
+				{
+					continue;
+				}
+				if ( dx && dy && (!passable(cx, ny) || !passable(nx, cy)) )
+				{
+					continue;
+				}
+				const int l = search.local(nx, ny);
+				if ( search.reached[l] )
+				{
+					continue;
+				}
+				const Uint32 cost = search.cost[current] + ((dx && dy) ? DIAGONALCOST : STRAIGHTCOST);
+				if ( cost < search.cost[l] )
+				{
+					search.cost[l] = cost;
+					search.parent[l] = current;
+					heap.push_back({ cost, l });
+					std::push_heap(heap.begin(), heap.end(), std::greater<std::pair<Uint32, int>>());
+				}
+			}
+		}
+	}
+}
+
+void SectorGraph::buildSectorEdges(int sector)
+{
+	static thread_local SectorSearch_t search;
+	for ( int from : sectorNodes[sector] )
+	{
+		searchSector(search, nodes[from].x, nodes[from].y, nullptr);
+		for ( int to : sectorNodes[sector] )
+		{
+			if ( to == from )
+			{
+				continue;
+			}
+			const int l = search.local(nodes[to].x, nodes[to].y);
+			if ( !search.reached[l] )
+			{
+				continue;
+			}
+			std::vector<int> route;
+			traceSectorRoute(search, nodes[to].x, nodes[to].y, route);
+			addEdge(from, to, search.cost[l], 0, std::move(route));
+		}
+	}
+}
+
+void SectorGraph::build(const int parentMapType)
+{
+	reset();
+	this->parentMapType = parentMapType;
+	const int* parentMap = nullptr;
+	if ( parentMapType == GateGraph::GATE_GRAPH_GROUNDED )
+	{
+		parentMap = pathMapGrounded;
+	}
+	else if ( parentMapType == GateGraph::GATE_GRAPH_FLYING )
+	{
+		parentMap = pathMapFlying;
+	}
+	if ( !parentMap )
+	{
+		printlog("[Sector Graph]: Parent map was NULL: %d", parentMapType);
+		return;
+	}
+
+	sectorsWide = (map.width + SECTOR_SIZE - 1) / SECTOR_SIZE;
+	sectorsHigh = (map.height + SECTOR_SIZE - 1) / SECTOR_SIZE;
+	sectorNodes.resize(sectorsWide * sectorsHigh);
+	gateTiles.assign(map.width * map.height, 0);
+	for ( auto& pair : gateGraph[parentMapType].gateNodes )
+	{
+		gateTiles[pair.second.y + pair.second.x * map.height] = 1;
+	}
+
+	auto open = [&](int x, int y) -> bool
+	{
+		if ( x < 0 || y < 0 || x >= (int)map.width || y >= (int)map.height )
+		{
+			return false;
+		}
+		const int tile = y + x * map.height;
+		return parentMap[tile] && !gateTiles[tile];
+	};
+
+	// place transitions across each opening between two sectors. short
+	// openings get one transition in the middle, long ones one at each end.
+	auto addTransitions = [&](int ax, int ay, int bx, int by, int dx, int dy, int length)
+	{
+		auto addTransition = [&](int i)
+		{
+			const int x1 = ax + dx * i, y1 = ay + dy * i;
+			const int x2 = bx + dx * i, y2 = by + dy * i;
+			const int a = addNode(x1, y1, false);
+			const int b = addNode(x2, y2, false);
+			addEdge(a, b, STRAIGHTCOST, 0, { y2 + x2 * (int)map.height });
+			addEdge(b, a, STRAIGHTCOST, 0, { y1 + x1 * (int)map.height });
+		};
+		if ( length >= 6 )
+		{
+			addTransition(0);
+			addTransition(length - 1);
+		}
+		else
+		{
+			addTransition(length / 2);
+		}
+	};
+
+	// borders between horizontally adjacent sectors
+	for ( int x = SECTOR_SIZE - 1; x < (int)map.width - 1; x += SECTOR_SIZE )
+	{
+		for ( int y0 = 0; y0 < (int)map.height; y0 += SECTOR_SIZE )
+		{
+			const int y1 = std::min(y0 + SECTOR_SIZE, (int)map.height);
+			int runStart = -1;
+			for ( int y = y0; y <= y1; ++y )
+			{
+				const bool passable = y < y1 && open(x, y) && open(x + 1, y);
+				if ( passable && runStart < 0 )
+				{
+					runStart = y;
+				}
+				else if ( !passable && runStart >= 0 )
+				{
+					addTransitions(x, runStart, x + 1, runStart, 0, 1, y - runStart);
+					runStart = -1;
+				}
+			}
+		}
+	}
+
+	// borders between vertically adjacent sectors
+	for ( int y = SECTOR_SIZE - 1; y < (int)map.height - 1; y += SECTOR_SIZE )
+	{
+		for ( int x0 = 0; x0 < (int)map.width; x0 += SECTOR_SIZE )
+		{
+			const int x1 = std::min(x0 + SECTOR_SIZE, (int)map.width);
+			int runStart = -1;
+			for ( int x = x0; x <= x1; ++x )
+			{
+				const bool passable = x < x1 && open(x, y) && open(x, y + 1);
+				if ( passable && runStart < 0 )
+				{
+					runStart = x;
+				}
+				else if ( !passable && runStart >= 0 )
+				{
+					addTransitions(runStart, y, runStart, y + 1, 1, 0, x - runStart);
+					runStart = -1;
+				}
+			}
+		}
+	}
+
+	// gates connect the tiles on either side of them, if open
+	for ( auto& pair : gateGraph[parentMapType].gateNodes )
+	{
+		auto& gate = pair.second;
+		int sides[2][2];
+		if ( gate.direction == GateGraph::DIR_NORTHSOUTH )
+		{
+			sides[0][0] = gate.x; sides[0][1] = gate.y - 1;
+			sides[1][0] = gate.x; sides[1][1] = gate.y + 1;
+		}
+		else
+		{
+			sides[0][0] = gate.x - 1; sides[0][1] = gate.y;
+			sides[1][0] = gate.x + 1; sides[1][1] = gate.y;
+		}
+		const int g = addNode(gate.x, gate.y, true);
+		for ( auto& side : sides )
+		{
+			if ( !open(side[0], side[1]) )
+			{
+				continue;
+			}
+			const int s = addNode(side[0], side[1], false);
+			addEdge(g, s, STRAIGHTCOST, gate.uid, { side[1] + side[0] * (int)map.height });
+			addEdge(s, g, STRAIGHTCOST, gate.uid, { gate.y + gate.x * (int)map.height });
+		}
+	}
+
+	for ( int sector = 0; sector < (int)sectorNodes.size(); ++sector )
+	{
+		buildSectorEdges(sector);
+	}
+
+	bIsInit = true;
+	printlog("[Sector Graph]: Map %d built with %d nodes, %d cached routes.", parentMapType, (int)nodes.size(), (int)routes.size());
+}
+
+// redoes the routes inside the sector holding x, y after that tile changed.
+// returns false if the change touches a sector border or a gate, in which
+// case the transitions themselves may differ and the graph needs rebuilding
+bool SectorGraph::updateTile(int x, int y)
+{
+	if ( !bIsInit )
+	{
+		return false;
+	}
+	const int lx = x % SECTOR_SIZE;
+	const int ly = y % SECTOR_SIZE;
+	if ( (lx == 0 && x > 0) || (lx == SECTOR_SIZE - 1 && x < (int)map.width - 1)
+		|| (ly == 0 && y > 0) || (ly == SECTOR_SIZE - 1 && y < (int)map.height - 1) )
+	{
+		return false;
+	}
+	const int around[5][2] = { { x, y }, { x + 1, y }, { x - 1, y }, { x, y + 1 }, { x, y - 1 } };
+	for ( auto& t : around )
+	{
+		if ( t[0] >= 0 && t[1] >= 0 && t[0] < (int)map.width && t[1] < (int)map.height
+			&& gateTiles[t[1] + t[0] * map.height] )
+		{
+			return false;
+		}
+	}
+
+	const int sector = getSector(x, y);
+	for ( int from : sectorNodes[sector] )
+	{
+		auto& edges = nodes[from].edges;
+		for ( auto it = edges.begin(); it != edges.end(); )
+		{
+			if ( it->gateUid == 0 && nodes[it->to].sector == sector )
+			{
+				std::vector<int>().swap(routes[it->route]);
+				freeRoutes.push_back(it->route);
+				it = edges.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+	}
+	buildSectorEdges(sector);
+	return true;
+}
+
+bool SectorGraph::generatePath(int x1, int y1, int x2, int y2, bool ignoreGates,
+	const std::function<bool(int, int)>& blocked, std::vector<int>& outTiles, int& outExpanded)
+{
+	outTiles.clear();
+	outExpanded = 0;
+	if ( !bIsInit )
+	{
+		return false;
+	}
+	const int srcSector = getSector(x1, y1);
+	const int destSector = getSector(x2, y2);
+	if ( srcSector == destSector )
+	{
+		return false; // a plain tile search is cheap enough
+	}
+	if ( gateTiles[y1 + x1 * map.height] || gateTiles[y2 + x2 * map.height] )
+	{
+		return false;
+	}
+
+	// tile-level work only happens in the first and last sectors
+	static thread_local SectorSearch_t srcSearch;
+	static thread_local SectorSearch_t destSearch;
+	searchSector(srcSearch, x1, y1, blocked);
+	searchSector(destSearch, x2, y2, blocked);
+
+	const int numNodes = nodes.size();
+	const int goal = numNodes;
+	static thread_local std::vector<Uint32> cost;
+	static thread_local std::vector<int> parent;
+	static thread_local std::vector<int> parentEdge;
+	static thread_local std::vector<Uint8> closed;
+	static thread_local std::vector<std::pair<Uint32, int>> heap;
+	cost.assign(numNodes + 1, 0xFFFFFFFF);
+	parent.assign(numNodes + 1, -1);
+	parentEdge.assign(numNodes + 1, -1);
+	closed.assign(numNodes + 1, 0);
+	heap.clear();
+	auto push = [&](Uint32 f, int id)
+	{
+		heap.push_back({ f, id });
+		std::push_heap(heap.begin(), heap.end(), std::greater<std::pair<Uint32, int>>());
+	};
+
+	for ( int id : sectorNodes[srcSector] )
+	{
+		const int l = srcSearch.local(nodes[id].x, nodes[id].y);
+		if ( srcSearch.reached[l] )
+		{
+			cost[id] = srcSearch.cost[l];
+			push(cost[id] + heuristic(nodes[id].x, nodes[id].y, x2, y2), id);
+		}
+	}
+
+	bool found = false;
+	while ( !heap.empty() )
+	{
+		std::pop_heap(heap.begin(), heap.end(), std::greater<std::pair<Uint32, int>>());
+		const int current = heap.back().second;
+		heap.pop_back();
+		if ( closed[current] )
+		{
+			continue;
+		}
+		closed[current] = 1;
+		++outExpanded;
+		if ( current == goal )
+		{
+			found = true;
+			break;
+		}
+
+		const Node_t& node = nodes[current];
+		if ( !node.isGate && node.sector == destSector )
+		{
+			const int l = destSearch.local(node.x, node.y);
+			if ( destSearch.reached[l] && cost[current] + destSearch.cost[l] < cost[goal] )
+			{
+				cost[goal] = cost[current] + destSearch.cost[l];
+				parent[goal] = current;
+				push(cost[goal], goal);
+			}
+		}
+		for ( int e = 0; e < (int)node.edges.size(); ++e )
+		{
+			const Edge_t& edge = node.edges[e];
+			if ( closed[edge.to] )
+			{
+				continue;
+			}
+			if ( edge.gateUid && !ignoreGates )
+			{
+				Entity* gateEntity = uidToEntity(edge.gateUid);
+				if ( gateEntity && !gateEntity->flags[PASSABLE] )
+				{
+					continue;
+				}
+			}
+			const Uint32 newCost = cost[current] + edge.cost;
+			if ( newCost < cost[edge.to] )
+			{
+				cost[edge.to] = newCost;
+				parent[edge.to] = current;
+				parentEdge[edge.to] = e;
+				push(newCost + heuristic(nodes[edge.to].x, nodes[edge.to].y, x2, y2), edge.to);
+			}
+		}
+	}
+	if ( !found )
+	{
+		return false;
+	}
+
+	std::vector<int> chain;
+	for ( int id = parent[goal]; id != -1; id = parent[id] )
+	{
+		chain.push_back(id);
+	}
+	std::reverse(chain.begin(), chain.end());
+
+	// refine the first sector, then stitch the cached routes together. the
+	// cached routes were built without this search's obstacles, so any that
+	// run through one are redone around it, or the caller falls back to A*
+	traceSectorRoute(srcSearch, nodes[chain.front()].x, nodes[chain.front()].y, outTiles);
+	for ( size_t i = 1; i < chain.size(); ++i )
+	{
+		const Node_t& from = nodes[chain[i - 1]];
+		const Node_t& to = nodes[chain[i]];
+		const Edge_t& edge = from.edges[parentEdge[chain[i]]];
+		const auto& route = routes[edge.route];
+		bool obstructed = false;
+		if ( blocked )
+		{
+			for ( int tile : route )
+			{
+				if ( blocked(tile / map.height, tile % map.height) )
+				{
+					obstructed = true;
+					break;
+				}
+			}
+		}
+		if ( !obstructed )
+		{
+			outTiles.insert(outTiles.end(), route.begin(), route.end());
+			continue;
+		}
+		if ( edge.gateUid || from.isGate || to.isGate || from.sector != to.sector )
+		{
+			return false; // a blocked gate or sector crossing has no way around
+		}
+		static thread_local SectorSearch_t detour;
+		searchSector(detour, from.x, from.y, blocked);
+		if ( !detour.reached[detour.local(to.x, to.y)] )
+		{
+			return false;
+		}
+		traceSectorRoute(detour, to.x, to.y, outTiles);
+	}
+
+	// and refine the last sector, which was searched outwards from the goal
+	std::vector<int> tail;
+	traceSectorRoute(destSearch, nodes[chain.back()].x, nodes[chain.back()].y, tail);
+	std::reverse(tail.begin(), tail.end());
+	if ( !tail.empty() )
+	{
+		tail.erase(tail.begin());
+	}
+	outTiles.insert(outTiles.end(), tail.begin(), tail.end());
+	const int goalTile = y2 + x2 * map.height;
+	if ( outTiles.empty() || outTiles.back() != goalTile )
+	{
+		outTiles.push_back(goalTile);
+	}
+	return true;
+}
+
+const FlowFieldCache::FlowField_t& FlowFieldCache::getField(Entity& target, int targetX, int targetY, int pathMapType)
+{
+	const Uint32 key = target.getUID() * GateGraph::GATE_GRAPH_NUM_PATHMAPS + pathMapType;
+	FlowField_t& field = fields[key];
+	field.lastUsedTick = ticks;
+	if ( field.targetX != targetX || field.targetY != targetY
+		|| field.pathMapGeneration != pathMapGeneration
+		|| field.distance.size() != map.width * map.height
+		|| ticks - field.builtOnTick > FIELD_MAX_AGE )
+	{
+		field.targetX = targetX;
+		field.targetY = targetY;
+		field.pathMapGeneration = pathMapGeneration;
+		field.builtOnTick = ticks;
+		build(field, pathMapType);
+		++numBuilds;
+		prune();
+	}
+	else
+	{
+		++numHits;
+	}
+	return field;
+}
+
+// roughly how many nodes A* would have expanded between x, y and the
+// field's target: the tiles whose distance to the target plus heuristic to
+// x, y is no more than the path itself. stops counting past limit, and
+// returns limit + 1 if x, y can't reach the target at all
+int FlowFieldCache::estimateExpansions(const FlowField_t& field, int x, int y, int limit) const
+{
+	const Uint32 pathCost = field.distance[y + x * map.height];
+	if ( pathCost == UNREACHABLE || limit < 0 )
+	{
+		return limit + 1;
+	}
+	if ( (int)(pathCost / DIAGONALCOST) > limit )
+	{
+		return limit + 1; // the path alone is longer than that
+	}
+
+	// every such tile is within pathCost of x, y by the heuristic
+	const int radius = pathCost / STRAIGHTCOST;
+	int count = 0;
+	for ( int u = std::max(0, x - radius); u <= std::min((int)map.width - 1, x + radius); ++u )
+	{
+		const int span = radius - abs(u - x);
+		for ( int v = std::max(0, y - span); v <= std::min((int)map.height - 1, y + span); ++v )
+		{
+			const Uint32 dist = field.distance[v + u * map.height];
+			if ( dist != UNREACHABLE && dist + heuristic(u, v, x, y) <= pathCost )
+			{
+				if ( ++count > limit )
+				{
+					return count;
+				}
+			}
+		}
+	}
+	return count;
+}
+
+void FlowFieldCache::build(FlowField_t& field, int pathMapType)
+{
+	const int* pathMap = (pathMapType == GateGraph::GATE_GRAPH_FLYING) ? pathMapFlying : pathMapGrounded;
+	field.distance.assign(map.width * map.height, UNREACHABLE);
+
+	// closed gates are the only entities shared by every hunter, the rest
+	// are checked per hunter while walking the field
+	static thread_local std::vector<Uint8> closedGates;
+	closedGates.assign(map.width * map.height, 0);
+	for ( auto& pair : gateGraph[pathMapType].gateNodes )
+	{
+		Entity* gate = uidToEntity(pair.second.uid);
+		if ( gate && !gate->flags[PASSABLE] )
+		{
+			closedGates[pair.second.y + pair.second.x * map.height] = 1;
+		}
+	}
+
+	auto passable = [&](int x, int y) -> bool
+	{
+		if ( x < 0 || y < 0 || x >= (int)map.width || y >= (int)map.height )
+		{
+			return false;
+		}
+		const int index = y + x * map.height;
+		return pathMap[index] && !closedGates[index];
+	};
+
+	static thread_local std::vector<std::pair<Uint32, int>> heap;
+	heap.clear();
+	const int start = field.targetY + field.targetX * map.height;
+	field.distance[start] = 0;
+	heap.push_back({ 0, start });
+	while ( !heap.empty() )
+	{
+		std::pop_heap(heap.begin(), heap.end(), std::greater<std::pair<Uint32, int>>());
+		const Uint32 dist = heap.back().first;
+		const int current = heap.back().second;
+		heap.pop_back();
+		if ( dist > field.distance[current] )
+		{
+			continue;
+		}
+		const int cx = current / map.height;
+		const int cy = current % map.height;
+		for ( int dy = -1; dy <= 1; ++dy )
+		{
+			for ( int dx = -1; dx <= 1; ++dx )
+			{
+				if ( dx == 0 && dy == 0 )
+				{
+					continue;
+				}
+				const int nx = cx + dx;
+				const int ny = cy + dy;
+				if ( !passable(nx, ny) )
+				{
+					continue;
+				}
+				if ( dx && dy && (!passable(cx, ny) || !passable(nx, cy)) )
+				{
+					continue;
+				}
+				const int index = ny + nx * map.height;
+				const Uint32 newDist = dist + ((dx && dy) ? DIAGONALCOST : STRAIGHTCOST);
+				if ( newDist < field.distance[index] )
+				{
+					field.distance[index] = newDist;
+					heap.push_back({ newDist, index });
+					std::push_heap(heap.begin(), heap.end(), std::greater<std::pair<Uint32, int>>());
+				}
+			}
+		}
+	}
+}
+
+void FlowFieldCache::prune()
+{
+	for ( auto it = fields.begin(); it != fields.end(); )
+	{
+		if ( ticks - it->second.lastUsedTick > 5 * TICKS_PER_SECOND )
+		{
+			it = fields.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+}
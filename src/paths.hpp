@@ -43,9 +43,11 @@ enum GeneratePathTypes
 	GENERATE_PATH_MOVEASIDE,
 	GENERATE_PATH_ACHIEVEMENT
 };
-extern int lastGeneratePathTries;
+extern thread_local int lastGeneratePathTries; // of the calling thread's last generatePath()
 list_t* generatePath(int x1, int y1, int x2, int y2, Entity* my, Entity* target, GeneratePathTypes pathingType, bool lavaIsPassable = false);
 void generatePathMaps();
+void updatePathMaps(int x, int y); // after a single tile changes passability
+void updatePathDebugStats(); // main thread, once a tick: publishes the last tick's /pathing_debug time
 // return true if an entity is blocks pathing
 bool isPathObstacle(Entity* entity);
 int pathCheckObstacle(int x, int y, Entity* my, Entity* target);
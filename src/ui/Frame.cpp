@@ -109,6 +109,9 @@ static ConsoleCommand ui_filter_refresh("/ui_filter_refresh", "refresh ui filter
 #endif
 
 void Frame::fboInit() {
+#ifdef BARONY_HEADLESS
+    return; // no GL context, frames are only kept for their state
+#endif
 #ifdef EDITOR
     gui_fb.init(Frame::virtualScreenX, Frame::virtualScreenY, GL_NEAREST, GL_NEAREST);
 #else
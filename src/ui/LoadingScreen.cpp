@@ -21,6 +21,9 @@ constexpr Uint32 loading_bar_color_filled = makeColor(255, 76, 49, 255);
 Uint32 loadingticks = 0;
 
 static void baseCreateLoadingScreen(real_t progress, const char* background_image) {
+#ifdef BARONY_HEADLESS
+	return; // no window to draw it in
+#endif
 	std::lock_guard<std::mutex> lock(loading_mutex);
 
 	if (!background_image) {
@@ -147,6 +150,9 @@ void createLevelLoadScreen(real_t progress) {
 }
 
 void doLoadingScreen() {
+#ifdef BARONY_HEADLESS
+	return; // no window to draw it in
+#endif
 	std::lock_guard<std::mutex> lock(loading_mutex);
 	auto loading_frame = gui->findFrame("loading_frame"); assert(loading_frame);
 	if (!loading_frame)
@@ -230,6 +236,9 @@ void doLoadingScreen() {
 }
 
 void updateLoadingScreen(real_t progress) {
+#ifdef BARONY_HEADLESS
+	return; // no window to draw it in
+#endif
 	std::lock_guard<std::mutex> lock(loading_mutex);
 	auto loading_frame = gui->findFrame("loading_frame");
 	if (!loading_frame)
@@ -283,6 +292,9 @@ void updateLoadingScreen(real_t progress) {
 }
 
 void destroyLoadingScreen() {
+#ifdef BARONY_HEADLESS
+	return; // no window to draw it in
+#endif
 	std::lock_guard<std::mutex> lock(loading_mutex);
 	gui->remove("loading_frame");
 	loading_fb.destroy();
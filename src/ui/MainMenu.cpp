@@ -10869,15 +10869,23 @@ bind_failed:
 			if ( playernum == 0 ) {
 				return;
 			}
-			if ( gameModeManager.currentSession.challengeRun.isActive() )
+			// the chunk number and count share a byte, so at most 15 chunks of 256
+			const size_t scenarioLen = gameModeManager.currentSession.challengeRun.scenarioStr.size();
+			const bool scenarioFits = scenarioLen <= 15 * 256;
+			if ( gameModeManager.currentSession.challengeRun.isActive() && !scenarioFits )
+			{
+				printlog("[NET]: Error - challenge scenario is %d bytes, too long to send to player %d (limit %d)",
+					(int)scenarioLen, playernum, 15 * 256);
+			}
+			if ( gameModeManager.currentSession.challengeRun.isActive() && scenarioFits )
 			{
 				// packet header
 				memcpy(net_packet->data, "CSCN", 4);
 				Uint8 sequence = 0;
 				// encode name
 				int chunksize = 256;
-				const size_t len = gameModeManager.currentSession.challengeRun.scenarioStr.size();
-				const int numchunks = 1 + (len / chunksize);
+				const size_t len = scenarioLen;
+				const int numchunks = (len + chunksize - 1) / chunksize;
 				for ( int c = 0; c < len; c += chunksize )
 				{
 					sequence += 1;
@@ -11148,14 +11156,30 @@ bind_failed:
 		}
 	}
 
-	static std::unordered_map<Uint32, void(*)()> serverPacketHandlers = {
+	// slot of the client that sent the packet being handled, -1 if unknown
+	static int lobbySender = -1;
+
+	static std::unordered_map<Uint32, void(*)(PacketReader&)> serverPacketHandlers = {
 		// network scan
-		{'SCAN', [](){
+		{'SCAN', [](PacketReader& packet){
 		    handleScanPacket();
 		}},
 
 		// update player attributes
-		{'PLYR', [](){
+		{'PLYR', [](PacketReader& packet){
+			const Uint8 player = packet.read8();
+			char name[33] = { 0 };
+			packet.readBytes(name, 32);
+			const int playerClass = (int)packet.read32();
+			const int sex = (int)packet.read32();
+	        Uint32 raceAndAppearance = packet.read32();
+			if (!packet.ok()) {
+				return;
+			}
+			if (player == 0 || player != lobbySender) {
+				return; // clients may only describe themselves
+			}
+
 		    // forward to other players
 			for (int i = 1; i < MAXPLAYERS; i++ ) {
 				if ( client_disconnected[i] ) {
@@ -11166,15 +11190,13 @@ bind_failed:
 				sendPacketSafe(net_sock, -1, net_packet, i - 1);
 			}
 
-			const Uint8 player = std::min(net_packet->data[4], (Uint8)(MAXPLAYERS - 1));
 			if (!loadingsavegame) {
 				stats[player]->clearStats();
 			}
 
-	        stringCopy(stats[player]->name, (char*)(&net_packet->data[5]), sizeof(Stat::name), 32);
-	        client_classes[player] = (int)SDLNet_Read32(&net_packet->data[37]);
-	        stats[player]->sex = static_cast<sex_t>((int)SDLNet_Read32(&net_packet->data[41]));
-	        Uint32 raceAndAppearance = SDLNet_Read32(&net_packet->data[45]);
+	        stringCopy(stats[player]->name, name, sizeof(Stat::name), 32);
+	        client_classes[player] = playerClass;
+	        stats[player]->sex = static_cast<sex_t>(sex);
 	        stats[player]->appearance = (raceAndAppearance & 0xFF00) >> 8;
 	        stats[player]->playerRace = (raceAndAppearance & 0xFF);
 
@@ -11184,7 +11206,16 @@ bind_failed:
 		}},
 
 		// update ready status
-		{'REDY', [](){
+		{'REDY', [](PacketReader& packet){
+			const Uint8 player = packet.read8();
+		    Uint8 status = packet.read8();
+			if (!packet.ok()) {
+				return;
+			}
+			if (player == 0 || player != lobbySender) {
+				return;
+			}
+
 		    // forward to other players
 			for (int i = 1; i < MAXPLAYERS; i++ ) {
 				if ( client_disconnected[i] ) {
@@ -11194,13 +11225,17 @@ bind_failed:
 				net_packet->address.port = net_clients[i - 1].port;
 				sendPacketSafe(net_sock, -1, net_packet, i - 1);
 			}
-			const Uint8 player = std::min(net_packet->data[4], (Uint8)(MAXPLAYERS - 1));
-		    Uint8 status = net_packet->data[5];
 		    createReadyStone((int)player, false, status ? true : false);
 		}},
 
 		// got a chat message from client
-		{'CMSG', [](){
+		{'CMSG', [](PacketReader& packet){
+			const Uint32 color = packet.read32();
+			char text[NET_PACKET_SIZE];
+			if (!packet.readString(text, sizeof(text))) {
+				return;
+			}
+
 		    // forward to other players
 			for (int i = 1; i < MAXPLAYERS; i++ ) {
 				if ( client_disconnected[i] ) {
@@ -11210,14 +11245,13 @@ bind_failed:
 				net_packet->address.port = net_clients[i - 1].port;
 				sendPacketSafe(net_sock, -1, net_packet, i - 1);
 			}
-			const Uint32 color = SDLNet_Read32(&net_packet->data[4]);
-			addLobbyChatMessage(color, (char*)(&net_packet->data[8]));
+			addLobbyChatMessage(color, text);
 		}},
 
 		// received manual client ping
-		{'PING', [](){
-			const int j = net_packet->data[4];
-			if (j <= 0 || j >= MAXPLAYERS ) {
+		{'PING', [](PacketReader& packet){
+			const int j = packet.read8();
+			if (!packet.ok() || j <= 0 || j >= MAXPLAYERS ) {
 				return;
 			}
 			if (client_disconnected[j] || players[j]->isLocalPlayer()) {
@@ -11231,19 +11265,19 @@ bind_failed:
 		}},
 
 		// automated ping
-		{'PNGU', []() {
-			PingNetworkStatus_t::respond();
+		{'PNGU', [](PacketReader& packet) {
+			PingNetworkStatus_t::respond(packet);
 		}},
 
 		// automated ping response
-		{'PNGR', []() {
-			PingNetworkStatus_t::receive();
+		{'PNGR', [](PacketReader& packet) {
+			PingNetworkStatus_t::receive(packet);
 		}},
 
 		// player disconnected
-		{'DISC', [](){
-			const Uint8 player = std::min(net_packet->data[4], (Uint8)(MAXPLAYERS - 1));
-            if (player == 0) {
+		{'DISC', [](PacketReader& packet){
+			const Uint8 player = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+            if (!packet.ok() || player == 0) {
                 // yeah right
                 return;
             }
@@ -11279,12 +11313,15 @@ bind_failed:
 		}},
 
 		// client requesting game scenario
-		{ 'CSCN', []() {
-			sendCustomScenarioOverNet(net_packet->data[4]);
+		{ 'CSCN', [](PacketReader& packet) {
+			const int player = packet.read8();
+			if (packet.ok()) {
+				sendCustomScenarioOverNet(player);
+			}
 		} },
 
 		// client requesting new svFlags
-		{'SVFL', [](){
+		{'SVFL', [](PacketReader& packet){
 			// update svFlags for everyone
 			SDLNet_Write32(svFlags, &net_packet->data[4]);
 			net_packet->len = 8;
@@ -11320,14 +11357,16 @@ bind_failed:
 		}},
 
 		// keepalive
-		{'KPAL', [](){
-			const Uint8 player = std::min(net_packet->data[4], (Uint8)(MAXPLAYERS - 1));
-			client_keepalive[player] = ticks;
+		{'KPAL', [](PacketReader& packet){
+			const Uint8 player = std::min(packet.read8(), (Uint8)(MAXPLAYERS - 1));
+			if (packet.ok()) {
+				client_keepalive[player] = ticks;
+			}
 		}},
 
 		// the client sent a gameplayer preferences update
-		{'GPPR', []() {
-			GameplayPreferences_t::receivePacket();
+		{'GPPR', [](PacketReader& packet) {
+			GameplayPreferences_t::receivePacket(packet);
 		}},
     };
 
@@ -11342,10 +11381,12 @@ bind_failed:
         updateLobby();
 
 		for (int numpacket = 0; numpacket < PACKET_LIMIT; numpacket++) {
+			lobbySender = -1;
 			if (directConnect) {
 				if (!SDLNet_UDP_Recv(net_sock, net_packet)) {
 					break;
 				}
+				lobbySender = directConnectSender();
 			} else {
 				if (LobbyHandler.getP2PType() == LobbyHandler_t::LobbyServiceType::LOBBY_STEAM) {
 #ifdef STEAMWORKS
@@ -11367,6 +11408,13 @@ bind_failed:
 					if (mySteamID.ConvertToUint64() == newSteamID.ConvertToUint64()) {
 						continue;
 					}
+					for (int c = 1; c < MAXPLAYERS; c++) {
+						if (!client_disconnected[c] && steamIDRemote[c - 1] &&
+							newSteamID.ConvertToUint64() == (static_cast<CSteamID*>(steamIDRemote[c - 1]))->ConvertToUint64()) {
+							lobbySender = c;
+							break;
+						}
+					}
 #endif // STEAMWORKS
 				} else if (LobbyHandler.getP2PType() == LobbyHandler_t::LobbyServiceType::LOBBY_CROSSPLAY) {
 #ifdef USE_EOS
@@ -11374,6 +11422,12 @@ bind_failed:
 						continue;
 					}
 					EOS.P2PConnectionInfo.insertProductIdIntoPeers(newRemoteProductId);
+					if (newRemoteProductId && EOS.P2PConnectionInfo.isPeerIndexed(newRemoteProductId)) {
+						const int index = EOS.P2PConnectionInfo.getIndexFromPeerId(newRemoteProductId);
+						if (index >= 0 && index + 1 < MAXPLAYERS && !client_disconnected[index + 1]) {
+							lobbySender = index + 1;
+						}
+					}
 #endif // USE_EOS
 				}
 			}
@@ -11500,7 +11554,9 @@ bind_failed:
 		            (char)net_packet->data[2],
 		            (char)net_packet->data[3]);
 		    } else {
-		        (*(find->second))(); // handle packet
+		        PacketReader packet(net_packet->data, net_packet->len);
+		        packet.skip(4); // the id
+		        (*(find->second))(packet); // handle packet
 		    }
 		}
 	}
@@ -11605,12 +11661,16 @@ bind_failed:
 
 		// automated ping
 		{'PNGU', []() {
-			PingNetworkStatus_t::respond();
+			PacketReader packet(net_packet->data, net_packet->len);
+			packet.skip(4); // the id
+			PingNetworkStatus_t::respond(packet);
 		}},
 
 		// automated ping response
 		{'PNGR', []() {
-			PingNetworkStatus_t::receive();
+			PacketReader packet(net_packet->data, net_packet->len);
+			packet.skip(4); // the id
+			PingNetworkStatus_t::receive(packet);
 		}},
 
 		// player disconnect
@@ -11739,7 +11799,9 @@ bind_failed:
 
 		// the server sent a game player preferences update
 		{'GPPR', []() {
-			GameplayPreferences_t::receivePacket();
+			PacketReader packet(net_packet->data, net_packet->len);
+			packet.skip(4); // the id
+			GameplayPreferences_t::receivePacket(packet);
 		}},
 
 		// the server requested a game player preferences update
@@ -11916,9 +11978,9 @@ bind_failed:
 
 					// now set up everybody else
 					for (int c = 0; c < MAXPLAYERS; c++) {
-						const int chunk_size = loadingsavegame ?
-							6 + 32 + 6 * 10:	// 6 bytes for player stats, 32 for name, 60 for equipment
-							6 + 32;				// 6 bytes for player stats, 32 for name
+						const int chunk_size = loadingsavegame && HELO_SENDS_EQUIPMENT ?
+							HELO_PLAYER_LEN + HELO_EQUIPMENT_LEN:	// 6 bytes for player stats, 32 for name, 60 for equipment
+							HELO_PLAYER_LEN;						// 6 bytes for player stats, 32 for name
 							
 						stats[c]->clearStats();
 						client_disconnected[c] = net_packet->data[8 + c * chunk_size + 0]; // connectedness
@@ -11929,7 +11991,7 @@ bind_failed:
 						stats[c]->playerRace = net_packet->data[8 + c * chunk_size + 5]; // player race
 						stringCopy(stats[c]->name, (char*)(net_packet->data + 8 + c * chunk_size + 6), sizeof(Stat::name), 32); // name
 
-						if (loadingsavegame) {
+						if (loadingsavegame && HELO_SENDS_EQUIPMENT) {
 							Item** player_slots[] = {
 								&stats[c]->helmet,
 								&stats[c]->breastplate,
@@ -11951,7 +12013,7 @@ bind_failed:
 									slot = newItem((ItemType)type, Status::EXCELLENT, 0, 1, (Uint32)appearance, true, nullptr);
 								}
 							}
-						} else {
+						} else if (!loadingsavegame) {
 							initClass(c);
 						}
 					}